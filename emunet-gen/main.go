@@ -1,6 +1,7 @@
 package main
 
 import (
+	"bufio"
 	"bytes"
 	"encoding/json"
 	"flag"
@@ -9,6 +10,9 @@ import (
 	"log"
 	"math/rand"
 	"net/http"
+	"sort"
+	"strconv"
+	"strings"
 	"sync"
 	"sync/atomic"
 	"time"
@@ -17,13 +21,43 @@ import (
 // ================= 配置与结构体 =================
 
 type Config struct {
-	Mode          string // "gen", "clean", "churn"
+	Mode          string // "gen", "clean", "churn", "topo", "e2e"
 	MasterURL     string
 	Namespace     string
 	EmuNetName    string
 	TotalRequests int
 	Concurrency   int
 	Interval      time.Duration // [新增] 更新间隔 (例如 10ms)
+
+	// Gilbert-Elliott 突发丢包参数 (单位 0.01%)，由数据面逐包演化，无需 churn 模拟突发
+	GeP       uint
+	GeR       uint
+	GeLossBad uint
+
+	// 抖动分布 (0 均匀，1 正态，2 Pareto) 与保序模式，保序时抖动不会触发 TCP 快速重传
+	JitterDist    uint
+	JitterOrdered bool
+
+	// netem 式包级损伤 (单位 0.01%)，用于协议健壮性测试
+	DupRate     uint
+	CorruptRate uint
+	ReorderRate uint
+	ReorderGap  uint
+
+	// 两个方向都写在 pod1 的 veth 上 (入口/出口)，每条链路只下发到一个节点
+	Ingress bool
+
+	// Bulk 为 true 时整份链路以一个 NDJSON 请求发往 /api/v1/topology，不再逐对 POST
+	Bulk bool
+	// topo 模式下由 linkserver 展开的拓扑: mesh / ring / fattree (K 为端口数)
+	Topology string
+	K        int
+	Seed     int64
+
+	// e2e 模式: 依次预置到各规模的链路数，在每个规模下按各速率持续 E2EDuration 发送更新
+	E2ESizes    string
+	E2ERates    string
+	E2EDuration time.Duration
 }
 
 type PodInfo struct {
@@ -42,15 +76,63 @@ type APIResponse struct {
 type EBPFEntryByPodsRequest struct {
 	Pod1            string `json:"pod1"`
 	Pod2            string `json:"pod2"`
-	ThrottleRateBps uint32 `json:"throttleRateBps"`
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
 	Delay           uint32 `json:"delay"`
 	LossRate        uint32 `json:"lossRate"`
 	Jitter          uint32 `json:"jitter"`
+	GeP             uint32 `json:"geP,omitempty"`
+	GeR             uint32 `json:"geR,omitempty"`
+	GeLossBad       uint32 `json:"geLossBad,omitempty"`
+	JitterDist      uint32 `json:"jitterDist,omitempty"`
+	JitterOrdered   bool   `json:"jitterOrdered,omitempty"`
+	DupRate         uint32 `json:"dupRate,omitempty"`
+	CorruptRate     uint32 `json:"corruptRate,omitempty"`
+	ReorderRate     uint32 `json:"reorderRate,omitempty"`
+	ReorderGap      uint32 `json:"reorderGap,omitempty"`
+	Ingress         bool   `json:"ingress,omitempty"`
 }
 
 type EBPFEntryDeleteByPodsRequest struct {
-	Pod1 string `json:"pod1"`
-	Pod2 string `json:"pod2"`
+	Pod1    string `json:"pod1"`
+	Pod2    string `json:"pod2"`
+	Ingress bool   `json:"ingress,omitempty"`
+}
+
+// TopologySpec 与 linkserver 的 api.TopologySpec 一致 (只列出这里用到的字段)
+type TopologySpec struct {
+	Kind          string               `json:"kind"`
+	Namespace     string               `json:"namespace,omitempty"`
+	Name          string               `json:"name,omitempty"`
+	Pods          []string             `json:"pods,omitempty"`
+	K             int                  `json:"k,omitempty"`
+	Seed          int64                `json:"seed,omitempty"`
+	Ingress       bool                 `json:"ingress,omitempty"`
+	GeP           uint32               `json:"geP,omitempty"`
+	GeR           uint32               `json:"geR,omitempty"`
+	GeLossBad     uint32               `json:"geLossBad,omitempty"`
+	JitterDist    uint32               `json:"jitterDist,omitempty"`
+	JitterOrdered bool                 `json:"jitterOrdered,omitempty"`
+	DupRate       uint32               `json:"dupRate,omitempty"`
+	CorruptRate   uint32               `json:"corruptRate,omitempty"`
+	ReorderRate   uint32               `json:"reorderRate,omitempty"`
+	ReorderGap    uint32               `json:"reorderGap,omitempty"`
+	Dists         map[string]ParamDist `json:"dists,omitempty"`
+}
+
+type ParamDist struct {
+	Type string  `json:"type,omitempty"`
+	Min  float64 `json:"min,omitempty"`
+	Max  float64 `json:"max,omitempty"`
+}
+
+type TopologyResult struct {
+	Status      string   `json:"status"`
+	Links       int      `json:"links"`
+	Rules       int      `json:"rules"`
+	Nodes       int      `json:"nodes"`
+	Skipped     int      `json:"skipped"`
+	MissingPods []string `json:"missingPods"`
+	LatencyUs   int64    `json:"latencyUs"`
 }
 
 type PodPair struct {
@@ -87,20 +169,41 @@ func main() {
 		doClean(client, cfg)
 	case "churn": // [新增模式]
 		doChurn(client, cfg)
+	case "topo":
+		doTopology(client, cfg)
+	case "e2e":
+		doE2E(client, cfg)
 	default:
-		log.Fatalf("未知模式: %s (可选: gen, clean, churn)", cfg.Mode)
+		log.Fatalf("未知模式: %s (可选: gen, clean, churn, topo, e2e)", cfg.Mode)
 	}
 }
 
 func parseFlags() Config {
 	cfg := Config{}
-	flag.StringVar(&cfg.Mode, "mode", "gen", "模式: 'gen'(一次性), 'clean'(清理), 'churn'(持续高频抖动)")
+	flag.StringVar(&cfg.Mode, "mode", "gen", "模式: 'gen'(一次性), 'clean'(清理), 'churn'(持续高频抖动), 'topo'(服务端展开拓扑), 'e2e'(端到端下发时延)")
 	flag.StringVar(&cfg.MasterURL, "url", "http://localhost:8082", "Master API 地址")
 	flag.StringVar(&cfg.Namespace, "ns", "default", "Namespace")
 	flag.StringVar(&cfg.EmuNetName, "name", "emunet-example", "EmuNet Name")
 	flag.IntVar(&cfg.TotalRequests, "count", 1000, "总请求数 (仅gen模式)")
 	flag.IntVar(&cfg.Concurrency, "workers", 50, "并发 Worker 数")
 	flag.DurationVar(&cfg.Interval, "interval", 10*time.Millisecond, "churn模式下的循环间隔 (默认10ms)")
+	flag.UintVar(&cfg.GeP, "ge-p", 0, "突发丢包: 好->坏状态转移概率 (0.01%), 0 表示独立丢包")
+	flag.UintVar(&cfg.GeR, "ge-r", 0, "突发丢包: 坏->好状态转移概率 (0.01%)")
+	flag.UintVar(&cfg.GeLossBad, "ge-loss-bad", 0, "突发丢包: 坏状态丢包率 (0.01%)")
+	flag.UintVar(&cfg.JitterDist, "jitter-dist", 0, "抖动分布: 0 均匀, 1 正态, 2 Pareto")
+	flag.BoolVar(&cfg.JitterOrdered, "jitter-ordered", false, "保序抖动: 同一链路的包不因抖动乱序")
+	flag.UintVar(&cfg.DupRate, "dup", 0, "包复制概率 (0.01%)")
+	flag.UintVar(&cfg.CorruptRate, "corrupt", 0, "载荷比特损坏概率 (0.01%)，接收方按校验和丢弃")
+	flag.UintVar(&cfg.ReorderRate, "reorder", 0, "重排概率 (0.01%)，被选中的包跳过时延")
+	flag.UintVar(&cfg.ReorderGap, "reorder-gap", 0, "重排间隔: 每 gap-1 个正常延迟的包之后才考虑重排")
+	flag.BoolVar(&cfg.Ingress, "ingress", false, "双向规则都写在 pod1 所在节点 (需 CNI 启用 ingress)")
+	flag.BoolVar(&cfg.Bulk, "bulk", false, "gen/clean/churn: 整份链路以一个 NDJSON 请求批量导入")
+	flag.StringVar(&cfg.Topology, "topology", "mesh", "topo模式的拓扑: mesh, ring, fattree")
+	flag.IntVar(&cfg.K, "k", 4, "fattree 端口数 (偶数)")
+	flag.Int64Var(&cfg.Seed, "seed", 0, "topo模式参数分布的随机种子 (0 表示按当前时间)")
+	flag.StringVar(&cfg.E2ESizes, "e2e-sizes", "0,10000,100000", "e2e模式: 依次预置的链路规模 (逗号分隔)")
+	flag.StringVar(&cfg.E2ERates, "e2e-rates", "100,1000,5000", "e2e模式: 每个规模下的更新速率 (次/秒，逗号分隔)")
+	flag.DurationVar(&cfg.E2EDuration, "e2e-duration", 10*time.Second, "e2e模式: 每个速率的持续时间")
 	flag.Parse()
 	return cfg
 }
@@ -136,6 +239,10 @@ func doChurn(client *http.Client, cfg Config) {
 			})
 		}
 	}
+	if cfg.Bulk {
+		churnBulk(cfg, allPairs)
+		return
+	}
 	log.Printf("检测到 %d 个 Pod，共 %d 条链路。正在启动 %d 个 Worker...", n, len(allPairs), cfg.Concurrency)
 
 	// 3. 启动 Workers
@@ -149,20 +256,7 @@ func doChurn(client *http.Client, cfg Config) {
 			// 每个 Worker 独立随机源
 			r := rand.New(rand.NewSource(time.Now().UnixNano()))
 			for p := range jobs {
-				// --- 随机生成大延迟和丢包 ---
-				randomDelay := uint32(r.Intn(100000) + 10000) // 10ms ~ 110ms
-				randomLoss := uint32(r.Intn(2500) + 500)      // 5% ~ 30%
-				randomJitter := uint32(r.Intn(1000) + 100)    // 0.1ms ~ 1.1ms
-
-				reqData := EBPFEntryByPodsRequest{
-					Pod1:            p.Pod1,
-					Pod2:            p.Pod2,
-					ThrottleRateBps: 0,
-					Delay:           randomDelay,
-					LossRate:        randomLoss,
-					Jitter:          randomJitter,
-				}
-
+				reqData := randomLink(r, cfg, p.Pod1, p.Pod2)
 				if err := sendJSON(client, "POST", targetURL, reqData); err == nil {
 					atomic.AddInt64(&stats.Success, 1)
 				} else {
@@ -228,6 +322,25 @@ func doGenerate(client *http.Client, cfg Config) {
 	}
 	log.Printf("有效种子 Pod 数量: %d, 目标生成请求: %d", len(activePods), cfg.TotalRequests)
 
+	if cfg.Bulk {
+		r := rand.New(rand.NewSource(time.Now().UnixNano()))
+		sent := 0
+		res, err := streamLinks(cfg, "POST", func() (EBPFEntryByPodsRequest, bool) {
+			if sent == cfg.TotalRequests {
+				return EBPFEntryByPodsRequest{}, false
+			}
+			sent++
+			p1 := activePods[r.Intn(len(activePods))]
+			p2 := activePods[r.Intn(len(activePods))]
+			for p1.PodName == p2.PodName {
+				p2 = activePods[r.Intn(len(activePods))]
+			}
+			return randomLink(r, cfg, p1.PodName, p2.PodName), true
+		})
+		reportTopology("生成模式", res, err)
+		return
+	}
+
 	start := time.Now()
 	stats := Stats{}
 	var wg sync.WaitGroup
@@ -255,16 +368,7 @@ func doGenerate(client *http.Client, cfg Config) {
 					p2 = activePods[r.Intn(len(activePods))]
 				}
 
-				// 参数: 延迟(10-110ms), 丢包(5-30%), 抖动(0.1-1.1ms)
-				reqData := EBPFEntryByPodsRequest{
-					Pod1:            p1.PodName,
-					Pod2:            p2.PodName,
-					ThrottleRateBps: 0,
-					Delay:           uint32(r.Intn(100000) + 10000),
-					LossRate:        uint32(r.Intn(2500) + 500),
-					Jitter:          uint32(r.Intn(1000) + 100),
-				}
-
+				reqData := randomLink(r, cfg, p1.PodName, p2.PodName)
 				if err := sendJSON(client, "POST", targetURL, reqData); err == nil {
 					atomic.AddInt64(&stats.Success, 1)
 				} else {
@@ -302,6 +406,17 @@ func doClean(client *http.Client, cfg Config) {
 	totalPairs := n * (n - 1) / 2
 	log.Printf("检测到 %d 个 Pod，生成 %d 对唯一组合进行清理...", n, totalPairs)
 
+	if cfg.Bulk {
+		// 全部组合即 mesh，由 linkserver 展开，请求体只有 Pod 列表
+		spec := TopologySpec{Kind: "mesh", Ingress: cfg.Ingress}
+		for _, p := range pods {
+			spec.Pods = append(spec.Pods, p.PodName)
+		}
+		res, err := sendTopology(cfg, "DELETE", spec)
+		reportTopology("清理模式", res, err)
+		return
+	}
+
 	start := time.Now()
 	stats := Stats{}
 	var wg sync.WaitGroup
@@ -315,8 +430,9 @@ func doClean(client *http.Client, cfg Config) {
 			defer wg.Done()
 			for p := range jobs {
 				reqData := EBPFEntryDeleteByPodsRequest{
-					Pod1: p.Pod1,
-					Pod2: p.Pod2,
+					Pod1:    p.Pod1,
+					Pod2:    p.Pod2,
+					Ingress: cfg.Ingress,
 				}
 				if err := sendJSON(client, "DELETE", targetURL, reqData); err == nil {
 					atomic.AddInt64(&stats.Success, 1)
@@ -350,6 +466,371 @@ func doClean(client *http.Client, cfg Config) {
 		time.Since(start), stats.Success, stats.Failed, tps)
 }
 
+// ================= 批量导入 (Bulk / Topo) =================
+
+// bulkClient 用于整份拓扑的单个长请求，不受逐对请求 5s 超时的限制
+var bulkClient = &http.Client{Timeout: 10 * time.Minute}
+
+// doTopology 只发送生成器规格，链路由 linkserver 按 EmuNet 的 Pod 列表展开；
+// 延迟、丢包、抖动的分布与 gen 模式相同
+func doTopology(_ *http.Client, cfg Config) {
+	log.Printf("=== [TOPO] 服务端展开 %s 拓扑 ===", cfg.Topology)
+	seed := cfg.Seed
+	if seed == 0 {
+		seed = time.Now().UnixNano()
+	}
+	spec := TopologySpec{
+		Kind:          cfg.Topology,
+		Namespace:     cfg.Namespace,
+		Name:          cfg.EmuNetName,
+		K:             cfg.K,
+		Seed:          seed,
+		Ingress:       cfg.Ingress,
+		GeP:           uint32(cfg.GeP),
+		GeR:           uint32(cfg.GeR),
+		GeLossBad:     uint32(cfg.GeLossBad),
+		JitterDist:    uint32(cfg.JitterDist),
+		JitterOrdered: cfg.JitterOrdered,
+		DupRate:       uint32(cfg.DupRate),
+		CorruptRate:   uint32(cfg.CorruptRate),
+		ReorderRate:   uint32(cfg.ReorderRate),
+		ReorderGap:    uint32(cfg.ReorderGap),
+		Dists: map[string]ParamDist{
+			"delay":    {Min: 10000, Max: 110000},
+			"lossRate": {Min: 500, Max: 3000},
+			"jitter":   {Min: 100, Max: 1100},
+		},
+	}
+	res, err := sendTopology(cfg, "POST", spec)
+	reportTopology("拓扑模式", res, err)
+}
+
+// churnBulk 每个周期把全部链路重新随机一遍，以一个 NDJSON 请求整体下发
+func churnBulk(cfg Config, allPairs []PodPair) {
+	log.Printf("共 %d 条链路，每 %v 批量下发一轮，按 Ctrl+C 停止...", len(allPairs), cfg.Interval)
+	r := rand.New(rand.NewSource(time.Now().UnixNano()))
+	ticker := time.NewTicker(cfg.Interval)
+	defer ticker.Stop()
+	for range ticker.C {
+		i := 0
+		res, err := streamLinks(cfg, "POST", func() (EBPFEntryByPodsRequest, bool) {
+			if i == len(allPairs) {
+				return EBPFEntryByPodsRequest{}, false
+			}
+			p := allPairs[i]
+			i++
+			return randomLink(r, cfg, p.Pod1, p.Pod2), true
+		})
+		if err != nil {
+			log.Printf("[错误] 批量下发失败: %v", err)
+			continue
+		}
+		log.Printf("一轮下发 %d 条链路 (%d 条规则, %d 个节点)，耗时 %v", res.Links, res.Rules, res.Nodes, time.Duration(res.LatencyUs)*time.Microsecond)
+	}
+}
+
+// randomLink 生成随机参数的链路: 延迟(10-110ms), 丢包(5-30%), 抖动(0.1-1.1ms)
+func randomLink(r *rand.Rand, cfg Config, pod1, pod2 string) EBPFEntryByPodsRequest {
+	return EBPFEntryByPodsRequest{
+		Pod1:            pod1,
+		Pod2:            pod2,
+		ThrottleRateBps: 0,
+		Delay:           uint32(r.Intn(100000) + 10000),
+		LossRate:        uint32(r.Intn(2500) + 500),
+		Jitter:          uint32(r.Intn(1000) + 100),
+		GeP:             uint32(cfg.GeP),
+		GeR:             uint32(cfg.GeR),
+		GeLossBad:       uint32(cfg.GeLossBad),
+		JitterDist:      uint32(cfg.JitterDist),
+		JitterOrdered:   cfg.JitterOrdered,
+		DupRate:         uint32(cfg.DupRate),
+		CorruptRate:     uint32(cfg.CorruptRate),
+		ReorderRate:     uint32(cfg.ReorderRate),
+		ReorderGap:      uint32(cfg.ReorderGap),
+		Ingress:         cfg.Ingress,
+	}
+}
+
+// streamLinks 边生成边把链路逐行写入请求体，客户端内存与链路数无关
+func streamLinks(cfg Config, method string, next func() (EBPFEntryByPodsRequest, bool)) (*TopologyResult, error) {
+	pr, pw := io.Pipe()
+	go func() {
+		bw := bufio.NewWriterSize(pw, 1<<20)
+		enc := json.NewEncoder(bw)
+		for {
+			link, ok := next()
+			if !ok {
+				break
+			}
+			if err := enc.Encode(link); err != nil {
+				pw.CloseWithError(err)
+				return
+			}
+		}
+		pw.CloseWithError(bw.Flush())
+	}()
+	return postTopology(cfg, method, "application/x-ndjson", pr)
+}
+
+func sendTopology(cfg Config, method string, spec TopologySpec) (*TopologyResult, error) {
+	body, err := json.Marshal(spec)
+	if err != nil {
+		return nil, err
+	}
+	return postTopology(cfg, method, "application/json", bytes.NewReader(body))
+}
+
+// postTopology 发送拓扑并等待 linkserver 确认全部规则已下发 (?wait=true)
+func postTopology(cfg Config, method, contentType string, body io.Reader) (*TopologyResult, error) {
+	url := fmt.Sprintf("%s/api/v1/topology?wait=true", cfg.MasterURL)
+	req, err := http.NewRequest(method, url, body)
+	if err != nil {
+		return nil, err
+	}
+	req.Header.Set("Content-Type", contentType)
+
+	resp, err := bulkClient.Do(req)
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Body.Close()
+
+	var apiResp struct {
+		Success bool           `json:"success"`
+		Data    TopologyResult `json:"data"`
+		Error   string         `json:"error"`
+	}
+	if err := json.NewDecoder(resp.Body).Decode(&apiResp); err != nil {
+		return nil, fmt.Errorf("status %d: JSON解析失败: %v", resp.StatusCode, err)
+	}
+	if !apiResp.Success {
+		return nil, fmt.Errorf("status %d: %s", resp.StatusCode, apiResp.Error)
+	}
+	return &apiResp.Data, nil
+}
+
+func reportTopology(title string, res *TopologyResult, err error) {
+	if err != nil {
+		log.Fatalf("%s批量导入失败: %v", title, err)
+	}
+	fmt.Printf("\n--- %s统计 (批量) ---\n耗时: %v\n链路: %d, 规则: %d, 节点: %d, 跳过: %d\n",
+		title, time.Duration(res.LatencyUs)*time.Microsecond, res.Links, res.Rules, res.Nodes, res.Skipped)
+	if len(res.MissingPods) > 0 {
+		fmt.Printf("缺失 Pod (部分): %v\n", res.MissingPods)
+	}
+	fmt.Printf("-------------------\n")
+}
+
+// ================= 端到端下发时延 (E2E) =================
+
+// e2eSample 为一次更新的两段时延：client 为发出请求到收到 agent 确认，server 为 linkserver 统计的下发时延
+type e2eSample struct {
+	client time.Duration
+	server time.Duration
+}
+
+// doE2E 逐步增大规则表并提高更新速率，每次更新带 ?wait=true，只有 agent 确认写入 map 才计为成功，
+// 分别报告客户端与服务端时延的 p50/p99/p999
+func doE2E(client *http.Client, cfg Config) {
+	log.Printf("=== [E2E] 端到端下发时延测试 ===")
+	sizes, err := parseInts(cfg.E2ESizes)
+	if err != nil {
+		log.Fatalf("-e2e-sizes 非法: %v", err)
+	}
+	rates, err := parseInts(cfg.E2ERates)
+	if err != nil {
+		log.Fatalf("-e2e-rates 非法: %v", err)
+	}
+	for _, rate := range rates {
+		if rate == 0 {
+			log.Fatalf("-e2e-rates 不能包含 0")
+		}
+	}
+
+	pods, err := fetchPodsViaAPI(client, cfg)
+	if err != nil {
+		log.Fatalf("获取 Pod 列表失败: %v", err)
+	}
+	var activePods []PodInfo
+	for _, p := range pods {
+		if p.Phase == "Running" && p.NodeName != "" {
+			activePods = append(activePods, p)
+		}
+	}
+	if len(activePods) < 2 {
+		log.Fatalf("有效 Pod 数量不足 (%d)", len(activePods))
+	}
+
+	r := rand.New(rand.NewSource(time.Now().UnixNano()))
+	randomPair := func() PodPair {
+		p1 := activePods[r.Intn(len(activePods))]
+		p2 := activePods[r.Intn(len(activePods))]
+		for p1.PodName == p2.PodName {
+			p2 = activePods[r.Intn(len(activePods))]
+		}
+		return PodPair{Pod1: p1.PodName, Pod2: p2.PodName}
+	}
+
+	fmt.Printf("\n%10s %8s %8s %8s %8s | %10s %10s %10s | %10s %10s\n",
+		"links", "rate", "sent", "ok", "failed", "p50", "p99", "p999", "srv p50", "srv p99")
+	loaded := 0
+	for _, size := range sizes {
+		// 预置链路走批量接口，随机组合可能重复，规模为近似值
+		if size > loaded {
+			remaining := size - loaded
+			res, err := streamLinks(cfg, "POST", func() (EBPFEntryByPodsRequest, bool) {
+				if remaining == 0 {
+					return EBPFEntryByPodsRequest{}, false
+				}
+				remaining--
+				p := randomPair()
+				return randomLink(r, cfg, p.Pod1, p.Pod2), true
+			})
+			if err != nil {
+				log.Fatalf("预置 %d 条链路失败: %v", size, err)
+			}
+			loaded = size
+			log.Printf("已预置 %d 条链路 (%d 条规则)，耗时 %v", loaded, res.Rules, time.Duration(res.LatencyUs)*time.Microsecond)
+		}
+		for _, rate := range rates {
+			samples, sent, failed := runE2EStage(client, cfg, rate, randomPair)
+			printE2EStage(loaded, rate, sent, failed, samples)
+		}
+	}
+}
+
+// runE2EStage 按固定速率 (开环) 发出更新，Worker 不足以跟上速率时计入失败而不是降速，避免掩盖排队时延
+func runE2EStage(client *http.Client, cfg Config, rate int, pair func() PodPair) ([]e2eSample, int64, int64) {
+	targetURL := fmt.Sprintf("%s/api/v1/ebpf/entry/by-pods?wait=true", cfg.MasterURL)
+	jobs := make(chan PodPair, cfg.Concurrency)
+	var (
+		mu      sync.Mutex
+		samples []e2eSample
+		sent    int64
+		failed  int64
+		wg      sync.WaitGroup
+	)
+
+	wg.Add(cfg.Concurrency)
+	for w := 0; w < cfg.Concurrency; w++ {
+		go func() {
+			defer wg.Done()
+			r := rand.New(rand.NewSource(time.Now().UnixNano()))
+			for p := range jobs {
+				start := time.Now()
+				server, err := sendAndWait(client, targetURL, randomLink(r, cfg, p.Pod1, p.Pod2))
+				elapsed := time.Since(start)
+				if err != nil {
+					atomic.AddInt64(&failed, 1)
+					continue
+				}
+				mu.Lock()
+				samples = append(samples, e2eSample{client: elapsed, server: server})
+				mu.Unlock()
+			}
+		}()
+	}
+
+	interval := time.Second / time.Duration(rate)
+	ticker := time.NewTicker(interval)
+	deadline := time.Now().Add(cfg.E2EDuration)
+	for now := range ticker.C {
+		if now.After(deadline) {
+			break
+		}
+		sent++
+		select {
+		case jobs <- pair():
+		default:
+			atomic.AddInt64(&failed, 1)
+		}
+	}
+	ticker.Stop()
+	close(jobs)
+	wg.Wait()
+	return samples, sent, atomic.LoadInt64(&failed)
+}
+
+// sendAndWait 发送一条链路并等待 agent 确认，返回 linkserver 报告的下发时延
+func sendAndWait(client *http.Client, url string, link EBPFEntryByPodsRequest) (time.Duration, error) {
+	body, err := json.Marshal(link)
+	if err != nil {
+		return 0, err
+	}
+	resp, err := client.Post(url, "application/json", bytes.NewReader(body))
+	if err != nil {
+		return 0, err
+	}
+	defer resp.Body.Close()
+
+	var apiResp struct {
+		Success bool `json:"success"`
+		Data    struct {
+			Status    string `json:"status"`
+			LatencyUs int64  `json:"latencyUs"`
+		} `json:"data"`
+		Error string `json:"error"`
+	}
+	if err := json.NewDecoder(resp.Body).Decode(&apiResp); err != nil {
+		return 0, fmt.Errorf("status %d: %v", resp.StatusCode, err)
+	}
+	if !apiResp.Success || apiResp.Data.Status != "applied" {
+		return 0, fmt.Errorf("status %d: %s", resp.StatusCode, apiResp.Error)
+	}
+	return time.Duration(apiResp.Data.LatencyUs) * time.Microsecond, nil
+}
+
+func printE2EStage(links, rate int, sent, failed int64, samples []e2eSample) {
+	clientLat := make([]time.Duration, len(samples))
+	serverLat := make([]time.Duration, len(samples))
+	for i, s := range samples {
+		clientLat[i], serverLat[i] = s.client, s.server
+	}
+	c := percentiles(clientLat, 0.5, 0.99, 0.999)
+	sv := percentiles(serverLat, 0.5, 0.99)
+	fmt.Printf("%10d %8d %8d %8d %8d | %10v %10v %10v | %10v %10v\n",
+		links, rate, sent, len(samples), failed, c[0], c[1], c[2], sv[0], sv[1])
+}
+
+// percentiles 返回各分位数 (最近秩)，没有样本时为 0
+func percentiles(d []time.Duration, qs ...float64) []time.Duration {
+	out := make([]time.Duration, len(qs))
+	if len(d) == 0 {
+		return out
+	}
+	sort.Slice(d, func(i, j int) bool { return d[i] < d[j] })
+	for i, q := range qs {
+		idx := int(q*float64(len(d))+0.5) - 1
+		if idx < 0 {
+			idx = 0
+		}
+		if idx >= len(d) {
+			idx = len(d) - 1
+		}
+		out[i] = d[idx].Round(time.Microsecond)
+	}
+	return out
+}
+
+func parseInts(s string) ([]int, error) {
+	var out []int
+	for _, f := range strings.Split(s, ",") {
+		f = strings.TrimSpace(f)
+		if f == "" {
+			continue
+		}
+		v, err := strconv.Atoi(f)
+		if err != nil || v < 0 {
+			return nil, fmt.Errorf("invalid value %q", f)
+		}
+		out = append(out, v)
+	}
+	if len(out) == 0 {
+		return nil, fmt.Errorf("empty list")
+	}
+	return out, nil
+}
+
 // ================= 辅助函数 =================
 
 func sendJSON(client *http.Client, method, url string, data interface{}) error {
@@ -65,6 +65,9 @@ func main() {
 	var redisAddr string
 	var redisPassword string
 	var redisDB int
+	var kubeAPIQPS float64
+	var kubeAPIBurst int
+	var podCreateConcurrency int
 	var tlsOpts []func(*tls.Config)
 
 	flag.StringVar(&metricsAddr, "metrics-bind-address", "0", "The address the metrics endpoint binds to. "+
@@ -76,6 +79,11 @@ func main() {
 	flag.StringVar(&redisPassword, "redis-password", "", "Redis password")
 	flag.IntVar(&redisDB, "redis-db", 0, "Redis database number")
 
+	// [API Server 限流 - 大规模 EmuNet 的 Pod 创建吞吐由此决定]
+	flag.Float64Var(&kubeAPIQPS, "kube-api-qps", 50, "Sustained QPS of the controller's API server client.")
+	flag.IntVar(&kubeAPIBurst, "kube-api-burst", 100, "Burst of the controller's API server client.")
+	flag.IntVar(&podCreateConcurrency, "pod-create-concurrency", controller.DefaultPodCreateConcurrency,
+		"Maximum in-flight pod create/update/delete calls per reconcile.")
 	flag.BoolVar(&enableLeaderElection, "leader-elect", false,
 		"Enable leader election for controller manager. "+
 			"Enabling this will ensure there is only one active controller manager.")
@@ -143,7 +151,11 @@ func main() {
 		metricsServerOptions.KeyName = metricsCertKey
 	}
 
-	mgr, err := ctrl.NewManager(ctrl.GetConfigOrDie(), ctrl.Options{
+	restConfig := ctrl.GetConfigOrDie()
+	restConfig.QPS = float32(kubeAPIQPS)
+	restConfig.Burst = kubeAPIBurst
+
+	mgr, err := ctrl.NewManager(restConfig, ctrl.Options{
 		Scheme:                 scheme,
 		Metrics:                metricsServerOptions,
 		WebhookServer:          webhookServer,
@@ -171,6 +183,8 @@ func main() {
 		Client: mgr.GetClient(),
 		Scheme: mgr.GetScheme(),
 		Redis:  redisClient,
+
+		PodCreateConcurrency: podCreateConcurrency,
 	}).SetupWithManager(mgr); err != nil {
 		setupLog.Error(err, "unable to create controller", "controller", "EmuNet")
 		os.Exit(1)
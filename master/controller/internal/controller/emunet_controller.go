@@ -3,6 +3,7 @@ package controller
 import (
 	"context"
 	"fmt"
+	"sync"
 	"time"
 
 	corev1 "k8s.io/api/core/v1"
@@ -24,6 +25,13 @@ type EmuNetReconciler struct {
 	client.Client
 	Scheme *runtime.Scheme
 	Redis  *redis.Client
+
+	// PodCreateConcurrency 为单次 Reconcile 中并发的 Pod 创建/更新/删除请求上限，0 表示默认值；
+	// 实际速率由 API Server 客户端的 QPS/Burst 限制
+	PodCreateConcurrency int
+
+	// 上次写入 Redis 的状态，用于增量同步
+	statusSync statusSyncCache
 }
 
 const (
@@ -34,6 +42,9 @@ const (
 	// 轮询间隔：未就绪时快，就绪后慢
 	SyncPeriodFast = 3 * time.Second
 	SyncPeriodSlow = 30 * time.Second
+
+	// DefaultPodCreateConcurrency 足以让默认 QPS 下的 API Server 客户端保持满载
+	DefaultPodCreateConcurrency = 32
 )
 
 // Reconcile is the main loop
@@ -101,6 +112,7 @@ func (r *EmuNetReconciler) syncPods(ctx context.Context, emunet *emunetv1.EmuNet
 	}
 
 	desiredPods := make(map[string]bool)
+	var ops []func(context.Context) error
 
 	// Reconcile desired state
 	for groupIdx, imageGroup := range emunet.Spec.ImageGroups {
@@ -108,16 +120,22 @@ func (r *EmuNetReconciler) syncPods(ctx context.Context, emunet *emunetv1.EmuNet
 			podName := fmt.Sprintf("%s-group%d-%d", emunet.Name, groupIdx, podIdx)
 			desiredPods[podName] = true
 
+			groupIdx, podIdx, imageGroup := groupIdx, podIdx, imageGroup
 			if existingPod, exists := existingPodMap[podName]; exists {
 				if existingPod.Spec.Containers[0].Image != imageGroup.Image {
-					if err := r.updateExistingPod(ctx, existingPod, imageGroup.Image); err != nil {
-						return err
-					}
+					ops = append(ops, func(ctx context.Context) error {
+						return r.updateExistingPod(ctx, existingPod, imageGroup.Image)
+					})
 				}
 			} else {
-				if err := r.createNewPod(ctx, emunet, groupIdx, podIdx, imageGroup); err != nil {
+				ops = append(ops, func(ctx context.Context) error {
+					err := r.createNewPod(ctx, emunet, groupIdx, podIdx, imageGroup)
+					// 缓存滞后时 Pod 可能已由上一轮创建
+					if errors.IsAlreadyExists(err) {
+						return nil
+					}
 					return err
-				}
+				})
 			}
 		}
 	}
@@ -125,13 +143,60 @@ func (r *EmuNetReconciler) syncPods(ctx context.Context, emunet *emunetv1.EmuNet
 	// Cleanup extraneous pods
 	for podName, pod := range existingPodMap {
 		if !desiredPods[podName] && pod.DeletionTimestamp == nil {
-			if err := r.Delete(ctx, pod); err != nil && !errors.IsNotFound(err) {
-				return err
-			}
+			pod := pod
+			ops = append(ops, func(ctx context.Context) error {
+				if err := r.Delete(ctx, pod); err != nil && !errors.IsNotFound(err) {
+					return err
+				}
+				return nil
+			})
 		}
 	}
 
-	return nil
+	return r.runBounded(ctx, ops)
+}
+
+// runBounded 以 PodCreateConcurrency 为上限并发执行 ops，返回第一个错误；
+// 出错后不再启动新的请求，已发出的请求执行完毕后返回
+func (r *EmuNetReconciler) runBounded(ctx context.Context, ops []func(context.Context) error) error {
+	limit := r.PodCreateConcurrency
+	if limit <= 0 {
+		limit = DefaultPodCreateConcurrency
+	}
+	ctx, cancel := context.WithCancel(ctx)
+	defer cancel()
+
+	var (
+		wg       sync.WaitGroup
+		once     sync.Once
+		firstErr error
+	)
+	sem := make(chan struct{}, limit)
+	for _, op := range ops {
+		select {
+		case sem <- struct{}{}:
+		case <-ctx.Done():
+		}
+		if ctx.Err() != nil {
+			break
+		}
+		wg.Add(1)
+		go func(op func(context.Context) error) {
+			defer wg.Done()
+			defer func() { <-sem }()
+			if err := op(ctx); err != nil {
+				once.Do(func() {
+					firstErr = err
+					cancel()
+				})
+			}
+		}(op)
+	}
+	wg.Wait()
+	if firstErr != nil {
+		return firstErr
+	}
+	return ctx.Err()
 }
 
 // updateStatus returns (isReady, error)
@@ -183,7 +248,7 @@ func (r *EmuNetReconciler) updateStatus(ctx context.Context, emunet *emunetv1.Em
 	}
 
 	// 2. Update Redis
-	// 将合并了 (Agent MAC) + (K8s IP) 的完整信息写回 Redis (写到 pod_lookup)
+	// 将合并了 (Agent MAC) + (K8s IP) 的完整信息写回 Redis (路由记录写到 pod_routes)
 	redisStatus := &redis.EmuNetStatus{
 		Name:             emunet.Name,
 		Namespace:        emunet.Namespace,
@@ -203,17 +268,25 @@ func (r *EmuNetReconciler) updateStatus(ctx context.Context, emunet *emunetv1.Em
 	return isFullyReady, nil
 }
 
+// saveStatusToRedis 只写入与上次相比发生变化的 key，TTL 按 TTLRefreshInterval 惰性刷新
 func (r *EmuNetReconciler) saveStatusToRedis(ctx context.Context, status *redis.EmuNetStatus) error {
-	var allPods []redis.PodStatus
-	for _, group := range status.ImageGroupStatus {
-		for _, pod := range group.PodStatuses {
-			allPods = append(allPods, pod)
-		}
+	nn := types.NamespacedName{Namespace: status.Namespace, Name: status.Name}
+
+	delta, next, err := r.buildStatusDelta(ctx, r.statusSync.get(nn), status, time.Now())
+	if err != nil {
+		return err
 	}
-	return r.Redis.SaveStatusBatch(ctx, status, allPods)
+	if err := r.Redis.SaveStatusDelta(ctx, delta); err != nil {
+		// Redis 中的实际状态未知，下次全量写入
+		r.statusSync.forget(nn)
+		return err
+	}
+	r.statusSync.set(nn, next)
+	return nil
 }
 
 func (r *EmuNetReconciler) handleDeletion(ctx context.Context, nn types.NamespacedName, emunet *emunetv1.EmuNet) (ctrl.Result, error) {
+	r.statusSync.forget(nn)
 	if err := r.Redis.DeleteEmuNetStatus(ctx, nn.Namespace, nn.Name); err != nil {
 		log.FromContext(ctx).Error(err, "failed to cleanup redis status")
 	}
@@ -234,6 +307,16 @@ func (r *EmuNetReconciler) calculateImageGroupStatus(ctx context.Context, emunet
 	var totalReady int32
 	allMacsFound := true
 
+	// 一次流水线 HMGET 取回所有已存在 Pod 的 Agent 上报，不再每个 Pod 一次 RTT
+	podNames := make([]string, 0, len(podMap))
+	for podName := range podMap {
+		podNames = append(podNames, podName)
+	}
+	agentInfos, err := r.Redis.GetAgentNetworkInfos(ctx, podNames)
+	if err != nil {
+		log.FromContext(ctx).Error(err, "failed to read agent network info")
+	}
+
 	for groupIdx, imageGroup := range emunet.Spec.ImageGroups {
 		groupStatus := emunetv1.ImageGroupStatus{
 			Image:           imageGroup.Image,
@@ -266,10 +349,8 @@ func (r *EmuNetReconciler) calculateImageGroupStatus(ctx context.Context, emunet
 				podStatus.Ready = isPodReady(pod)
 				podStatus.Message = getPodMessage(pod)
 
-				// 3. [核心修改] 尝试从 Agent 专用 Key 读取 MAC/IfIndex
-				// 使用 GetAgentNetworkInfo (agent:network:...)
-				redisInfo, err := r.Redis.GetAgentNetworkInfo(ctx, podName)
-				if err == nil && redisInfo != nil {
+				// 3. 使用 Agent 上报 (agent_routes) 中的 MAC/IfIndex
+				if redisInfo := agentInfos[podName]; redisInfo != nil {
 					if redisInfo.MACAddress != "" {
 						podStatus.MACAddress = redisInfo.MACAddress
 					}
@@ -0,0 +1,124 @@
+package controller
+
+import (
+	"context"
+	"reflect"
+	"sync"
+	"time"
+
+	"k8s.io/apimachinery/pkg/types"
+
+	"emunet/controller/internal/redis"
+)
+
+// TTLRefreshInterval 超过该时间未刷新过 TTL 时才整体 EXPIRE 一次，值不变的 key 不再重写
+const TTLRefreshInterval = redis.DefaultTTL / 2
+
+// syncedEmuNet 记录上一次成功写入 Redis 的状态 (LastUpdated 已清零，便于比较)
+type syncedEmuNet struct {
+	status         redis.EmuNetStatus
+	pods           map[string]redis.PodStatus
+	lastTTLRefresh time.Time
+}
+
+// statusSyncCache 按 EmuNet 保存上次写入的状态，Reconcile 可能并发执行，因此加锁
+type statusSyncCache struct {
+	mu    sync.Mutex
+	state map[types.NamespacedName]*syncedEmuNet
+}
+
+func (c *statusSyncCache) get(nn types.NamespacedName) *syncedEmuNet {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.state == nil {
+		return nil
+	}
+	return c.state[nn]
+}
+
+func (c *statusSyncCache) set(nn types.NamespacedName, s *syncedEmuNet) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.state == nil {
+		c.state = make(map[types.NamespacedName]*syncedEmuNet)
+	}
+	c.state[nn] = s
+}
+
+func (c *statusSyncCache) forget(nn types.NamespacedName) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	delete(c.state, nn)
+}
+
+// normalizeStatus 去掉每次 Reconcile 都会变化的时间戳，只比较有意义的字段
+func normalizeStatus(status *redis.EmuNetStatus) redis.EmuNetStatus {
+	out := *status
+	out.LastUpdated = time.Time{}
+	out.ImageGroupStatus = make([]redis.ImageGroupStatus, len(status.ImageGroupStatus))
+	for i, group := range status.ImageGroupStatus {
+		out.ImageGroupStatus[i] = group
+		out.ImageGroupStatus[i].PodStatuses = make([]redis.PodStatus, len(group.PodStatuses))
+		for j, pod := range group.PodStatuses {
+			pod.LastUpdated = time.Time{}
+			out.ImageGroupStatus[i].PodStatuses[j] = pod
+		}
+	}
+	return out
+}
+
+// buildStatusDelta 计算与上次写入之间的差异；prev 为 nil (首次或写入失败后) 时，
+// 以 Redis 中的 pod 索引为基准，全量写入并清理已不存在的 pod
+func (r *EmuNetReconciler) buildStatusDelta(ctx context.Context, prev *syncedEmuNet, status *redis.EmuNetStatus, now time.Time) (*redis.StatusDelta, *syncedEmuNet, error) {
+	next := &syncedEmuNet{
+		status:         normalizeStatus(status),
+		pods:           make(map[string]redis.PodStatus),
+		lastTTLRefresh: now,
+	}
+	delta := &redis.StatusDelta{Namespace: status.Namespace, Name: status.Name}
+
+	for _, group := range status.ImageGroupStatus {
+		for _, pod := range group.PodStatuses {
+			cmp := pod
+			cmp.LastUpdated = time.Time{}
+			next.pods[pod.PodName] = cmp
+			delta.Live = append(delta.Live, pod.PodName)
+
+			if prev != nil {
+				if old, ok := prev.pods[pod.PodName]; ok && old == cmp {
+					continue
+				}
+			}
+			delta.Upserts = append(delta.Upserts, pod)
+		}
+	}
+
+	if prev == nil {
+		delta.Status = status
+		indexed, err := r.Redis.ListPodIndex(ctx, status.Namespace, status.Name)
+		if err != nil {
+			return nil, nil, err
+		}
+		for _, podName := range indexed {
+			if _, ok := next.pods[podName]; !ok {
+				delta.Removed = append(delta.Removed, podName)
+			}
+		}
+		return delta, next, nil
+	}
+
+	if !reflect.DeepEqual(prev.status, next.status) {
+		delta.Status = status
+	}
+	for podName := range prev.pods {
+		if _, ok := next.pods[podName]; !ok {
+			delta.Removed = append(delta.Removed, podName)
+		}
+	}
+	if now.Sub(prev.lastTTLRefresh) >= TTLRefreshInterval {
+		delta.RefreshTTL = true
+	} else {
+		next.lastTTLRefresh = prev.lastTTLRefresh
+	}
+	return delta, next, nil
+}
@@ -0,0 +1,56 @@
+package api
+
+import (
+	"encoding/json"
+	"net/http"
+
+	"go.uber.org/zap"
+)
+
+// AggregateByPodRequest 为 Pod 接入链路 (其 veth 上所有链路共享) 的限速配置
+type AggregateByPodRequest struct {
+	Pod             string `json:"pod"`
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
+	QueueBytes      uint32 `json:"queueBytes,omitempty"`
+	QueueDelay      uint32 `json:"queueDelay,omitempty"`
+}
+
+// agentAggregate 与 Agent 侧 pkg.AggregateRequest 的 JSON 一致
+type agentAggregate struct {
+	Ifindex         uint32 `json:"ifindex"`
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
+	QueueBytes      uint32 `json:"queueBytes,omitempty"`
+	QueueDelay      uint32 `json:"queueDelay,omitempty"`
+}
+
+// handleAggregateByPod 把 Pod 解析为 (节点, veth ifindex) 后写入 (POST) 或清除 (DELETE) 接口聚合瓶颈
+func (s *MasterServer) handleAggregateByPod(w http.ResponseWriter, r *http.Request) {
+	var req AggregateByPodRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON body")
+		return
+	}
+
+	pod, err := s.lookupPod(r.Context(), req.Pod)
+	if err != nil || pod == nil {
+		s.sendError(w, http.StatusNotFound, "Pod not found")
+		return
+	}
+	if pod.NodeName == "" || pod.VethIfIndex == 0 {
+		s.sendError(w, http.StatusPreconditionFailed, "Pod metadata incomplete (missing Node or ifindex)")
+		return
+	}
+
+	payload, _ := json.Marshal([]agentAggregate{{
+		Ifindex:         uint32(pod.VethIfIndex),
+		ThrottleRateBps: req.ThrottleRateBps,
+		QueueBytes:      req.QueueBytes,
+		QueueDelay:      req.QueueDelay,
+	}})
+	if _, err := s.agentJSON(r.Context(), pod.NodeName, r.Method, "/api/ebpf/aggregates", payload); err != nil {
+		s.logger.Warn("Failed to apply aggregate", zap.String("pod", req.Pod), zap.String("node", pod.NodeName), zap.Error(err))
+		s.sendError(w, http.StatusBadGateway, err.Error())
+		return
+	}
+	s.sendSuccess(w, map[string]interface{}{"node": pod.NodeName, "ifindex": pod.VethIfIndex})
+}
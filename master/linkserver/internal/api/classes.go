@@ -0,0 +1,72 @@
+package api
+
+import (
+	"encoding/json"
+	"net/http"
+
+	"go.uber.org/zap"
+)
+
+// ClassByPodRequest 为 Pod veth 上的一条 L3/L4 分类：port (需带 proto)、prefix、dscp 三者选一，
+// 命中的包改用 (或 stack 时叠加) 模板 profileId 的参数。模板需先通过 /api/v1/profiles 同步到各节点
+type ClassByPodRequest struct {
+	Pod       string `json:"pod"`
+	Ingress   bool   `json:"ingress,omitempty"`
+	Proto     string `json:"proto,omitempty"`
+	Port      uint16 `json:"port,omitempty"`
+	Prefix    string `json:"prefix,omitempty"`
+	DSCP      *uint8 `json:"dscp,omitempty"`
+	ClassID   uint32 `json:"classId,omitempty"`
+	ProfileID uint32 `json:"profileId,omitempty"`
+	Stack     bool   `json:"stack,omitempty"`
+}
+
+// agentClass 与 Agent 侧 pkg.ClassRequest 的 JSON 一致
+type agentClass struct {
+	Ifindex   uint32 `json:"ifindex"`
+	Ingress   bool   `json:"ingress,omitempty"`
+	Proto     string `json:"proto,omitempty"`
+	Port      uint16 `json:"port,omitempty"`
+	Prefix    string `json:"prefix,omitempty"`
+	DSCP      *uint8 `json:"dscp,omitempty"`
+	ClassID   uint32 `json:"classId,omitempty"`
+	ProfileID uint32 `json:"profileId,omitempty"`
+	Stack     bool   `json:"stack,omitempty"`
+}
+
+// handleClassByPod 把 Pod 解析为 (节点, veth ifindex) 后写入 (POST) 或删除 (DELETE) 分类
+func (s *MasterServer) handleClassByPod(w http.ResponseWriter, r *http.Request) {
+	var req ClassByPodRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON body")
+		return
+	}
+
+	pod, err := s.lookupPod(r.Context(), req.Pod)
+	if err != nil || pod == nil {
+		s.sendError(w, http.StatusNotFound, "Pod not found")
+		return
+	}
+	if pod.NodeName == "" || pod.VethIfIndex == 0 {
+		s.sendError(w, http.StatusPreconditionFailed, "Pod metadata incomplete (missing Node or ifindex)")
+		return
+	}
+
+	payload, _ := json.Marshal([]agentClass{{
+		Ifindex:   uint32(pod.VethIfIndex),
+		Ingress:   req.Ingress,
+		Proto:     req.Proto,
+		Port:      req.Port,
+		Prefix:    req.Prefix,
+		DSCP:      req.DSCP,
+		ClassID:   req.ClassID,
+		ProfileID: req.ProfileID,
+		Stack:     req.Stack,
+	}})
+	if _, err := s.agentJSON(r.Context(), pod.NodeName, r.Method, "/api/ebpf/classes", payload); err != nil {
+		s.logger.Warn("Failed to apply class", zap.String("pod", req.Pod), zap.String("node", pod.NodeName), zap.Error(err))
+		s.sendError(w, http.StatusBadGateway, err.Error())
+		return
+	}
+	s.sendSuccess(w, map[string]interface{}{"node": pod.NodeName, "ifindex": pod.VethIfIndex})
+}
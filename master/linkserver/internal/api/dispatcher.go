@@ -0,0 +1,599 @@
+package api
+
+import (
+	"bytes"
+	"context"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"net"
+	"net/http"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+	FlushSize         = 4096                 // 单节点待下发条数达到该值立即 flush
+	FlushInterval     = 5 * time.Millisecond // 未达到 FlushSize 时的最长攒批时间
+	MaxPendingPerNode = 200000               // 单节点待下发上限，超过后新 key 被拒绝 (背压)
+	MaxAgentBatch     = 65535                // 与 Agent 侧 pkg.MaxBatchEntries 一致
+	flushRetryBackoff = 200 * time.Millisecond
+)
+
+// =================================================================================
+// 1. 规则 Key 与待下发操作
+// =================================================================================
+
+// linkKey 对应 Agent 侧 MAC_HANDLE_EMU 的 key，同一 key 的多次更新只保留最后一次
+type linkKey struct {
+	Ifindex uint32
+	SrcMac  [6]byte
+}
+
+type pendingOp struct {
+	Delete bool
+	Req    AgentRequest
+	// waiters 在该 key 的最终状态被 agent 应用 (或被拒绝) 后收到结果，
+	// 被后续更新覆盖时由新操作继承
+	waiters []chan<- applyResult
+	// tallies 与 waiters 相同，但只计数，供不逐条等待的批量调用方 (拓扑导入) 使用
+	tallies []*applyTally
+}
+
+// applyResult 为一条规则的下发结果
+type applyResult struct {
+	Node    string
+	Seq     uint64 // 承载该规则的帧序号
+	ApplyNs uint64 // agent 侧 map 写入耗时
+	Err     error
+}
+
+func (op *pendingOp) notify(res applyResult) {
+	for _, ch := range op.waiters {
+		ch <- res
+	}
+	for _, t := range op.tallies {
+		t.record(res.Err)
+	}
+	op.waiters, op.tallies = nil, nil
+}
+
+// inherit 接管被覆盖的同 key 操作的等待方
+func (op *pendingOp) inherit(prev *pendingOp) {
+	op.waiters = append(prev.waiters, op.waiters...)
+	op.tallies = mergeTallies(prev.tallies, op.tallies)
+}
+
+// mergeTallies 合并两组计数器，同一计数器只保留一次，一个 key 的最终结果只计一次
+func mergeTallies(a, b []*applyTally) []*applyTally {
+	for _, t := range b {
+		dup := false
+		for _, u := range a {
+			if u == t {
+				dup = true
+				break
+			}
+		}
+		if !dup {
+			a = append(a, t)
+		}
+	}
+	return a
+}
+
+// applyTally 统计一组规则的下发结果
+type applyTally struct {
+	mu       sync.Mutex
+	applied  int
+	failed   int
+	firstErr error
+}
+
+func (t *applyTally) record(err error) {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	if err == nil {
+		t.applied++
+		return
+	}
+	t.failed++
+	if t.firstErr == nil {
+		t.firstErr = err
+	}
+}
+
+func (t *applyTally) get() (applied, failed int, firstErr error) {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	return t.applied, t.failed, t.firstErr
+}
+
+// flowDirIngress 与 Agent 侧 pkg.FlowDirIngress 一致：入口方向规则的 ifindex 最高位置 1
+const flowDirIngress = 1 << 31
+
+func newLinkKey(ifindex uint32, macStr string, ingress bool) (linkKey, error) {
+	key := linkKey{Ifindex: ifindex}
+	if ifindex&flowDirIngress != 0 {
+		return key, fmt.Errorf("ifindex %d out of range", ifindex)
+	}
+	if ingress {
+		key.Ifindex |= flowDirIngress
+	}
+	mac, err := net.ParseMAC(macStr)
+	if err != nil || len(mac) != 6 {
+		return key, fmt.Errorf("invalid MAC address %q", macStr)
+	}
+	copy(key.SrcMac[:], mac)
+	return key, nil
+}
+
+// =================================================================================
+// 2. Agent 批量接口二进制编码 (与 emunet-node-agent/pkg/ebpf_batch.go 保持一致，
+//    改动布局时同步修改 ebpf_batch_test.go 中照抄的 encodeLinkserverBatch)
+// =================================================================================
+
+const (
+	batchMagic         = 0xEB01
+	batchVersion       = 7
+	batchHeaderSize    = 8
+	batchUpsertRecSize = 96
+	batchDeleteRecSize = 12
+	batchContentType   = "application/octet-stream"
+	batchFlagECN       = 1 << 0
+	batchFlagJitterOrd = 1 << 1
+	batchFlagKeepCsum  = 1 << 2
+	batchJitterShift   = 8
+)
+
+func encodeAgentBatch(keys []linkKey, ops []*pendingOp, del bool) []byte {
+	recSize := batchUpsertRecSize
+	if del {
+		recSize = batchDeleteRecSize
+	}
+	buf := make([]byte, batchHeaderSize+len(keys)*recSize)
+	binary.LittleEndian.PutUint16(buf[0:], batchMagic)
+	binary.LittleEndian.PutUint16(buf[2:], batchVersion)
+	binary.LittleEndian.PutUint32(buf[4:], uint32(len(keys)))
+	for i, key := range keys {
+		rec := buf[batchHeaderSize+i*recSize:]
+		binary.LittleEndian.PutUint32(rec[0:], key.Ifindex)
+		copy(rec[4:10], key.SrcMac[:])
+		if del {
+			continue
+		}
+		req := &ops[i].Req
+		binary.LittleEndian.PutUint64(rec[12:], req.ThrottleRateBps)
+		binary.LittleEndian.PutUint32(rec[20:], req.Delay)
+		binary.LittleEndian.PutUint32(rec[24:], req.LossRate)
+		binary.LittleEndian.PutUint32(rec[28:], req.Jitter)
+		binary.LittleEndian.PutUint32(rec[32:], req.ProfileID)
+		binary.LittleEndian.PutUint32(rec[36:], req.GeP)
+		binary.LittleEndian.PutUint32(rec[40:], req.GeR)
+		binary.LittleEndian.PutUint32(rec[44:], req.GeLossBad)
+		binary.LittleEndian.PutUint32(rec[48:], req.QueueBytes)
+		binary.LittleEndian.PutUint32(rec[52:], req.QueueDelay)
+		binary.LittleEndian.PutUint32(rec[56:], req.RedMin)
+		binary.LittleEndian.PutUint32(rec[60:], req.RedMax)
+		binary.LittleEndian.PutUint32(rec[64:], req.RedMaxP)
+		flags := (req.JitterDist & 0xff) << batchJitterShift
+		if req.ECN {
+			flags |= batchFlagECN
+		}
+		if req.JitterOrdered {
+			flags |= batchFlagJitterOrd
+		}
+		if req.CorruptKeepCsum {
+			flags |= batchFlagKeepCsum
+		}
+		binary.LittleEndian.PutUint32(rec[68:], flags)
+		binary.LittleEndian.PutUint32(rec[72:], req.GroupID)
+		binary.LittleEndian.PutUint32(rec[76:], req.TraceID)
+		binary.LittleEndian.PutUint32(rec[80:], req.DupRate)
+		binary.LittleEndian.PutUint32(rec[84:], req.CorruptRate)
+		binary.LittleEndian.PutUint32(rec[88:], req.ReorderRate)
+		binary.LittleEndian.PutUint32(rec[92:], req.ReorderGap)
+	}
+	return buf
+}
+
+// =================================================================================
+// 3. 单节点分发器 (Coalescing Dispatcher)
+// =================================================================================
+
+// nodeDispatcher 为每个节点维护一张待下发表，按 linkKey 合并 (last-writer-wins)，
+// 由单个 goroutine 按大小/时间阈值批量 flush，保证同一 key 的下发顺序
+type nodeDispatcher struct {
+	nodeIP string
+	server *MasterServer
+
+	mu      sync.Mutex
+	pending map[linkKey]*pendingOp
+	kick    chan struct{}
+	// inflight 为 true 表示 flush 已取走待下发表但尚未发送完毕
+	inflight bool
+
+	// epochToken 非 0 时为暂存分发器，只写入 agent 上该 token 对应的影子表
+	epochToken uint64
+	// staged 为暂存分发器已下发的规则，提交成功后写入节点规则快照
+	staged stagedRules
+	// rejected 为暂存分发器被 agent 拒绝的规则数，只增不减，非 0 时该 epoch 不能提交
+	rejected int
+
+	// 以下字段只由 run goroutine 访问
+	seq        uint64
+	stream     *agentStream
+	nextDialAt time.Time
+}
+
+func newNodeDispatcher(s *MasterServer, nodeIP string) *nodeDispatcher {
+	return &nodeDispatcher{
+		nodeIP:  nodeIP,
+		server:  s,
+		pending: make(map[linkKey]*pendingOp),
+		kick:    make(chan struct{}, 1),
+	}
+}
+
+// submit 合并一条操作；已有同 key 的待下发操作时直接覆盖，
+// 只有新 key 在节点待下发数达到上限时才返回 false
+func (d *nodeDispatcher) submit(key linkKey, op *pendingOp) bool {
+	d.mu.Lock()
+	prev, exists := d.pending[key]
+	if !exists && len(d.pending) >= MaxPendingPerNode {
+		d.mu.Unlock()
+		return false
+	}
+	if exists {
+		op.inherit(prev)
+	}
+	d.pending[key] = op
+	full := len(d.pending) >= FlushSize
+	d.mu.Unlock()
+
+	if full {
+		d.wake()
+	}
+	return true
+}
+
+// submitBatch 在一次加锁内按顺序合并多条操作，返回被接受的条数；
+// 遇到新 key 且节点待下发数已达上限时停止，剩余操作由调用方稍后重试
+func (d *nodeDispatcher) submitBatch(keys []linkKey, ops []*pendingOp) int {
+	d.mu.Lock()
+	n := 0
+	for ; n < len(keys); n++ {
+		prev, exists := d.pending[keys[n]]
+		if !exists && len(d.pending) >= MaxPendingPerNode {
+			break
+		}
+		if exists {
+			ops[n].inherit(prev)
+		}
+		d.pending[keys[n]] = ops[n]
+	}
+	full := len(d.pending) >= FlushSize
+	d.mu.Unlock()
+
+	if full {
+		d.wake()
+	}
+	return n
+}
+
+// wake 通知 run goroutine 立即 flush
+func (d *nodeDispatcher) wake() {
+	select {
+	case d.kick <- struct{}{}:
+	default:
+	}
+}
+
+func (d *nodeDispatcher) run(ctx context.Context) {
+	// 新节点先同步模板与轨迹，保证随后下发的绑定规则引用的模板/轨迹已存在
+	if d.epochToken == 0 {
+		d.server.syncProfilesTo(ctx, d.nodeIP)
+		d.server.syncTracesTo(ctx, d.nodeIP)
+	}
+
+	ticker := time.NewTicker(FlushInterval)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-ctx.Done():
+			// 退出前尽力下发剩余规则
+			d.flush()
+			d.closeStream()
+			return
+		case <-d.kick:
+		case <-ticker.C:
+		}
+		if !d.flush() {
+			// Agent 不可达时退避，避免对故障节点空转
+			select {
+			case <-ctx.Done():
+				d.flush()
+				d.closeStream()
+				return
+			case <-time.After(flushRetryBackoff):
+			}
+		}
+	}
+}
+
+// flush 取走当前待下发表并按 upsert/delete 分批发送，失败的操作在未被更新覆盖时放回
+func (d *nodeDispatcher) flush() bool {
+	d.mu.Lock()
+	if len(d.pending) == 0 {
+		d.mu.Unlock()
+		return true
+	}
+	batch := d.pending
+	d.pending = make(map[linkKey]*pendingOp, len(batch))
+	d.inflight = true
+	d.mu.Unlock()
+	defer func() {
+		d.mu.Lock()
+		d.inflight = false
+		d.mu.Unlock()
+	}()
+
+	var upKeys, delKeys []linkKey
+	var upOps, delOps []*pendingOp
+	for key, op := range batch {
+		if op.Delete {
+			delKeys = append(delKeys, key)
+			delOps = append(delOps, op)
+		} else {
+			upKeys = append(upKeys, key)
+			upOps = append(upOps, op)
+		}
+	}
+
+	ok := true
+	for _, part := range []struct {
+		method string
+		keys   []linkKey
+		ops    []*pendingOp
+	}{
+		{"POST", upKeys, upOps},
+		{"DELETE", delKeys, delOps},
+	} {
+		for start := 0; start < len(part.keys); start += MaxAgentBatch {
+			end := start + MaxAgentBatch
+			if end > len(part.keys) {
+				end = len(part.keys)
+			}
+			if !d.sendChunk(part.method, part.keys[start:end], part.ops[start:end]) {
+				ok = false
+			}
+		}
+	}
+	return ok
+}
+
+// sendChunk 发送一帧并通知等待方，连接类错误时放回待下发表并返回 false。
+// agent 按帧校验参数，整帧被拒绝时二分重发，最终只有非法的规则收到拒绝，同帧合并的其他规则照常生效
+func (d *nodeDispatcher) sendChunk(method string, keys []linkKey, ops []*pendingOp) bool {
+	del := method == "DELETE"
+	payload := encodeAgentBatch(keys, ops, del)
+	d.seq++
+	res := applyResult{Node: d.nodeIP, Seq: d.seq}
+	res.ApplyNs, res.Err = d.send(method, d.seq, payload)
+	if errors.Is(res.Err, errAgentRejected) && len(keys) > 1 {
+		mid := len(keys) / 2
+		ok := d.sendChunk(method, keys[:mid], ops[:mid])
+		return d.sendChunk(method, keys[mid:], ops[mid:]) && ok
+	}
+	if res.Err != nil && !errors.Is(res.Err, errAgentRejected) {
+		d.server.logger.Warn("Failed to flush batch to agent",
+			zap.String("node", d.nodeIP), zap.String("method", method),
+			zap.Int("entries", len(keys)), zap.Error(res.Err))
+		d.requeue(keys, ops)
+		return false
+	}
+	for _, op := range ops {
+		op.notify(res)
+	}
+	if res.Err == nil {
+		d.recordApplied(payload, del)
+	} else if d.epochToken != 0 {
+		d.mu.Lock()
+		d.rejected += len(ops)
+		d.mu.Unlock()
+	}
+	return true
+}
+
+// idle 报告待下发表为空且没有正在进行的 flush
+func (d *nodeDispatcher) idle() bool {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	return len(d.pending) == 0 && !d.inflight
+}
+
+// drain 立即触发 flush 并等待所有已提交的操作下发完毕 (失败的会重试直到 ctx 结束)
+func (d *nodeDispatcher) drain(ctx context.Context) error {
+	d.wake()
+	ticker := time.NewTicker(time.Millisecond)
+	defer ticker.Stop()
+	for !d.idle() {
+		select {
+		case <-ctx.Done():
+			return fmt.Errorf("node %s: %d rules still pending: %v", d.nodeIP, d.pendingCount(), ctx.Err())
+		case <-ticker.C:
+		}
+	}
+	return nil
+}
+
+// discard 丢弃全部待下发操作并以 err 通知等待方 (暂存 epoch 被放弃时使用)
+func (d *nodeDispatcher) discard(err error) {
+	d.mu.Lock()
+	batch := d.pending
+	d.pending = make(map[linkKey]*pendingOp)
+	d.mu.Unlock()
+	for _, op := range batch {
+		op.notify(applyResult{Node: d.nodeIP, Err: err})
+	}
+}
+
+func (d *nodeDispatcher) rejectedCount() int {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	return d.rejected
+}
+
+func (d *nodeDispatcher) pendingCount() int {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	return len(d.pending)
+}
+
+func (d *nodeDispatcher) requeue(keys []linkKey, ops []*pendingOp) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	for i, key := range keys {
+		if newer, ok := d.pending[key]; ok {
+			newer.waiters = append(newer.waiters, ops[i].waiters...)
+			newer.tallies = mergeTallies(newer.tallies, ops[i].tallies)
+		} else {
+			d.pending[key] = ops[i]
+		}
+	}
+}
+
+// errAgentRejected 表示 agent 判定参数非法，重试无意义，直接通知等待方
+var errAgentRejected = errors.New("agent rejected batch")
+
+// send 优先通过长连接下发并返回 agent 侧应用耗时，连接不可用时退回 HTTP 批量接口
+func (d *nodeDispatcher) send(method string, seq uint64, payload []byte) (uint64, error) {
+	if d.epochToken != 0 {
+		// 暂存写入量小且只在 epoch 准备期间出现，不占用长连接
+		return 0, d.sendHTTP(method, payload)
+	}
+	if d.stream == nil && time.Now().After(d.nextDialAt) {
+		stream, err := dialAgentStream(d.nodeIP)
+		if err != nil {
+			d.nextDialAt = time.Now().Add(streamRedialDelay)
+			d.server.logger.Debug("Agent stream unavailable, using HTTP batch", zap.String("node", d.nodeIP), zap.Error(err))
+		} else {
+			d.stream = stream
+		}
+	}
+
+	if d.stream != nil {
+		frameType := frameUpsert
+		if method == "DELETE" {
+			frameType = frameDelete
+		}
+		ack, err := d.stream.roundTrip(frameType, seq, payload)
+		if err == nil {
+			switch ack.Status {
+			case ackOK:
+				return ack.ApplyNs, nil
+			case ackInvalid:
+				d.server.logger.Error("Agent rejected batch", zap.String("node", d.nodeIP), zap.String("message", ack.Message))
+				return ack.ApplyNs, fmt.Errorf("%w: %s", errAgentRejected, ack.Message)
+			default:
+				return ack.ApplyNs, fmt.Errorf("agent failed to apply frame %d: %s", seq, ack.Message)
+			}
+		}
+		// 连接出错后状态未知，丢弃连接；本批由调用方重新排队，按 last-writer-wins 重放是安全的
+		d.closeStream()
+		return 0, err
+	}
+
+	return 0, d.sendHTTP(method, payload)
+}
+
+func (d *nodeDispatcher) closeStream() {
+	if d.stream != nil {
+		d.stream.close()
+		d.stream = nil
+	}
+}
+
+func (d *nodeDispatcher) sendHTTP(method string, payload []byte) error {
+	url := fmt.Sprintf("http://%s:%d/api/ebpf/entries:batch", d.nodeIP, AgentPort)
+	if d.epochToken != 0 {
+		url = fmt.Sprintf("http://%s:%d/api/ebpf/epoch/entries:batch?token=%d", d.nodeIP, AgentPort, d.epochToken)
+	}
+	req, err := http.NewRequest(method, url, bytes.NewReader(payload))
+	if err != nil {
+		return err
+	}
+	req.Header.Set("Content-Type", batchContentType)
+
+	resp, err := d.server.httpClient.Do(req)
+	if err != nil {
+		return err
+	}
+	// 关键：读取并丢弃 Body，确保 TCP 连接能被复用
+	body, _ := io.ReadAll(io.LimitReader(resp.Body, 512))
+	resp.Body.Close()
+
+	if resp.StatusCode == http.StatusBadRequest {
+		// 参数非法，重试无意义，直接丢弃
+		d.server.logger.Error("Agent rejected batch", zap.String("node", d.nodeIP), zap.ByteString("body", body))
+		return fmt.Errorf("%w: %s", errAgentRejected, bytes.TrimSpace(body))
+	}
+	if resp.StatusCode != http.StatusOK {
+		return fmt.Errorf("agent returned %d: %s", resp.StatusCode, bytes.TrimSpace(body))
+	}
+	return nil
+}
+
+// =================================================================================
+// 4. 分发器注册表
+// =================================================================================
+
+// dispatcherFor 获取 (必要时创建) 目标节点的分发器
+func (s *MasterServer) dispatcherFor(nodeIP string) *nodeDispatcher {
+	s.dispatchersMu.RLock()
+	d, ok := s.dispatchers[nodeIP]
+	s.dispatchersMu.RUnlock()
+	if ok {
+		return d
+	}
+
+	s.dispatchersMu.Lock()
+	defer s.dispatchersMu.Unlock()
+	if d, ok = s.dispatchers[nodeIP]; ok {
+		return d
+	}
+	d = newNodeDispatcher(s, nodeIP)
+	s.dispatchers[nodeIP] = d
+	s.wg.Add(1)
+	go func() {
+		defer s.wg.Done()
+		d.run(s.ctx)
+	}()
+	return d
+}
+
+// submitRule 把一条规则交给分发器，节点背压时返回 false；
+// done 非空时在规则被应用后收到一次结果，需有 1 个缓冲
+func (s *MasterServer) submitRule(d *nodeDispatcher, req AgentRequest, del bool, done chan<- applyResult) (bool, error) {
+	key, err := newLinkKey(req.Ifindex, req.SrcMac, req.Ingress)
+	if err != nil {
+		return false, err
+	}
+	op := &pendingOp{Delete: del, Req: req}
+	if done != nil {
+		op.waiters = []chan<- applyResult{done}
+	}
+	if !d.submit(key, op) {
+		s.logger.Warn("Node dispatcher backlog full, rejecting request", zap.String("target", d.nodeIP))
+		return false, nil
+	}
+	return true, nil
+}
+
+func (s *MasterServer) dispatcherCount() int {
+	s.dispatchersMu.RLock()
+	defer s.dispatchersMu.RUnlock()
+	return len(s.dispatchers)
+}
@@ -0,0 +1,392 @@
+package api
+
+import (
+	"bytes"
+	"context"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"net/http"
+	"strconv"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+	DefaultCommitLead = 50 * time.Millisecond // 提交时刻相对扇出开始的提前量，需覆盖扇出耗时
+	MaxCommitLead     = time.Second           // 小于 Agent 侧 maxCommitDelay
+	EpochDrainTimeout = 30 * time.Second      // 提交前等待暂存规则全部下发的上限
+	epochAgentTimeout = 5 * time.Second
+)
+
+// errEpochDiscarded 通知仍在等待暂存规则结果的调用方该 epoch 已被放弃
+var errEpochDiscarded = errors.New("epoch aborted before rules were applied")
+
+// dispatchRoute 为一次请求选择目标节点的分发器
+type dispatchRoute func(nodeIP string) (*nodeDispatcher, error)
+
+// epochCoordinator 记录当前暂存中的 epoch；同一时刻最多一个。
+// begin/commit/abort 的扇出期间 busy 为 true，期间带 ?epoch= 的写入被拒绝
+type epochCoordinator struct {
+	mu      sync.RWMutex
+	token   uint64
+	busy    bool
+	seed    bool
+	begunAt time.Time
+	staged  map[string]*nodeDispatcher // 参与该 epoch 的节点 -> 暂存分发器
+	cancel  context.CancelFunc
+	wg      sync.WaitGroup
+}
+
+// EpochNodeResult 为 epoch 操作在单个节点上的结果
+type EpochNodeResult struct {
+	Node              string `json:"node"`
+	Epoch             uint32 `json:"epoch,omitempty"`
+	FlippedAtUnixNano int64  `json:"flippedAtUnixNano,omitempty"`
+	Error             string `json:"error,omitempty"`
+}
+
+type epochBeginRequest struct {
+	// Seed 为 true 时影子表以各节点当前规则为初始内容，只需暂存差异
+	Seed bool `json:"seed"`
+}
+
+type epochCommitRequest struct {
+	Token  uint64 `json:"token"`
+	LeadMs int    `json:"leadMs,omitempty"`
+}
+
+// =================================================================================
+// Epoch Handlers
+// =================================================================================
+
+// handleEpochBegin 在所有已知节点上创建影子表，返回后续写入需携带的 token
+func (s *MasterServer) handleEpochBegin(w http.ResponseWriter, r *http.Request) {
+	var req epochBeginRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil && !errors.Is(err, io.EOF) {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON: "+err.Error())
+		return
+	}
+
+	e := &s.epoch
+	e.mu.Lock()
+	if e.token != 0 || e.busy {
+		token := e.token
+		e.mu.Unlock()
+		s.sendError(w, http.StatusConflict, fmt.Sprintf("epoch %d already staged", token))
+		return
+	}
+	e.busy = true
+	e.mu.Unlock()
+	defer func() {
+		e.mu.Lock()
+		e.busy = false
+		e.mu.Unlock()
+	}()
+
+	nodes := s.knownNodes()
+	if len(nodes) == 0 {
+		s.sendError(w, http.StatusPreconditionFailed, "No known nodes")
+		return
+	}
+	token := uint64(time.Now().UnixNano())
+
+	payload, _ := json.Marshal(map[string]interface{}{"token": token, "seed": req.Seed})
+	results := s.fanoutEpoch(r.Context(), nodes, "/api/ebpf/epoch/begin", payload)
+	if failed := countEpochFailures(results); failed > 0 {
+		// 任一节点失败则整体放弃，避免部分节点无法参与切换
+		abort, _ := json.Marshal(map[string]uint64{"token": token})
+		s.fanoutEpoch(context.Background(), nodes, "/api/ebpf/epoch/abort", abort)
+		s.sendEpochFailure(w, results, fmt.Sprintf("%d/%d nodes failed to stage", failed, len(results)))
+		return
+	}
+
+	ctx, cancel := context.WithCancel(s.ctx)
+	staged := make(map[string]*nodeDispatcher, len(nodes))
+	for _, node := range nodes {
+		d := newNodeDispatcher(s, node)
+		d.epochToken, d.staged = token, make(stagedRules)
+		staged[node] = d
+		e.wg.Add(1)
+		s.wg.Add(1)
+		go func() {
+			defer s.wg.Done()
+			defer e.wg.Done()
+			d.run(ctx)
+		}()
+	}
+
+	e.mu.Lock()
+	e.token, e.seed, e.begunAt, e.staged, e.cancel = token, req.Seed, time.Now(), staged, cancel
+	e.mu.Unlock()
+
+	s.logger.Info("Epoch staged", zap.Uint64("token", token), zap.Int("nodes", len(nodes)))
+	s.sendSuccess(w, map[string]interface{}{"token": strconv.FormatUint(token, 10), "nodes": results})
+}
+
+// handleEpochCommit 等待暂存规则全部下发后，让所有节点在同一时刻翻转 EMU_EPOCH；
+// 有暂存规则被 agent 拒绝时不翻转并放弃该 epoch (409)
+func (s *MasterServer) handleEpochCommit(w http.ResponseWriter, r *http.Request) {
+	var req epochCommitRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON: "+err.Error())
+		return
+	}
+	lead := DefaultCommitLead
+	if req.LeadMs > 0 {
+		lead = time.Duration(req.LeadMs) * time.Millisecond
+	}
+	if lead > MaxCommitLead {
+		s.sendError(w, http.StatusBadRequest, fmt.Sprintf("leadMs must not exceed %d", MaxCommitLead.Milliseconds()))
+		return
+	}
+
+	e := &s.epoch
+	// 获取写锁即等待正在提交暂存规则的请求结束，此后新写入看到 busy 被拒绝
+	e.mu.Lock()
+	if e.busy || e.token == 0 || e.token != req.Token {
+		e.mu.Unlock()
+		s.sendError(w, http.StatusConflict, fmt.Sprintf("epoch %d is not staged", req.Token))
+		return
+	}
+	e.busy = true
+	staged, seed := e.staged, e.seed
+	e.mu.Unlock()
+
+	drainCtx, cancel := context.WithTimeout(r.Context(), EpochDrainTimeout)
+	defer cancel()
+	for _, d := range staged {
+		if err := d.drain(drainCtx); err != nil {
+			e.mu.Lock()
+			e.busy = false
+			e.mu.Unlock()
+			s.sendError(w, http.StatusGatewayTimeout, "Staged rules not drained: "+err.Error())
+			return
+		}
+	}
+
+	nodes := make([]string, 0, len(staged))
+	rejected := 0
+	for node, d := range staged {
+		nodes = append(nodes, node)
+		rejected += d.rejectedCount()
+	}
+	if rejected > 0 {
+		// 影子表缺少被拒绝的规则，翻转后生效规则与调用方预期不一致，整体放弃
+		s.finishEpoch(errEpochDiscarded)
+		abort, _ := json.Marshal(map[string]uint64{"token": req.Token})
+		s.fanoutEpoch(context.Background(), nodes, "/api/ebpf/epoch/abort", abort)
+		s.logger.Error("Epoch aborted on rejected rules", zap.Uint64("token", req.Token), zap.Int("rejected", rejected))
+		s.sendError(w, http.StatusConflict, fmt.Sprintf("%d staged rules rejected by agents, epoch aborted", rejected))
+		return
+	}
+	at := time.Now().Add(lead)
+	payload, _ := json.Marshal(map[string]interface{}{"token": req.Token, "atUnixNano": at.UnixNano()})
+	results := s.fanoutEpoch(r.Context(), nodes, "/api/ebpf/epoch/commit", payload)
+	// 已翻转的节点以影子表为生效规则，同步更新其快照 (未播种时影子表即全部规则)
+	s.commitStaged(staged, results, !seed)
+
+	// 无论成败都结束本 epoch：已翻转的节点无法回滚，未翻转的节点在下次 begin 时丢弃影子表
+	s.finishEpoch(errEpochDiscarded)
+
+	if failed := countEpochFailures(results); failed > 0 {
+		s.logger.Error("Epoch commit partially failed", zap.Uint64("token", req.Token), zap.Int("failed", failed))
+		s.sendEpochFailure(w, results, fmt.Sprintf("%d/%d nodes failed to commit", failed, len(results)))
+		return
+	}
+
+	var first, last int64
+	for i, res := range results {
+		if i == 0 || res.FlippedAtUnixNano < first {
+			first = res.FlippedAtUnixNano
+		}
+		if res.FlippedAtUnixNano > last {
+			last = res.FlippedAtUnixNano
+		}
+	}
+	s.logger.Info("Epoch committed", zap.Uint64("token", req.Token), zap.Int("nodes", len(results)),
+		zap.Duration("skew", time.Duration(last-first)))
+	s.sendSuccess(w, map[string]interface{}{
+		"status":              "committed",
+		"scheduledAtUnixNano": at.UnixNano(),
+		"skewUs":              (last - first) / 1000,
+		"nodes":               results,
+	})
+}
+
+// handleEpochAbort 丢弃暂存中的影子表，生效规则不受影响
+func (s *MasterServer) handleEpochAbort(w http.ResponseWriter, r *http.Request) {
+	e := &s.epoch
+	e.mu.Lock()
+	if e.busy {
+		e.mu.Unlock()
+		s.sendError(w, http.StatusConflict, "epoch operation in progress")
+		return
+	}
+	if e.token == 0 {
+		e.mu.Unlock()
+		s.sendSuccess(w, map[string]string{"status": "idle"})
+		return
+	}
+	token := e.token
+	nodes := make([]string, 0, len(e.staged))
+	for node := range e.staged {
+		nodes = append(nodes, node)
+	}
+	e.busy = true
+	e.mu.Unlock()
+
+	s.finishEpoch(errEpochDiscarded)
+	payload, _ := json.Marshal(map[string]uint64{"token": token})
+	results := s.fanoutEpoch(r.Context(), nodes, "/api/ebpf/epoch/abort", payload)
+	s.logger.Info("Epoch aborted", zap.Uint64("token", token))
+	s.sendSuccess(w, map[string]interface{}{"status": "aborted", "nodes": results})
+}
+
+func (s *MasterServer) handleEpochStatus(w http.ResponseWriter, r *http.Request) {
+	e := &s.epoch
+	e.mu.RLock()
+	defer e.mu.RUnlock()
+	if e.token == 0 {
+		s.sendSuccess(w, map[string]string{"status": "idle"})
+		return
+	}
+	pending := make(map[string]int, len(e.staged))
+	for node, d := range e.staged {
+		pending[node] = d.pendingCount()
+	}
+	s.sendSuccess(w, map[string]interface{}{
+		"status":  "staged",
+		"token":   strconv.FormatUint(e.token, 10),
+		"busy":    e.busy,
+		"stagedS": int64(time.Since(e.begunAt).Seconds()),
+		"pending": pending,
+	})
+}
+
+// =================================================================================
+// 写入路由与暂存分发器生命周期
+// =================================================================================
+
+// routeFor 根据 ?epoch= 选择写入目标：缺省为实时分发器，否则为该 epoch 的暂存分发器。
+// 返回的 release 需在提交完成后调用，保证 commit 开始 drain 时不再有写入落入暂存分发器
+func (s *MasterServer) routeFor(r *http.Request) (dispatchRoute, func(), error) {
+	raw := r.URL.Query().Get("epoch")
+	if raw == "" {
+		return func(nodeIP string) (*nodeDispatcher, error) { return s.dispatcherFor(nodeIP), nil }, func() {}, nil
+	}
+	token, err := strconv.ParseUint(raw, 10, 64)
+	if err != nil {
+		return nil, nil, fmt.Errorf("invalid epoch token %q", raw)
+	}
+
+	e := &s.epoch
+	e.mu.RLock()
+	if e.busy || e.token == 0 || e.token != token {
+		e.mu.RUnlock()
+		return nil, nil, fmt.Errorf("epoch %d is not accepting writes", token)
+	}
+	staged := e.staged
+	route := func(nodeIP string) (*nodeDispatcher, error) {
+		d, ok := staged[nodeIP]
+		if !ok {
+			return nil, fmt.Errorf("node %s is not part of epoch %d", nodeIP, token)
+		}
+		return d, nil
+	}
+	return route, e.mu.RUnlock, nil
+}
+
+// finishEpoch 停止暂存分发器并清空 epoch 状态；未下发的暂存规则以 err 通知等待方
+func (s *MasterServer) finishEpoch(err error) {
+	e := &s.epoch
+	e.mu.Lock()
+	staged, cancel := e.staged, e.cancel
+	e.token, e.staged, e.cancel = 0, nil, nil
+	e.mu.Unlock()
+
+	for _, d := range staged {
+		d.discard(err)
+	}
+	if cancel != nil {
+		cancel()
+	}
+	e.wg.Wait()
+
+	e.mu.Lock()
+	e.busy = false
+	e.mu.Unlock()
+}
+
+// =================================================================================
+// Agent 扇出
+// =================================================================================
+
+func (s *MasterServer) fanoutEpoch(ctx context.Context, nodes []string, path string, payload []byte) []EpochNodeResult {
+	results := make([]EpochNodeResult, len(nodes))
+	var wg sync.WaitGroup
+	for i, node := range nodes {
+		wg.Add(1)
+		go func(i int, node string) {
+			defer wg.Done()
+			results[i].Node = node
+			body, err := s.agentJSON(ctx, node, "POST", path, payload)
+			if err != nil {
+				results[i].Error = err.Error()
+				return
+			}
+			var resp struct {
+				Epoch             uint32 `json:"epoch"`
+				FlippedAtUnixNano int64  `json:"flippedAtUnixNano"`
+			}
+			if err := json.Unmarshal(body, &resp); err == nil {
+				results[i].Epoch, results[i].FlippedAtUnixNano = resp.Epoch, resp.FlippedAtUnixNano
+			}
+		}(i, node)
+	}
+	wg.Wait()
+	return results
+}
+
+// agentJSON 向节点 agent 发送一个 JSON 请求，非 200 时返回错误
+func (s *MasterServer) agentJSON(ctx context.Context, nodeIP, method, path string, payload []byte) ([]byte, error) {
+	ctx, cancel := context.WithTimeout(ctx, epochAgentTimeout)
+	defer cancel()
+
+	url := fmt.Sprintf("http://%s:%d%s", nodeIP, AgentPort, path)
+	req, err := http.NewRequestWithContext(ctx, method, url, bytes.NewReader(payload))
+	if err != nil {
+		return nil, err
+	}
+	req.Header.Set("Content-Type", "application/json")
+
+	resp, err := s.httpClient.Do(req)
+	if err != nil {
+		return nil, err
+	}
+	body, _ := io.ReadAll(io.LimitReader(resp.Body, 4096))
+	resp.Body.Close()
+	if resp.StatusCode != http.StatusOK {
+		return nil, fmt.Errorf("agent returned %d: %s", resp.StatusCode, bytes.TrimSpace(body))
+	}
+	return body, nil
+}
+
+func countEpochFailures(results []EpochNodeResult) int {
+	failed := 0
+	for _, res := range results {
+		if res.Error != "" {
+			failed++
+		}
+	}
+	return failed
+}
+
+func (s *MasterServer) sendEpochFailure(w http.ResponseWriter, results []EpochNodeResult, msg string) {
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(http.StatusBadGateway)
+	json.NewEncoder(w).Encode(Response{Success: false, Data: results, Error: msg})
+}
@@ -0,0 +1,159 @@
+package api
+
+import (
+	"context"
+	"emunet/linkserver/internal/redis"
+	"encoding/json"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+	PodCacheResyncInterval = 60 * time.Second // 兜底全量同步，覆盖 pub/sub 断线期间丢失的事件
+	podEventChannelSize    = 4096
+)
+
+// =================================================================================
+// Pod 位置缓存 (pod -> node, MAC, veth ifindex)
+// =================================================================================
+
+// PodCache 使用 sync.Map 实现高性能并发读，写入只来自同步 goroutine 和未命中回源
+type PodCache struct {
+	data sync.Map
+}
+
+func (c *PodCache) Get(podName string) (*redis.PodStatus, bool) {
+	val, ok := c.data.Load(podName)
+	if !ok {
+		return nil, false
+	}
+	return val.(*redis.PodStatus), true
+}
+
+func (c *PodCache) Set(pod *redis.PodStatus) {
+	if pod.PodName == "" {
+		return
+	}
+	c.data.Store(pod.PodName, pod)
+}
+
+func (c *PodCache) Delete(podName string) {
+	c.data.Delete(podName)
+}
+
+func (c *PodCache) Len() int {
+	n := 0
+	c.data.Range(func(_, _ interface{}) bool {
+		n++
+		return true
+	})
+	return n
+}
+
+// replaceAll 用全量快照替换缓存内容
+func (c *PodCache) replaceAll(pods []redis.PodStatus) {
+	fresh := make(map[string]struct{}, len(pods))
+	for i := range pods {
+		c.Set(&pods[i])
+		fresh[pods[i].PodName] = struct{}{}
+	}
+	c.data.Range(func(key, _ interface{}) bool {
+		if _, ok := fresh[key.(string)]; !ok {
+			c.data.Delete(key)
+		}
+		return true
+	})
+}
+
+func (c *PodCache) apply(event *redis.PodEvent) {
+	switch event.Op {
+	case redis.PodEventUpsert:
+		for i := range event.Pods {
+			c.Set(&event.Pods[i])
+		}
+	case redis.PodEventDelete:
+		for _, name := range event.PodNames {
+			c.Delete(name)
+		}
+	}
+}
+
+// StartPodCacheSync 订阅 pod 事件并全量加载；订阅先于加载，加载期间到达的事件在加载后按序应用。
+// 订阅断开时 go-redis 自动重连，周期性全量同步兜底可能丢失的事件
+func (s *MasterServer) StartPodCacheSync() {
+	s.wg.Add(1)
+	go func() {
+		defer s.wg.Done()
+		for s.ctx.Err() == nil {
+			if err := s.runPodCacheSync(); err != nil && s.ctx.Err() == nil {
+				s.logger.Warn("Pod cache sync interrupted, retrying", zap.Error(err))
+				select {
+				case <-s.ctx.Done():
+				case <-time.After(time.Second):
+				}
+			}
+		}
+	}()
+}
+
+func (s *MasterServer) runPodCacheSync() error {
+	sub, events, err := s.redis.SubscribePodEvents(s.ctx, podEventChannelSize)
+	if err != nil {
+		return err
+	}
+	defer sub.Close()
+
+	if err := s.resyncPodCache(); err != nil {
+		return err
+	}
+
+	ticker := time.NewTicker(PodCacheResyncInterval)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-s.ctx.Done():
+			return nil
+		case msg, ok := <-events:
+			if !ok {
+				return nil
+			}
+			var event redis.PodEvent
+			if err := json.Unmarshal([]byte(msg.Payload), &event); err != nil {
+				s.logger.Warn("Invalid pod event", zap.Error(err))
+				continue
+			}
+			s.podCache.apply(&event)
+		case <-ticker.C:
+			if err := s.resyncPodCache(); err != nil {
+				s.logger.Warn("Periodic pod cache resync failed", zap.Error(err))
+			}
+		}
+	}
+}
+
+func (s *MasterServer) resyncPodCache() error {
+	ctx, cancel := context.WithTimeout(s.ctx, 30*time.Second)
+	defer cancel()
+	pods, err := s.redis.LoadAllPodLookups(ctx)
+	if err != nil {
+		return err
+	}
+	s.podCache.replaceAll(pods)
+	s.logger.Debug("Pod cache synced", zap.Int("pods", len(pods)))
+	return nil
+}
+
+// lookupPod 优先读本地缓存，未命中时回源 Redis 并写回缓存
+func (s *MasterServer) lookupPod(ctx context.Context, podName string) (*redis.PodStatus, error) {
+	if pod, ok := s.podCache.Get(podName); ok {
+		return pod, nil
+	}
+	pod, err := s.redis.GetPodInfoDirectly(ctx, podName)
+	if err != nil {
+		return nil, err
+	}
+	s.podCache.Set(pod)
+	return pod, nil
+}
@@ -0,0 +1,182 @@
+package api
+
+import (
+	"bytes"
+	"context"
+	"emunet/linkserver/internal/redis"
+	"encoding/json"
+	"fmt"
+	"io"
+	"net/http"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+	MaxProfileID       = 4095 // 与 Agent 侧 MAX_PROFILES - 1 一致，0 号保留
+	profileSyncTimeout = 5 * time.Second
+)
+
+// ProfileNodeResult 为模板在单个节点上的写入结果
+type ProfileNodeResult struct {
+	Node  string `json:"node"`
+	Error string `json:"error,omitempty"`
+}
+
+// =================================================================================
+// 链路模板 Handlers
+// =================================================================================
+
+// handleProfilesUpsert 保存模板到 Redis (新节点据此同步)，并并行下发到所有已知节点
+func (s *MasterServer) handleProfilesUpsert(w http.ResponseWriter, r *http.Request) {
+	var profiles []redis.LinkProfile
+	if err := json.NewDecoder(r.Body).Decode(&profiles); err != nil {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON: "+err.Error())
+		return
+	}
+	for _, p := range profiles {
+		if p.ID == 0 || p.ID > MaxProfileID {
+			s.sendError(w, http.StatusBadRequest, fmt.Sprintf("profile id %d out of range [1, %d]", p.ID, MaxProfileID))
+			return
+		}
+	}
+
+	if err := s.redis.SaveProfiles(r.Context(), profiles); err != nil {
+		s.logger.Error("Failed to save profiles", zap.Error(err))
+		s.sendError(w, http.StatusInternalServerError, "Failed to save profiles")
+		return
+	}
+
+	payload, _ := json.Marshal(profiles)
+	s.sendProfileFanout(w, r.Context(), "POST", payload)
+}
+
+// handleProfilesDelete 删除模板；节点上对应数组元素被清零，仍绑定它的链路变为无损伤
+func (s *MasterServer) handleProfilesDelete(w http.ResponseWriter, r *http.Request) {
+	var ids []uint32
+	if err := json.NewDecoder(r.Body).Decode(&ids); err != nil {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON: "+err.Error())
+		return
+	}
+
+	if err := s.redis.DeleteProfiles(r.Context(), ids); err != nil {
+		s.logger.Error("Failed to delete profiles", zap.Error(err))
+		s.sendError(w, http.StatusInternalServerError, "Failed to delete profiles")
+		return
+	}
+
+	payload, _ := json.Marshal(ids)
+	s.sendProfileFanout(w, r.Context(), "DELETE", payload)
+}
+
+func (s *MasterServer) handleProfilesList(w http.ResponseWriter, r *http.Request) {
+	profiles, err := s.redis.ListProfiles(r.Context())
+	if err != nil {
+		s.logger.Error("Redis list error", zap.Error(err))
+		s.sendError(w, http.StatusInternalServerError, "Failed to retrieve profiles")
+		return
+	}
+	s.sendSuccess(w, profiles)
+}
+
+func (s *MasterServer) sendProfileFanout(w http.ResponseWriter, ctx context.Context, method string, payload []byte) {
+	results := s.fanoutProfiles(ctx, method, payload)
+	failed := 0
+	for _, res := range results {
+		if res.Error != "" {
+			failed++
+		}
+	}
+	if failed > 0 {
+		w.Header().Set("Content-Type", "application/json")
+		w.WriteHeader(http.StatusBadGateway)
+		json.NewEncoder(w).Encode(Response{Success: false, Data: results, Error: fmt.Sprintf("%d/%d nodes failed", failed, len(results))})
+		return
+	}
+	s.sendSuccess(w, map[string]interface{}{"status": "applied", "nodes": results})
+}
+
+// =================================================================================
+// 模板扇出
+// =================================================================================
+
+// knownNodes 返回 Pod 缓存中出现过的节点与已有分发器的节点的并集
+func (s *MasterServer) knownNodes() []string {
+	set := make(map[string]struct{})
+	s.podCache.data.Range(func(_, val interface{}) bool {
+		if node := val.(*redis.PodStatus).NodeName; node != "" {
+			set[node] = struct{}{}
+		}
+		return true
+	})
+	s.dispatchersMu.RLock()
+	for node := range s.dispatchers {
+		set[node] = struct{}{}
+	}
+	s.dispatchersMu.RUnlock()
+
+	nodes := make([]string, 0, len(set))
+	for node := range set {
+		nodes = append(nodes, node)
+	}
+	return nodes
+}
+
+func (s *MasterServer) fanoutProfiles(ctx context.Context, method string, payload []byte) []ProfileNodeResult {
+	nodes := s.knownNodes()
+	results := make([]ProfileNodeResult, len(nodes))
+	var wg sync.WaitGroup
+	for i, node := range nodes {
+		wg.Add(1)
+		go func(i int, node string) {
+			defer wg.Done()
+			results[i].Node = node
+			if err := s.sendProfiles(ctx, node, method, payload); err != nil {
+				results[i].Error = err.Error()
+			}
+		}(i, node)
+	}
+	wg.Wait()
+	return results
+}
+
+func (s *MasterServer) sendProfiles(ctx context.Context, nodeIP, method string, payload []byte) error {
+	ctx, cancel := context.WithTimeout(ctx, profileSyncTimeout)
+	defer cancel()
+
+	url := fmt.Sprintf("http://%s:%d/api/ebpf/profiles", nodeIP, AgentPort)
+	req, err := http.NewRequestWithContext(ctx, method, url, bytes.NewReader(payload))
+	if err != nil {
+		return err
+	}
+	req.Header.Set("Content-Type", "application/json")
+
+	resp, err := s.httpClient.Do(req)
+	if err != nil {
+		return err
+	}
+	body, _ := io.ReadAll(io.LimitReader(resp.Body, 512))
+	resp.Body.Close()
+	if resp.StatusCode != http.StatusOK {
+		return fmt.Errorf("agent returned %d: %s", resp.StatusCode, bytes.TrimSpace(body))
+	}
+	return nil
+}
+
+// syncProfilesTo 把 Redis 中的全部模板推送到一个节点 (best effort)
+func (s *MasterServer) syncProfilesTo(ctx context.Context, nodeIP string) {
+	profiles, err := s.redis.ListProfiles(ctx)
+	if err != nil {
+		s.logger.Warn("Failed to load profiles for node sync", zap.String("node", nodeIP), zap.Error(err))
+		return
+	}
+	if len(profiles) == 0 {
+		return
+	}
+	payload, _ := json.Marshal(profiles)
+	if err := s.sendProfiles(ctx, nodeIP, "POST", payload); err != nil {
+		s.logger.Warn("Failed to sync profiles to node", zap.String("node", nodeIP), zap.Error(err))
+	}
+}
@@ -0,0 +1,180 @@
+package api
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"net/http"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const scheduleAgentPath = "/api/ebpf/schedule"
+
+// ScheduledLinkChange 为一个定时链路变更：在 AtUnixNano (或相对当前的 AtOffsetMs) 时刻
+// 写入 (Delete 为 false) 或删除 Pod1 与 Pod2 之间的双向规则
+type ScheduledLinkChange struct {
+	ID         string `json:"id"`
+	AtUnixNano int64  `json:"atUnixNano,omitempty"`
+	AtOffsetMs int64  `json:"atOffsetMs,omitempty"`
+	Delete     bool   `json:"delete,omitempty"`
+	EBPFEntryByPodsRequest
+}
+
+// agentScheduleEvent 与 Agent 侧 pkg.ScheduleRequest 的 JSON 一致
+type agentScheduleEvent struct {
+	ID         string         `json:"id"`
+	AtUnixNano int64          `json:"atUnixNano"`
+	Upsert     []AgentRequest `json:"upsert,omitempty"`
+	Delete     []AgentRequest `json:"delete,omitempty"`
+}
+
+// ScheduleNodeResult 为定时事件在单个节点上的上传结果
+type ScheduleNodeResult struct {
+	Node   string          `json:"node"`
+	Events int             `json:"events,omitempty"`
+	Status json.RawMessage `json:"status,omitempty"`
+	Error  string          `json:"error,omitempty"`
+}
+
+// =================================================================================
+// 定时链路变更 Handlers
+// =================================================================================
+
+// handleScheduleByPods 把定时变更解析为各节点的本地事件并提前上传。
+// 生效时刻由节点本地调度保证，与 linkserver 排队、HTTP 时延无关；各节点时钟需已同步
+func (s *MasterServer) handleScheduleByPods(w http.ResponseWriter, r *http.Request) {
+	var changes []ScheduledLinkChange
+	if err := json.NewDecoder(r.Body).Decode(&changes); err != nil {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON: "+err.Error())
+		return
+	}
+
+	now := time.Now()
+	perNode := make(map[string][]agentScheduleEvent)
+	for i := range changes {
+		c := &changes[i]
+		if c.ID == "" || c.Pod1 == "" || c.Pod2 == "" {
+			s.sendError(w, http.StatusBadRequest, fmt.Sprintf("change %d: id, pod1 and pod2 are required", i))
+			return
+		}
+		if !c.Delete {
+			if err := c.validate(); err != nil {
+				s.sendError(w, http.StatusBadRequest, fmt.Sprintf("change %s: %v", c.ID, err))
+				return
+			}
+		}
+		at := c.AtUnixNano
+		if at == 0 {
+			at = now.Add(time.Duration(c.AtOffsetMs) * time.Millisecond).UnixNano()
+		}
+
+		pod1, err1 := s.lookupPod(r.Context(), c.Pod1)
+		pod2, err2 := s.lookupPod(r.Context(), c.Pod2)
+		if err1 != nil || err2 != nil || pod1 == nil || pod2 == nil {
+			s.sendError(w, http.StatusNotFound, fmt.Sprintf("change %s: pod info not found", c.ID))
+			return
+		}
+		if pod1.NodeName == "" || pod2.NodeName == "" || pod1.MACAddress == "" || pod2.MACAddress == "" {
+			s.sendError(w, http.StatusPreconditionFailed, fmt.Sprintf("change %s: pod metadata incomplete", c.ID))
+			return
+		}
+
+		// 与 handleRuleCreate 相同的双向规则 (Ingress 时两条都在 Node1 上)
+		for _, nr := range c.linkRules(pod1, pod2) {
+			events := perNode[nr.node]
+			// 同一变更在同一节点上合并为一个事件，两个方向同时生效
+			if len(events) == 0 || events[len(events)-1].ID != c.ID {
+				events = append(events, agentScheduleEvent{ID: c.ID, AtUnixNano: at})
+			}
+			ev := &events[len(events)-1]
+			if c.Delete {
+				ev.Delete = append(ev.Delete, AgentRequest{Ifindex: nr.rule.Ifindex, SrcMac: nr.rule.SrcMac, Ingress: nr.rule.Ingress})
+			} else {
+				ev.Upsert = append(ev.Upsert, nr.rule)
+			}
+			perNode[nr.node] = events
+		}
+	}
+
+	results := make([]ScheduleNodeResult, 0, len(perNode))
+	var mu sync.Mutex
+	var wg sync.WaitGroup
+	for node, events := range perNode {
+		wg.Add(1)
+		go func(node string, events []agentScheduleEvent) {
+			defer wg.Done()
+			res := ScheduleNodeResult{Node: node, Events: len(events)}
+			payload, _ := json.Marshal(events)
+			if _, err := s.agentJSON(r.Context(), node, "POST", scheduleAgentPath, payload); err != nil {
+				res.Error = err.Error()
+			}
+			mu.Lock()
+			results = append(results, res)
+			mu.Unlock()
+		}(node, events)
+	}
+	wg.Wait()
+	s.sendScheduleResults(w, results)
+}
+
+// handleScheduleCancel 在所有已知节点上取消事件 (JSON id 数组，空数组取消全部)
+func (s *MasterServer) handleScheduleCancel(w http.ResponseWriter, r *http.Request) {
+	var ids []string
+	if err := json.NewDecoder(r.Body).Decode(&ids); err != nil {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON: "+err.Error())
+		return
+	}
+	payload, _ := json.Marshal(ids)
+	s.sendScheduleResults(w, s.fanoutSchedule(r.Context(), "DELETE", payload))
+}
+
+// handleScheduleStatus 汇总各节点的待执行事件与生效偏差
+func (s *MasterServer) handleScheduleStatus(w http.ResponseWriter, r *http.Request) {
+	s.sendScheduleResults(w, s.fanoutSchedule(r.Context(), "GET", nil))
+}
+
+func (s *MasterServer) fanoutSchedule(ctx context.Context, method string, payload []byte) []ScheduleNodeResult {
+	nodes := s.knownNodes()
+	results := make([]ScheduleNodeResult, len(nodes))
+	var wg sync.WaitGroup
+	for i, node := range nodes {
+		wg.Add(1)
+		go func(i int, node string) {
+			defer wg.Done()
+			results[i].Node = node
+			path := scheduleAgentPath
+			if method == "GET" {
+				// 只取摘要，待执行事件列表可能超过 agentJSON 的响应读取上限
+				path += "?summary=true"
+			}
+			body, err := s.agentJSON(ctx, node, method, path, payload)
+			if err != nil {
+				results[i].Error = err.Error()
+			} else if method == "GET" {
+				results[i].Status = json.RawMessage(body)
+			}
+		}(i, node)
+	}
+	wg.Wait()
+	return results
+}
+
+func (s *MasterServer) sendScheduleResults(w http.ResponseWriter, results []ScheduleNodeResult) {
+	failed := 0
+	for _, res := range results {
+		if res.Error != "" {
+			failed++
+			s.logger.Warn("Schedule request failed on node", zap.String("node", res.Node), zap.String("error", res.Error))
+		}
+	}
+	if failed > 0 {
+		w.Header().Set("Content-Type", "application/json")
+		w.WriteHeader(http.StatusBadGateway)
+		json.NewEncoder(w).Encode(Response{Success: false, Data: results, Error: fmt.Sprintf("%d/%d nodes failed", failed, len(results))})
+		return
+	}
+	s.sendSuccess(w, map[string]interface{}{"nodes": results})
+}
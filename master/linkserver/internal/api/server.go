@@ -1,13 +1,13 @@
 package api
 
 import (
-	"bytes"
 	"context"
 	"emunet/linkserver/internal/redis"
 	"encoding/json"
+	"errors"
 	"fmt"
-	"io"
 	"net/http"
+	"strconv"
 	"sync"
 	"time"
 
@@ -16,44 +16,242 @@ import (
 )
 
 const (
-	AgentPort    = 12345   // Agent 监听端口
-	JobQueueSize = 1000000 // 任务队列缓冲区大小
-	WorkerCount  = 1000    // 并发 Worker 数量
+	AgentPort        = 12345           // Agent 监听端口
+	ApplyWaitTimeout = 5 * time.Second // ?wait=true 时等待 agent 确认的最长时间
 )
 
 // =================================================================================
 // 1. 数据结构定义 (Types)
 // =================================================================================
 
-// AgentJob 定义发送给 Agent 的异步任务
-type AgentJob struct {
-	TargetNodeIP string
-	Method       string
-	Payload      []byte
-}
-
 // Request/Response DTOs
-type EBPFEntryByPodsRequest struct {
-	Pod1            string `json:"pod1"`
-	Pod2            string `json:"pod2"`
-	ThrottleRateBps uint32 `json:"throttleRateBps"`
+
+// LinkParams 为链路一个方向的参数
+type LinkParams struct {
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
 	Delay           uint32 `json:"delay"`
 	LossRate        uint32 `json:"lossRate"`
 	Jitter          uint32 `json:"jitter"`
+	// ProfileID 非 0 时把链路绑定到 /profiles 中定义的模板，以上参数不再生效
+	ProfileID uint32 `json:"profileId,omitempty"`
+	// Gilbert-Elliott 突发丢包 (单位 0.01%)：GeP 为好->坏转移概率，GeR 为坏->好转移概率，
+	// GeLossBad 为坏状态丢包率，好状态丢包率仍为 LossRate；GeP 为 0 时独立丢包
+	GeP       uint32 `json:"geP,omitempty"`
+	GeR       uint32 `json:"geR,omitempty"`
+	GeLossBad uint32 `json:"geLossBad,omitempty"`
+	// 瓶颈队列与 AQM (仅限速时生效)：QueueBytes/QueueDelay 为队列上限，RedMin/RedMax 为
+	// RED 排队时延阈值 (0.01ms)，RedMaxP 为最大早期丢包概率 (0.01%)，ECN 为 true 时标记 CE 代替早期丢包
+	QueueBytes uint32 `json:"queueBytes,omitempty"`
+	QueueDelay uint32 `json:"queueDelay,omitempty"`
+	RedMin     uint32 `json:"redMin,omitempty"`
+	RedMax     uint32 `json:"redMax,omitempty"`
+	RedMaxP    uint32 `json:"redMaxP,omitempty"`
+	ECN        bool   `json:"ecn,omitempty"`
+	// GroupID 非 0 时链路还经过节点上该组的共享瓶颈 (组在 agent 的 /api/ebpf/aggregates 配置)
+	GroupID uint32 `json:"groupId,omitempty"`
+	// TraceID 非 0 时链路的速率/时延/丢包率按 /traces 中的轨迹随时间变化
+	TraceID uint32 `json:"traceId,omitempty"`
+	// JitterDist 为抖动分布 (0 均匀，1 正态，2 Pareto；非均匀时 Jitter 为标准差)，
+	// JitterOrdered 为 true 时抖动不造成同一链路内的乱序
+	JitterDist    uint32 `json:"jitterDist,omitempty"`
+	JitterOrdered bool   `json:"jitterOrdered,omitempty"`
+	// netem 式包级损伤 (单位 0.01%)：DupRate 复制，CorruptRate 翻转载荷比特 (默认令校验和失配，
+	// CorruptKeepCsum 时修正)，ReorderRate 跳过时延抖动造成重排 (ReorderGap 同 netem 的 gap，需配合 Delay)
+	DupRate         uint32 `json:"dupRate,omitempty"`
+	CorruptRate     uint32 `json:"corruptRate,omitempty"`
+	CorruptKeepCsum bool   `json:"corruptKeepCsum,omitempty"`
+	ReorderRate     uint32 `json:"reorderRate,omitempty"`
+	ReorderGap      uint32 `json:"reorderGap,omitempty"`
+}
+
+// EBPFEntryByPodsRequest 描述 Pod1 与 Pod2 之间的一条双向链路。内嵌参数作用于两个方向，
+// 指定 Reverse 时 Pod2 -> Pod1 方向改用 Reverse，用于模拟上下行不对称的接入链路
+type EBPFEntryByPodsRequest struct {
+	Pod1 string `json:"pod1"`
+	Pod2 string `json:"pod2"`
+	LinkParams
+	Reverse *LinkParams `json:"reverse,omitempty"`
+	// Ingress 为 true 时两个方向都写在 Pod1 的 veth 上 (出口为下行 Pod2 -> Pod1，入口为上行
+	// Pod1 -> Pod2)，只下发到 Pod1 所在节点；该节点的 CNI 需启用 ingress
+	Ingress bool `json:"ingress,omitempty"`
 }
 
 type EBPFEntryDeleteByPodsRequest struct {
 	Pod1 string `json:"pod1"`
 	Pod2 string `json:"pod2"`
+	// Ingress 与创建时一致，删除 Pod1 veth 上两个方向的规则
+	Ingress bool `json:"ingress,omitempty"`
 }
 
 type AgentRequest struct {
 	Ifindex         uint32 `json:"ifindex"`
 	SrcMac          string `json:"srcMac"`
-	ThrottleRateBps uint32 `json:"throttleRateBps,omitempty"`
+	ThrottleRateBps uint64 `json:"throttleRateBps,omitempty"`
 	Delay           uint32 `json:"delay,omitempty"`
 	LossRate        uint32 `json:"lossRate,omitempty"`
 	Jitter          uint32 `json:"jitter,omitempty"`
+	ProfileID       uint32 `json:"profileId,omitempty"`
+	GeP             uint32 `json:"geP,omitempty"`
+	GeR             uint32 `json:"geR,omitempty"`
+	GeLossBad       uint32 `json:"geLossBad,omitempty"`
+	QueueBytes      uint32 `json:"queueBytes,omitempty"`
+	QueueDelay      uint32 `json:"queueDelay,omitempty"`
+	RedMin          uint32 `json:"redMin,omitempty"`
+	RedMax          uint32 `json:"redMax,omitempty"`
+	RedMaxP         uint32 `json:"redMaxP,omitempty"`
+	ECN             bool   `json:"ecn,omitempty"`
+	GroupID         uint32 `json:"groupId,omitempty"`
+	TraceID         uint32 `json:"traceId,omitempty"`
+	JitterDist      uint32 `json:"jitterDist,omitempty"`
+	JitterOrdered   bool   `json:"jitterOrdered,omitempty"`
+	DupRate         uint32 `json:"dupRate,omitempty"`
+	CorruptRate     uint32 `json:"corruptRate,omitempty"`
+	CorruptKeepCsum bool   `json:"corruptKeepCsum,omitempty"`
+	ReorderRate     uint32 `json:"reorderRate,omitempty"`
+	ReorderGap      uint32 `json:"reorderGap,omitempty"`
+	// Ingress 为 true 时规则作用于 Ifindex 入口方向，SrcMac 为目的 MAC
+	Ingress bool `json:"ingress,omitempty"`
+}
+
+// agentRule 生成下发到 ifindex 所在节点、匹配来自 srcMac 的包的规则
+func (req *LinkParams) agentRule(ifindex uint32, srcMac string) AgentRequest {
+	return AgentRequest{
+		Ifindex:         ifindex,
+		SrcMac:          srcMac,
+		ThrottleRateBps: req.ThrottleRateBps,
+		Delay:           req.Delay,
+		LossRate:        req.LossRate,
+		Jitter:          req.Jitter,
+		ProfileID:       req.ProfileID,
+		GeP:             req.GeP,
+		GeR:             req.GeR,
+		GeLossBad:       req.GeLossBad,
+		QueueBytes:      req.QueueBytes,
+		QueueDelay:      req.QueueDelay,
+		RedMin:          req.RedMin,
+		RedMax:          req.RedMax,
+		RedMaxP:         req.RedMaxP,
+		ECN:             req.ECN,
+		GroupID:         req.GroupID,
+		TraceID:         req.TraceID,
+		JitterDist:      req.JitterDist,
+		JitterOrdered:   req.JitterOrdered,
+		DupRate:         req.DupRate,
+		CorruptRate:     req.CorruptRate,
+		CorruptKeepCsum: req.CorruptKeepCsum,
+		ReorderRate:     req.ReorderRate,
+		ReorderGap:      req.ReorderGap,
+	}
+}
+
+// 链路参数取值范围，与 Agent 侧 pkg.ValidateParams 一致
+const (
+	MinThrottleRateBps = 1000  // 与 Agent 侧 pkg.MinThrottleRateBps 一致
+	LossScope          = 10000 // 概率类参数 (0.01%) 的满量程
+	MaxGroupID         = 4095  // 与 Agent 侧 MaxGroupAggregates - 1 一致
+	MaxJitterDist      = 2     // 0 均匀，1 正态，2 Pareto
+)
+
+// errInvalidParams 表示链路参数会被 agent 拒绝 (400)
+var errInvalidParams = errors.New("invalid link params")
+
+// validate 在入队前拒绝 agent 会判为非法的参数：agent 按帧校验，
+// 一条非法规则会让同帧合并的其他调用方的规则一起被拒绝
+func (p *LinkParams) validate() error {
+	if p.ThrottleRateBps != 0 && p.ThrottleRateBps < MinThrottleRateBps {
+		return fmt.Errorf("%w: throttleRateBps %d below minimum %d", errInvalidParams, p.ThrottleRateBps, MinThrottleRateBps)
+	}
+	if p.LossRate > LossScope {
+		return fmt.Errorf("%w: lossRate must not exceed %d", errInvalidParams, LossScope)
+	}
+	if p.ProfileID > MaxProfileID {
+		return fmt.Errorf("%w: profileId %d out of range [0, %d]", errInvalidParams, p.ProfileID, MaxProfileID)
+	}
+	if p.GeP > LossScope || p.GeR > LossScope || p.GeLossBad > LossScope {
+		return fmt.Errorf("%w: geP/geR/geLossBad must not exceed %d", errInvalidParams, LossScope)
+	}
+	if p.GeP != 0 && p.GeR == 0 {
+		return fmt.Errorf("%w: geR must be non-zero when geP is set", errInvalidParams)
+	}
+	if p.RedMax != 0 && p.RedMax <= p.RedMin {
+		return fmt.Errorf("%w: redMax %d must be greater than redMin %d", errInvalidParams, p.RedMax, p.RedMin)
+	}
+	if p.RedMaxP > LossScope {
+		return fmt.Errorf("%w: redMaxP must not exceed %d", errInvalidParams, LossScope)
+	}
+	if p.GroupID > MaxGroupID {
+		return fmt.Errorf("%w: groupId %d out of range [0, %d]", errInvalidParams, p.GroupID, MaxGroupID)
+	}
+	if p.TraceID > MaxTraceID {
+		return fmt.Errorf("%w: traceId %d out of range [0, %d]", errInvalidParams, p.TraceID, MaxTraceID)
+	}
+	if p.JitterDist > MaxJitterDist {
+		return fmt.Errorf("%w: unknown jitterDist %d", errInvalidParams, p.JitterDist)
+	}
+	if p.DupRate > LossScope || p.CorruptRate > LossScope || p.ReorderRate > LossScope {
+		return fmt.Errorf("%w: dupRate/corruptRate/reorderRate must not exceed %d", errInvalidParams, LossScope)
+	}
+	return nil
+}
+
+// validate 校验两个方向的参数
+func (req *EBPFEntryByPodsRequest) validate() error {
+	if err := req.LinkParams.validate(); err != nil {
+		return err
+	}
+	if req.Reverse != nil {
+		if err := req.Reverse.validate(); err != nil {
+			return fmt.Errorf("reverse: %w", err)
+		}
+	}
+	return nil
+}
+
+// nodeRule 为下发到某个节点的一条规则
+type nodeRule struct {
+	node string
+	rule AgentRequest
+}
+
+// reverse 返回 Pod2 -> Pod1 方向的参数
+func (req *EBPFEntryByPodsRequest) reverse() *LinkParams {
+	if req.Reverse != nil {
+		return req.Reverse
+	}
+	return &req.LinkParams
+}
+
+// linkRules 生成双向规则：默认每个方向写在接收端 veth 的出口、匹配发送端 MAC，
+// 分别下发到两个节点；Ingress 时两条规则都写在 Pod1 的 veth 上，只涉及 Pod1 所在节点
+func (req *EBPFEntryByPodsRequest) linkRules(pod1, pod2 *redis.PodStatus) [2]nodeRule {
+	if req.Ingress {
+		up := req.agentRule(uint32(pod1.VethIfIndex), pod2.MACAddress)
+		up.Ingress = true
+		return [2]nodeRule{
+			{pod1.NodeName, up},
+			{pod1.NodeName, req.reverse().agentRule(uint32(pod1.VethIfIndex), pod2.MACAddress)},
+		}
+	}
+	return [2]nodeRule{
+		// 规则 A: 告诉 Node2，来自 Pod1 (MAC1) 的包要限制
+		{pod2.NodeName, req.agentRule(uint32(pod2.VethIfIndex), pod1.MACAddress)},
+		// 规则 B: 告诉 Node1，来自 Pod2 (MAC2) 的包要限制
+		{pod1.NodeName, req.reverse().agentRule(uint32(pod1.VethIfIndex), pod2.MACAddress)},
+	}
+}
+
+// linkKeys 返回 linkRules 对应的删除规则 (只包含识别 Key)
+func linkKeys(pod1, pod2 *redis.PodStatus, ingress bool) [2]nodeRule {
+	if ingress {
+		return [2]nodeRule{
+			{pod1.NodeName, AgentRequest{Ifindex: uint32(pod1.VethIfIndex), SrcMac: pod2.MACAddress, Ingress: true}},
+			{pod1.NodeName, AgentRequest{Ifindex: uint32(pod1.VethIfIndex), SrcMac: pod2.MACAddress}},
+		}
+	}
+	return [2]nodeRule{
+		{pod2.NodeName, AgentRequest{Ifindex: uint32(pod2.VethIfIndex), SrcMac: pod1.MACAddress}},
+		{pod1.NodeName, AgentRequest{Ifindex: uint32(pod1.VethIfIndex), SrcMac: pod2.MACAddress}},
+	}
 }
 
 type Response struct {
@@ -71,12 +269,15 @@ type MasterServer struct {
 	router     *mux.Router
 	logger     *zap.Logger
 	httpClient *http.Client
-
-	// 异步任务系统
-	jobQueue chan AgentJob
-	wg       sync.WaitGroup // 用于优雅退出等待
-	ctx      context.Context
-	cancel   context.CancelFunc
+	podCache   *PodCache
+
+	// 异步下发系统：每个节点一个合并分发器
+	dispatchers   map[string]*nodeDispatcher
+	dispatchersMu sync.RWMutex
+	epoch         epochCoordinator // 暂存中的规则表切换 (epoch)
+	wg            sync.WaitGroup   // 用于优雅退出等待
+	ctx           context.Context
+	cancel        context.CancelFunc
 }
 
 // NewMasterServer 初始化
@@ -84,40 +285,40 @@ func NewMasterServer(redisClient *redis.Client, logger *zap.Logger) *MasterServe
 	ctx, cancel := context.WithCancel(context.Background())
 
 	s := &MasterServer{
-		redis:  redisClient,
-		logger: logger,
-		router: mux.NewRouter(),
-		ctx:    ctx,
-		cancel: cancel,
+		redis:    redisClient,
+		logger:   logger,
+		router:   mux.NewRouter(),
+		podCache: &PodCache{},
+		ctx:      ctx,
+		cancel:   cancel,
 
-		// 缓冲队列：应对 Churn 模式下的突发流量
-		jobQueue: make(chan AgentJob, JobQueueSize),
+		// 按节点合并规则：应对 Churn 模式下同一链路的反复更新
+		dispatchers: make(map[string]*nodeDispatcher),
 
 		// 极致优化的 HTTP Client
 		httpClient: &http.Client{
 			Timeout: 5 * time.Second, // 快速失败原则
 			Transport: &http.Transport{
-				MaxIdleConns:        WorkerCount * 2, // 匹配 Worker 数量
-				MaxIdleConnsPerHost: 100,             // 单个 Node 的最大连接数
+				MaxIdleConns:        1000, // 每个节点同一时刻只有一个批量请求在途
+				MaxIdleConnsPerHost: 4,    // 单个 Node 的最大空闲连接数
 				IdleConnTimeout:     90 * time.Second,
 				DisableKeepAlives:   false,
 			},
 		},
 	}
 
-	// 启动路由和后台进程
+	// 启动路由和 Pod 缓存同步 (分发器在首次下发到某节点时按需启动)
 	s.setupRoutes()
-	s.startWorkers()
+	s.StartPodCacheSync()
 
 	return s
 }
 
 // Stop 优雅关闭
 func (s *MasterServer) Stop() {
-	s.logger.Info("Stopping Master Server, waiting for workers...")
-	close(s.jobQueue) // 关闭通道，Worker 处理完剩余数据后会自动退出
-	s.wg.Wait()       // 等待所有 Worker 归队
-	s.cancel()        // 取消上下文
+	s.logger.Info("Stopping Master Server, flushing node dispatchers...")
+	s.cancel()  // 取消上下文，分发器 flush 剩余规则后退出
+	s.wg.Wait() // 等待所有分发器退出
 	s.logger.Info("Master Server stopped gracefully.")
 }
 
@@ -136,6 +337,26 @@ func (s *MasterServer) setupRoutes() {
 	// 负责规则的下发、更新、删除。要求极致性能。
 	v1.HandleFunc("/ebpf/entry/by-pods", s.handleRuleCreate).Methods("POST")
 	v1.HandleFunc("/ebpf/entry/by-pods", s.handleRuleDelete).Methods("DELETE")
+	v1.HandleFunc("/topology", s.handleTopology).Methods("POST", "DELETE")
+	// 链路模板：一次写入、扇出到所有节点，绑定该模板的链路同时生效
+	v1.HandleFunc("/profiles", s.handleProfilesUpsert).Methods("POST")
+	v1.HandleFunc("/profiles", s.handleProfilesDelete).Methods("DELETE")
+	v1.HandleFunc("/profiles", s.handleProfilesList).Methods("GET")
+	v1.HandleFunc("/traces", s.handleTracesUpsert).Methods("POST")
+	v1.HandleFunc("/traces", s.handleTracesDelete).Methods("DELETE")
+	v1.HandleFunc("/traces", s.handleTracesList).Methods("GET")
+	// 定时变更：按 Pod 解析后提前上传到节点，由节点本地调度在计划时刻生效
+	v1.HandleFunc("/schedule/by-pods", s.handleScheduleByPods).Methods("POST")
+	v1.HandleFunc("/schedule", s.handleScheduleCancel).Methods("DELETE")
+	v1.HandleFunc("/schedule", s.handleScheduleStatus).Methods("GET")
+	// 接口聚合瓶颈：按 Pod 解析到所在节点与 veth，模拟 Pod 的接入链路
+	v1.HandleFunc("/aggregates/by-pod", s.handleAggregateByPod).Methods("POST", "DELETE")
+	v1.HandleFunc("/classes/by-pod", s.handleClassByPod).Methods("POST", "DELETE")
+	// Epoch：在影子表中暂存整套规则，所有节点在同一时刻原子切换
+	v1.HandleFunc("/epochs/begin", s.handleEpochBegin).Methods("POST")
+	v1.HandleFunc("/epochs/commit", s.handleEpochCommit).Methods("POST")
+	v1.HandleFunc("/epochs/abort", s.handleEpochAbort).Methods("POST")
+	v1.HandleFunc("/epochs", s.handleEpochStatus).Methods("GET")
 
 	// --- Group C: 查询平面 (Query Plane) - 低频、读操作 ---
 	// 负责查询当前的状态、拓扑信息。直接查 Redis。
@@ -146,52 +367,11 @@ func (s *MasterServer) setupRoutes() {
 }
 
 // =================================================================================
-// 3. Worker 系统 (Async Dispatcher)
-// =================================================================================
-
-func (s *MasterServer) startWorkers() {
-	s.logger.Info("Starting background workers", zap.Int("count", WorkerCount))
-
-	for i := 0; i < WorkerCount; i++ {
-		s.wg.Add(1)
-		go func(workerID int) {
-			defer s.wg.Done()
-
-			// 循环直到 jobQueue 关闭
-			for job := range s.jobQueue {
-				s.executeAgentJob(job)
-			}
-		}(i)
-	}
-}
-
-func (s *MasterServer) executeAgentJob(job AgentJob) {
-	url := fmt.Sprintf("http://%s:%d/api/ebpf/entry", job.TargetNodeIP, AgentPort)
-
-	req, err := http.NewRequest(job.Method, url, bytes.NewBuffer(job.Payload))
-	if err != nil {
-		s.logger.Error("Failed to create request", zap.Error(err))
-		return
-	}
-	req.Header.Set("Content-Type", "application/json")
-
-	resp, err := s.httpClient.Do(req)
-	if err != nil {
-		// 生产环境建议：此处应加入重试机制或死信队列 (DLQ)
-		// s.logger.Warn("Failed to send to agent", zap.String("node", job.TargetNodeIP), zap.Error(err))
-		return
-	}
-
-	// 关键：读取并丢弃 Body，确保 TCP 连接能被复用
-	io.Copy(io.Discard, resp.Body)
-	resp.Body.Close()
-}
-
-// =================================================================================
-// 4. Group B: 控制平面 Handlers (高频核心逻辑)
+// 3. Group B: 控制平面 Handlers (高频核心逻辑)
 // =================================================================================
 
 func (s *MasterServer) handleRuleCreate(w http.ResponseWriter, r *http.Request) {
+	start := time.Now()
 	var req EBPFEntryByPodsRequest
 
 	// 使用 Strict Decoding 防止字段拼写错误
@@ -206,11 +386,15 @@ func (s *MasterServer) handleRuleCreate(w http.ResponseWriter, r *http.Request)
 		s.sendError(w, http.StatusBadRequest, "pod1 and pod2 are required")
 		return
 	}
+	if err := req.validate(); err != nil {
+		s.sendError(w, http.StatusBadRequest, err.Error())
+		return
+	}
 
-	// 1. O(1) Redis Lookup
+	// 1. 本地缓存查询 (未命中时回源 Redis)
 	// 移除了 K8s Client，完全依赖 Controller 同步到 Redis 的数据
-	pod1Info, err1 := s.redis.GetPodInfoDirectly(r.Context(), req.Pod1)
-	pod2Info, err2 := s.redis.GetPodInfoDirectly(r.Context(), req.Pod2)
+	pod1Info, err1 := s.lookupPod(r.Context(), req.Pod1)
+	pod2Info, err2 := s.lookupPod(r.Context(), req.Pod2)
 
 	if err1 != nil || err2 != nil || pod1Info == nil || pod2Info == nil {
 		s.sendError(w, http.StatusNotFound, "Pod info not found in cache. Is the Pod running?")
@@ -224,45 +408,33 @@ func (s *MasterServer) handleRuleCreate(w http.ResponseWriter, r *http.Request)
 	}
 
 	// 3. 构造双向规则
-	// 规则 A: 告诉 Node2，来自 Pod1 (MAC1) 的包要限制
-	job1Payload, _ := json.Marshal(AgentRequest{
-		Ifindex:         uint32(pod2Info.VethIfIndex),
-		SrcMac:          pod1Info.MACAddress,
-		ThrottleRateBps: req.ThrottleRateBps,
-		Delay:           req.Delay,
-		LossRate:        req.LossRate,
-		Jitter:          req.Jitter,
-	})
+	rules := req.linkRules(pod1Info, pod2Info)
 
-	// 规则 B: 告诉 Node1，来自 Pod2 (MAC2) 的包要限制
-	job2Payload, _ := json.Marshal(AgentRequest{
-		Ifindex:         uint32(pod1Info.VethIfIndex),
-		SrcMac:          pod2Info.MACAddress,
-		ThrottleRateBps: req.ThrottleRateBps,
-		Delay:           req.Delay,
-		LossRate:        req.LossRate,
-		Jitter:          req.Jitter,
-	})
-
-	// 4. 非阻塞入队 (Fast Fail)
-	if !s.enqueueJob(pod2Info.NodeName, "POST", job1Payload) {
-		s.sendError(w, http.StatusServiceUnavailable, "Job queue overloaded")
+	// 4. 交给节点分发器合并下发 (节点积压时 Fast Fail)；?epoch= 时写入暂存中的影子表
+	route, release, err := s.routeFor(r)
+	if err != nil {
+		s.sendError(w, http.StatusConflict, err.Error())
+		return
+	}
+	done, expected, ok := s.submitPair(w, route, rules, false, wantWait(r))
+	release()
+	if !ok {
 		return
 	}
-	s.enqueueJob(pod1Info.NodeName, "POST", job2Payload) // Best effort for the second one
 
-	s.sendSuccess(w, map[string]string{"status": "queued", "tx_id": fmt.Sprintf("%d", time.Now().UnixNano())})
+	s.sendSubmitted(w, start, done, expected)
 }
 
 func (s *MasterServer) handleRuleDelete(w http.ResponseWriter, r *http.Request) {
+	start := time.Now()
 	var req EBPFEntryDeleteByPodsRequest
 	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
 		s.sendError(w, http.StatusBadRequest, "Invalid JSON body")
 		return
 	}
 
-	pod1Info, err1 := s.redis.GetPodInfoDirectly(r.Context(), req.Pod1)
-	pod2Info, err2 := s.redis.GetPodInfoDirectly(r.Context(), req.Pod2)
+	pod1Info, err1 := s.lookupPod(r.Context(), req.Pod1)
+	pod2Info, err2 := s.lookupPod(r.Context(), req.Pod2)
 
 	// 幂等性：如果缓存里没这 Pod，说明可能已经被删除了，直接返回成功
 	if err1 != nil || err2 != nil || pod1Info == nil || pod2Info == nil {
@@ -270,38 +442,122 @@ func (s *MasterServer) handleRuleDelete(w http.ResponseWriter, r *http.Request)
 		return
 	}
 
-	// 构造删除 Payload (只包含识别 Key)
-	del1Payload, _ := json.Marshal(AgentRequest{
-		Ifindex: uint32(pod2Info.VethIfIndex),
-		SrcMac:  pod1Info.MACAddress,
-	})
-	del2Payload, _ := json.Marshal(AgentRequest{
-		Ifindex: uint32(pod1Info.VethIfIndex),
-		SrcMac:  pod2Info.MACAddress,
-	})
+	// 构造删除规则 (只包含识别 Key)
+	dels := linkKeys(pod1Info, pod2Info, req.Ingress)
 
-	if !s.enqueueJob(pod2Info.NodeName, "DELETE", del1Payload) {
-		s.sendError(w, http.StatusServiceUnavailable, "Job queue overloaded")
+	route, release, err := s.routeFor(r)
+	if err != nil {
+		s.sendError(w, http.StatusConflict, err.Error())
+		return
+	}
+	done, expected, ok := s.submitPair(w, route, dels, true, wantWait(r))
+	release()
+	if !ok {
 		return
 	}
-	s.enqueueJob(pod1Info.NodeName, "DELETE", del2Payload)
 
-	s.sendSuccess(w, map[string]string{"status": "queued"})
+	s.sendSubmitted(w, start, done, expected)
 }
 
-// 辅助函数：安全入队
-func (s *MasterServer) enqueueJob(nodeIP, method string, payload []byte) bool {
-	select {
-	case s.jobQueue <- AgentJob{TargetNodeIP: nodeIP, Method: method, Payload: payload}:
-		return true
-	default:
-		s.logger.Warn("Job queue full, dropping request", zap.String("target", nodeIP))
-		return false
+// 辅助函数：提交双向规则，第一条被拒绝时写好错误响应并返回 false。
+// wait 为 true 时返回接收下发结果的 channel 及预期结果数
+func (s *MasterServer) submitPair(w http.ResponseWriter, route dispatchRoute, rules [2]nodeRule, del bool, wait bool) (<-chan applyResult, int, bool) {
+	var done chan applyResult
+	if wait {
+		done = make(chan applyResult, 2)
+	}
+	node1, rule1 := rules[0].node, rules[0].rule
+	node2, rule2 := rules[1].node, rules[1].rule
+
+	d1, err := route(node1)
+	if err != nil {
+		s.sendError(w, http.StatusConflict, err.Error())
+		return nil, 0, false
+	}
+	d2, err := route(node2)
+	if err != nil {
+		s.sendError(w, http.StatusConflict, err.Error())
+		return nil, 0, false
 	}
+
+	ok, err := s.submitRule(d1, rule1, del, done)
+	if err != nil {
+		s.sendError(w, http.StatusPreconditionFailed, err.Error())
+		return nil, 0, false
+	}
+	if !ok {
+		s.sendError(w, http.StatusServiceUnavailable, "Node dispatcher overloaded")
+		return nil, 0, false
+	}
+	expected := 1
+	// Best effort for the second one
+	if ok, err := s.submitRule(d2, rule2, del, done); err != nil {
+		s.logger.Warn("Failed to submit reverse rule", zap.String("target", node2), zap.Error(err))
+	} else if ok {
+		expected++
+	}
+	return done, expected, true
+}
+
+// wantWait 判断调用方是否要求等待 agent 确认 (?wait=true)
+func wantWait(r *http.Request) bool {
+	wait, _ := strconv.ParseBool(r.URL.Query().Get("wait"))
+	return wait
+}
+
+// AppliedRule 为单条规则在节点上的确认信息
+type AppliedRule struct {
+	Node    string `json:"node"`
+	Seq     uint64 `json:"seq"`
+	ApplyUs uint64 `json:"applyUs"`
+	Error   string `json:"error,omitempty"`
+}
+
+// sendSubmitted 未要求等待时立即返回 queued；否则等到全部规则被 agent 确认，
+// 返回从收到请求到最后一条确认的真实下发时延
+func (s *MasterServer) sendSubmitted(w http.ResponseWriter, start time.Time, done <-chan applyResult, expected int) {
+	if done == nil {
+		s.sendSuccess(w, map[string]string{"status": "queued"})
+		return
+	}
+
+	timer := time.NewTimer(ApplyWaitTimeout)
+	defer timer.Stop()
+
+	rules := make([]AppliedRule, 0, expected)
+	failed := false
+	for len(rules) < expected {
+		select {
+		case res := <-done:
+			rule := AppliedRule{Node: res.Node, Seq: res.Seq, ApplyUs: res.ApplyNs / 1000}
+			if res.Err != nil {
+				rule.Error = res.Err.Error()
+				failed = true
+			}
+			rules = append(rules, rule)
+		case <-timer.C:
+			s.sendError(w, http.StatusGatewayTimeout, fmt.Sprintf("timed out waiting for agent ack (%d/%d applied)", len(rules), expected))
+			return
+		}
+	}
+
+	result := map[string]interface{}{
+		"status":    "applied",
+		"latencyUs": time.Since(start).Microseconds(),
+		"rules":     rules,
+	}
+	if failed {
+		result["status"] = "rejected"
+		w.Header().Set("Content-Type", "application/json")
+		w.WriteHeader(http.StatusUnprocessableEntity)
+		json.NewEncoder(w).Encode(Response{Success: false, Data: result, Error: "agent rejected rule"})
+		return
+	}
+	s.sendSuccess(w, result)
 }
 
 // =================================================================================
-// 5. Group C: 查询平面 Handlers (只读操作)
+// 4. Group C: 查询平面 Handlers (只读操作)
 // =================================================================================
 
 func (s *MasterServer) listPodsFromCache(w http.ResponseWriter, r *http.Request) {
@@ -309,8 +565,12 @@ func (s *MasterServer) listPodsFromCache(w http.ResponseWriter, r *http.Request)
 	ns := vars["namespace"]
 	name := vars["name"]
 
-	// 直接从 Redis 集合中读取，这要求 Controller 维护好 "emunet:pods:{ns}:{name}" 这个 Set
-	pods, err := s.redis.ListPodStatuses(r.Context(), ns, name)
+	// 直接从 Controller 维护的 Hash 中一次读取；view=routes 只返回路由字段 (节点、MAC、ifindex、IP)
+	list := s.redis.ListPodStatuses
+	if r.URL.Query().Get("view") == "routes" {
+		list = s.redis.ListPodRoutes
+	}
+	pods, err := list(r.Context(), ns, name)
 	if err != nil {
 		s.logger.Error("Redis list error", zap.Error(err))
 		s.sendError(w, http.StatusInternalServerError, "Failed to retrieve pod list")
@@ -326,7 +586,11 @@ func (s *MasterServer) healthCheck(w http.ResponseWriter, r *http.Request) {
 		s.sendError(w, http.StatusServiceUnavailable, "Redis disconnected")
 		return
 	}
-	s.sendSuccess(w, map[string]string{"status": "healthy", "worker_count": fmt.Sprintf("%d", WorkerCount)})
+	s.sendSuccess(w, map[string]string{
+		"status":           "healthy",
+		"node_dispatchers": fmt.Sprintf("%d", s.dispatcherCount()),
+		"cached_pods":      fmt.Sprintf("%d", s.podCache.Len()),
+	})
 }
 
 func (s *MasterServer) notImplemented(w http.ResponseWriter, r *http.Request) {
@@ -334,7 +598,7 @@ func (s *MasterServer) notImplemented(w http.ResponseWriter, r *http.Request) {
 }
 
 // =================================================================================
-// 6. HTTP Helper Functions
+// 5. HTTP Helper Functions
 // =================================================================================
 
 func (s *MasterServer) sendSuccess(w http.ResponseWriter, data interface{}) {
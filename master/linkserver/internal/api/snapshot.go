@@ -0,0 +1,107 @@
+package api
+
+import (
+	"context"
+	"time"
+
+	"go.uber.org/zap"
+
+	"emunet/linkserver/internal/redis"
+)
+
+// =================================================================================
+// 节点规则快照 (agent 重启后据此对账，只补写差异)
+// =================================================================================
+
+const snapshotTimeout = 5 * time.Second
+
+// stagedRules 累积暂存分发器已写入影子表的规则 (字段 -> 记录，nil 表示删除)，
+// 只有提交成功的节点才把它写入快照
+type stagedRules map[string][]byte
+
+// eachRecord 遍历一个已编码 agent 请求体中的记录，field 为记录开头的规则 key
+func eachRecord(payload []byte, del bool, fn func(field string, rec []byte)) {
+	recSize := batchUpsertRecSize
+	if del {
+		recSize = batchDeleteRecSize
+	}
+	for off := batchHeaderSize; off+recSize <= len(payload); off += recSize {
+		rec := payload[off : off+recSize]
+		fn(string(rec[:redis.NodeRuleKeySize]), rec)
+	}
+}
+
+// snapshotDelta 把一批 agent 已确认的请求体转换为快照增量
+func snapshotDelta(payload []byte, del bool) *redis.NodeRulesDelta {
+	delta := &redis.NodeRulesDelta{}
+	if del {
+		eachRecord(payload, true, func(field string, _ []byte) {
+			delta.Deletes = append(delta.Deletes, field)
+		})
+		return delta
+	}
+	delta.Upserts = make(map[string][]byte)
+	eachRecord(payload, false, func(field string, rec []byte) {
+		delta.Upserts[field] = rec
+	})
+	return delta
+}
+
+func (c stagedRules) add(payload []byte, del bool) {
+	eachRecord(payload, del, func(field string, rec []byte) {
+		if del {
+			rec = nil
+		}
+		c[field] = rec
+	})
+}
+
+// delta 返回提交后快照需要的变更；replace 时影子表从空表开始，快照整体替换
+func (c stagedRules) delta(replace bool) *redis.NodeRulesDelta {
+	delta := &redis.NodeRulesDelta{Upserts: make(map[string][]byte), Replace: replace}
+	for field, rec := range c {
+		switch {
+		case rec != nil:
+			delta.Upserts[field] = rec
+		case !replace:
+			delta.Deletes = append(delta.Deletes, field)
+		}
+	}
+	return delta
+}
+
+// recordApplied 记录 agent 已确认的一批规则：实时分发器直接写入快照，暂存分发器先累积到提交。
+// 由 run goroutine 在通知等待方之后调用，快照的写入顺序与 agent 的应用顺序一致
+func (d *nodeDispatcher) recordApplied(payload []byte, del bool) {
+	if d.epochToken != 0 {
+		d.mu.Lock()
+		d.staged.add(payload, del)
+		d.mu.Unlock()
+		return
+	}
+	d.server.saveSnapshot(d.nodeIP, snapshotDelta(payload, del))
+}
+
+// commitStaged 把提交成功节点的暂存规则写入快照
+func (s *MasterServer) commitStaged(staged map[string]*nodeDispatcher, results []EpochNodeResult, replace bool) {
+	for _, res := range results {
+		d, ok := staged[res.Node]
+		if !ok || res.Error != "" {
+			continue
+		}
+		d.mu.Lock()
+		delta := d.staged.delta(replace)
+		d.mu.Unlock()
+		s.saveSnapshot(res.Node, delta)
+	}
+}
+
+// saveSnapshot 写入失败只记录日志：规则已在节点上生效，快照落后只影响该节点下次重启时的对账
+func (s *MasterServer) saveSnapshot(node string, delta *redis.NodeRulesDelta) {
+	ctx, cancel := context.WithTimeout(context.Background(), snapshotTimeout)
+	defer cancel()
+	if _, err := s.redis.SaveNodeRules(ctx, node, delta); err != nil {
+		s.logger.Error("Failed to save node rule snapshot", zap.String("node", node),
+			zap.Int("upserts", len(delta.Upserts)), zap.Int("deletes", len(delta.Deletes)), zap.Error(err))
+	}
+}
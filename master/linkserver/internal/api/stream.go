@@ -0,0 +1,114 @@
+package api
+
+import (
+	"bufio"
+	"encoding/binary"
+	"fmt"
+	"io"
+	"net"
+	"time"
+)
+
+// =================================================================================
+// 控制流长连接客户端 (与 emunet-node-agent/pkg/stream_codec.go 保持一致)
+// =================================================================================
+//
+//	frame: length u32 | type u8 | seq u64 | payload [length-9]
+//	ACK payload: status u8 | applied u32 | apply_ns u64 | message [...]
+
+const (
+	AgentStreamPort = 12346 // Agent 控制流监听端口
+
+	frameUpsert byte = 1
+	frameDelete byte = 2
+	frameAck    byte = 3
+
+	ackOK      byte = 0
+	ackInvalid byte = 1
+
+	frameHeaderSize   = 13
+	ackFixedSize      = 13
+	streamDialTimeout = 2 * time.Second
+	streamAckTimeout  = 5 * time.Second
+	streamRedialDelay = 2 * time.Second // 建连失败后在该时间内直接走 HTTP 批量接口
+)
+
+// agentAck 为 agent 对一帧规则的应用结果
+type agentAck struct {
+	Seq     uint64
+	Status  byte
+	Applied uint32
+	ApplyNs uint64
+	Message string
+}
+
+// agentStream 为到单个节点的长连接，只由该节点分发器的 flush goroutine 使用
+type agentStream struct {
+	conn net.Conn
+	r    *bufio.Reader
+	w    *bufio.Writer
+	hdr  [frameHeaderSize]byte
+}
+
+func dialAgentStream(nodeIP string) (*agentStream, error) {
+	conn, err := net.DialTimeout("tcp", fmt.Sprintf("%s:%d", nodeIP, AgentStreamPort), streamDialTimeout)
+	if err != nil {
+		return nil, err
+	}
+	if tcp, ok := conn.(*net.TCPConn); ok {
+		tcp.SetNoDelay(true)
+		tcp.SetKeepAlive(true)
+		tcp.SetKeepAlivePeriod(15 * time.Second)
+	}
+	return &agentStream{
+		conn: conn,
+		r:    bufio.NewReaderSize(conn, 4*1024),
+		w:    bufio.NewWriterSize(conn, 64*1024),
+	}, nil
+}
+
+// roundTrip 发送一帧并等待对应 seq 的 ACK；任何 I/O 错误后连接不可再用
+func (c *agentStream) roundTrip(frameType byte, seq uint64, payload []byte) (*agentAck, error) {
+	c.conn.SetDeadline(time.Now().Add(streamAckTimeout))
+
+	binary.LittleEndian.PutUint32(c.hdr[0:], uint32(len(payload)+9))
+	c.hdr[4] = frameType
+	binary.LittleEndian.PutUint64(c.hdr[5:], seq)
+	if _, err := c.w.Write(c.hdr[:]); err != nil {
+		return nil, err
+	}
+	if _, err := c.w.Write(payload); err != nil {
+		return nil, err
+	}
+	if err := c.w.Flush(); err != nil {
+		return nil, err
+	}
+
+	var hdr [frameHeaderSize]byte
+	if _, err := io.ReadFull(c.r, hdr[:]); err != nil {
+		return nil, err
+	}
+	length := binary.LittleEndian.Uint32(hdr[0:])
+	if hdr[4] != frameAck || length < 9+ackFixedSize || length > 9+ackFixedSize+4096 {
+		return nil, fmt.Errorf("unexpected frame type %d length %d", hdr[4], length)
+	}
+	body := make([]byte, length-9)
+	if _, err := io.ReadFull(c.r, body); err != nil {
+		return nil, err
+	}
+	ack := &agentAck{
+		Seq:     binary.LittleEndian.Uint64(hdr[5:]),
+		Status:  body[0],
+		Applied: binary.LittleEndian.Uint32(body[1:]),
+		ApplyNs: binary.LittleEndian.Uint64(body[5:]),
+		Message: string(body[ackFixedSize:]),
+	}
+	if ack.Seq != seq {
+		return nil, fmt.Errorf("ack seq %d does not match frame seq %d", ack.Seq, seq)
+	}
+	return ack, nil
+}
+
+func (c *agentStream) close() {
+	c.conn.Close()
+}
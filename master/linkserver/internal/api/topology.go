@@ -0,0 +1,476 @@
+package api
+
+import (
+	"bufio"
+	"context"
+	"emunet/linkserver/internal/redis"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"math/rand"
+	"net/http"
+	"sort"
+	"strings"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+	TopologyWaitTimeout = 60 * time.Second // ?wait=true 时等待整份拓扑下发完毕的最长时间
+	ndjsonContentType   = "application/x-ndjson"
+	topologyChunk       = FlushSize // 单节点攒够该条数后一次性交给分发器
+	topologyMaxMissing  = 16        // 响应中最多列出的缺失 Pod 数
+)
+
+// errInvalidTopology 表示请求内容非法 (400)，errTopologyRoute 表示节点不在 ?epoch= 指定的 epoch 中 (409)，
+// 其余错误为下发失败
+var (
+	errInvalidTopology = errors.New("invalid topology")
+	errTopologyRoute   = errors.New("topology route")
+)
+
+// TopologySpec 为由 linkserver 展开的拓扑生成器。Pods 为空时取 Namespace/Name 对应 EmuNet
+// 的全部 Pod (按名字排序)；fat-tree 按 core、agg、edge、host 的顺序依次占用 Pod
+type TopologySpec struct {
+	Kind      string   `json:"kind"` // "mesh"、"ring" 或 "fattree"
+	Namespace string   `json:"namespace,omitempty"`
+	Name      string   `json:"name,omitempty"`
+	Pods      []string `json:"pods,omitempty"`
+	// K 为 fat-tree 的交换机端口数 (偶数)，需要 5k²/4 + k³/4 个 Pod
+	K       int   `json:"k,omitempty"`
+	Seed    int64 `json:"seed,omitempty"`
+	Ingress bool  `json:"ingress,omitempty"`
+	// 内嵌参数为每条链路的基础参数，Dists 中列出的参数改为逐链路按分布取值
+	LinkParams
+	Dists map[string]ParamDist `json:"dists,omitempty"`
+}
+
+// ParamDist 为一个链路参数的分布：uniform (默认) 在 [Min, Max] 上均匀取值；
+// normal 按 Mean/StdDev 取值后截断到不小于 Min，Max 非 0 时不大于 Max
+type ParamDist struct {
+	Type   string  `json:"type,omitempty"`
+	Min    float64 `json:"min,omitempty"`
+	Max    float64 `json:"max,omitempty"`
+	Mean   float64 `json:"mean,omitempty"`
+	StdDev float64 `json:"stdDev,omitempty"`
+}
+
+// TopologyResult 为一次拓扑导入的统计
+type TopologyResult struct {
+	Status      string   `json:"status"`
+	Links       int      `json:"links"`
+	Rules       int      `json:"rules"`
+	Nodes       int      `json:"nodes"`
+	Skipped     int      `json:"skipped,omitempty"` // Pod 未找到或信息不完整而跳过的链路数
+	Applied     int      `json:"applied,omitempty"` // ?wait=true 时 agent 确认的规则数，同一 key 只计最终一次
+	MissingPods []string `json:"missingPods,omitempty"`
+	LatencyUs   int64    `json:"latencyUs"`
+}
+
+// distParam 为可按分布取值的参数，值按 LinkParams 中的单位，[min, max] 为 agent 接受的范围
+type distParam struct {
+	set      func(p *LinkParams, v float64)
+	min, max float64
+}
+
+var distParams = map[string]distParam{
+	"throttleRateBps": {func(p *LinkParams, v float64) { p.ThrottleRateBps = uint64(v) }, MinThrottleRateBps, math.MaxInt64},
+	"delay":           {func(p *LinkParams, v float64) { p.Delay = uint32(v) }, 0, math.MaxUint32},
+	"lossRate":        {func(p *LinkParams, v float64) { p.LossRate = uint32(v) }, 0, LossScope},
+	"jitter":          {func(p *LinkParams, v float64) { p.Jitter = uint32(v) }, 0, math.MaxUint32},
+	"dupRate":         {func(p *LinkParams, v float64) { p.DupRate = uint32(v) }, 0, LossScope},
+	"corruptRate":     {func(p *LinkParams, v float64) { p.CorruptRate = uint32(v) }, 0, LossScope},
+	"reorderRate":     {func(p *LinkParams, v float64) { p.ReorderRate = uint32(v) }, 0, LossScope},
+}
+
+// validate 要求分布的取值区间落在参数范围内；normal 未设 Max 时取值在 draw 中截断到参数上限
+func (d *ParamDist) validate(param string) error {
+	dp, ok := distParams[param]
+	if !ok {
+		return fmt.Errorf("%w: unsupported dist parameter %q", errInvalidTopology, param)
+	}
+	if d.Min < 0 || d.Max < 0 || d.StdDev < 0 {
+		return fmt.Errorf("%w: dist %s: negative bound", errInvalidTopology, param)
+	}
+	if d.Min < dp.min {
+		return fmt.Errorf("%w: dist %s: min must be at least %g", errInvalidTopology, param, dp.min)
+	}
+	if d.Min > dp.max || d.Max > dp.max {
+		return fmt.Errorf("%w: dist %s: bounds must not exceed %g", errInvalidTopology, param, dp.max)
+	}
+	switch d.Type {
+	case "", "uniform":
+		if d.Max < d.Min {
+			return fmt.Errorf("%w: dist %s: max < min", errInvalidTopology, param)
+		}
+	case "normal":
+		if d.Max != 0 && d.Max < d.Min {
+			return fmt.Errorf("%w: dist %s: max < min", errInvalidTopology, param)
+		}
+	default:
+		return fmt.Errorf("%w: dist %s: unknown type %q", errInvalidTopology, param, d.Type)
+	}
+	return nil
+}
+
+func (d *ParamDist) draw(r *rand.Rand, limit float64) float64 {
+	if d.Type == "normal" {
+		v := d.Mean + r.NormFloat64()*d.StdDev
+		if v < d.Min {
+			v = d.Min
+		}
+		if d.Max != 0 && v > d.Max {
+			v = d.Max
+		}
+		if v > limit {
+			v = limit
+		}
+		return v
+	}
+	return d.Min + r.Float64()*(d.Max-d.Min)
+}
+
+// links 按拓扑类型枚举 n 个 Pod 之间的链路 (下标)，emit 返回错误时停止
+func (spec *TopologySpec) links(n int, emit func(i, j int) error) error {
+	switch spec.Kind {
+	case "mesh":
+		for i := 0; i < n; i++ {
+			for j := i + 1; j < n; j++ {
+				if err := emit(i, j); err != nil {
+					return err
+				}
+			}
+		}
+	case "ring":
+		if n == 2 {
+			return emit(0, 1)
+		}
+		for i := 0; i < n; i++ {
+			if err := emit(i, (i+1)%n); err != nil {
+				return err
+			}
+		}
+	case "fattree":
+		h := spec.K / 2
+		aggBase := h * h
+		edgeBase := aggBase + spec.K*h
+		hostBase := edgeBase + spec.K*h
+		for p := 0; p < spec.K; p++ {
+			for j := 0; j < h; j++ {
+				agg := aggBase + p*h + j
+				// agg j 上连第 j 组 core
+				for c := 0; c < h; c++ {
+					if err := emit(agg, j*h+c); err != nil {
+						return err
+					}
+				}
+			}
+			for e := 0; e < h; e++ {
+				edge := edgeBase + p*h + e
+				for j := 0; j < h; j++ {
+					if err := emit(edge, aggBase+p*h+j); err != nil {
+						return err
+					}
+				}
+				for host := 0; host < h; host++ {
+					if err := emit(edge, hostBase+(p*h+e)*h+host); err != nil {
+						return err
+					}
+				}
+			}
+		}
+	}
+	return nil
+}
+
+// podsNeeded 返回拓扑需要的最少 Pod 数
+func (spec *TopologySpec) podsNeeded() (int, error) {
+	switch spec.Kind {
+	case "mesh", "ring":
+		return 2, nil
+	case "fattree":
+		if spec.K < 2 || spec.K%2 != 0 {
+			return 0, fmt.Errorf("%w: fattree requires an even k >= 2", errInvalidTopology)
+		}
+		return 5*spec.K*spec.K/4 + spec.K*spec.K*spec.K/4, nil
+	default:
+		return 0, fmt.Errorf("%w: unknown kind %q (mesh, ring, fattree)", errInvalidTopology, spec.Kind)
+	}
+}
+
+// =================================================================================
+// 导入过程：每个 Pod 只解析一次，规则按节点攒批后整批交给分发器
+// =================================================================================
+
+type topologyBatch struct {
+	d    *nodeDispatcher
+	keys []linkKey
+	ops  []*pendingOp
+}
+
+type topologyLoader struct {
+	s     *MasterServer
+	ctx   context.Context
+	route dispatchRoute
+	del   bool
+
+	pods    map[string]*redis.PodStatus // 本次请求已解析的 Pod，未找到的记为 nil
+	batches map[string]*topologyBatch
+	tally   *applyTally // 统计全部规则的下发结果，?wait=true 时据此报告 agent 拒绝的规则
+	result  TopologyResult
+}
+
+func (s *MasterServer) newTopologyLoader(ctx context.Context, route dispatchRoute, del bool) *topologyLoader {
+	return &topologyLoader{
+		s:       s,
+		ctx:     ctx,
+		route:   route,
+		del:     del,
+		pods:    make(map[string]*redis.PodStatus),
+		batches: make(map[string]*topologyBatch),
+		tally:   &applyTally{},
+	}
+}
+
+// resolve 返回可用于下发的 Pod，节点或 MAC 缺失时视为未找到
+func (l *topologyLoader) resolve(name string) *redis.PodStatus {
+	pod, ok := l.pods[name]
+	if ok {
+		return pod
+	}
+	pod, err := l.s.lookupPod(l.ctx, name)
+	if err != nil || pod == nil || pod.NodeName == "" || pod.MACAddress == "" {
+		pod = nil
+		if len(l.result.MissingPods) < topologyMaxMissing {
+			l.result.MissingPods = append(l.result.MissingPods, name)
+		}
+	}
+	l.pods[name] = pod
+	return pod
+}
+
+// add 展开一条链路并放入对应节点的批次，Pod 不可用时跳过；参数非法时整个请求失败
+func (l *topologyLoader) add(req *EBPFEntryByPodsRequest, pod1, pod2 *redis.PodStatus) error {
+	if !l.del {
+		if err := req.validate(); err != nil {
+			return fmt.Errorf("%w: link %s-%s: %v", errInvalidTopology, req.Pod1, req.Pod2, err)
+		}
+	}
+	if pod1 == nil || pod2 == nil {
+		l.result.Skipped++
+		return nil
+	}
+	var rules [2]nodeRule
+	if l.del {
+		rules = linkKeys(pod1, pod2, req.Ingress)
+	} else {
+		rules = req.linkRules(pod1, pod2)
+	}
+	for _, nr := range rules {
+		key, err := newLinkKey(nr.rule.Ifindex, nr.rule.SrcMac, nr.rule.Ingress)
+		if err != nil {
+			return fmt.Errorf("%w: link %s-%s: %v", errInvalidTopology, req.Pod1, req.Pod2, err)
+		}
+		b, ok := l.batches[nr.node]
+		if !ok {
+			d, err := l.route(nr.node)
+			if err != nil {
+				return fmt.Errorf("%w: %v", errTopologyRoute, err)
+			}
+			b = &topologyBatch{d: d}
+			l.batches[nr.node] = b
+		}
+		b.keys = append(b.keys, key)
+		b.ops = append(b.ops, &pendingOp{Delete: l.del, Req: nr.rule, tallies: []*applyTally{l.tally}})
+		if len(b.keys) >= topologyChunk {
+			if err := l.push(b); err != nil {
+				return err
+			}
+		}
+	}
+	l.result.Links++
+	return nil
+}
+
+// push 把批次交给分发器；节点积压时等待其 flush 后继续，而不是像单条接口那样拒绝
+func (l *topologyLoader) push(b *topologyBatch) error {
+	for len(b.keys) > 0 {
+		n := b.d.submitBatch(b.keys, b.ops)
+		l.result.Rules += n
+		b.keys, b.ops = b.keys[n:], b.ops[n:]
+		if len(b.keys) == 0 {
+			break
+		}
+		b.d.wake()
+		select {
+		case <-l.ctx.Done():
+			return fmt.Errorf("node %s backlog full: %v", b.d.nodeIP, l.ctx.Err())
+		case <-time.After(FlushInterval):
+		}
+	}
+	b.keys, b.ops = nil, nil
+	return nil
+}
+
+func (l *topologyLoader) flush() error {
+	for _, b := range l.batches {
+		if err := l.push(b); err != nil {
+			return err
+		}
+	}
+	l.result.Nodes = len(l.batches)
+	return nil
+}
+
+// loadLines 逐行读取 EBPFEntryByPodsRequest (删除时只用 pod1/pod2/ingress)，不在内存中保留整份拓扑
+func (l *topologyLoader) loadLines(body io.Reader) error {
+	dec := json.NewDecoder(bufio.NewReaderSize(body, 1<<20))
+	dec.DisallowUnknownFields()
+	for line := 1; ; line++ {
+		var req EBPFEntryByPodsRequest
+		if err := dec.Decode(&req); err != nil {
+			if errors.Is(err, io.EOF) {
+				return nil
+			}
+			return fmt.Errorf("%w: link %d: %v", errInvalidTopology, line, err)
+		}
+		if req.Pod1 == "" || req.Pod2 == "" {
+			return fmt.Errorf("%w: link %d: pod1 and pod2 are required", errInvalidTopology, line)
+		}
+		if err := l.add(&req, l.resolve(req.Pod1), l.resolve(req.Pod2)); err != nil {
+			return err
+		}
+	}
+}
+
+// loadSpec 解析生成器规格，一次取齐 Pod 后逐条生成链路
+func (l *topologyLoader) loadSpec(body io.Reader) error {
+	var spec TopologySpec
+	dec := json.NewDecoder(body)
+	dec.DisallowUnknownFields()
+	if err := dec.Decode(&spec); err != nil {
+		return fmt.Errorf("%w: %v", errInvalidTopology, err)
+	}
+	needed, err := spec.podsNeeded()
+	if err != nil {
+		return err
+	}
+	for param, d := range spec.Dists {
+		if err := d.validate(param); err != nil {
+			return err
+		}
+	}
+
+	names := spec.Pods
+	if len(names) == 0 {
+		if spec.Namespace == "" || spec.Name == "" {
+			return fmt.Errorf("%w: pods or namespace/name required", errInvalidTopology)
+		}
+		routes, err := l.s.redis.ListPodRoutes(l.ctx, spec.Namespace, spec.Name)
+		if err != nil {
+			return fmt.Errorf("list pods of %s/%s: %v", spec.Namespace, spec.Name, err)
+		}
+		for i := range routes {
+			l.s.podCache.Set(&routes[i])
+			names = append(names, routes[i].PodName)
+		}
+		sort.Strings(names)
+	}
+	if len(names) < needed {
+		return fmt.Errorf("%w: %s needs %d pods, got %d", errInvalidTopology, spec.Kind, needed, len(names))
+	}
+	if spec.Kind == "fattree" {
+		names = names[:needed]
+	}
+	pods := make([]*redis.PodStatus, len(names))
+	for i, name := range names {
+		pods[i] = l.resolve(name)
+	}
+
+	// 参数名排序后再取值，保证同一 Seed 生成相同的拓扑
+	params := make([]string, 0, len(spec.Dists))
+	for param := range spec.Dists {
+		params = append(params, param)
+	}
+	sort.Strings(params)
+	rng := rand.New(rand.NewSource(spec.Seed))
+
+	return spec.links(len(pods), func(i, j int) error {
+		req := EBPFEntryByPodsRequest{Pod1: names[i], Pod2: names[j], LinkParams: spec.LinkParams, Ingress: spec.Ingress}
+		for _, param := range params {
+			d, dp := spec.Dists[param], distParams[param]
+			dp.set(&req.LinkParams, d.draw(rng, dp.max))
+		}
+		return l.add(&req, pods[i], pods[j])
+	})
+}
+
+// =================================================================================
+// 拓扑导入 Handler
+// =================================================================================
+
+// handleTopology 一次导入 (POST) 或删除 (DELETE) 整份拓扑。Content-Type 为 application/x-ndjson 时
+// 请求体为逐行的链路，否则为 TopologySpec。中途出错时已提交的规则仍会下发，按 last-writer-wins
+// 重新提交整份拓扑是安全的；?wait=true 时等到涉及的节点全部下发完毕，有规则被 agent 拒绝时返回 502
+func (s *MasterServer) handleTopology(w http.ResponseWriter, r *http.Request) {
+	start := time.Now()
+	route, release, err := s.routeFor(r)
+	if err != nil {
+		s.sendError(w, http.StatusConflict, err.Error())
+		return
+	}
+
+	l := s.newTopologyLoader(r.Context(), route, r.Method == http.MethodDelete)
+	if strings.HasPrefix(r.Header.Get("Content-Type"), ndjsonContentType) {
+		err = l.loadLines(r.Body)
+	} else {
+		err = l.loadSpec(r.Body)
+	}
+	if err == nil {
+		err = l.flush()
+	}
+	release()
+
+	if err != nil {
+		s.logger.Warn("Topology import failed", zap.Int("links", l.result.Links), zap.Int("rules", l.result.Rules), zap.Error(err))
+		switch {
+		case errors.Is(err, errInvalidTopology):
+			s.sendError(w, http.StatusBadRequest, err.Error())
+		case errors.Is(err, errTopologyRoute):
+			s.sendError(w, http.StatusConflict, err.Error())
+		case r.Context().Err() != nil:
+			s.sendError(w, http.StatusServiceUnavailable, err.Error())
+		default:
+			s.sendError(w, http.StatusInternalServerError, err.Error())
+		}
+		return
+	}
+
+	l.result.Status = "queued"
+	if wantWait(r) {
+		ctx, cancel := context.WithTimeout(r.Context(), TopologyWaitTimeout)
+		defer cancel()
+		for _, b := range l.batches {
+			if err := b.d.drain(ctx); err != nil {
+				s.sendError(w, http.StatusGatewayTimeout, err.Error())
+				return
+			}
+		}
+		applied, failed, firstErr := l.tally.get()
+		l.result.Applied = applied
+		if failed > 0 {
+			s.logger.Warn("Topology rules rejected by agents", zap.Int("failed", failed), zap.Error(firstErr))
+			s.sendError(w, http.StatusBadGateway, fmt.Sprintf("%d of %d rules failed: %v", failed, applied+failed, firstErr))
+			return
+		}
+		l.result.Status = "applied"
+	}
+	l.result.LatencyUs = time.Since(start).Microseconds()
+	s.logger.Info("Topology imported",
+		zap.Int("links", l.result.Links), zap.Int("rules", l.result.Rules),
+		zap.Int("nodes", l.result.Nodes), zap.Int("skipped", l.result.Skipped))
+	s.sendSuccess(w, l.result)
+}
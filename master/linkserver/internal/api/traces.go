@@ -0,0 +1,134 @@
+package api
+
+import (
+	"context"
+	"emunet/linkserver/internal/redis"
+	"encoding/json"
+	"fmt"
+	"net/http"
+	"sync"
+	"time"
+
+	"go.uber.org/zap"
+)
+
+const (
+	MaxTraceID       = 63   // 与 Agent 侧 MAX_TRACES - 1 一致，0 号保留
+	MaxTracePoints   = 4096 // 与 Agent 侧 MAX_TRACE_POINTS 一致
+	traceAgentPath   = "/api/ebpf/traces"
+	DefaultTraceLead = 200 * time.Millisecond
+)
+
+// =================================================================================
+// 轨迹回放 Handlers
+// =================================================================================
+
+// handleTracesUpsert 保存轨迹到 Redis 并并行下发到所有已知节点。
+// 未指定 startUnixNano 的轨迹在此统一打上 "当前时间 + DefaultTraceLead" 的起点，
+// 各节点 (及之后加入的节点) 按同一墙上时间换算起点，回放保持同相 (要求节点时钟已同步)
+func (s *MasterServer) handleTracesUpsert(w http.ResponseWriter, r *http.Request) {
+	var traces []redis.LinkTrace
+	if err := json.NewDecoder(r.Body).Decode(&traces); err != nil {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON: "+err.Error())
+		return
+	}
+	start := time.Now().Add(DefaultTraceLead).UnixNano()
+	for i := range traces {
+		t := &traces[i]
+		if t.ID == 0 || t.ID > MaxTraceID {
+			s.sendError(w, http.StatusBadRequest, fmt.Sprintf("trace id %d out of range [1, %d]", t.ID, MaxTraceID))
+			return
+		}
+		if t.SlotUs == 0 || (len(t.Points) == 0 && len(t.Mahimahi) == 0) || len(t.Points) > MaxTracePoints {
+			s.sendError(w, http.StatusBadRequest, fmt.Sprintf("trace %d: slotUs and 1..%d points (or mahimahi) required", t.ID, MaxTracePoints))
+			return
+		}
+		if t.StartUnixNano == 0 {
+			t.StartUnixNano = start
+		}
+	}
+
+	if err := s.redis.SaveTraces(r.Context(), traces); err != nil {
+		s.logger.Error("Failed to save traces", zap.Error(err))
+		s.sendError(w, http.StatusInternalServerError, "Failed to save traces")
+		return
+	}
+
+	payload, _ := json.Marshal(traces)
+	s.sendTraceFanout(w, r.Context(), "POST", payload)
+}
+
+// handleTracesDelete 删除轨迹；绑定它的链路回到自身参数
+func (s *MasterServer) handleTracesDelete(w http.ResponseWriter, r *http.Request) {
+	var ids []uint32
+	if err := json.NewDecoder(r.Body).Decode(&ids); err != nil {
+		s.sendError(w, http.StatusBadRequest, "Invalid JSON: "+err.Error())
+		return
+	}
+
+	if err := s.redis.DeleteTraces(r.Context(), ids); err != nil {
+		s.logger.Error("Failed to delete traces", zap.Error(err))
+		s.sendError(w, http.StatusInternalServerError, "Failed to delete traces")
+		return
+	}
+
+	payload, _ := json.Marshal(ids)
+	s.sendTraceFanout(w, r.Context(), "DELETE", payload)
+}
+
+func (s *MasterServer) handleTracesList(w http.ResponseWriter, r *http.Request) {
+	traces, err := s.redis.ListTraces(r.Context())
+	if err != nil {
+		s.logger.Error("Redis list error", zap.Error(err))
+		s.sendError(w, http.StatusInternalServerError, "Failed to retrieve traces")
+		return
+	}
+	s.sendSuccess(w, traces)
+}
+
+func (s *MasterServer) sendTraceFanout(w http.ResponseWriter, ctx context.Context, method string, payload []byte) {
+	nodes := s.knownNodes()
+	results := make([]ProfileNodeResult, len(nodes))
+	var wg sync.WaitGroup
+	for i, node := range nodes {
+		wg.Add(1)
+		go func(i int, node string) {
+			defer wg.Done()
+			results[i].Node = node
+			if _, err := s.agentJSON(ctx, node, method, traceAgentPath, payload); err != nil {
+				results[i].Error = err.Error()
+			}
+		}(i, node)
+	}
+	wg.Wait()
+
+	failed := 0
+	for _, res := range results {
+		if res.Error != "" {
+			failed++
+		}
+	}
+	if failed > 0 {
+		w.Header().Set("Content-Type", "application/json")
+		w.WriteHeader(http.StatusBadGateway)
+		json.NewEncoder(w).Encode(Response{Success: false, Data: results, Error: fmt.Sprintf("%d/%d nodes failed", failed, len(results))})
+		return
+	}
+	s.sendSuccess(w, map[string]interface{}{"status": "applied", "nodes": results})
+}
+
+// syncTracesTo 把 Redis 中的全部轨迹推送到一个节点 (best effort)，起点沿用保存时的墙上时间
+func (s *MasterServer) syncTracesTo(ctx context.Context, nodeIP string) {
+	traces, err := s.redis.ListTraces(ctx)
+	if err != nil {
+		s.logger.Warn("Failed to load traces for node sync", zap.String("node", nodeIP), zap.Error(err))
+		return
+	}
+	if len(traces) == 0 {
+		return
+	}
+	payload, _ := json.Marshal(traces)
+	if _, err := s.agentJSON(ctx, nodeIP, "POST", traceAgentPath, payload); err != nil {
+		s.logger.Warn("Failed to sync traces to node", zap.String("node", nodeIP), zap.Error(err))
+	}
+}
@@ -2,8 +2,11 @@ package redis
 
 import (
 	"context"
+	"encoding/binary"
 	"encoding/json"
+	"errors"
 	"fmt"
+	"net"
 	"time"
 
 	"github.com/redis/go-redis/v9"
@@ -12,8 +15,33 @@ import (
 const (
 	// Key TTL (Time To Live) to prevent stale data leaking
 	DefaultTTL = 24 * time.Hour
+
+	// PodEventsChannel carries pod route changes so readers can keep a local cache
+	PodEventsChannel = "emunet:pod_events"
+
+	// PodRoutesKey is the global hash podName -> binary PodRoute used for
+	// O(1) lookups by pod name. Fields are removed explicitly when a pod or
+	// EmuNet goes away, the hash itself has no TTL.
+	PodRoutesKey = "pod_routes"
+	// AgentRoutesKey is the hash podName -> binary PodRoute (MAC, ifindex)
+	// reported by node agents.
+	AgentRoutesKey = "agent_routes"
 )
 
+// Pod event operations published on PodEventsChannel
+const (
+	PodEventUpsert = "upsert"
+	PodEventDelete = "delete"
+)
+
+// PodEvent is published once per SaveStatusBatch / DeleteEmuNetStatus call.
+// Upsert carries the full pod records, Delete only the pod names.
+type PodEvent struct {
+	Op       string      `json:"op"`
+	Pods     []PodStatus `json:"pods,omitempty"`
+	PodNames []string    `json:"podNames,omitempty"`
+}
+
 type Client struct {
 	client *redis.Client
 }
@@ -48,6 +76,120 @@ type PodStatus struct {
 	LastUpdated time.Time `json:"lastUpdated"`
 }
 
+// PodRoute is the routing subset of PodStatus (node, MAC, veth ifindex, IP),
+// stored as a compact binary record instead of the verbose status JSON:
+//
+//	[0]      version (routeRecordVersion)
+//	[1:5]    veth ifindex, little endian
+//	[5:11]   MAC (all zero when unknown)
+//	[11]     IP length n (0, 4 or 16), followed by n bytes
+//	[..]     node name length m (<= 255), followed by m bytes
+type PodRoute struct {
+	NodeName string
+	MAC      [6]byte
+	Ifindex  uint32
+	PodIP    net.IP
+}
+
+const routeRecordVersion = 1
+
+var errBadRouteRecord = errors.New("malformed pod route record")
+
+// MarshalBinary encodes the route record.
+func (r *PodRoute) MarshalBinary() ([]byte, error) {
+	ip := r.PodIP
+	if v4 := ip.To4(); v4 != nil {
+		ip = v4
+	}
+	if len(r.NodeName) > 255 {
+		return nil, fmt.Errorf("node name %q too long", r.NodeName)
+	}
+	b := make([]byte, 0, 13+len(ip)+len(r.NodeName))
+	b = append(b, routeRecordVersion)
+	b = binary.LittleEndian.AppendUint32(b, r.Ifindex)
+	b = append(b, r.MAC[:]...)
+	b = append(b, byte(len(ip)))
+	b = append(b, ip...)
+	b = append(b, byte(len(r.NodeName)))
+	b = append(b, r.NodeName...)
+	return b, nil
+}
+
+// UnmarshalBinary decodes a record produced by MarshalBinary.
+func (r *PodRoute) UnmarshalBinary(b []byte) error {
+	if len(b) < 13 || b[0] != routeRecordVersion {
+		return errBadRouteRecord
+	}
+	r.Ifindex = binary.LittleEndian.Uint32(b[1:5])
+	copy(r.MAC[:], b[5:11])
+	n := int(b[11])
+	if n != 0 && n != net.IPv4len && n != net.IPv6len || len(b) < 13+n {
+		return errBadRouteRecord
+	}
+	r.PodIP = nil
+	if n > 0 {
+		r.PodIP = net.IP(append([]byte(nil), b[12:12+n]...))
+	}
+	m := int(b[12+n])
+	if len(b) != 13+n+m {
+		return errBadRouteRecord
+	}
+	r.NodeName = string(b[13+n:])
+	return nil
+}
+
+// RouteOf extracts the routing fields of a pod status.
+func RouteOf(pod *PodStatus) PodRoute {
+	r := PodRoute{NodeName: pod.NodeName, Ifindex: uint32(pod.VethIfIndex), PodIP: net.ParseIP(pod.PodIP)}
+	if mac, err := net.ParseMAC(pod.MACAddress); err == nil && len(mac) == 6 {
+		copy(r.MAC[:], mac)
+	}
+	return r
+}
+
+// Status returns a PodStatus carrying only the routing fields.
+func (r *PodRoute) Status(podName string) *PodStatus {
+	pod := &PodStatus{PodName: podName, NodeName: r.NodeName, VethIfIndex: int(r.Ifindex)}
+	if r.MAC != [6]byte{} {
+		pod.MACAddress = net.HardwareAddr(r.MAC[:]).String()
+	}
+	if r.PodIP != nil {
+		pod.PodIP = r.PodIP.String()
+	}
+	return pod
+}
+
+func decodeRoute(podName string, data string) (*PodStatus, error) {
+	var r PodRoute
+	if err := r.UnmarshalBinary([]byte(data)); err != nil {
+		return nil, err
+	}
+	return r.Status(podName), nil
+}
+
+func emunetRoutesKey(namespace, name string) string {
+	return fmt.Sprintf("emunet:%s:%s:routes", namespace, name)
+}
+
+// emunetStatusKey is the hash podName -> verbose PodStatus JSON of an EmuNet.
+func emunetStatusKey(namespace, name string) string {
+	return fmt.Sprintf("emunet:%s:%s:status", namespace, name)
+}
+
+// encodePod returns the verbose JSON and the binary route record of a pod.
+func encodePod(pod *PodStatus) ([]byte, []byte, error) {
+	data, err := json.Marshal(pod)
+	if err != nil {
+		return nil, nil, err
+	}
+	route := RouteOf(pod)
+	rec, err := route.MarshalBinary()
+	if err != nil {
+		return nil, nil, err
+	}
+	return data, rec, nil
+}
+
 // NewClient creates a redis client.
 // addr: "localhost:6379" or "redis-service.default.svc:6379"
 func NewClient(addr string, password string, db int) *Client {
@@ -77,34 +219,42 @@ func (c *Client) Close() error {
 // Agent Operations (Targeted Updates)
 // ==========================================
 
-// UpdatePodNetworkInfo [核心修改] Agent 写入专用的 Key，防止被 Master 覆盖
-// Agent 写入: agent:network:{podName}
+// UpdatePodNetworkInfo [核心修改] Agent 写入专用的 Hash，防止被 Master 覆盖
+// Agent 写入: agent_routes[podName] (binary PodRoute: MAC + ifindex)
 func (c *Client) UpdatePodNetworkInfo(ctx context.Context, podName string, mac string, ifIndex int) error {
-	pod := PodStatus{
-		PodName:     podName,
-		MACAddress:  mac,
-		VethIfIndex: ifIndex,
-		LastUpdated: time.Now(),
-	}
-
-	data, err := json.Marshal(pod)
+	route := RouteOf(&PodStatus{MACAddress: mac, VethIfIndex: ifIndex})
+	rec, err := route.MarshalBinary()
 	if err != nil {
 		return err
 	}
+	return c.client.HSet(ctx, AgentRoutesKey, podName, rec).Err()
+}
 
-	// 使用专用前缀 "agent:network:"
-	key := fmt.Sprintf("agent:network:%s", podName)
-	return c.client.Set(ctx, key, data, DefaultTTL).Err()
+// DeleteAgentNetworkInfo removes the agent report of a pod (and the legacy
+// per-pod JSON key written by older agents).
+func (c *Client) DeleteAgentNetworkInfo(ctx context.Context, podName string) error {
+	pipe := c.client.Pipeline()
+	pipe.HDel(ctx, AgentRoutesKey, podName)
+	pipe.Del(ctx, fmt.Sprintf("agent:network:%s", podName))
+	_, err := pipe.Exec(ctx)
+	return err
 }
 
-// GetAgentNetworkInfo [新增] Master 从专用 Key 读取 Agent 上报的数据
+// GetAgentNetworkInfo [新增] Master 从 agent_routes 读取 Agent 上报的数据，
+// 未找到时回退到旧版本 agent 写入的 agent:network:{podName}
 func (c *Client) GetAgentNetworkInfo(ctx context.Context, podName string) (*PodStatus, error) {
-	key := fmt.Sprintf("agent:network:%s", podName)
-	data, err := c.client.Get(ctx, key).Result()
-	if err != nil {
+	data, err := c.client.HGet(ctx, AgentRoutesKey, podName).Result()
+	if err == nil {
+		return decodeRoute(podName, data)
+	}
+	if err != redis.Nil {
 		return nil, err
 	}
 
+	data, err = c.client.Get(ctx, fmt.Sprintf("agent:network:%s", podName)).Result()
+	if err != nil {
+		return nil, err
+	}
 	var pod PodStatus
 	if err := json.Unmarshal([]byte(data), &pod); err != nil {
 		return nil, err
@@ -112,12 +262,54 @@ func (c *Client) GetAgentNetworkInfo(ctx context.Context, podName string) (*PodS
 	return &pod, nil
 }
 
+// agentMGetChunk bounds the fields per HMGET so one reply never grows unbounded
+// and a single command does not block Redis for long.
+const agentMGetChunk = 1000
+
+// GetAgentNetworkInfos reads agent_routes for all podNames with chunked
+// HMGETs sent in one pipeline (1 RTT). Pods without a record, or with an
+// unparsable one, are absent from the result.
+func (c *Client) GetAgentNetworkInfos(ctx context.Context, podNames []string) (map[string]*PodStatus, error) {
+	result := make(map[string]*PodStatus, len(podNames))
+	if len(podNames) == 0 {
+		return result, nil
+	}
+
+	pipe := c.client.Pipeline()
+	var cmds []*redis.SliceCmd
+	for start := 0; start < len(podNames); start += agentMGetChunk {
+		end := start + agentMGetChunk
+		if end > len(podNames) {
+			end = len(podNames)
+		}
+		cmds = append(cmds, pipe.HMGet(ctx, AgentRoutesKey, podNames[start:end]...))
+	}
+	if _, err := pipe.Exec(ctx); err != nil {
+		return nil, err
+	}
+
+	for i, cmd := range cmds {
+		for j, val := range cmd.Val() {
+			data, ok := val.(string)
+			if !ok {
+				continue
+			}
+			podName := podNames[i*agentMGetChunk+j]
+			if pod, err := decodeRoute(podName, data); err == nil {
+				result[podName] = pod
+			}
+		}
+	}
+	return result, nil
+}
+
 // ==========================================
 // Master Operations (Batch & Hierarchy)
 // ==========================================
 
 // SaveStatusBatch uses Redis Pipeline to save everything in 1 RTT.
-// Master 写入: pod_lookup:{podName} (这是合并了 IP 和 MAC 的完整数据)
+// Master 写入: pod_routes[podName] (合并了 IP 和 MAC 的路由记录，binary)，
+// 以及每个 EmuNet 的 routes / status 两个 Hash
 func (c *Client) SaveStatusBatch(ctx context.Context, emunet *EmuNetStatus, pods []PodStatus) error {
 	pipe := c.client.Pipeline()
 
@@ -131,23 +323,25 @@ func (c *Client) SaveStatusBatch(ctx context.Context, emunet *EmuNetStatus, pods
 
 	// 2. Save Pods and Indices
 	indexKey := fmt.Sprintf("emunet:%s:%s:pods", emunet.Namespace, emunet.Name)
+	routesKey := emunetRoutesKey(emunet.Namespace, emunet.Name)
+	statusKey := emunetStatusKey(emunet.Namespace, emunet.Name)
 
-	for _, pod := range pods {
-		podData, err := json.Marshal(pod)
+	for i := range pods {
+		pod := &pods[i]
+		if pod.PodName == "" {
+			continue
+		}
+		podData, rec, err := encodePod(pod)
 		if err != nil {
 			continue
 		}
 
-		// A. Hierarchical Key
-		podKey := fmt.Sprintf("emunet:%s:%s:pod:%s", emunet.Namespace, emunet.Name, pod.PodName)
-		pipe.Set(ctx, podKey, podData, DefaultTTL)
+		// A. Verbose status, read only by list queries
+		pipe.HSet(ctx, statusKey, pod.PodName, podData)
 
-		// B. Lookup Key (pod_lookup:podname) - Enables O(1) global lookup
-		// API Server 读取这个 Key
-		if pod.PodName != "" {
-			lookupKey := fmt.Sprintf("pod_lookup:%s", pod.PodName)
-			pipe.Set(ctx, lookupKey, podData, DefaultTTL)
-		}
+		// B. Route records - per EmuNet (list) and global (O(1) lookup by pod name)
+		pipe.HSet(ctx, routesKey, pod.PodName, rec)
+		pipe.HSet(ctx, PodRoutesKey, pod.PodName, rec)
 
 		// C. Add to Index Set
 		pipe.SAdd(ctx, indexKey, pod.PodName)
@@ -155,11 +349,125 @@ func (c *Client) SaveStatusBatch(ctx context.Context, emunet *EmuNetStatus, pods
 
 	// Refresh Index TTL
 	pipe.Expire(ctx, indexKey, DefaultTTL)
+	pipe.Expire(ctx, routesKey, DefaultTTL)
+	pipe.Expire(ctx, statusKey, DefaultTTL)
+
+	// Notify cache holders in the same round trip
+	if len(pods) > 0 {
+		if event, err := json.Marshal(PodEvent{Op: PodEventUpsert, Pods: pods}); err == nil {
+			pipe.Publish(ctx, PodEventsChannel, event)
+		}
+	}
 
 	_, err = pipe.Exec(ctx)
 	return err
 }
 
+// StatusDelta describes the changes between the last write of an EmuNet and
+// its current state. Only non-empty parts are sent to Redis.
+type StatusDelta struct {
+	Namespace string
+	Name      string
+
+	// Status is nil when the EmuNet status JSON did not change
+	Status *EmuNetStatus
+	// Upserts are pods whose record changed (or are new)
+	Upserts []PodStatus
+	// Removed are pods that are no longer part of the EmuNet
+	Removed []string
+
+	// RefreshTTL re-arms the expiry of every key of the EmuNet without rewriting values;
+	// Live lists the current pod names for that purpose
+	RefreshTTL bool
+	Live       []string
+}
+
+// Empty reports whether the delta would not touch Redis at all.
+func (d *StatusDelta) Empty() bool {
+	return d.Status == nil && len(d.Upserts) == 0 && len(d.Removed) == 0 && !d.RefreshTTL
+}
+
+// SaveStatusDelta pipelines only the keys that changed (1 RTT), and publishes
+// the matching pod events.
+func (c *Client) SaveStatusDelta(ctx context.Context, delta *StatusDelta) error {
+	if delta.Empty() {
+		return nil
+	}
+	pipe := c.client.Pipeline()
+
+	key := fmt.Sprintf("emunet:%s:%s", delta.Namespace, delta.Name)
+	indexKey := fmt.Sprintf("emunet:%s:%s:pods", delta.Namespace, delta.Name)
+	routesKey := emunetRoutesKey(delta.Namespace, delta.Name)
+	statusKey := emunetStatusKey(delta.Namespace, delta.Name)
+
+	if delta.Status != nil {
+		data, err := json.Marshal(delta.Status)
+		if err != nil {
+			return err
+		}
+		pipe.Set(ctx, key, data, DefaultTTL)
+	}
+
+	for i := range delta.Upserts {
+		pod := &delta.Upserts[i]
+		if pod.PodName == "" {
+			continue
+		}
+		podData, rec, err := encodePod(pod)
+		if err != nil {
+			continue
+		}
+		pipe.HSet(ctx, statusKey, pod.PodName, podData)
+		pipe.HSet(ctx, routesKey, pod.PodName, rec)
+		pipe.HSet(ctx, PodRoutesKey, pod.PodName, rec)
+		pipe.SAdd(ctx, indexKey, pod.PodName)
+	}
+
+	if len(delta.Removed) > 0 {
+		members := make([]interface{}, len(delta.Removed))
+		for i, podName := range delta.Removed {
+			members[i] = podName
+			// Legacy per-pod JSON keys written before the hash layout
+			pipe.Del(ctx, fmt.Sprintf("emunet:%s:%s:pod:%s", delta.Namespace, delta.Name, podName))
+			pipe.Del(ctx, fmt.Sprintf("pod_lookup:%s", podName))
+		}
+		pipe.HDel(ctx, statusKey, delta.Removed...)
+		pipe.HDel(ctx, routesKey, delta.Removed...)
+		pipe.HDel(ctx, PodRoutesKey, delta.Removed...)
+		pipe.SRem(ctx, indexKey, members...)
+	}
+
+	// One EXPIRE per hash covers every pod of the EmuNet
+	if delta.RefreshTTL && delta.Status == nil {
+		pipe.Expire(ctx, key, DefaultTTL)
+	}
+	if delta.RefreshTTL || len(delta.Upserts) > 0 {
+		pipe.Expire(ctx, indexKey, DefaultTTL)
+		pipe.Expire(ctx, routesKey, DefaultTTL)
+		pipe.Expire(ctx, statusKey, DefaultTTL)
+	}
+
+	if len(delta.Upserts) > 0 {
+		if event, err := json.Marshal(PodEvent{Op: PodEventUpsert, Pods: delta.Upserts}); err == nil {
+			pipe.Publish(ctx, PodEventsChannel, event)
+		}
+	}
+	if len(delta.Removed) > 0 {
+		if event, err := json.Marshal(PodEvent{Op: PodEventDelete, PodNames: delta.Removed}); err == nil {
+			pipe.Publish(ctx, PodEventsChannel, event)
+		}
+	}
+
+	_, err := pipe.Exec(ctx)
+	return err
+}
+
+// ListPodIndex returns the pod names currently in the EmuNet index set.
+func (c *Client) ListPodIndex(ctx context.Context, namespace, name string) ([]string, error) {
+	indexKey := fmt.Sprintf("emunet:%s:%s:pods", namespace, name)
+	return c.client.SMembers(ctx, indexKey).Result()
+}
+
 func (c *Client) SaveEmuNetStatus(ctx context.Context, status *EmuNetStatus) error {
 	key := fmt.Sprintf("emunet:%s:%s", status.Namespace, status.Name)
 	data, err := json.Marshal(status)
@@ -191,18 +499,30 @@ func (c *Client) DeleteEmuNetStatus(ctx context.Context, namespace, name string)
 	indexKey := fmt.Sprintf("emunet:%s:%s:pods", namespace, name)
 	podNames, _ := c.client.SMembers(ctx, indexKey).Result()
 
-	// 2. Delete all Pod specific keys
+	// 2. Delete all Pod specific records (hash fields, plus legacy per-pod keys)
 	for _, podName := range podNames {
 		pipe.Del(ctx, fmt.Sprintf("emunet:%s:%s:pod:%s", namespace, name, podName))
 		pipe.Del(ctx, fmt.Sprintf("pod_lookup:%s", podName))
-		// Optional: We can also cleanup agent data, but TTL handles it usually
 		pipe.Del(ctx, fmt.Sprintf("agent:network:%s", podName))
 	}
+	if len(podNames) > 0 {
+		// The global hashes have no TTL, their fields must be removed here
+		pipe.HDel(ctx, PodRoutesKey, podNames...)
+		pipe.HDel(ctx, AgentRoutesKey, podNames...)
+	}
 
 	// 3. Delete EmuNet keys
 	mainKey := fmt.Sprintf("emunet:%s:%s", namespace, name)
 	pipe.Del(ctx, mainKey)
 	pipe.Del(ctx, indexKey)
+	pipe.Del(ctx, emunetRoutesKey(namespace, name))
+	pipe.Del(ctx, emunetStatusKey(namespace, name))
+
+	if len(podNames) > 0 {
+		if event, err := json.Marshal(PodEvent{Op: PodEventDelete, PodNames: podNames}); err == nil {
+			pipe.Publish(ctx, PodEventsChannel, event)
+		}
+	}
 
 	_, err := pipe.Exec(ctx)
 	return err
@@ -213,14 +533,21 @@ func (c *Client) DeleteEmuNetStatus(ctx context.Context, namespace, name string)
 // ==========================================
 
 // GetPodInfoDirectly is the O(1) lookup method for the Master API
-// It reads from "pod_lookup:{podName}" which contains merged data
+// It reads the binary route record from "pod_routes" (routing fields only),
+// falling back to the legacy "pod_lookup:{podName}" JSON.
 func (c *Client) GetPodInfoDirectly(ctx context.Context, podName string) (*PodStatus, error) {
-	key := fmt.Sprintf("pod_lookup:%s", podName)
-	data, err := c.client.Get(ctx, key).Result()
-	if err != nil {
+	data, err := c.client.HGet(ctx, PodRoutesKey, podName).Result()
+	if err == nil {
+		return decodeRoute(podName, data)
+	}
+	if err != redis.Nil {
 		return nil, err
 	}
 
+	data, err = c.client.Get(ctx, fmt.Sprintf("pod_lookup:%s", podName)).Result()
+	if err != nil {
+		return nil, err
+	}
 	var pod PodStatus
 	if err := json.Unmarshal([]byte(data), &pod); err != nil {
 		return nil, err
@@ -228,42 +555,39 @@ func (c *Client) GetPodInfoDirectly(ctx context.Context, podName string) (*PodSt
 	return &pod, nil
 }
 
-// ListPodStatuses Optimized: Uses SMEMBERS instead of SCAN
+// ListPodStatuses returns the verbose statuses of an EmuNet with one HGETALL.
 func (c *Client) ListPodStatuses(ctx context.Context, namespace, name string) ([]PodStatus, error) {
-	indexKey := fmt.Sprintf("emunet:%s:%s:pods", namespace, name)
-	podNames, err := c.client.SMembers(ctx, indexKey).Result()
+	fields, err := c.client.HGetAll(ctx, emunetStatusKey(namespace, name)).Result()
 	if err != nil {
 		return nil, err
 	}
 
-	if len(podNames) == 0 {
-		return []PodStatus{}, nil
+	pods := make([]PodStatus, 0, len(fields))
+	for _, data := range fields {
+		var pod PodStatus
+		if json.Unmarshal([]byte(data), &pod) == nil {
+			pods = append(pods, pod)
+		}
 	}
+	return pods, nil
+}
 
-	pipe := c.client.Pipeline()
-	cmds := make([]*redis.StringCmd, len(podNames))
-
-	for i, podName := range podNames {
-		key := fmt.Sprintf("emunet:%s:%s:pod:%s", namespace, name, podName)
-		cmds[i] = pipe.Get(ctx, key)
-	}
+// ListPodRoutes returns the routing fields of every pod of an EmuNet with one HGETALL.
+func (c *Client) ListPodRoutes(ctx context.Context, namespace, name string) ([]PodStatus, error) {
+	return c.hgetAllRoutes(ctx, emunetRoutesKey(namespace, name))
+}
 
-	_, err = pipe.Exec(ctx)
-	if err != nil && err != redis.Nil {
+func (c *Client) hgetAllRoutes(ctx context.Context, key string) ([]PodStatus, error) {
+	fields, err := c.client.HGetAll(ctx, key).Result()
+	if err != nil {
 		return nil, err
 	}
-
-	var pods []PodStatus
-	for _, cmd := range cmds {
-		data, err := cmd.Result()
-		if err == nil {
-			var pod PodStatus
-			if json.Unmarshal([]byte(data), &pod) == nil {
-				pods = append(pods, pod)
-			}
+	pods := make([]PodStatus, 0, len(fields))
+	for podName, data := range fields {
+		if pod, err := decodeRoute(podName, data); err == nil {
+			pods = append(pods, *pod)
 		}
 	}
-
 	return pods, nil
 }
 
@@ -275,3 +599,258 @@ func (c *Client) SavePodStatus(ctx context.Context, namespace, name string, pod
 func (c *Client) GetPodStatus(ctx context.Context, namespace, name, podName string) (*PodStatus, error) {
 	return c.GetPodInfoDirectly(ctx, podName)
 }
+
+// ==========================================
+// Pod Cache Support
+// ==========================================
+
+// SubscribePodEvents subscribes to PodEventsChannel and waits for the
+// subscription to be confirmed, so no event published afterwards is missed.
+// Messages are buffered in a channel of channelSize until read.
+func (c *Client) SubscribePodEvents(ctx context.Context, channelSize int) (*redis.PubSub, <-chan *redis.Message, error) {
+	sub := c.client.Subscribe(ctx, PodEventsChannel)
+	if _, err := sub.Receive(ctx); err != nil {
+		sub.Close()
+		return nil, nil, err
+	}
+	return sub, sub.Channel(redis.WithChannelSize(channelSize)), nil
+}
+
+// LoadAllPodLookups returns the route record of every pod with one HGETALL
+// of the global pod_routes hash.
+func (c *Client) LoadAllPodLookups(ctx context.Context) ([]PodStatus, error) {
+	return c.hgetAllRoutes(ctx, PodRoutesKey)
+}
+
+// ==========================================
+// Link Profiles
+// ==========================================
+
+// ProfilesKey is a hash of profile id -> LinkProfile JSON, the desired
+// content of every node's EMU_PROFILES array.
+const ProfilesKey = "emunet:profiles"
+
+// LinkProfile is a shared set of link parameters that rules can bind to by id.
+type LinkProfile struct {
+	ID              uint32 `json:"id"`
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
+	Delay           uint32 `json:"delay"`
+	LossRate        uint32 `json:"lossRate"`
+	Jitter          uint32 `json:"jitter"`
+	GeP             uint32 `json:"geP,omitempty"`
+	GeR             uint32 `json:"geR,omitempty"`
+	GeLossBad       uint32 `json:"geLossBad,omitempty"`
+	QueueBytes      uint32 `json:"queueBytes,omitempty"`
+	QueueDelay      uint32 `json:"queueDelay,omitempty"`
+	RedMin          uint32 `json:"redMin,omitempty"`
+	RedMax          uint32 `json:"redMax,omitempty"`
+	RedMaxP         uint32 `json:"redMaxP,omitempty"`
+	ECN             bool   `json:"ecn,omitempty"`
+	GroupID         uint32 `json:"groupId,omitempty"`
+	TraceID         uint32 `json:"traceId,omitempty"`
+	JitterDist      uint32 `json:"jitterDist,omitempty"`
+	JitterOrdered   bool   `json:"jitterOrdered,omitempty"`
+	DupRate         uint32 `json:"dupRate,omitempty"`
+	CorruptRate     uint32 `json:"corruptRate,omitempty"`
+	CorruptKeepCsum bool   `json:"corruptKeepCsum,omitempty"`
+	ReorderRate     uint32 `json:"reorderRate,omitempty"`
+	ReorderGap      uint32 `json:"reorderGap,omitempty"`
+}
+
+// SaveProfiles upserts profiles in a single HSET (profiles don't expire).
+func (c *Client) SaveProfiles(ctx context.Context, profiles []LinkProfile) error {
+	if len(profiles) == 0 {
+		return nil
+	}
+	values := make([]interface{}, 0, 2*len(profiles))
+	for _, p := range profiles {
+		data, err := json.Marshal(p)
+		if err != nil {
+			return err
+		}
+		values = append(values, fmt.Sprintf("%d", p.ID), data)
+	}
+	return c.client.HSet(ctx, ProfilesKey, values...).Err()
+}
+
+// DeleteProfiles removes profiles by id.
+func (c *Client) DeleteProfiles(ctx context.Context, ids []uint32) error {
+	if len(ids) == 0 {
+		return nil
+	}
+	fields := make([]string, len(ids))
+	for i, id := range ids {
+		fields[i] = fmt.Sprintf("%d", id)
+	}
+	return c.client.HDel(ctx, ProfilesKey, fields...).Err()
+}
+
+// ListProfiles returns every stored profile.
+func (c *Client) ListProfiles(ctx context.Context) ([]LinkProfile, error) {
+	raw, err := c.client.HGetAll(ctx, ProfilesKey).Result()
+	if err != nil {
+		return nil, err
+	}
+	profiles := make([]LinkProfile, 0, len(raw))
+	for _, data := range raw {
+		var p LinkProfile
+		if json.Unmarshal([]byte(data), &p) == nil {
+			profiles = append(profiles, p)
+		}
+	}
+	return profiles, nil
+}
+
+// =================================================================================
+// Link Traces
+// =================================================================================
+
+// TracesKey is a hash of trace id -> LinkTrace JSON, the desired content of
+// every node's EMU_TRACE_META / EMU_TRACE_POINTS arrays.
+const TracesKey = "emunet:traces"
+
+// TracePoint is one step of a trace, in the same units as link parameters.
+type TracePoint struct {
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
+	Delay           uint32 `json:"delay"`
+	LossRate        uint32 `json:"lossRate"`
+}
+
+// LinkTrace is a time-varying schedule of link parameters replayed by the
+// datapath. Either Points or Mahimahi (ms delivery-opportunity timestamps)
+// is set. StartUnixNano is fixed when the trace is first stored so every
+// node replays it in phase.
+type LinkTrace struct {
+	ID            uint32       `json:"id"`
+	SlotUs        uint32       `json:"slotUs"`
+	StartUnixNano int64        `json:"startUnixNano,omitempty"`
+	Points        []TracePoint `json:"points,omitempty"`
+	Mahimahi      []uint64     `json:"mahimahi,omitempty"`
+	Delay         uint32       `json:"delay,omitempty"`
+	LossRate      uint32       `json:"lossRate,omitempty"`
+}
+
+// SaveTraces upserts traces in a single HSET (traces don't expire).
+func (c *Client) SaveTraces(ctx context.Context, traces []LinkTrace) error {
+	if len(traces) == 0 {
+		return nil
+	}
+	values := make([]interface{}, 0, 2*len(traces))
+	for _, t := range traces {
+		data, err := json.Marshal(t)
+		if err != nil {
+			return err
+		}
+		values = append(values, fmt.Sprintf("%d", t.ID), data)
+	}
+	return c.client.HSet(ctx, TracesKey, values...).Err()
+}
+
+// DeleteTraces removes traces by id.
+func (c *Client) DeleteTraces(ctx context.Context, ids []uint32) error {
+	if len(ids) == 0 {
+		return nil
+	}
+	fields := make([]string, len(ids))
+	for i, id := range ids {
+		fields[i] = fmt.Sprintf("%d", id)
+	}
+	return c.client.HDel(ctx, TracesKey, fields...).Err()
+}
+
+// ListTraces returns every stored trace.
+func (c *Client) ListTraces(ctx context.Context) ([]LinkTrace, error) {
+	raw, err := c.client.HGetAll(ctx, TracesKey).Result()
+	if err != nil {
+		return nil, err
+	}
+	traces := make([]LinkTrace, 0, len(raw))
+	for _, data := range raw {
+		var t LinkTrace
+		if json.Unmarshal([]byte(data), &t) == nil {
+			traces = append(traces, t)
+		}
+	}
+	return traces, nil
+}
+
+// =================================================================================
+// Node Rule Snapshots
+// =================================================================================
+
+// NodeRuleKeySize is the length of a snapshot field: the rule key as encoded
+// in agent batches (ifindex little endian + source MAC).
+const NodeRuleKeySize = 10
+
+// nodeRulesKey is the hash of rule key -> agent batch upsert record, the
+// desired MAC_HANDLE_EMU content of one node. The linkserver updates it after
+// every batch the agent acknowledges; the agent reconciles against it on restart.
+func nodeRulesKey(node string) string {
+	return fmt.Sprintf("emunet:node:%s:rules", node)
+}
+
+// nodeRulesVersionKey is bumped in the same transaction as every snapshot change.
+func nodeRulesVersionKey(node string) string {
+	return fmt.Sprintf("emunet:node:%s:rules_version", node)
+}
+
+// NodeRulesDelta is one change to a node rule snapshot.
+type NodeRulesDelta struct {
+	Upserts map[string][]byte // rule key -> upsert record
+	Deletes []string
+	// Replace drops every rule not in Upserts first (an unseeded epoch commit).
+	Replace bool
+}
+
+// Empty reports whether the delta changes nothing.
+func (d *NodeRulesDelta) Empty() bool {
+	return len(d.Upserts) == 0 && len(d.Deletes) == 0 && !d.Replace
+}
+
+// SaveNodeRules applies delta to the snapshot of node and returns the new
+// version. Rules and version change in one MULTI, so a reader never sees one
+// without the other.
+func (c *Client) SaveNodeRules(ctx context.Context, node string, delta *NodeRulesDelta) (int64, error) {
+	if delta.Empty() {
+		return 0, nil
+	}
+	key := nodeRulesKey(node)
+	pipe := c.client.TxPipeline()
+	if delta.Replace {
+		pipe.Del(ctx, key)
+	}
+	if len(delta.Upserts) > 0 {
+		values := make([]interface{}, 0, 2*len(delta.Upserts))
+		for field, rec := range delta.Upserts {
+			values = append(values, field, rec)
+		}
+		pipe.HSet(ctx, key, values...)
+	}
+	if len(delta.Deletes) > 0 {
+		pipe.HDel(ctx, key, delta.Deletes...)
+	}
+	version := pipe.Incr(ctx, nodeRulesVersionKey(node))
+	if _, err := pipe.Exec(ctx); err != nil {
+		return 0, err
+	}
+	return version.Val(), nil
+}
+
+// LoadNodeRules returns the snapshot of node and its version, read in one
+// MULTI. Version 0 means no snapshot was ever written for the node.
+func (c *Client) LoadNodeRules(ctx context.Context, node string) (map[string]string, int64, error) {
+	pipe := c.client.TxPipeline()
+	version := pipe.Get(ctx, nodeRulesVersionKey(node))
+	rules := pipe.HGetAll(ctx, nodeRulesKey(node))
+	if _, err := pipe.Exec(ctx); err != nil && !errors.Is(err, redis.Nil) {
+		return nil, 0, err
+	}
+	v, err := version.Int64()
+	if errors.Is(err, redis.Nil) {
+		return rules.Val(), 0, nil
+	}
+	if err != nil {
+		return nil, 0, err
+	}
+	return rules.Val(), v, nil
+}
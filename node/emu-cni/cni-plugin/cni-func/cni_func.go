@@ -2,7 +2,9 @@ package cnifunc
 
 import (
 	"encoding/json"
+	"errors"
 	"fmt"
+	"net"
 	"os"
 	"runtime"
 	"strings"
@@ -15,6 +17,7 @@ import (
 	cni_network "EMU_CNI/cni-plugin/cni-network"
 	"EMU_CNI/tools/config"
 	ebpftc "EMU_CNI/tools/ebpf/ebpf-tc"
+	ebpfxdp "EMU_CNI/tools/ebpf/ebpf-xdp"
 )
 
 type EmuCNIPlugin struct {
@@ -98,15 +101,7 @@ func (e *EmuCNIPlugin) Add(args *skel.CmdArgs) error {
 
 	// --- 业务逻辑：eBPF 与 Agent 交互 ---
 
-	// 1. 初始化并附加 eBPF TC 程序
-	if err := ebpftc.Init(); err != nil {
-		return fmt.Errorf("ebpf init failed: %v", err)
-	}
-	if err := ebpftc.AttachTCByName(hostVethName); err != nil {
-		return fmt.Errorf("attach eBPF to %s failed: %v", hostVethName, err)
-	}
-
-	// 2. 解析 Pod 标识信息
+	// 1. 解析 Pod 标识信息
 	podName := ""
 	if args.Args != "" {
 		for _, arg := range strings.Split(args.Args, ";") {
@@ -120,11 +115,34 @@ func (e *EmuCNIPlugin) Add(args *skel.CmdArgs) error {
 		podName = args.ContainerID
 	}
 
-	// 3. 注册 Pod 信息到 Agent 服务
+	// 2. 由 agent 挂载 TC 程序并登记 Pod (unix socket 一次往返)，CNI 进程不再加载 eBPF 对象
+	mode, err := ebpftc.ParseMode(n.EmuMode)
+	if err != nil {
+		return err
+	}
 	agentClient := cni_network.NewAgentClient()
-	if err := agentClient.AddPodInfo(podName, hostIfIndex, containerMac); err != nil {
-		// 记录到 stderr，不阻断 CNI 主流程
-		fmt.Fprintf(os.Stderr, "emu-cni warning: call agent failed: %v\n", err)
+	if n.AgentSocket != "" {
+		agentClient.SocketPath = n.AgentSocket
+	}
+	err = agentClient.AttachPod(cni_network.AttachRequest{
+		PodName:     podName,
+		Ifindex:     hostIfIndex,
+		SrcMac:      containerMac,
+		Mode:        string(mode),
+		Ingress:     n.Ingress,
+		EDTLockless: n.EdtLockless,
+		MaxEntries:  n.MaxEntries,
+		IfaceTables: n.IfaceTables,
+		DupMark:     n.DupMark,
+		XDPFastPath: n.XdpFastPath,
+	})
+	if errors.Is(err, cni_network.ErrAgentUnavailable) {
+		// 3. agent 不可达时回退：本地初始化并挂载，再通过 HTTP 登记
+		fmt.Fprintf(os.Stderr, "emu-cni warning: %v, attaching locally\n", err)
+		err = attachLocal(n, mode, hostVethName, agentClient, podName, hostIfIndex, containerMac)
+	}
+	if err != nil {
+		return err
 	}
 
 	// --- 结束流程 ---
@@ -144,6 +162,67 @@ func (e *EmuCNIPlugin) Add(args *skel.CmdArgs) error {
 	return nil
 }
 
+// attachLocal 为 agent 不可达时的回退路径：CNI 进程自行加载 eBPF 对象并挂载，再通过 HTTP 登记 Pod
+func attachLocal(n *config.NetConf, mode ebpftc.Mode, hostVethName string, agentClient *cni_network.AgentClient,
+	podName string, hostIfIndex int, containerMac string) error {
+	initOpts := ebpftc.Options{
+		EDTLockless: n.EdtLockless,
+		MaxEntries:  n.MaxEntries,
+		IfaceTables: n.IfaceTables,
+		DupMark:     n.DupMark,
+	}
+	if err := ebpftc.InitWithOptions(initOpts); err != nil {
+		return fmt.Errorf("ebpf init failed: %v", err)
+	}
+	if err := ebpftc.AttachTCByName(hostVethName, mode, n.Ingress); err != nil {
+		return fmt.Errorf("attach eBPF to %s failed: %v", hostVethName, err)
+	}
+	// XDP 快速路径在 TC 程序加载之后挂载，首次加载时共享其 pin 住的仿真规则
+	if n.XdpFastPath {
+		if err := attachXDP(hostVethName, hostIfIndex, containerMac); err != nil {
+			return err
+		}
+	}
+
+	if err := agentClient.AddPodInfo(podName, hostIfIndex, containerMac); err != nil {
+		// 记录到 stderr，不阻断 CNI 主流程
+		fmt.Fprintf(os.Stderr, "emu-cni warning: call agent failed: %v\n", err)
+	}
+	return nil
+}
+
+// attachXDP 为 attachLocal 的 XDP 部分，与 agent 侧 ebpfxdp.Attacher 的顺序一致：
+// 先写 devmap 与 mac_table，挂载后其他 veth 重定向到该 Pod 的包不会因表项缺失而丢弃
+func attachXDP(hostVethName string, hostIfIndex int, containerMac string) error {
+	mac, err := net.ParseMAC(containerMac)
+	if err != nil {
+		return fmt.Errorf("invalid container mac %q: %v", containerMac, err)
+	}
+	if err := ebpfxdp.InitWithOptions(ebpfxdp.Options{FastPath: true}); err != nil {
+		return fmt.Errorf("xdp init failed: %v", err)
+	}
+	if err := ebpfxdp.AddToDevMap(uint32(hostIfIndex)); err != nil {
+		return err
+	}
+	if err := ebpfxdp.UpdateFwdRule(mac, uint32(hostIfIndex)); err != nil {
+		return err
+	}
+	if err := ebpfxdp.AttachXDPByName(hostVethName); err != nil {
+		return fmt.Errorf("attach xdp to %s failed: %v", hostVethName, err)
+	}
+	return nil
+}
+
+// detachXDP 清理指向该 veth 的转发表项；veth 随 Pod 删除时 XDP 程序自动卸载
+func detachXDP(hostIfIndex int) {
+	if err := ebpfxdp.DeleteAllFwdRulesByIfIndex(uint32(hostIfIndex)); err != nil {
+		fmt.Fprintf(os.Stderr, "emu-cni warning: delete xdp fwd rules failed: %v\n", err)
+	}
+	if err := ebpfxdp.DeleteFromDevMap(uint32(hostIfIndex)); err != nil {
+		fmt.Fprintf(os.Stderr, "emu-cni warning: delete xdp devmap entry failed: %v\n", err)
+	}
+}
+
 // Del 实现 CNI DEL 命令
 func (e *EmuCNIPlugin) Del(args *skel.CmdArgs) error {
 	podName := ""
@@ -159,14 +238,45 @@ func (e *EmuCNIPlugin) Del(args *skel.CmdArgs) error {
 		podName = args.ContainerID
 	}
 
+	// 容器网络空间仍在时带上 veth/MAC，agent 重启丢失本地记录时也能回收规则
+	hostIfIndex, containerMac := podLink(args)
+
 	agentClient := cni_network.NewAgentClient()
-	if err := agentClient.DeletePodInfo(podName); err != nil {
+	if err := agentClient.DeletePodInfo(podName, hostIfIndex, containerMac); err != nil {
 		fmt.Fprintf(os.Stderr, "emu-cni warning: delete pod info failed: %v\n", err)
 	}
+	if n, err := config.LoadNetConf(args.StdinData); err == nil && n.XdpFastPath && hostIfIndex != 0 {
+		detachXDP(hostIfIndex)
+	}
 
 	return nil
 }
 
+// podLink 尽力获取 Pod 的主机端 veth ifindex 与容器 MAC，网络空间已销毁时返回零值
+func podLink(args *skel.CmdArgs) (int, string) {
+	if args.Netns == "" {
+		return 0, ""
+	}
+
+	// WithNetNSPath 自行锁定线程并在回调结束后切回主机空间
+	var (
+		ifindex int
+		mac     string
+	)
+	err := ns.WithNetNSPath(args.Netns, func(ns.NetNS) error {
+		cLink, err := netlink.LinkByName(args.IfName)
+		if err != nil {
+			return err
+		}
+		ifindex, mac = cLink.Attrs().ParentIndex, cLink.Attrs().HardwareAddr.String()
+		return nil
+	})
+	if err != nil {
+		return 0, ""
+	}
+	return ifindex, mac
+}
+
 // Check 实现 CNI CHECK 命令
 func (e *EmuCNIPlugin) Check(args *skel.CmdArgs) error {
 	n, err := config.LoadNetConf(args.StdinData)
@@ -1,10 +1,15 @@
 package cni_network
 
 import (
+	"bufio"
 	"bytes"
 	"encoding/json"
+	"errors"
 	"fmt"
+	"net"
 	"net/http"
+	"net/url"
+	"strconv"
 	"time"
 )
 
@@ -15,20 +20,75 @@ type PodInfoRequest struct {
 	SrcMac  string `json:"srcMac"`  // 源MAC地址
 }
 
+// DefaultAgentSocket 为 agent 监听的 unix socket 路径，需与 agent 的 -cni-socket 参数一致
+const DefaultAgentSocket = "/run/emunet/agent.sock"
+
+// AttachRequest 为 unix socket 上的一次调用：agent 挂载 TC (及 XDP) 程序并登记 Pod，一次往返完成。
+// Options 字段与 ebpftc.Options 对应，仅在节点首次加载 eBPF 对象时生效
+type AttachRequest struct {
+	Op          string `json:"op"` // 目前只有 "add"
+	PodName     string `json:"podName"`
+	Ifindex     int    `json:"ifindex"`
+	SrcMac      string `json:"srcMac"`
+	Mode        string `json:"mode,omitempty"`
+	Ingress     bool   `json:"ingress,omitempty"`
+	EDTLockless bool   `json:"edtLockless,omitempty"`
+	MaxEntries  uint32 `json:"maxEntries,omitempty"`
+	IfaceTables bool   `json:"ifaceTables,omitempty"`
+	DupMark     uint32 `json:"dupMark,omitempty"`
+	// XDPFastPath 在 TC 程序之后挂载 XDP 快速路径，与 ebpfxdp.Options.FastPath 对应
+	XDPFastPath bool `json:"xdpFastPath,omitempty"`
+}
+
+// AttachResponse 为 agent 的应答，Status 为 "success" 或 "error"
+type AttachResponse struct {
+	Status string `json:"status"`
+	Error  string `json:"error,omitempty"`
+}
+
+// ErrAgentUnavailable 表示 unix socket 不可连接 (agent 未启动或版本过旧)，调用方应回退到本地挂载
+var ErrAgentUnavailable = errors.New("agent socket unavailable")
+
 // AgentClient 定义agent服务客户端
 type AgentClient struct {
-	BaseURL string
-	Timeout time.Duration
+	BaseURL    string
+	SocketPath string
+	Timeout    time.Duration
 }
 
 // NewAgentClient 创建一个新的agent客户端
 func NewAgentClient() *AgentClient {
 	return &AgentClient{
-		BaseURL: "http://localhost:12345",
-		Timeout: 5 * time.Second,
+		BaseURL:    "http://localhost:12345",
+		SocketPath: DefaultAgentSocket,
+		Timeout:    5 * time.Second,
 	}
 }
 
+// AttachPod 通过 unix socket 请求 agent 挂载并登记 Pod。连接失败时返回 ErrAgentUnavailable；
+// agent 已收到请求但执行失败时返回其错误，此时不应回退，避免与 agent 重复挂载
+func (ac *AgentClient) AttachPod(req AttachRequest) error {
+	conn, err := net.DialTimeout("unix", ac.SocketPath, ac.Timeout)
+	if err != nil {
+		return fmt.Errorf("%w: %v", ErrAgentUnavailable, err)
+	}
+	defer conn.Close()
+	conn.SetDeadline(time.Now().Add(ac.Timeout))
+
+	req.Op = "add"
+	if err := json.NewEncoder(conn).Encode(req); err != nil {
+		return fmt.Errorf("发送请求失败: %v", err)
+	}
+	var resp AttachResponse
+	if err := json.NewDecoder(bufio.NewReader(conn)).Decode(&resp); err != nil {
+		return fmt.Errorf("读取应答失败: %v", err)
+	}
+	if resp.Status != "success" {
+		return fmt.Errorf("agent 挂载失败: %s", resp.Error)
+	}
+	return nil
+}
+
 // AddPodInfo 向agent服务添加PodInfo
 func (ac *AgentClient) AddPodInfo(podName string, ifindex int, srcMac string) error {
 	req := PodInfoRequest{
@@ -62,10 +122,19 @@ func (ac *AgentClient) AddPodInfo(podName string, ifindex int, srcMac string) er
 	return nil
 }
 
-// DeletePodInfo 从agent服务删除PodInfo
-func (ac *AgentClient) DeletePodInfo(podName string) error {
+// DeletePodInfo 从agent服务删除PodInfo，agent 同时批量回收该 Pod 的全部链路规则。
+// ifindex 为 0 时由 agent 使用其记录的接口信息
+func (ac *AgentClient) DeletePodInfo(podName string, ifindex int, srcMac string) error {
+	reqURL := ac.BaseURL + "/api/podinfo/" + url.PathEscape(podName)
+	if ifindex > 0 {
+		q := url.Values{}
+		q.Set("ifindex", strconv.Itoa(ifindex))
+		q.Set("srcMac", srcMac)
+		reqURL += "?" + q.Encode()
+	}
+
 	client := &http.Client{Timeout: ac.Timeout}
-	httpReq, err := http.NewRequest("DELETE", ac.BaseURL+"/api/podinfo/"+podName, nil)
+	httpReq, err := http.NewRequest("DELETE", reqURL, nil)
 	if err != nil {
 		return fmt.Errorf("创建HTTP请求失败: %v", err)
 	}
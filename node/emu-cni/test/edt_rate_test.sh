@@ -0,0 +1,69 @@
+#!/usr/bin/env bash
+# EDT 限速准确性测试：在两个 netns 之间用 iperf3 -P 打多条并发流，
+# 校验 tc_loss_bps 实际限速结果与配置速率的偏差。
+# 依赖: root 权限、iproute2 (带 libbpf 支持)、bpftool、iperf3、jq
+set -euo pipefail
+
+RATE_BPS=${RATE_BPS:-100000000} # 配置速率 (bps)
+FLOWS=${FLOWS:-16}              # 并发流数量
+DURATION=${DURATION:-10}        # 打流时长 (s)
+TOLERANCE=${TOLERANCE:-5}       # 允许的偏差 (%)
+OBJ=${OBJ:-$(cd "$(dirname "$0")" && pwd)/../tools/ebpf/ebpf-tc/bpf_bpfel.o}
+
+# tc 加载 LIBBPF_PIN_BY_NAME 的 map 时默认 pin 到该目录
+MAP_DIR=/sys/fs/bpf/tc/globals
+
+cleanup() {
+    ip netns del emu-edt-a 2>/dev/null || true
+    ip netns del emu-edt-b 2>/dev/null || true
+    rm -f "$MAP_DIR/MAC_HANDLE_EMU"
+}
+trap cleanup EXIT
+
+# 小端序 hex 编码，供 bpftool map update 使用
+le32() { printf '%02x %02x %02x %02x' $(($1 & 0xff)) $(($1 >> 8 & 0xff)) $(($1 >> 16 & 0xff)) $(($1 >> 24 & 0xff)); }
+
+le64() { echo "$(le32 $(($1 & 0xffffffff))) $(le32 $(($1 >> 32)))"; }
+
+# struct handle_emu (104B): throttle_rate_bps, ns_per_byte_fp, 之后 22 个 u32 只限速时均为 0
+RATE_FP_SHIFT=20
+handle_emu_hex() {
+    local fp=$(( (8000000000 << RATE_FP_SHIFT) / $1 ))
+    local rest=""
+    for _ in $(seq 22); do rest="$rest $(le32 0)"; done
+    echo "$(le64 "$1") $(le64 "$fp")$rest"
+}
+
+ip netns add emu-edt-a
+ip netns add emu-edt-b
+ip link add va netns emu-edt-a type veth peer name vb netns emu-edt-b
+ip -n emu-edt-a addr add 10.99.0.1/24 dev va
+ip -n emu-edt-b addr add 10.99.0.2/24 dev vb
+ip -n emu-edt-a link set va up
+ip -n emu-edt-b link set vb up
+ip -n emu-edt-a link set lo up
+ip -n emu-edt-b link set lo up
+
+# 与 ebpftc.AttachTC 相同的挂载方式: root fq + clsact egress
+ip netns exec emu-edt-a tc qdisc add dev va root handle 123: fq
+ip netns exec emu-edt-a tc qdisc add dev va clsact
+ip netns exec emu-edt-a tc filter add dev va egress bpf direct-action obj "$OBJ" sec tc_loss_bps
+
+IFINDEX=$(ip netns exec emu-edt-a cat /sys/class/net/va/ifindex)
+MAC=$(ip netns exec emu-edt-a cat /sys/class/net/va/address | tr ':' ' ')
+bpftool map update pinned "$MAP_DIR/MAC_HANDLE_EMU" \
+    key hex $(le32 "$IFINDEX") $MAC \
+    value hex $(handle_emu_hex "$RATE_BPS")
+
+ip netns exec emu-edt-b iperf3 -s -D -1
+sleep 1
+RESULT=$(ip netns exec emu-edt-a iperf3 -c 10.99.0.2 -P "$FLOWS" -t "$DURATION" -J)
+GOT=$(echo "$RESULT" | jq '.end.sum_received.bits_per_second | floor')
+
+DEV=$(( (GOT - RATE_BPS) * 100 / RATE_BPS ))
+echo "configured=${RATE_BPS}bps measured=${GOT}bps flows=${FLOWS} deviation=${DEV}%"
+if [ "${DEV#-}" -gt "$TOLERANCE" ]; then
+    echo "FAIL: deviation exceeds ${TOLERANCE}%"
+    exit 1
+fi
+echo "PASS"
@@ -12,6 +12,24 @@ import (
 // NetConf is the Cilium specific CNI network configuration
 type NetConf struct {
 	cniTypes.NetConf
+	// EmuMode 选择挂载的 TC 流水线变体: full(默认), loss, rate, delay
+	EmuMode string `json:"emuMode,omitempty"`
+	// EdtLockless 限速状态使用无原子指令的读改写，仅适用于单 CPU 发送的 veth
+	EdtLockless bool `json:"edtLockless,omitempty"`
+	// MaxEntries 规则表与按流状态表的容量，0 表示默认 65535；仅在节点首次加载 eBPF 对象时生效
+	MaxEntries uint32 `json:"maxEntries,omitempty"`
+	// IfaceTables 启用按接口分表的规则布局 (不支持 epoch 切换)
+	IfaceTables bool `json:"ifaceTables,omitempty"`
+	// DupMark 包复制时标记副本的 skb->mark 位，0 表示默认 0x00200000；须与集群其他组件使用的 mark 位错开
+	DupMark uint32 `json:"dupMark,omitempty"`
+	// Ingress 在 host veth 入口挂载上行程序，Pod 的上行/下行规则都写在其所在节点
+	Ingress bool `json:"ingress,omitempty"`
+	// AgentSocket 为 agent 的 unix socket 路径，空表示 /run/emunet/agent.sock；
+	// agent 可达时由其挂载 TC 程序并登记 Pod，否则 CNI 自行挂载并走 HTTP 登记
+	AgentSocket string `json:"agentSocket,omitempty"`
+	// XdpFastPath 在 host veth 上挂载 XDP 快速路径：同节点 Pod 间两个方向都无损伤的单播直接重定向，
+	// 带损伤的交给内核栈经过 TC 仿真；未开启的 Pod 不在转发表中，与其之间的流量照常走内核栈
+	XdpFastPath bool `json:"xdpFastPath,omitempty"`
 }
 
 func parsePrevResult(n *NetConf) (*NetConf, error) {
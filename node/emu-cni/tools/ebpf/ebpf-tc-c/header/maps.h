@@ -6,14 +6,75 @@ struct flow_key {
     unsigned char src_mac[ETH_ALEN];  // 源MAC地址
 } __attribute__((packed)); // 确保结构体按照实际大小对齐
 
+/*
+ * 入口方向 (Pod 发出) 的规则：ifindex 最高位置 1，src_mac 存放目的 MAC。
+ * 同一 veth 上的上行 (ingress) 与下行 (egress) 规则、限速状态与统计互不冲突
+ */
+#define FLOW_DIR_INGRESS (1U << 31)
+
+/*
+ * 按类 (L3/L4 分类) 的限速状态与统计：ifindex 第 20~29 位存放 class_id，
+ * 叠加模式再置第 30 位。因此 veth ifindex 须小于 1 << FLOW_CLASS_SHIFT
+ */
+#define FLOW_CLASS_SHIFT   20
+#define MAX_CLASSES        1024 // 0 号保留表示“未分类”
+#define FLOW_CLASS_MASK    ((MAX_CLASSES - 1) << FLOW_CLASS_SHIFT)
+#define FLOW_CLASS_STACKED (1U << 30)
+
+// ns_per_byte_fp 的定点小数位数，需与用户态 (pkg.RateFPShift) 保持一致
+#define RATE_FP_SHIFT 20
+
 // 使用typedef定义类型别名，便于在map定义中使用
+// v2 布局：64 位速率 + 用户态预计算的每字节耗时，热路径只需一次乘法和移位
 typedef struct handle_emu {
-    __u32 throttle_rate_bps;
+    __u64 throttle_rate_bps; // 单位：bps，0 表示不限速
+    __u64 ns_per_byte_fp; // 每字节传输耗时 (ns)，RATE_FP_SHIFT 位定点数
     __u32 delay; // 单位：0.01 ms
     __u32 loss_rate; // 单位：0.01%
     __u32 jitter; // 单位：0.01 ms
+    __u32 profile_id; // 非 0 时忽略以上参数，改用 EMU_PROFILES[profile_id]
+    // Gilbert-Elliott 突发丢包模型，ge_p 为 0 时按 loss_rate 独立丢包
+    __u32 ge_p;        // 单位：0.01%，好状态 -> 坏状态的逐包转移概率
+    __u32 ge_r;        // 单位：0.01%，坏状态 -> 好状态的逐包转移概率
+    __u32 ge_loss_bad; // 单位：0.01%，坏状态下的丢包率 (好状态下为 loss_rate)
+    // 瓶颈队列与 AQM，均以排队时延表示 (字节上限由用户态按速率换算)，仅在限速时生效
+    __u32 queue_limit_ns; // 队列上限 (ns)，超过则尾部丢包；0 表示只受 TIME_HORIZON_NS 限制
+    __u32 red_min_ns;     // RED 下限 (ns)，低于该排队时延不做早期丢包
+    __u32 red_max_ns;     // RED 上限 (ns)，0 表示不启用 RED
+    __u32 red_max_p;      // 单位：0.01%，排队时延达到 red_max_ns 时的丢包/标记概率
+    __u32 aqm_flags;      // AQM_F_*
+    __u32 group_id;       // 非 0 时本链路还经过 EMU_GROUP_AGG[group_id] 的共享瓶颈
+    __u32 trace_id;       // 非 0 时速率/时延/丢包率按 EMU_TRACE_META[trace_id] 描述的轨迹随时间变化
+    __u32 jitter_dist;    // JITTER_DIST_*，抖动分布
+    __u32 jitter_flags;   // JITTER_F_*
+    // netem 式的包级损伤
+    __u32 dup_rate;       // 单位：0.01%，复制一份经 bpf_clone_redirect 重新注入，副本独立限速与延迟
+    __u32 corrupt_rate;   // 单位：0.01%，翻转 TCP/UDP 载荷中的一个比特
+    __u32 reorder_rate;   // 单位：0.01%，被选中的包跳过时延抖动，从而越过前面被延迟的包
+    __u32 reorder_gap;    // 大于 1 时每 reorder_gap - 1 个包正常延迟后才考虑重排下一个 (同 netem gap)
+    __u32 impair_flags;   // IMPAIR_F_*
+    __u32 reserved;
 } HANDLE_EMU;
 
+// impair_flags：损坏后修正 L4 校验和，模拟接收方无法发现的损坏；默认令校验和失配
+#define IMPAIR_F_KEEP_CSUM (1 << 0)
+
+// aqm_flags：对 ECT 报文标记 CE 代替 RED 早期丢包；未启用 RED 时排队超过
+// red_min_ns (为 0 时取 ECN_HORIZON_NS) 即标记
+#define AQM_F_ECN (1 << 0)
+
+// jitter_dist：UNIFORM 在 [-jitter, jitter] 内均匀分布；其余分布以 jitter 为标准差，
+// 从 EMU_JITTER_DIST 中预计算的分位数表取样 (与 netem 的分布表思路一致)
+#define JITTER_DIST_UNIFORM 0
+#define JITTER_DIST_NORMAL  1
+#define JITTER_DIST_PARETO  2
+#define JITTER_DISTS        2    // 查表分布的数量 (不含 UNIFORM)
+#define JITTER_DIST_SIZE    4096 // 每张表的样本数，须为 2 的幂
+#define JITTER_DIST_SHIFT   13   // 表值为 1 << JITTER_DIST_SHIFT 定点的标准差倍数
+
+// jitter_flags：发送时间不早于同一链路上一个包，抖动不再造成乱序
+#define JITTER_F_ORDERED (1 << 0)
+
 // 修改映射键类型为复合键（网卡index + MAC地址）
 struct {
     __uint(type, BPF_MAP_TYPE_HASH);
@@ -23,19 +84,306 @@ struct {
     __uint(max_entries, 65535);
 } MAC_HANDLE_EMU SEC(".maps");
 
+/*
+ * 双缓冲规则表 (epoch 模式)：EMU_TABLES 的两个槽位各放一张与 MAC_HANDLE_EMU
+ * 结构相同的内层哈希表，由用户态创建并写满影子表后翻转 EMU_EPOCH，
+ * 所有 CPU 在下一个包即切换到新表，不会看到写了一半的拓扑。
+ */
+#define EMU_TABLE_SLOTS 2
+
+struct emu_table {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __type(key, struct flow_key);
+    __type(value, struct handle_emu);
+    __uint(max_entries, 65535);
+};
 
-/* flow_key => last_tstamp timestamp used */
 struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+    __type(key, __u32);
+    __uint(max_entries, EMU_TABLE_SLOTS);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __array(values, struct emu_table);
+} EMU_TABLES SEC(".maps");
+
+/*
+ * EMU_EPOCH[0]：0 表示直接使用 MAC_HANDLE_EMU (默认)，
+ * n > 0 表示使用 EMU_TABLES[(n - 1) & 1]
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, __u32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, 1);
+} EMU_EPOCH SEC(".maps");
+
+/*
+ * 按接口分表 (iface_tables = 1 时启用)：每个 veth ifindex 一张内层哈希表，
+ * 单表更小、局部性更好，Pod 删除时删掉外层一个元素即可整体回收其规则。
+ * 内层表由 agent 在该接口的第一条规则写入时创建。
+ */
+#define MAX_IFACE_TABLES    4096 // 每节点最多的 veth 数
+#define IFACE_TABLE_ENTRIES 4096 // 内层表模板容量，agent 创建内层表时可另行指定
+
+struct iface_table {
     __uint(type, BPF_MAP_TYPE_HASH);
+    __type(key, struct flow_key);
+    __type(value, struct handle_emu);
+    __uint(max_entries, IFACE_TABLE_ENTRIES);
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH_OF_MAPS);
+    __type(key, __u32);
+    __uint(max_entries, MAX_IFACE_TABLES);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // 仅在按接口分表时 pin，agent 据此识别布局
+    __array(values, struct iface_table);
+} EMU_IFACE_TABLES SEC(".maps");
+
+// 链路模板数量上限，0 号保留表示“不使用模板”
+#define MAX_PROFILES 4096
+
+/*
+ * profile_id => 链路参数模板 (value 复用 handle_emu，其 profile_id 字段忽略)。
+ * 绑定到同一模板的链路共享参数，改写一个数组元素即可批量调整这些链路。
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct handle_emu);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, MAX_PROFILES);
+} EMU_PROFILES SEC(".maps");
+
+
+// EDT 限速状态：多个 CPU 并发发送时通过原子 CAS 更新 last_tstamp
+struct edt_state {
+    __u64 last_tstamp; // 上一个包预计发送完成的时间 (ns)
+};
+
+/*
+ * flow_key => EDT 限速状态。按流状态均为 LRU：Pod 频繁创建删除时旧链路的状态被自动淘汰，
+ * 表满时插入不会失败；被淘汰的链路下一个包重新初始化状态，只损失一次排队历史
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
     __type(key, struct flow_key);    // 使用复合键
-    __type(value, uint64_t);
+    __type(value, struct edt_state);
     __uint(max_entries, 65535);
 } flow_map SEC(".maps");
 
+
+/*
+ * 轨迹回放 (Mahimahi 风格)：每条轨迹为等间隔的 (速率, 时延, 丢包率) 序列，
+ * 数据面按 (now - start_ns) / slot_ns 对长度取模定位当前点，循环播放。
+ * 轨迹 t 的第 i 个点位于 EMU_TRACE_POINTS[t * MAX_TRACE_POINTS + i]。
+ */
+#define MAX_TRACES       64   // 0 号保留表示不使用轨迹
+#define MAX_TRACE_POINTS 4096 // 单条轨迹的最大点数
+
+struct trace_meta {
+    __u64 start_ns; // 轨迹起点 (bpf_ktime_get_ns 时钟)
+    __u64 slot_ns;  // 每个点的持续时间
+    __u32 len;      // 点数，0 表示未加载
+    __u32 reserved;
+};
+
+struct trace_point {
+    __u64 ns_per_byte_fp; // 0 表示不限速
+    __u32 delay;          // 单位：0.01 ms
+    __u32 loss_rate;      // 单位：0.01%
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct trace_meta);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, MAX_TRACES);
+} EMU_TRACE_META SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct trace_point);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, MAX_TRACES * MAX_TRACE_POINTS);
+} EMU_TRACE_POINTS SEC(".maps");
+
+/*
+ * 抖动分布表：分布 d (JITTER_DIST_NORMAL 起) 的第 i 个样本位于
+ * EMU_JITTER_DIST[(d - 1) * JITTER_DIST_SIZE + i]，由加载器在加载时写入
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, __s32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, JITTER_DISTS * JITTER_DIST_SIZE);
+} EMU_JITTER_DIST SEC(".maps");
+
+/* flow_key => 自上次重排以来正常延迟的包数，reorder_gap > 1 时使用；与 loss_state 一样按 CPU 计数 */
 struct {
-	__uint(type, BPF_MAP_TYPE_PROG_ARRAY);
-	__uint(key_size, sizeof(uint32_t));
-	__uint(max_entries, 2);
-	__uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
-	__array(values, int ());
-} progs SEC(".maps");
\ No newline at end of file
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __type(key, struct flow_key);
+    __type(value, __u32);
+    __uint(max_entries, 65535);
+} reorder_state_map SEC(".maps");
+
+/* flow_key => 上一个包的发送时间，JITTER_F_ORDERED 使用 */
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __type(key, struct flow_key);
+    __type(value, struct edt_state);
+    __uint(max_entries, 65535);
+} jitter_state_map SEC(".maps");
+
+// 突发丢包模型的链路状态。per-CPU 存放，每个 CPU 独立演化一条马尔可夫链，
+// 热路径上无需原子操作；veth 发送通常固定在少数 CPU 上，突发特征基本保持
+struct loss_state {
+    __u32 bad; // 1 表示处于坏状态
+};
+
+/* flow_key => 突发丢包状态 */
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __type(key, struct flow_key);
+    __type(value, struct loss_state);
+    __uint(max_entries, 65535);
+} loss_state_map SEC(".maps");
+
+
+/*
+ * 聚合瓶颈：在链路限速之后，同一接口 (ifindex) 或同一组 (group_id) 的链路共享一个 EDT 队列，
+ * 用于模拟 Pod 接入链路或共享上行链路。配置由 agent 写入，限速状态只由数据面维护。
+ * 两者均为 ARRAY，未配置时热路径只多一次数组查找。
+ */
+#define MAX_IFACE_AGG 65536 // 支持的最大 ifindex + 1
+#define MAX_GROUP_AGG 4096  // 0 号保留表示不属于任何组
+
+struct agg_cfg {
+    __u64 throttle_rate_bps; // 0 表示未配置
+    __u64 ns_per_byte_fp;    // RATE_FP_SHIFT 位定点数，由用户态预计算
+    __u32 queue_limit_ns;    // 0 表示只受 TIME_HORIZON_NS 限制
+    __u32 reserved;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct agg_cfg);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, MAX_IFACE_AGG);
+} EMU_IFACE_AGG SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct agg_cfg);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, MAX_GROUP_AGG);
+} EMU_GROUP_AGG SEC(".maps");
+
+/* ifindex / group_id => 聚合瓶颈的 EDT 限速状态 */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct edt_state);
+    __uint(max_entries, MAX_IFACE_AGG);
+} iface_agg_state SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct edt_state);
+    __uint(max_entries, MAX_GROUP_AGG);
+} group_agg_state SEC(".maps");
+
+/*
+ * L3/L4 分类 (第二级查找)：按协议 + 端口、对端 IPv4 前缀或 DSCP 把包归入类，
+ * 类的参数取自 EMU_PROFILES[profile_id]。查找顺序为端口、前缀、DSCP，先命中者生效。
+ * 分类按接口与方向配置 (键中 ifindex 含 FLOW_DIR_INGRESS 位)，作用于该接口上的所有对端。
+ */
+#define CLASS_MODE_OVERRIDE 0 // 命中的包只按类参数处理，忽略 MAC 规则
+#define CLASS_MODE_STACK    1 // 先按 MAC 规则处理，再叠加类参数
+
+// EMU_CLASS_IFACES 中的标志位：该接口配置了哪些分类，均为 0 时跳过解析 IP 头
+#define CLASS_F_PORT          (1 << 0)
+#define CLASS_F_PREFIX        (1 << 1)
+#define CLASS_F_DSCP          (1 << 2)
+#define CLASS_F_MASK          0x7
+#define CLASS_F_INGRESS_SHIFT 4 // 入口方向的标志位左移 4 位存放
+
+// 端口规则的 dscp 与 DSCP 规则的 proto/port 均为 0
+struct class_key {
+    __u32 ifindex; // 含方向位
+    __u8  proto;   // IPPROTO_TCP / IPPROTO_UDP，DSCP 规则为 0
+    __u8  dscp;    // DSCP 值 (tos >> 2)，端口规则为 0
+    __u16 port;    // 主机字节序，源端口或目的端口任一匹配即命中
+};
+
+struct class_prefix_key {
+    __u32 prefixlen; // 32 (ifindex) + IPv4 前缀长度
+    __u32 ifindex;   // 含方向位
+    __u32 addr;      // 对端地址，网络字节序：出口方向为源地址，入口方向为目的地址
+};
+
+struct class_rule {
+    __u32 class_id;   // [1, MAX_CLASSES)，区分各类的限速状态与统计
+    __u32 profile_id; // [1, MAX_PROFILES)
+    __u32 mode;       // CLASS_MODE_*
+    __u32 reserved;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __type(key, struct class_key);
+    __type(value, struct class_rule);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, 16384);
+} EMU_CLASS_RULES SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LPM_TRIE);
+    __type(key, struct class_prefix_key);
+    __type(value, struct class_rule);
+    __uint(map_flags, BPF_F_NO_PREALLOC);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, 16384);
+} EMU_CLASS_PREFIXES SEC(".maps");
+
+// ifindex => CLASS_F_* (含两个方向)，由 agent 在分类增删后重算
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, __u32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, MAX_IFACE_AGG);
+} EMU_CLASS_IFACES SEC(".maps");
+
+
+// 每条链路的统计信息，per-CPU 计数，由 agent 周期性批量读取并聚合
+struct link_stats {
+    __u64 packets;         // 命中规则的包数
+    __u64 bytes;           // 命中规则的字节数
+    __u64 loss_drops;      // 随机丢包
+    __u64 horizon_drops;   // 排队超过 TIME_HORIZON_NS 丢弃
+    __u64 error_drops;     // map 更新失败丢弃 (按流状态改为 LRU 后不再发生，保留以兼容统计格式)
+    __u64 delay_ns;        // 累计注入的时延 (限速排队 + 时延抖动)
+    __u64 queue_drops;     // 超过 queue_limit_ns 尾部丢弃
+    __u64 aqm_drops;       // RED 早期丢弃
+    __u64 ecn_marks;       // 标记 CE 的报文
+    __u64 agg_drops;       // 接口/组聚合瓶颈排队溢出丢弃
+    __u64 dup_packets;     // 复制出的副本
+    __u64 corrupt_packets; // 被翻转比特的报文
+    __u64 reorder_packets; // 跳过时延抖动而被重排的报文
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __type(key, struct flow_key);
+    __type(value, struct link_stats);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name (accessible under /sys/fs/bpf/<name>)
+    __uint(max_entries, 65535);
+} LINK_STATS SEC(".maps");
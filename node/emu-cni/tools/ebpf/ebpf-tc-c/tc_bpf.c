@@ -6,6 +6,7 @@
 #include <linux/ip.h>
 #include <linux/pkt_cls.h>
 #include <linux/tcp.h>
+#include <linux/udp.h>
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_endian.h>
 #include "header/helpers.h"
@@ -18,149 +19,753 @@
 #define NS_PER_MS 1000000
 #define NS_PER_0_0_1_MS 10000
 #define PKT_LOSS_SCOPE 10000
+// 抖动上限，保证均匀分布的乘法映射不溢出 (2 * MAX_JITTER_NS + 1 < 2^32)
+#define MAX_JITTER_NS ((1ULL << 31) - 1)
+// IP 头 TOS 字段低 2 位 (RFC 3168)
+#define INET_ECN_MASK    3
+#define INET_ECN_NOT_ECT 0
+#define INET_ECN_CE      3
+// CAS 竞争失败后的重试次数，耗尽后退化为 fetch_add 直接预约发送时间
+#define EDT_CAS_RETRIES 4
 
-static inline int inject_delay_jitter(struct __sk_buff *skb, uint32_t *delay, uint32_t *jitter) { // 参数名从delay_ms改为delay
-    uint64_t delay_ns;
-    uint64_t jitter_ns;
-    uint64_t now = bpf_ktime_get_ns();
-    // 单位转换：0.01ms -> ns = *delay * 10000ns (因为1ms=1,000,000ns，所以0.01ms=10,000ns)
-    delay_ns = (*delay) * NS_PER_0_0_1_MS; // 0.01ms = 10,000ns 
-    // 单位转换：0.01ms -> ns = *jitter * 10000ns (因为1ms=1,000,000ns，所以0.01ms=10,000ns)
-    jitter_ns = (*jitter) * NS_PER_0_0_1_MS; // 0.01ms = 10,000ns 
-    uint64_t ts = skb->tstamp;
-    
-    // 生成不定正负的随机抖动：[-jitter_ns, jitter_ns]
-    int64_t random_jitter = 0;
+/*
+ * 加载期常量 (.rodata)，由 ebpftc.InitWithOptions 在加载前设置，
+ * verifier 会据此裁剪掉未使用的分支。
+ * edt_lockless = 1 时限速状态使用普通读改写，仅适用于单 CPU 发送的 veth。
+ */
+volatile const __u32 edt_lockless = 0;
+// iface_tables = 1 时规则按 ifindex 分表存放于 EMU_IFACE_TABLES (不支持 epoch 切换)
+volatile const __u32 iface_tables = 0;
+// 包复制时给副本打的 skb->mark 位：副本重新经过本程序时据此跳过复制并清除该位，不得与集群网络组件的 mark 冲突
+volatile const __u32 dup_mark = 0x00200000;
+
+/*
+ * 流水线阶段位：作为编译期常量传入 emu_pipeline，
+ * 未启用的阶段会被编译器整体裁剪，从而生成专用的程序变体。
+ */
+#define EMU_STAGE_LOSS  (1 << 0)
+#define EMU_STAGE_RATE  (1 << 1)
+#define EMU_STAGE_DELAY (1 << 2)
+#define EMU_STAGE_ALL   (EMU_STAGE_LOSS | EMU_STAGE_RATE | EMU_STAGE_DELAY)
+// 方向位：挂在 host veth 入口，按目的 MAC 匹配 Pod 发出的包 (上行)
+#define EMU_DIR_INGRESS (1 << 3)
+
+// 各阶段的处理结果，非 EMU_PASS 时由 emu_pipeline 记入 LINK_STATS 并丢包
+enum emu_verdict {
+    EMU_PASS = 0,
+    EMU_DROP_LOSS,    // 随机丢包
+    EMU_DROP_HORIZON, // 排队超过 TIME_HORIZON_NS
+    EMU_DROP_ERROR,   // map 更新失败
+    EMU_DROP_QUEUE,   // 排队超过 queue_limit_ns (尾部丢包)
+    EMU_DROP_AQM,     // RED 早期丢包
+    EMU_DROP_AGG,     // 接口/组聚合瓶颈排队溢出
+};
+
+/*
+ * jitter_sample 按链路的抖动分布生成一个有符号抖动 (ns)。
+ * UNIFORM 用乘法取高 32 位把随机数映射到 [0, 2 * jitter_ns]，避免 64 位取模且偏差可忽略；
+ * 其余分布查预计算的分位数表，表未加载时 (全 0) 不产生抖动
+ */
+static __always_inline __s64 jitter_sample(const struct handle_emu *val, __u64 jitter_ns)
+{
+    __u32 rand = bpf_get_prandom_u32();
+
+    if (jitter_ns > MAX_JITTER_NS)
+        jitter_ns = MAX_JITTER_NS;
+
+    __u32 dist = val->jitter_dist;
+    if (dist == JITTER_DIST_UNIFORM || dist > JITTER_DISTS) {
+        return (__s64)(((__u64)rand * (2 * jitter_ns + 1)) >> 32) - (__s64)jitter_ns;
+    }
+
+    __u32 idx = (dist - 1) * JITTER_DIST_SIZE + (rand & (JITTER_DIST_SIZE - 1));
+    __s32 *sample = bpf_map_lookup_elem(&EMU_JITTER_DIST, &idx);
+    if (!sample)
+        return 0;
+    return ((__s64)jitter_ns * *sample) >> JITTER_DIST_SHIFT;
+}
+
+static __always_inline int inject_delay_jitter(struct __sk_buff *skb, struct flow_key *key,
+                                               const struct handle_emu *val, __u64 now)
+{
+    // 单位转换：0.01ms -> ns = delay * 10000ns (因为1ms=1,000,000ns，所以0.01ms=10,000ns)
+    __u64 delay_ns = (__u64)val->delay * NS_PER_0_0_1_MS;
+    // 单位转换：0.01ms -> ns = jitter * 10000ns
+    __u64 jitter_ns = (__u64)val->jitter * NS_PER_0_0_1_MS;
+    __u64 ts = skb->tstamp;
+
+    __s64 random_jitter = 0;
     if (jitter_ns > 0) {
-        // 使用bpf_get_prandom_u32()生成随机数
-        __u32 rand = bpf_get_prandom_u32();
-        // 转换为[-jitter_ns, jitter_ns]的范围
-        random_jitter = (int64_t)(rand % (2 * jitter_ns + 1)) - jitter_ns;
-    }
-    
-    uint64_t new_ts = 0;
-    if (ts == 0) {
-        // 第一次收到包，使用当前时间作为基准
-        new_ts = now + delay_ns + random_jitter;
-    } else {
-        // 否则在原有时间基础上添加延迟和抖动
-        new_ts = ts + delay_ns + random_jitter;
+        random_jitter = jitter_sample(val, jitter_ns);
+    }
+
+    // 第一次收到包 (未经限速) 时以当前时间为基准，否则在原有时间基础上添加延迟和抖动
+    __u64 base = ts ? ts : now;
+    __s64 new_ts = (__s64)(base + delay_ns) + random_jitter;
+    if (new_ts < 0) {
+        new_ts = 0;
+    }
+
+    // 保序模式：不早于上一个包的发送时间，fq 按 tstamp 出队时同一链路的包不会被抖动打乱
+    if (val->jitter_flags & JITTER_F_ORDERED) {
+        struct edt_state *st = bpf_map_lookup_elem(&jitter_state_map, key);
+        if (!st) {
+            struct edt_state init = {};
+            bpf_map_update_elem(&jitter_state_map, key, &init, BPF_NOEXIST);
+            st = bpf_map_lookup_elem(&jitter_state_map, key);
+        }
+        if (st) {
+            if ((__u64)new_ts < st->last_tstamp) {
+                new_ts = (__s64)st->last_tstamp;
+            }
+            st->last_tstamp = (__u64)new_ts;
+        }
     }
 
     // 设置新的时间戳
-    skb->tstamp = new_ts;
+    skb->tstamp = (__u64)new_ts;
 
-    return TC_ACT_OK;
+    return EMU_PASS;
 }
 
 /*
- * For some reason section names need to start with "tc"
- * TODO: Remove duplicate header parsing code
+ * loss_decide 返回本包是否应被丢弃。
+ * ge_p 为 0 时为独立丢包；否则先按 Gilbert-Elliott 两状态马尔可夫链转移状态，
+ * 再按所处状态的丢包率决定，突发丢包无需控制面高频改写规则。
+ */
+static __always_inline int loss_decide(struct flow_key *key, const struct handle_emu *val)
+{
+    __u32 loss_rate = val->loss_rate;
+
+    if (val->ge_p) {
+        struct loss_state *st = bpf_map_lookup_elem(&loss_state_map, key);
+        if (!st) {
+            struct loss_state init = {};
+            bpf_map_update_elem(&loss_state_map, key, &init, BPF_NOEXIST);
+            st = bpf_map_lookup_elem(&loss_state_map, key);
+        }
+        if (st) {
+            __u32 rand_state = bpf_get_prandom_u32() % PKT_LOSS_SCOPE;
+            if (st->bad) {
+                if (rand_state < val->ge_r)
+                    st->bad = 0;
+            } else if (rand_state < val->ge_p) {
+                st->bad = 1;
+            }
+            if (st->bad)
+                loss_rate = val->ge_loss_bad;
+        }
+    }
+
+    if (loss_rate == 0)
+        return 0;
+    return bpf_get_prandom_u32() % PKT_LOSS_SCOPE < loss_rate;
+}
+
+/*
+ * ecn_mark 把 IPv4 ECT 报文的 ECN 字段改为 CE 并增量更新校验和。
+ * 返回 1 表示报文已带 CE 标记；非 IPv4 或 Not-ECT 报文返回 0，由调用方改为丢包
  */
-SEC("tc_delay_jitter")
-int delay_jitter(struct __sk_buff *skb)
+static __always_inline int ecn_mark(struct __sk_buff *skb)
 {
-    // data_end is a void* to the end of the packet. Needs weird casting due to kernel weirdness.
     void *data_end = (void *)(unsigned long long)skb->data_end;
-    // data is a void* to the beginning of the packet. Also needs weird casting.
     void *data = (void *)(unsigned long long)skb->data;
+    struct hdr_cursor nh = { .pos = data };
+    struct ethhdr *eth;
+    struct iphdr *iph = 0;
 
-    // nh keeps track of the beginning of the next header to parse
-    struct hdr_cursor nh;
+    if (parse_ethhdr(&nh, data_end, &eth) != bpf_htons(ETH_P_IP))
+        return 0;
+    parse_iphdr(&nh, data_end, &iph);
+    if (!iph)
+        return 0;
 
-    struct ethhdr *eth;
+    __u8 ecn = iph->tos & INET_ECN_MASK;
+    if (ecn == INET_ECN_NOT_ECT)
+        return 0;
+    if (ecn == INET_ECN_CE)
+        return 1;
 
-    // start parsing at beginning of data
-    nh.pos = data;
+    // tos 与 version/ihl 同在首个 16 位字中，按该字做增量校验和
+    __u32 csum_off = (void *)&iph->check - data;
+    __u16 old_word = *(__u16 *)iph;
+    iph->tos |= INET_ECN_CE;
+    __u16 new_word = *(__u16 *)iph;
+    bpf_l3_csum_replace(skb, csum_off, old_word, new_word, sizeof(__u16));
+    return 1;
+}
 
-    // parse ethernet header only to get source MAC address
-    if (parse_ethhdr(&nh, data_end, &eth) == TC_ACT_SHOT) {
-        return TC_ACT_SHOT;
+/*
+ * aqm_check 按当前排队时延 backlog 执行 RED (时间域阈值) 与 ECN 标记。
+ * [red_min_ns, red_max_ns) 区间内概率从 0 线性增至 red_max_p，
+ * 命中时 ECT 报文标记 CE，其余早期丢弃；达到 red_max_ns 时一律丢弃。
+ */
+static __always_inline int aqm_check(struct __sk_buff *skb, const struct handle_emu *val,
+                                     __u64 backlog, struct link_stats *stats)
+{
+    __u64 min_ns = val->red_min_ns;
+    __u64 max_ns = val->red_max_ns;
+    int ecn = val->aqm_flags & AQM_F_ECN;
+
+    if (!max_ns) {
+        // 仅启用 ECN：超过阈值的 ECT 报文标记 CE，不做早期丢包
+        if (!min_ns)
+            min_ns = ECN_HORIZON_NS;
+        if (ecn && backlog > min_ns && ecn_mark(skb) && stats)
+            stats->ecn_marks++;
+        return EMU_PASS;
     }
-    
-    // 创建复合键：网卡index + 源MAC地址
-    struct flow_key key;
-    key.ifindex = skb->ifindex;  // 获取当前网卡index
-    bpf_probe_read_kernel(key.src_mac, ETH_ALEN, eth->h_source);
-    
-    uint32_t *delay;
-    uint32_t *jitter; // 新增字段：抖动
-    struct handle_emu *val_struct;
-    // Map lookup - 使用复合键
-    val_struct = bpf_map_lookup_elem(&MAC_HANDLE_EMU, &key);
 
-    // Safety check, go on if no handle could be retrieved
-    if (!val_struct) {
-        return TC_ACT_OK;
+    if (backlog <= min_ns)
+        return EMU_PASS;
+    if (backlog < max_ns) {
+        __u64 p = (val->red_max_p * (backlog - min_ns)) / (max_ns - min_ns);
+        if (bpf_get_prandom_u32() % PKT_LOSS_SCOPE >= p)
+            return EMU_PASS;
+        if (ecn && ecn_mark(skb)) {
+            if (stats)
+                stats->ecn_marks++;
+            return EMU_PASS;
+        }
     }
+    return EMU_DROP_AQM;
+}
 
-    delay = &val_struct->delay; // 字段名从delay_ms改为delay
-    // Safety check, go on if no handle could be retrieved
-    if (!delay) {
-        return TC_ACT_OK;
+/*
+ * edt_next 根据上一个包的完成时间计算本包的发送时间与新的完成时间。
+ * 返回 0 表示无需排队 (depart = 0，不修改 skb->tstamp)，
+ * 返回 -1 表示排队超过 limit_ns (队列上限或 TIME_HORIZON_NS)，需要丢包。
+ */
+static __always_inline int edt_next(__u64 last, __u64 tstamp, __u64 now, __u64 delay_ns, __u64 limit_ns,
+                                    __u64 *new_last, __u64 *depart)
+{
+    __u64 next_tstamp = last + delay_ns;
+
+    // 如果计算出的发送时间在“现在”之前（即不需要排队）
+    if (next_tstamp <= tstamp) {
+        // 即使立即发送，也要把状态更新为“该包发送完成的时间”，防止突发；
+        // 重置时间窗口到 tstamp + delay，避免长时间空闲后积累过多 credit
+        *new_last = tstamp + delay_ns;
+        *depart = 0;
+        return 0;
     }
 
-    jitter = &val_struct->jitter; // 新增字段：抖动
-    // Safety check, go on if no handle could be retrieved
-    if (!jitter) {
-        return TC_ACT_OK;
+    // 防止队列积压过大（超过队列上限或 2 秒的包直接丢弃）
+    if (next_tstamp - now >= limit_ns)
+        return -1;
+
+    // 告诉下一个包，你最早只能在 next_tstamp 之后发
+    *new_last = next_tstamp;
+    *depart = next_tstamp;
+    return 0;
+}
+
+/*
+ * edt_reserve 在 st 上为本包预约发送时间，成功时 depart 为本包的发送时间 (0 表示无需排队)，
+ * 返回 -1 表示排队超过 limit_ns。lockless 为 1 时使用普通读改写，否则 CAS 更新 last_tstamp
+ */
+static __always_inline int edt_reserve(struct edt_state *st, __u64 tstamp, __u64 now, __u64 delay_ns,
+                                       __u64 limit_ns, int lockless, __u64 *depart)
+{
+    __u64 new_last = 0;
+
+    if (lockless) {
+        // 无锁模式：普通读改写，热路径上没有原子指令
+        if (edt_next(st->last_tstamp, tstamp, now, delay_ns, limit_ns, &new_last, depart))
+            return -1;
+        st->last_tstamp = new_last;
+        return 0;
+    }
+
+    // 并发模式：CAS 更新 last_tstamp，保证多 CPU 发送时预约不丢失
+#pragma unroll
+    for (int i = 0; i < EDT_CAS_RETRIES; i++) {
+        __u64 last = *(volatile __u64 *)&st->last_tstamp;
+        if (edt_next(last, tstamp, now, delay_ns, limit_ns, &new_last, depart))
+            return -1;
+        if (__sync_val_compare_and_swap(&st->last_tstamp, last, new_last) == last)
+            return 0;
+    }
+
+    // 竞争激烈时链路必然处于排队状态，直接原子地追加本包的传输时间
+    *depart = __sync_fetch_and_add(&st->last_tstamp, delay_ns) + delay_ns;
+    if (*depart - now >= limit_ns) {
+        // 丢弃的包归还已预约的传输时间
+        __sync_fetch_and_sub(&st->last_tstamp, delay_ns);
+        return -1;
+    }
+    return 0;
+}
+
+// queue_limit 返回有限队列的上限，未配置时仍以 TIME_HORIZON_NS 兜底
+static __always_inline __u64 queue_limit(__u32 queue_limit_ns)
+{
+    if (queue_limit_ns && queue_limit_ns < TIME_HORIZON_NS)
+        return queue_limit_ns;
+    return TIME_HORIZON_NS;
+}
+
+// throttle_link 为单条链路 (flow_key) 的 EDT 限速
+static __always_inline int throttle_link(struct __sk_buff *skb, struct flow_key *key, const struct handle_emu *val,
+                                         __u64 tstamp, __u64 now, struct link_stats *stats, __u64 *depart)
+{
+    // 传输耗时 = 字节数 * 每字节耗时 (定点数)，避免每包一次 64 位除法
+    uint64_t delay_ns = (((uint64_t)skb->len) * val->ns_per_byte_fp) >> RATE_FP_SHIFT;
+
+    struct edt_state *st = bpf_map_lookup_elem(&flow_map, key);
+    if (!st) {
+        // 第一次收到包：本包立即发送，状态初始化为本包发送完成时间。
+        // 使用 BPF_NOEXIST，若其他 CPU 抢先创建则回到下面的并发更新路径
+        struct edt_state init = { .last_tstamp = tstamp + delay_ns };
+        if (bpf_map_update_elem(&flow_map, key, &init, BPF_NOEXIST) == 0)
+            return EMU_PASS;
+        st = bpf_map_lookup_elem(&flow_map, key);
+        // 刚插入即被 LRU 淘汰 (极端抢占) 时本包不限速放行，数据面不因 map 压力丢包
+        if (!st)
+            return EMU_PASS;
     }
 
-    return inject_delay_jitter(skb, delay, jitter);
+    // 有限队列：超过上限尾部丢弃
+    __u64 limit_ns = queue_limit(val->queue_limit_ns);
+    int overflow = limit_ns < TIME_HORIZON_NS ? EMU_DROP_QUEUE : EMU_DROP_HORIZON;
+
+    // AQM 按入队前的排队时延判定，用一次普通读取即可 (概率判定不要求精确)
+    if (val->red_max_ns || (val->aqm_flags & AQM_F_ECN)) {
+        __u64 last = *(volatile __u64 *)&st->last_tstamp;
+        int verdict = aqm_check(skb, val, last > now ? last - now : 0, stats);
+        if (verdict != EMU_PASS)
+            return verdict;
+    }
+
+    if (edt_reserve(st, tstamp, now, delay_ns, limit_ns, edt_lockless, depart))
+        return overflow;
+    return EMU_PASS;
 }
 
-static inline int throttle_flow(struct __sk_buff *skb, struct flow_key *key, uint32_t *throttle_rate_bps)
+/*
+ * throttle_aggregate 让本包离开上一级队列后再经过一个共享瓶颈 (接口或组)。
+ * cfg 未配置 (速率为 0) 时直接通过；tstamp 为进入本级的时间，排队时被推迟
+ */
+static __always_inline int throttle_aggregate(struct __sk_buff *skb, const struct agg_cfg *cfg, struct edt_state *st,
+                                              int lockless, __u64 now, __u64 *tstamp, __u64 *depart)
 {
-    uint64_t *last_tstamp = bpf_map_lookup_elem(&flow_map, key);
-    
-    // 修正1：单位换算，字节转比特 (* 8)
-    uint64_t delay_ns = ((uint64_t)skb->len) * 8 * NS_PER_SEC / *throttle_rate_bps;
+    if (!cfg || !st || !cfg->ns_per_byte_fp)
+        return EMU_PASS;
+
+    __u64 delay_ns = (((__u64)skb->len) * cfg->ns_per_byte_fp) >> RATE_FP_SHIFT;
+    __u64 agg_depart = 0;
+    if (edt_reserve(st, *tstamp, now, delay_ns, queue_limit(cfg->queue_limit_ns), lockless, &agg_depart))
+        return EMU_DROP_AGG;
+    if (agg_depart) {
+        *tstamp = agg_depart;
+        *depart = agg_depart;
+    }
+    return EMU_PASS;
+}
+
+/*
+ * throttle_flow 为分层限速：链路 (flow_key) -> 接口 (ifindex) -> 组 (group_id)，
+ * 每一级都是独立的 EDT 队列，本包的发送时间为最后一级给出的时间。
+ * 未配置的层级只有一次数组查找的开销。
+ */
+static __always_inline int throttle_flow(struct __sk_buff *skb, struct flow_key *key, const struct handle_emu *val, __u64 now,
+                                         struct link_stats *stats)
+{
+    __u64 tstamp = skb->tstamp;
 
-    uint64_t now = bpf_ktime_get_ns();
-    uint64_t tstamp = skb->tstamp;
-    
     // 如果 skb->tstamp 是 0 或者旧时间，修正为当前时间
     if (tstamp < now)
         tstamp = now;
 
-    uint64_t next_tstamp = 0;
+    __u64 depart = 0;
+
+    if (val->ns_per_byte_fp > 0) {
+        int verdict = throttle_link(skb, key, val, tstamp, now, stats, &depart);
+        if (verdict != EMU_PASS)
+            return verdict;
+        if (depart)
+            tstamp = depart;
+    }
+
+    // 接口级聚合：同一 veth 上所有链路共享，与链路状态处于相同的发送 CPU 条件。
+    // 只作用于下行 (入口方向的 ifindex 带 FLOW_DIR_INGRESS 位，超出范围)，共享上行用 group_id 表示。
+    // 覆盖模式的分类仍经过接口聚合；叠加模式的分类带 FLOW_CLASS_STACKED 位，不重复计入
+    __u32 ifindex = key->ifindex & ~FLOW_CLASS_MASK;
+    if (ifindex < MAX_IFACE_AGG) {
+        struct agg_cfg *cfg = bpf_map_lookup_elem(&EMU_IFACE_AGG, &ifindex);
+        if (cfg && cfg->ns_per_byte_fp) {
+            struct edt_state *st = bpf_map_lookup_elem(&iface_agg_state, &ifindex);
+            int verdict = throttle_aggregate(skb, cfg, st, edt_lockless, now, &tstamp, &depart);
+            if (verdict != EMU_PASS)
+                return verdict;
+        }
+    }
+
+    // 组级聚合：跨接口共享，必然存在多 CPU 并发，始终使用 CAS
+    __u32 group_id = val->group_id;
+    if (group_id && group_id < MAX_GROUP_AGG) {
+        struct agg_cfg *cfg = bpf_map_lookup_elem(&EMU_GROUP_AGG, &group_id);
+        if (cfg && cfg->ns_per_byte_fp) {
+            struct edt_state *st = bpf_map_lookup_elem(&group_agg_state, &group_id);
+            int verdict = throttle_aggregate(skb, cfg, st, 0, now, &tstamp, &depart);
+            if (verdict != EMU_PASS)
+                return verdict;
+        }
+    }
+
+    // 设置 skb 的发送时间，fq qdisc 会看到这个时间并挂起数据包
+    if (depart)
+        skb->tstamp = depart;
+
+    return EMU_PASS;
+}
+
+// emu_rule_lookup 按布局与当前 epoch 选择规则表并查找链路规则
+static __always_inline struct handle_emu *emu_rule_lookup(struct flow_key *key)
+{
+    if (iface_tables) {
+        __u32 ifindex = key->ifindex;
+        void *table = bpf_map_lookup_elem(&EMU_IFACE_TABLES, &ifindex);
+        if (!table)
+            return 0;
+        return bpf_map_lookup_elem(table, key);
+    }
+
+    __u32 zero = 0;
+    __u32 *epoch = bpf_map_lookup_elem(&EMU_EPOCH, &zero);
+
+    if (epoch && *epoch) {
+        __u32 slot = (*epoch - 1) & (EMU_TABLE_SLOTS - 1);
+        void *table = bpf_map_lookup_elem(&EMU_TABLES, &slot);
+        if (!table)
+            return 0;
+        return bpf_map_lookup_elem(table, key);
+    }
+    return bpf_map_lookup_elem(&MAC_HANDLE_EMU, key);
+}
+
+/*
+ * trace_apply 取出轨迹在 now 时刻的点，与链路其余参数合成到 out。
+ * 轨迹未加载时返回 0，链路按原参数处理
+ */
+static __always_inline int trace_apply(const struct handle_emu *val, __u32 trace_id, __u64 now,
+                                       struct handle_emu *out)
+{
+    if (trace_id >= MAX_TRACES)
+        return 0;
+    struct trace_meta *meta = bpf_map_lookup_elem(&EMU_TRACE_META, &trace_id);
+    if (!meta || !meta->len || !meta->slot_ns || meta->len > MAX_TRACE_POINTS)
+        return 0;
+
+    __u64 elapsed = now > meta->start_ns ? now - meta->start_ns : 0;
+    __u32 idx = trace_id * MAX_TRACE_POINTS + (__u32)((elapsed / meta->slot_ns) % meta->len);
+    struct trace_point *pt = bpf_map_lookup_elem(&EMU_TRACE_POINTS, &idx);
+    if (!pt)
+        return 0;
+
+    __builtin_memcpy(out, val, sizeof(*out));
+    out->ns_per_byte_fp = pt->ns_per_byte_fp;
+    out->delay = pt->delay;
+    out->loss_rate = pt->loss_rate;
+    return 1;
+}
 
-    if (last_tstamp) {
-        next_tstamp = *last_tstamp + delay_ns;
+// link_stats_get 返回当前 CPU 上该链路的统计槽位，首次命中时创建
+static __always_inline struct link_stats *link_stats_get(struct flow_key *key)
+{
+    struct link_stats *stats = bpf_map_lookup_elem(&LINK_STATS, key);
+    if (stats)
+        return stats;
+
+    struct link_stats zero = {};
+    bpf_map_update_elem(&LINK_STATS, key, &zero, BPF_NOEXIST);
+    return bpf_map_lookup_elem(&LINK_STATS, key);
+}
+
+// emu_drop 记录丢包原因并返回 TC_ACT_SHOT
+static __always_inline int emu_drop(struct link_stats *stats, int verdict)
+{
+    if (stats) {
+        if (verdict == EMU_DROP_LOSS)
+            stats->loss_drops++;
+        else if (verdict == EMU_DROP_HORIZON)
+            stats->horizon_drops++;
+        else if (verdict == EMU_DROP_QUEUE)
+            stats->queue_drops++;
+        else if (verdict == EMU_DROP_AQM)
+            stats->aqm_drops++;
+        else if (verdict == EMU_DROP_AGG)
+            stats->agg_drops++;
+        else
+            stats->error_drops++;
+    }
+    return TC_ACT_SHOT;
+}
+
+/*
+ * emu_duplicate 以 dup_rate 的概率复制本包：副本经 bpf_clone_redirect 重新送入同一设备的同一方向，
+ * 再次经过本程序 (不再复制)，独立地限速与延迟。副本的 tstamp 恢复为进入流水线时的值，
+ * 避免叠加分类时把已注入的时延带入副本
+ */
+static __always_inline void emu_duplicate(struct __sk_buff *skb, const struct handle_emu *val, const __u32 stages,
+                                          __u64 tstamp0, struct link_stats *stats)
+{
+    if (bpf_get_prandom_u32() % PKT_LOSS_SCOPE >= val->dup_rate)
+        return;
+
+    __u32 mark = skb->mark;
+    __u64 tstamp = skb->tstamp;
+    skb->mark = mark | dup_mark;
+    skb->tstamp = tstamp0;
+    long err = bpf_clone_redirect(skb, skb->ifindex, (stages & EMU_DIR_INGRESS) ? BPF_F_INGRESS : 0);
+    skb->mark = mark;
+    skb->tstamp = tstamp;
+    if (!err && stats)
+        stats->dup_packets++;
+}
+
+/*
+ * emu_corrupt 以 corrupt_rate 的概率翻转 IPv4 TCP/UDP 载荷中随机 16 位字的一个比特，其余报文不处理。
+ * 校验和按改动的字增量调整：默认把校验和朝相反方向调整，无论 skb 是否由后续 (网卡/veth 对端) 计算校验和，
+ * 接收方都会发现失配而丢弃；IMPAIR_F_KEEP_CSUM 时按改动修正校验和，损坏数据被当作正常数据交付
+ */
+static __always_inline void emu_corrupt(struct __sk_buff *skb, const struct handle_emu *val, struct link_stats *stats)
+{
+    if (bpf_get_prandom_u32() % PKT_LOSS_SCOPE >= val->corrupt_rate)
+        return;
+
+    void *data_end = (void *)(unsigned long long)skb->data_end;
+    void *data = (void *)(unsigned long long)skb->data;
+    struct hdr_cursor nh = { .pos = data };
+    struct ethhdr *eth;
+    struct iphdr *iph = 0;
+
+    if (parse_ethhdr(&nh, data_end, &eth) != bpf_htons(ETH_P_IP))
+        return;
+    parse_iphdr(&nh, data_end, &iph);
+    if (!iph || (iph->frag_off & bpf_htons(0x1fff | 0x2000)))
+        return;
+
+    __u32 l4_off = nh.pos - data;
+    __u32 l4_len = bpf_ntohs(iph->tot_len) - iph->ihl * 4;
+    __u32 hdr_len, csum_off;
+    __u64 flags = 2; // 校验和按 16 位字调整
+    if (iph->protocol == IPPROTO_TCP) {
+        struct tcphdr *tcp = nh.pos;
+        if ((void *)(tcp + 1) > data_end)
+            return;
+        hdr_len = tcp->doff * 4;
+        if (hdr_len < sizeof(*tcp))
+            return;
+        csum_off = (void *)&tcp->check - data;
+    } else if (iph->protocol == IPPROTO_UDP) {
+        struct udphdr *udp = nh.pos;
+        if ((void *)(udp + 1) > data_end)
+            return;
+        hdr_len = sizeof(*udp);
+        csum_off = (void *)&udp->check - data;
+        flags |= BPF_F_MARK_MANGLED_0; // 未启用校验和 (0) 的 UDP 保持为 0
     } else {
-        // 第一次收到包，基准是当前时间 + 传输耗时
-        next_tstamp = tstamp + delay_ns;
+        return;
     }
+    if (l4_len > 0xffff || l4_len < hdr_len + 2)
+        return;
 
-    // 如果计算出的发送时间在“现在”之前（即不需要排队），或者只是轻微排队
-    if (next_tstamp <= tstamp) {
-        // 即使立即发送，也要更新 map 为“该包发送完成的时间”，防止突发
-        // 修正3：使用 next_tstamp (即 last + delay) 而不是 tstamp (now)
-        // 这里的逻辑稍微调整：如果拥塞并不严重，我们重置时间窗口到 now + delay，避免长时间空闲后积累过多 credit
-        uint64_t new_base = tstamp + delay_ns; 
-        bpf_map_update_elem(&flow_map, key, &new_base, BPF_ANY);
-        
-        bpf_tail_call(skb, &progs, 0);
-        return TC_ACT_OK;
+    // L4 头长度为偶数，相对 L4 起点的偶数偏移保证改动落在校验和的同一个 16 位字内
+    __u32 words = (l4_len - hdr_len) / 2;
+    __u32 off = l4_off + hdr_len + (bpf_get_prandom_u32() % words) * 2;
+    __u16 old_word, new_word;
+    if (bpf_skb_load_bytes(skb, off, &old_word, sizeof(old_word)))
+        return;
+    new_word = old_word ^ (__u16)(1 << (bpf_get_prandom_u32() & 15));
+    if (bpf_skb_store_bytes(skb, off, &new_word, sizeof(new_word), BPF_F_RECOMPUTE_CSUM))
+        return;
+
+    if (val->impair_flags & IMPAIR_F_KEEP_CSUM)
+        bpf_l4_csum_replace(skb, csum_off, old_word, new_word, flags);
+    else
+        // 由后续计算校验和 (CHECKSUM_PARTIAL) 时，反向调整伪首部种子使最终结果对应原数据；
+        // 否则校验和字段被反向调整两倍偏差，同样失配
+        bpf_l4_csum_replace(skb, csum_off, new_word, old_word, flags | BPF_F_PSEUDO_HDR);
+    if (stats)
+        stats->corrupt_packets++;
+}
+
+/*
+ * reorder_decide 返回本包是否跳过时延抖动 (重排)，语义同 netem 的 reorder/gap：
+ * reorder_gap > 1 时，每 reorder_gap - 1 个包正常延迟之后，下一个包才以 reorder_rate 的概率被重排
+ */
+static __always_inline int reorder_decide(struct flow_key *key, const struct handle_emu *val)
+{
+    if (val->reorder_gap <= 1)
+        return bpf_get_prandom_u32() % PKT_LOSS_SCOPE < val->reorder_rate;
+
+    __u32 *count = bpf_map_lookup_elem(&reorder_state_map, key);
+    if (!count) {
+        __u32 init = 0;
+        bpf_map_update_elem(&reorder_state_map, key, &init, BPF_NOEXIST);
+        count = bpf_map_lookup_elem(&reorder_state_map, key);
+        if (!count)
+            return 0;
     }
+    if (*count + 1 < val->reorder_gap) {
+        (*count)++;
+        return 0;
+    }
+    if (bpf_get_prandom_u32() % PKT_LOSS_SCOPE >= val->reorder_rate)
+        return 0;
+    *count = 0;
+    return 1;
+}
 
-    // 防止队列积压过大（例如超过2秒的包直接丢弃）
-    if (next_tstamp - now >= TIME_HORIZON_NS)
-        return TC_ACT_SHOT;
+/*
+ * emu_resolve 返回链路实际生效的参数：profile_id 非 0 时取模板 (ARRAY 查找，无哈希开销)，
+ * 绑定轨迹时与轨迹当前点合成到 traced。模板不存在时返回 0
+ */
+static __always_inline struct handle_emu *emu_resolve(struct handle_emu *val, __u32 profile_id, __u64 now,
+                                                      struct handle_emu *traced)
+{
+    if (profile_id)
+        val = bpf_map_lookup_elem(&EMU_PROFILES, &profile_id);
+    if (!val)
+        return 0;
 
-    // 更新 Map：告诉下一个包，你最早只能在 next_tstamp 之后发
-    if (bpf_map_update_elem(&flow_map, key, &next_tstamp, BPF_ANY)) // 建议用 BPF_ANY 以防万一
-        return TC_ACT_SHOT;
+    // 绑定轨迹的链路：速率/时延/丢包率取轨迹当前点，其余参数不变
+    if (val->trace_id && trace_apply(val, val->trace_id, now, traced))
+        return traced;
+    return val;
+}
 
-    // 设置 skb 的发送时间，fq qdisc 会看到这个时间并挂起数据包
-    skb->tstamp = next_tstamp;
+/*
+ * emu_stages 按 val 依次执行丢包 (含复制、损坏)、限速、时延抖动 (含重排) 三个阶段，限速状态与统计按 key 区分。
+ * tstamp0 为进入流水线时的 tstamp，is_dup 表示本包是复制出的副本。丢包时返回 TC_ACT_SHOT
+ */
+static __always_inline int emu_stages(struct __sk_buff *skb, struct flow_key *key, const struct handle_emu *val,
+                                      const __u32 stages, __u64 now, __u64 tstamp0, int is_dup)
+{
+    // 进入本阶段时的最早发送时间，用于统计本包被注入的时延
+    __u64 tstamp_in = skb->tstamp > now ? skb->tstamp : now;
 
-    bpf_tail_call(skb, &progs, 0);
+    struct link_stats *stats = link_stats_get(key);
+    if (stats) {
+        stats->packets++;
+        stats->bytes += skb->len;
+    }
+
+    //========================================================================
+    // 丢包逻辑：生成[0, PKT_LOSS_SCOPE)随机数与当前状态的丢包率比较，比丢包率小则丢包
+    if ((stages & EMU_STAGE_LOSS) && (val->loss_rate > 0 || val->ge_p > 0)) {
+        if (loss_decide(key, val)) {
+            return emu_drop(stats, EMU_DROP_LOSS);  // 丢包
+        }
+    }
+    // 复制与损坏：在限速之前执行，副本不再复制
+    if (stages & EMU_STAGE_LOSS) {
+        if (val->dup_rate && !is_dup)
+            emu_duplicate(skb, val, stages, tstamp0, stats);
+        if (val->corrupt_rate)
+            emu_corrupt(skb, val, stats);
+    }
+    //========================================================================
+    // 限速逻辑：链路速率为 0 时仍需经过接口/组聚合瓶颈
+    if (stages & EMU_STAGE_RATE) {
+        int verdict = throttle_flow(skb, key, val, now, stats);
+        if (verdict != EMU_PASS) {
+            return emu_drop(stats, verdict);
+        }
+    }
+    //========================================================================
+    // 时延抖动逻辑：被重排的包只保留限速得到的发送时间，越过前面被延迟的包
+    if (stages & EMU_STAGE_DELAY) {
+        if (val->reorder_rate && reorder_decide(key, val)) {
+            if (stats)
+                stats->reorder_packets++;
+        } else {
+            inject_delay_jitter(skb, key, val, now);
+        }
+    }
+
+    if (stats && skb->tstamp > tstamp_in) {
+        stats->delay_ns += skb->tstamp - tstamp_in;
+    }
     return TC_ACT_OK;
 }
 
-SEC("tc_loss_bps")
-int loss_bps(struct __sk_buff *skb)
+/*
+ * class_lookup 是 MAC 规则之后的第二级查找：按端口、对端前缀、DSCP 的顺序匹配 IPv4 包。
+ * 先查 EMU_CLASS_IFACES，接口 (该方向) 未配置分类时不解析 IP 头
+ */
+static __always_inline struct class_rule *class_lookup(void *data_end, struct hdr_cursor *nh, int eth_proto,
+                                                       __u32 ifindex)
+{
+    __u32 iface = ifindex & ~FLOW_DIR_INGRESS;
+    if (iface >= MAX_IFACE_AGG)
+        return 0;
+    __u32 *iface_flags = bpf_map_lookup_elem(&EMU_CLASS_IFACES, &iface);
+    if (!iface_flags)
+        return 0;
+    __u32 flags = *iface_flags;
+    if (ifindex & FLOW_DIR_INGRESS)
+        flags >>= CLASS_F_INGRESS_SHIFT;
+    flags &= CLASS_F_MASK;
+    if (!flags || eth_proto != bpf_htons(ETH_P_IP))
+        return 0;
+
+    struct iphdr *iph = 0;
+    parse_iphdr(nh, data_end, &iph);
+    if (!iph)
+        return 0;
+
+    struct class_rule *cls;
+    struct class_key ck = {
+        .ifindex = ifindex,
+        .proto = iph->protocol,
+    };
+
+    // 端口：源端口与目的端口任一命中，同时覆盖请求与响应方向；分片的非首片不带端口
+    if ((flags & CLASS_F_PORT) && (iph->protocol == IPPROTO_TCP || iph->protocol == IPPROTO_UDP) &&
+        !(iph->frag_off & bpf_htons(0x1fff))) {
+        __be16 *ports = nh->pos;
+        if ((void *)(ports + 2) <= data_end) {
+            ck.port = bpf_ntohs(ports[1]);
+            cls = bpf_map_lookup_elem(&EMU_CLASS_RULES, &ck);
+            if (cls)
+                return cls;
+            ck.port = bpf_ntohs(ports[0]);
+            cls = bpf_map_lookup_elem(&EMU_CLASS_RULES, &ck);
+            if (cls)
+                return cls;
+        }
+    }
+
+    // 对端前缀：出口方向 (发往 Pod) 取源地址，入口方向 (Pod 发出) 取目的地址
+    if (flags & CLASS_F_PREFIX) {
+        struct class_prefix_key pk = {
+            .prefixlen = 32 + 32,
+            .ifindex = ifindex,
+            .addr = (ifindex & FLOW_DIR_INGRESS) ? iph->daddr : iph->saddr,
+        };
+        cls = bpf_map_lookup_elem(&EMU_CLASS_PREFIXES, &pk);
+        if (cls)
+            return cls;
+    }
+
+    if (flags & CLASS_F_DSCP) {
+        ck.proto = 0;
+        ck.port = 0;
+        ck.dscp = iph->tos >> 2;
+        return bpf_map_lookup_elem(&EMU_CLASS_RULES, &ck);
+    }
+    return 0;
+}
+
+/*
+ * emu_pipeline 是单次解析、单次查表的融合流水线：
+ * 以太网头只解析一次，MAC_HANDLE_EMU 只查一次 (绑定模板/轨迹时再查对应数组)，查到的 handle_emu
+ * 依次传给丢包、限速、时延抖动三个阶段，不再经过 progs 尾调用。
+ * 接口配置了 L3/L4 分类时，命中分类的包改用 (覆盖) 或再经过 (叠加) 类的参数。
+ */
+static __always_inline int emu_pipeline(struct __sk_buff *skb, const __u32 stages)
 {
     // 数据包尾指针
     void *data_end = (void *)(unsigned long long)skb->data_end;
@@ -176,46 +781,117 @@ int loss_bps(struct __sk_buff *skb)
     nh.pos = data;
 
     // 解析以太网头，获取源MAC地址
-    if (parse_ethhdr(&nh, data_end, &eth) == TC_ACT_SHOT) {
+    int eth_proto = parse_ethhdr(&nh, data_end, &eth);
+    if (eth_proto == TC_ACT_SHOT) {
         return TC_ACT_SHOT;
     }
-    
-    // 创建复合键：网卡index + 源MAC地址
+
+    // 创建复合键：网卡index + 源MAC地址 (入口方向为目的MAC)
     struct flow_key key;
-    key.ifindex = skb->ifindex;  // 获取当前网卡index
-    bpf_probe_read_kernel(key.src_mac, ETH_ALEN, eth->h_source);
+    if (stages & EMU_DIR_INGRESS) {
+        key.ifindex = skb->ifindex | FLOW_DIR_INGRESS;
+        bpf_probe_read_kernel(key.src_mac, ETH_ALEN, eth->h_dest);
+    } else {
+        key.ifindex = skb->ifindex;  // 获取当前网卡index
+        bpf_probe_read_kernel(key.src_mac, ETH_ALEN, eth->h_source);
+    }
+
+    // Map lookup - 使用复合键 (按接口分表或 epoch 模式下查对应的内层表)
+    struct handle_emu *rule = emu_rule_lookup(&key);
+    // 第二级 L3/L4 分类，接口未配置分类时只多一次数组查找
+    struct class_rule *cls = class_lookup(data_end, &nh, eth_proto, key.ifindex);
 
-    struct handle_emu *val_struct;
-    // Map lookup - 使用复合键
-    val_struct = bpf_map_lookup_elem(&MAC_HANDLE_EMU, &key);
+    // 本包是 emu_duplicate 复制出的副本：清除标记，照常处理但不再复制
+    int is_dup = 0;
+    if (skb->mark & dup_mark) {
+        skb->mark &= ~dup_mark;
+        is_dup = 1;
+    }
 
     // Safety check, go on if no handle could be retrieved
-    if (!val_struct) {
+    if (!rule && !cls) {
         return TC_ACT_OK;
     }
-    
-    //========================================================================
-    // 丢包逻辑
-    __u32 *loss_rate = &val_struct->loss_rate;
-    
-    // 丢包逻辑：生成[0, PKT_LOSS_SCOPE]随机数与loss_rate比较，比loss_rate小则丢包
-    if (*loss_rate > 0) {
-        __u32 rand_num = bpf_get_prandom_u32() % PKT_LOSS_SCOPE;
-        if (rand_num < *loss_rate) {
-            return TC_ACT_SHOT;  // 丢包
+
+    // 只取一次当前时间，各阶段共用
+    __u64 now = bpf_ktime_get_ns();
+
+    // 入口方向的 tstamp 可能是接收时间戳 (CLOCK_REALTIME)，只沿用已标记为单调发送时间的值
+    if ((stages & EMU_DIR_INGRESS) && skb->tstamp_type != BPF_SKB_TSTAMP_DELIVERY_MONO) {
+        bpf_skb_set_tstamp(skb, 0, BPF_SKB_TSTAMP_UNSPEC);
+    }
+    __u64 tstamp0 = skb->tstamp;
+
+    struct handle_emu traced;
+    struct handle_emu *val;
+
+    // MAC 规则：限速状态与统计按 flow_key 区分；命中覆盖模式的分类时跳过
+    if (rule && !(cls && cls->mode == CLASS_MODE_OVERRIDE)) {
+        val = emu_resolve(rule, rule->profile_id, now, &traced);
+        if (val && emu_stages(skb, &key, val, stages, now, tstamp0, is_dup) == TC_ACT_SHOT) {
+            return TC_ACT_SHOT;
         }
     }
-    //========================================================================
-    //========================================================================
-    // 限速逻辑
-    __u32 *throttle_rate_bps = &val_struct->throttle_rate_bps;
-    
-    // Safety check, go on if no handle could be retrieved
-    if (!throttle_rate_bps)  {
-        return TC_ACT_OK;
+
+    // 分类：参数取自模板，状态与统计记在 ifindex 带 class_id 的键上，与 MAC 规则互不干扰
+    if (cls) {
+        __u32 class_id = cls->class_id;
+        val = emu_resolve(0, cls->profile_id, now, &traced);
+        if (val && class_id && class_id < MAX_CLASSES) {
+            struct flow_key ckey = key;
+            ckey.ifindex |= class_id << FLOW_CLASS_SHIFT;
+            if (cls->mode == CLASS_MODE_STACK)
+                ckey.ifindex |= FLOW_CLASS_STACKED;
+            if (emu_stages(skb, &ckey, val, stages, now, tstamp0, is_dup) == TC_ACT_SHOT) {
+                return TC_ACT_SHOT;
+            }
+        }
     }
-    return throttle_flow(skb, &key, throttle_rate_bps);
-    //========================================================================
+
+    /*
+     * 入口方向不经过 ifb：把发送时间标记为单调时钟的 delivery time，
+     * 转发时内核保留该时间，由出口设备 (对端 veth 或上联网卡) 上的 fq 按时间出队
+     */
+    if ((stages & EMU_DIR_INGRESS) && skb->tstamp) {
+        bpf_skb_set_tstamp(skb, skb->tstamp, BPF_SKB_TSTAMP_DELIVERY_MONO);
+    }
+
+    return TC_ACT_OK;
+}
+
+/*
+ * For some reason section names need to start with "tc"
+ * loss_bps 为完整流水线（丢包 + 限速 + 时延抖动），其余为按需挂载的专用变体。
+ */
+SEC("tc_loss_bps")
+int loss_bps(struct __sk_buff *skb)
+{
+    return emu_pipeline(skb, EMU_STAGE_ALL);
+}
+
+SEC("tc_emu_loss")
+int emu_loss(struct __sk_buff *skb)
+{
+    return emu_pipeline(skb, EMU_STAGE_LOSS);
+}
+
+SEC("tc_emu_rate")
+int emu_rate(struct __sk_buff *skb)
+{
+    return emu_pipeline(skb, EMU_STAGE_RATE);
+}
+
+SEC("tc_emu_delay")
+int emu_delay(struct __sk_buff *skb)
+{
+    return emu_pipeline(skb, EMU_STAGE_DELAY);
+}
+
+// emu_ingress 挂在 host veth 入口，对 Pod 发出的包执行完整流水线 (上行方向)
+SEC("tc_emu_ingress")
+int emu_ingress(struct __sk_buff *skb)
+{
+    return emu_pipeline(skb, EMU_STAGE_ALL | EMU_DIR_INGRESS);
 }
 
 char _license[] SEC("license") = "GPL";
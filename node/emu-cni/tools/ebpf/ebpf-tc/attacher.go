@@ -0,0 +1,67 @@
+package ebpftc
+
+import (
+	"fmt"
+	"sync"
+
+	"github.com/cilium/ebpf"
+	"github.com/vishvananda/netlink"
+)
+
+// Attacher 供常驻进程 (node agent) 挂载 TC 程序：对象只在首次挂载时加载，
+// 之后复用已打开的 pin 住的程序，每次挂载只剩 netlink 操作
+type Attacher struct {
+	mu    sync.Mutex
+	progs map[Mode]*ebpf.Program
+	// ingress 为入口方向程序，未用到时不打开
+	ingress *ebpf.Program
+}
+
+// NewAttacher 创建 Attacher，eBPF 对象延迟到第一次 Attach 时加载
+func NewAttacher() *Attacher {
+	return &Attacher{progs: make(map[Mode]*ebpf.Program)}
+}
+
+// Attach 按 ifindex 挂载指定变体；opts 仅在节点首次加载 eBPF 对象时生效，与 InitWithOptions 一致
+func (a *Attacher) Attach(ifindex int, mode Mode, ingress bool, opts Options) error {
+	prog, ingressProg, err := a.programs(mode, ingress, opts)
+	if err != nil {
+		return err
+	}
+	iface, err := netlink.LinkByIndex(ifindex)
+	if err != nil {
+		return fmt.Errorf("查找网络接口 %d 失败: %v", ifindex, err)
+	}
+	return attachPrograms(iface, prog, ingressProg)
+}
+
+// programs 返回已打开的程序，缺失时先初始化对象再打开 pin 住的程序
+func (a *Attacher) programs(mode Mode, ingress bool, opts Options) (*ebpf.Program, *ebpf.Program, error) {
+	a.mu.Lock()
+	defer a.mu.Unlock()
+
+	prog, ok := a.progs[mode]
+	if !ok || (ingress && a.ingress == nil) {
+		if err := InitWithOptions(opts); err != nil {
+			return nil, nil, fmt.Errorf("ebpf init failed: %v", err)
+		}
+	}
+	if !ok {
+		p, err := ebpf.LoadPinnedProgram(mode.pinPath(), nil)
+		if err != nil {
+			return nil, nil, fmt.Errorf("eBPF TC 程序 (%s) 未初始化或未 pin 住: %v", mode, err)
+		}
+		a.progs[mode], prog = p, p
+	}
+	if !ingress {
+		return prog, nil, nil
+	}
+	if a.ingress == nil {
+		p, err := ebpf.LoadPinnedProgram(ingressPinPath, nil)
+		if err != nil {
+			return nil, nil, fmt.Errorf("eBPF TC 入口程序未初始化或未 pin 住: %v", err)
+		}
+		a.ingress = p
+	}
+	return prog, a.ingress, nil
+}
@@ -0,0 +1,137 @@
+package ebpftc
+
+import (
+	"encoding/binary"
+	"fmt"
+	"testing"
+
+	"github.com/cilium/ebpf"
+	"github.com/cilium/ebpf/rlimit"
+)
+
+// 数据面微基准：通过 BPF_PROG_TEST_RUN 在内核中重复执行程序，报告每包耗时 (ns/pkt)。
+// 需要 root (CAP_BPF)，权限不足时跳过；运行方式见 Makefile 的 bench 目标
+
+const (
+	// benchIfindex 为 BPF_PROG_TEST_RUN 未指定设备时 skb 所在的 loopback
+	benchIfindex = 1
+	// benchRateFPShift 需与 maps.h 中的 RATE_FP_SHIFT 保持一致
+	benchRateFPShift = 20
+)
+
+// benchMapSizes 为 MAC_HANDLE_EMU 的容量，表按容量填满，观察规则数增长对查表的影响
+var benchMapSizes = []uint32{1024, 65535, 1 << 20}
+
+// benchMAC 生成第 i 条规则的源 MAC (本地管理地址)
+func benchMAC(i uint32) [6]uint8 {
+	var mac [6]uint8
+	mac[0] = 0x02
+	binary.BigEndian.PutUint32(mac[2:], i)
+	return mac
+}
+
+// benchPacket 构造一个 128 字节的 IPv4/UDP 帧，源 MAC 为 src
+func benchPacket(src [6]uint8) []byte {
+	pkt := make([]byte, 128)
+	copy(pkt[0:6], []byte{0x02, 0xff, 0, 0, 0, 1})
+	copy(pkt[6:12], src[:])
+	binary.BigEndian.PutUint16(pkt[12:], 0x0800)
+	ip := pkt[14:]
+	ip[0] = 0x45
+	binary.BigEndian.PutUint16(ip[2:], uint16(len(pkt)-14))
+	ip[8] = 64
+	ip[9] = 17
+	copy(ip[12:16], []byte{10, 0, 0, 1})
+	copy(ip[16:20], []byte{10, 0, 0, 2})
+	udp := ip[20:]
+	binary.BigEndian.PutUint16(udp[0:], 40000)
+	binary.BigEndian.PutUint16(udp[2:], 5201)
+	binary.BigEndian.PutUint16(udp[4:], uint16(len(pkt)-34))
+	return pkt
+}
+
+// loadBench 加载一份不 pin 的对象 (不影响节点上已挂载的程序)，并以 rule 填满容量为 entries 的规则表。
+// testing 会以递增的 b.N 多次调用子基准，对象在外层加载一次，由调用方关闭
+func loadBench(b *testing.B, entries uint32, rule bpfHandleEmu) *bpfObjects {
+	b.Helper()
+	if err := rlimit.RemoveMemlock(); err != nil {
+		b.Skipf("移除内存锁定限制失败 (需要 root): %v", err)
+	}
+	spec, err := loadBpf()
+	if err != nil {
+		b.Fatalf("读取 eBPF 对象失败: %v", err)
+	}
+	if err := setConstants(spec, Options{}); err != nil {
+		b.Fatal(err)
+	}
+	if err := resizeMaps(spec, Options{MaxEntries: entries}); err != nil {
+		b.Fatal(err)
+	}
+	for _, m := range spec.Maps {
+		m.Pinning = ebpf.PinNone
+	}
+
+	var objs bpfObjects
+	if err := spec.LoadAndAssign(&objs, nil); err != nil {
+		b.Skipf("加载 eBPF 对象失败 (需要 root 与 BPF 权限): %v", err)
+	}
+	if err := fillJitterDist(objs.EMU_JITTER_DIST); err != nil {
+		objs.Close()
+		b.Fatal(err)
+	}
+
+	for i := uint32(0); i < entries; i++ {
+		key := bpfFlowKey{Ifindex: benchIfindex, SrcMac: benchMAC(i)}
+		if err := objs.MAC_HANDLE_EMU.Put(key, rule); err != nil {
+			objs.Close()
+			b.Fatalf("填充第 %d 条规则失败: %v", i, err)
+		}
+	}
+	return &objs
+}
+
+// runBench 以 b.N 次重复执行 prog 并报告内核测得的每包耗时
+func runBench(b *testing.B, prog *ebpf.Program, pkt []byte) {
+	b.Helper()
+	b.ResetTimer()
+	_, perRun, err := prog.Benchmark(pkt, b.N, nil)
+	if err != nil {
+		b.Fatalf("BPF_PROG_TEST_RUN 失败: %v", err)
+	}
+	b.ReportMetric(float64(perRun.Nanoseconds()), "ns/pkt")
+}
+
+func BenchmarkTC(b *testing.B) {
+	// 完整损伤：限速 1Gbps、时延 10ms ± 1ms (正态)、丢包 0.1%
+	impaired := bpfHandleEmu{
+		ThrottleRateBps: 1_000_000_000,
+		NsPerByteFp:     (8 * 1000000000 << benchRateFPShift) / 1_000_000_000,
+		Delay:           10000,
+		Jitter:          1000,
+		JitterDist:      1,
+		LossRate:        10,
+	}
+	delayOnly := bpfHandleEmu{Delay: 10000, Jitter: 1000}
+
+	cases := []struct {
+		name string
+		prog func(o *bpfObjects) *ebpf.Program
+		rule bpfHandleEmu
+	}{
+		{"loss_bps", func(o *bpfObjects) *ebpf.Program { return o.LossBps }, impaired},
+		{"delay_jitter", func(o *bpfObjects) *ebpf.Program { return o.EmuDelay }, delayOnly},
+	}
+	for _, c := range cases {
+		for _, size := range benchMapSizes {
+			objs := loadBench(b, size, c.rule)
+			b.Run(fmt.Sprintf("%s/entries=%d", c.name, size), func(b *testing.B) {
+				runBench(b, c.prog(objs), benchPacket(benchMAC(size/2)))
+			})
+			// 未命中规则的包只付出解析与一次查表的开销
+			b.Run(fmt.Sprintf("%s/entries=%d/miss", c.name, size), func(b *testing.B) {
+				runBench(b, c.prog(objs), benchPacket(benchMAC(1<<31)))
+			})
+			objs.Close()
+		}
+	}
+}
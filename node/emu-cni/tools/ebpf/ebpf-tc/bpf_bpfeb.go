@@ -13,6 +13,42 @@ import (
 	"github.com/cilium/ebpf"
 )
 
+type bpfAggCfg struct {
+	_               structs.HostLayout
+	ThrottleRateBps uint64
+	NsPerByteFp     uint64
+	QueueLimitNs    uint32
+	Reserved        uint32
+}
+
+type bpfClassKey struct {
+	_       structs.HostLayout
+	Ifindex uint32
+	Proto   uint8
+	Dscp    uint8
+	Port    uint16
+}
+
+type bpfClassPrefixKey struct {
+	_         structs.HostLayout
+	Prefixlen uint32
+	Ifindex   uint32
+	Addr      uint32
+}
+
+type bpfClassRule struct {
+	_         structs.HostLayout
+	ClassId   uint32
+	ProfileId uint32
+	Mode      uint32
+	Reserved  uint32
+}
+
+type bpfEdtState struct {
+	_          structs.HostLayout
+	LastTstamp uint64
+}
+
 type bpfFlowKey struct {
 	_       structs.HostLayout
 	Ifindex uint32
@@ -21,10 +57,67 @@ type bpfFlowKey struct {
 
 type bpfHandleEmu struct {
 	_               structs.HostLayout
-	ThrottleRateBps uint32
+	ThrottleRateBps uint64
+	NsPerByteFp     uint64
 	Delay           uint32
 	LossRate        uint32
 	Jitter          uint32
+	ProfileId       uint32
+	GeP             uint32
+	GeR             uint32
+	GeLossBad       uint32
+	QueueLimitNs    uint32
+	RedMinNs        uint32
+	RedMaxNs        uint32
+	RedMaxP         uint32
+	AqmFlags        uint32
+	GroupId         uint32
+	TraceId         uint32
+	JitterDist      uint32
+	JitterFlags     uint32
+	DupRate         uint32
+	CorruptRate     uint32
+	ReorderRate     uint32
+	ReorderGap      uint32
+	ImpairFlags     uint32
+	Reserved        uint32
+}
+
+type bpfLinkStats struct {
+	_              structs.HostLayout
+	Packets        uint64
+	Bytes          uint64
+	LossDrops      uint64
+	HorizonDrops   uint64
+	ErrorDrops     uint64
+	DelayNs        uint64
+	QueueDrops     uint64
+	AqmDrops       uint64
+	EcnMarks       uint64
+	AggDrops       uint64
+	DupPackets     uint64
+	CorruptPackets uint64
+	ReorderPackets uint64
+}
+
+type bpfLossState struct {
+	_   structs.HostLayout
+	Bad uint32
+}
+
+type bpfTraceMeta struct {
+	_        structs.HostLayout
+	StartNs  uint64
+	SlotNs   uint64
+	Len      uint32
+	Reserved uint32
+}
+
+type bpfTracePoint struct {
+	_           structs.HostLayout
+	NsPerByteFp uint64
+	Delay       uint32
+	LossRate    uint32
 }
 
 // loadBpf returns the embedded CollectionSpec for bpf.
@@ -69,23 +162,46 @@ type bpfSpecs struct {
 //
 // It can be passed ebpf.CollectionSpec.Assign.
 type bpfProgramSpecs struct {
-	DelayJitter *ebpf.ProgramSpec `ebpf:"delay_jitter"`
-	LossBps     *ebpf.ProgramSpec `ebpf:"loss_bps"`
+	EmuDelay   *ebpf.ProgramSpec `ebpf:"emu_delay"`
+	EmuIngress *ebpf.ProgramSpec `ebpf:"emu_ingress"`
+	EmuLoss    *ebpf.ProgramSpec `ebpf:"emu_loss"`
+	EmuRate    *ebpf.ProgramSpec `ebpf:"emu_rate"`
+	LossBps    *ebpf.ProgramSpec `ebpf:"loss_bps"`
 }
 
 // bpfMapSpecs contains maps before they are loaded into the kernel.
 //
 // It can be passed ebpf.CollectionSpec.Assign.
 type bpfMapSpecs struct {
-	MAC_HANDLE_EMU *ebpf.MapSpec `ebpf:"MAC_HANDLE_EMU"`
-	FlowMap        *ebpf.MapSpec `ebpf:"flow_map"`
-	Progs          *ebpf.MapSpec `ebpf:"progs"`
+	EMU_CLASS_IFACES   *ebpf.MapSpec `ebpf:"EMU_CLASS_IFACES"`
+	EMU_CLASS_PREFIXES *ebpf.MapSpec `ebpf:"EMU_CLASS_PREFIXES"`
+	EMU_CLASS_RULES    *ebpf.MapSpec `ebpf:"EMU_CLASS_RULES"`
+	EMU_EPOCH          *ebpf.MapSpec `ebpf:"EMU_EPOCH"`
+	EMU_GROUP_AGG      *ebpf.MapSpec `ebpf:"EMU_GROUP_AGG"`
+	EMU_IFACE_AGG      *ebpf.MapSpec `ebpf:"EMU_IFACE_AGG"`
+	EMU_IFACE_TABLES   *ebpf.MapSpec `ebpf:"EMU_IFACE_TABLES"`
+	EMU_JITTER_DIST    *ebpf.MapSpec `ebpf:"EMU_JITTER_DIST"`
+	EMU_PROFILES       *ebpf.MapSpec `ebpf:"EMU_PROFILES"`
+	EMU_TABLES         *ebpf.MapSpec `ebpf:"EMU_TABLES"`
+	EMU_TRACE_META     *ebpf.MapSpec `ebpf:"EMU_TRACE_META"`
+	EMU_TRACE_POINTS   *ebpf.MapSpec `ebpf:"EMU_TRACE_POINTS"`
+	LINK_STATS         *ebpf.MapSpec `ebpf:"LINK_STATS"`
+	MAC_HANDLE_EMU     *ebpf.MapSpec `ebpf:"MAC_HANDLE_EMU"`
+	FlowMap            *ebpf.MapSpec `ebpf:"flow_map"`
+	GroupAggState      *ebpf.MapSpec `ebpf:"group_agg_state"`
+	IfaceAggState      *ebpf.MapSpec `ebpf:"iface_agg_state"`
+	JitterStateMap     *ebpf.MapSpec `ebpf:"jitter_state_map"`
+	LossStateMap       *ebpf.MapSpec `ebpf:"loss_state_map"`
+	ReorderStateMap    *ebpf.MapSpec `ebpf:"reorder_state_map"`
 }
 
 // bpfVariableSpecs contains global variables before they are loaded into the kernel.
 //
 // It can be passed ebpf.CollectionSpec.Assign.
 type bpfVariableSpecs struct {
+	DupMark     *ebpf.VariableSpec `ebpf:"dup_mark"`
+	EdtLockless *ebpf.VariableSpec `ebpf:"edt_lockless"`
+	IfaceTables *ebpf.VariableSpec `ebpf:"iface_tables"`
 }
 
 // bpfObjects contains all objects after they have been loaded into the kernel.
@@ -108,16 +224,50 @@ func (o *bpfObjects) Close() error {
 //
 // It can be passed to loadBpfObjects or ebpf.CollectionSpec.LoadAndAssign.
 type bpfMaps struct {
-	MAC_HANDLE_EMU *ebpf.Map `ebpf:"MAC_HANDLE_EMU"`
-	FlowMap        *ebpf.Map `ebpf:"flow_map"`
-	Progs          *ebpf.Map `ebpf:"progs"`
+	EMU_CLASS_IFACES   *ebpf.Map `ebpf:"EMU_CLASS_IFACES"`
+	EMU_CLASS_PREFIXES *ebpf.Map `ebpf:"EMU_CLASS_PREFIXES"`
+	EMU_CLASS_RULES    *ebpf.Map `ebpf:"EMU_CLASS_RULES"`
+	EMU_EPOCH          *ebpf.Map `ebpf:"EMU_EPOCH"`
+	EMU_GROUP_AGG      *ebpf.Map `ebpf:"EMU_GROUP_AGG"`
+	EMU_IFACE_AGG      *ebpf.Map `ebpf:"EMU_IFACE_AGG"`
+	EMU_IFACE_TABLES   *ebpf.Map `ebpf:"EMU_IFACE_TABLES"`
+	EMU_JITTER_DIST    *ebpf.Map `ebpf:"EMU_JITTER_DIST"`
+	EMU_PROFILES       *ebpf.Map `ebpf:"EMU_PROFILES"`
+	EMU_TABLES         *ebpf.Map `ebpf:"EMU_TABLES"`
+	EMU_TRACE_META     *ebpf.Map `ebpf:"EMU_TRACE_META"`
+	EMU_TRACE_POINTS   *ebpf.Map `ebpf:"EMU_TRACE_POINTS"`
+	LINK_STATS         *ebpf.Map `ebpf:"LINK_STATS"`
+	MAC_HANDLE_EMU     *ebpf.Map `ebpf:"MAC_HANDLE_EMU"`
+	FlowMap            *ebpf.Map `ebpf:"flow_map"`
+	GroupAggState      *ebpf.Map `ebpf:"group_agg_state"`
+	IfaceAggState      *ebpf.Map `ebpf:"iface_agg_state"`
+	JitterStateMap     *ebpf.Map `ebpf:"jitter_state_map"`
+	LossStateMap       *ebpf.Map `ebpf:"loss_state_map"`
+	ReorderStateMap    *ebpf.Map `ebpf:"reorder_state_map"`
 }
 
 func (m *bpfMaps) Close() error {
 	return _BpfClose(
+		m.EMU_CLASS_IFACES,
+		m.EMU_CLASS_PREFIXES,
+		m.EMU_CLASS_RULES,
+		m.EMU_EPOCH,
+		m.EMU_GROUP_AGG,
+		m.EMU_IFACE_AGG,
+		m.EMU_IFACE_TABLES,
+		m.EMU_JITTER_DIST,
+		m.EMU_PROFILES,
+		m.EMU_TABLES,
+		m.EMU_TRACE_META,
+		m.EMU_TRACE_POINTS,
+		m.LINK_STATS,
 		m.MAC_HANDLE_EMU,
 		m.FlowMap,
-		m.Progs,
+		m.GroupAggState,
+		m.IfaceAggState,
+		m.JitterStateMap,
+		m.LossStateMap,
+		m.ReorderStateMap,
 	)
 }
 
@@ -125,19 +275,28 @@ func (m *bpfMaps) Close() error {
 //
 // It can be passed to loadBpfObjects or ebpf.CollectionSpec.LoadAndAssign.
 type bpfVariables struct {
+	DupMark     *ebpf.Variable `ebpf:"dup_mark"`
+	EdtLockless *ebpf.Variable `ebpf:"edt_lockless"`
+	IfaceTables *ebpf.Variable `ebpf:"iface_tables"`
 }
 
 // bpfPrograms contains all programs after they have been loaded into the kernel.
 //
 // It can be passed to loadBpfObjects or ebpf.CollectionSpec.LoadAndAssign.
 type bpfPrograms struct {
-	DelayJitter *ebpf.Program `ebpf:"delay_jitter"`
-	LossBps     *ebpf.Program `ebpf:"loss_bps"`
+	EmuDelay   *ebpf.Program `ebpf:"emu_delay"`
+	EmuIngress *ebpf.Program `ebpf:"emu_ingress"`
+	EmuLoss    *ebpf.Program `ebpf:"emu_loss"`
+	EmuRate    *ebpf.Program `ebpf:"emu_rate"`
+	LossBps    *ebpf.Program `ebpf:"loss_bps"`
 }
 
 func (p *bpfPrograms) Close() error {
 	return _BpfClose(
-		p.DelayJitter,
+		p.EmuDelay,
+		p.EmuIngress,
+		p.EmuLoss,
+		p.EmuRate,
 		p.LossBps,
 	)
 }
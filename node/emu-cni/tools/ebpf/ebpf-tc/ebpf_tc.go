@@ -1,9 +1,11 @@
 package ebpftc
 
 // 1. Generate 指令
-//go:generate go run github.com/cilium/ebpf/cmd/bpf2go bpf ../ebpf-tc-c/tc_bpf.c
+// -mcpu=v3: 限速状态使用原子 CAS/fetch_add 指令
+//go:generate go run github.com/cilium/ebpf/cmd/bpf2go -cflags "-O2 -g -Wall -mcpu=v3" bpf ../ebpf-tc-c/tc_bpf.c
 
 import (
+	"errors"
 	"fmt"
 	"os"
 	"golang.org/x/sys/unix"
@@ -17,8 +19,50 @@ const (
 	defaultDir        = "/sys/fs/bpf/tc_emu"
 	defaultPinPath    = "/sys/fs/bpf/tc_emu/program"
 	defaultMapPinPath = "/sys/fs/bpf/tc_emu/maps"
+	// ingressPinPath 为入口方向 (上行) 程序的 pin 路径，只有完整流水线一个变体
+	ingressPinPath = "/sys/fs/bpf/tc_emu/program_ingress"
 )
 
+// Mode 选择挂载到网卡上的 TC 程序变体，均为单次解析、单次查表的融合流水线
+type Mode string
+
+const (
+	ModeFull  Mode = "full"  // 丢包 + 限速 + 时延抖动
+	ModeLoss  Mode = "loss"  // 仅丢包
+	ModeRate  Mode = "rate"  // 仅限速
+	ModeDelay Mode = "delay" // 仅时延抖动
+)
+
+// pinPath 返回各变体程序的 pin 路径，完整流水线沿用原有路径以兼容旧部署
+func (m Mode) pinPath() string {
+	if m == ModeFull {
+		return defaultPinPath
+	}
+	return defaultDir + "/program_" + string(m)
+}
+
+// ParseMode 解析 CNI 配置中的模式字符串，空字符串表示完整流水线
+func ParseMode(s string) (Mode, error) {
+	switch m := Mode(s); m {
+	case "":
+		return ModeFull, nil
+	case ModeFull, ModeLoss, ModeRate, ModeDelay:
+		return m, nil
+	default:
+		return "", fmt.Errorf("未知的 TC 模式 %q (可选: full, loss, rate, delay)", s)
+	}
+}
+
+// programs 返回各变体与已加载程序的对应关系
+func (o *bpfObjects) programs() map[Mode]*ebpf.Program {
+	return map[Mode]*ebpf.Program{
+		ModeFull:  o.LossBps,
+		ModeLoss:  o.EmuLoss,
+		ModeRate:  o.EmuRate,
+		ModeDelay: o.EmuDelay,
+	}
+}
+
 // ClearEbpf 清理网络接口上的 eBPF 程序和 TC 组件
 func ClearEbpf(iface netlink.Link) error {
 	// 移除 clsact qdisc（包含入口和出口过滤器）
@@ -124,17 +168,37 @@ func CreateTCBpfFilter(iface netlink.Link, progFd int, parent uint32, name strin
 	return filter, nil
 }
 
-// Init 初始化 eBPF XDP 程序
+// Options 控制 eBPF TC 对象的加载期参数，仅在首次加载 (尚未 pin 住) 时生效
+type Options struct {
+	// EDTLockless 限速状态使用普通读改写而非原子 CAS，
+	// 仅适用于只有单个 CPU 发送的 veth，否则并发更新会丢失导致超速
+	EDTLockless bool
+	// MaxEntries 覆盖规则表及按流状态表 (flow_map、LINK_STATS 等) 的容量，0 表示沿用 maps.h 中的默认值
+	MaxEntries uint32
+	// IfaceTables 规则按 ifindex 分表存放于 EMU_IFACE_TABLES，Pod 删除时可整表回收；
+	// 该布局下不支持 epoch 双缓冲切换
+	IfaceTables bool
+	// DupMark 为包复制时标记副本的 skb->mark 位，需避开 kube-proxy/CNI 使用的位，0 表示 DefaultDupMark
+	DupMark uint32
+}
+
+// DefaultDupMark 与 tc_bpf.c 中 dup_mark 的默认值一致
+const DefaultDupMark = 0x00200000
+
+// resizedMaps 为随 MaxEntries 一起伸缩的 map，均以 flow_key 为键
+var resizedMaps = []string{"MAC_HANDLE_EMU", "flow_map", "LINK_STATS", "loss_state_map", "jitter_state_map", "reorder_state_map"}
+
+// Init 使用默认参数初始化 eBPF TC 程序
 func Init() error {
-	// 1. 幂等性检查
-	prog, err := ebpf.LoadPinnedProgram(defaultPinPath, nil)
-	if err == nil {
-		prog.Close()
+	return InitWithOptions(Options{})
+}
+
+// InitWithOptions 初始化 eBPF TC 程序，加载并 pin 住所有流水线变体
+func InitWithOptions(opts Options) error {
+	// 1. 幂等性检查：所有变体均已 pin 住则直接返回
+	if allPinned() {
 		return nil
 	}
-	// if !os.IsNotExist(err) {
-	// 	return fmt.Errorf("检查 Pin 程序时发生意外错误: %v", err)
-	// }
 
 	// 2. 移除内存锁定限制
 	if err := rlimit.RemoveMemlock(); err != nil {
@@ -152,27 +216,121 @@ func Init() error {
 		PinPath: defaultMapPinPath,
 	}
 
-	// 5. 加载编译后的 eBPF 对象
+	// 5. 设置加载期常量并加载编译后的 eBPF 对象
+	spec, err := loadBpf()
+	if err != nil {
+		return fmt.Errorf("读取 eBPF 对象失败: %v", err)
+	}
+	if err := setConstants(spec, opts); err != nil {
+		return err
+	}
+	if err := resizeMaps(spec, opts); err != nil {
+		return err
+	}
 	var objs bpfObjects
-	if err := loadBpfObjects(&objs, loadOpts); err != nil {
+	if err := spec.LoadAndAssign(&objs, loadOpts); err != nil {
+		if errors.Is(err, ebpf.ErrMapIncompatible) {
+			return fmt.Errorf("已 pin 住的 map 与当前程序布局不兼容，升级后需先清理 %s: %w", defaultDir, err)
+		}
 		return fmt.Errorf("加载 eBPF 对象失败: %v", err)
 	}
 	defer objs.Close()
 
-	// 6. 将程序 Pin 到文件系统
-	if err := objs.LossBps.Pin(defaultPinPath); err != nil {
-		return fmt.Errorf("无法将 eBPF 程序 pin 到 %s: %v", defaultPinPath, err)
+	// 抖动分布表为只读常量，随 map 一起创建时写入
+	if err := fillJitterDist(objs.EMU_JITTER_DIST); err != nil {
+		return err
 	}
 
-	// 7. 更新程序的延迟函数指针
-	err = objs.Progs.Update(uint32(0), uint32(objs.DelayJitter.FD()), ebpf.UpdateAny)
-	if err != nil {
-		return fmt.Errorf("更新 eBPF 程序延迟函数指针失败: %v", err)
+	// 6. 将尚未 pin 住的程序 Pin 到文件系统 (旧部署可能只 pin 了完整流水线)
+	pins := map[string]*ebpf.Program{ingressPinPath: objs.EmuIngress}
+	for mode, prog := range objs.programs() {
+		pins[mode.pinPath()] = prog
+	}
+	for path, prog := range pins {
+		if _, err := os.Stat(path); err == nil {
+			continue
+		}
+		if err := prog.Pin(path); err != nil {
+			return fmt.Errorf("无法将 eBPF 程序 pin 到 %s: %v", path, err)
+		}
 	}
 
 	return nil
 }
 
+// setConstants 将 Options 写入 .rodata 中的加载期常量
+func setConstants(spec *ebpf.CollectionSpec, opts Options) error {
+	consts := map[string]interface{}{
+		"edt_lockless": boolToU32(opts.EDTLockless),
+		"iface_tables": boolToU32(opts.IfaceTables),
+		"dup_mark":     dupMark(opts.DupMark),
+	}
+	for name, val := range consts {
+		v, ok := spec.Variables[name]
+		if !ok {
+			return fmt.Errorf("eBPF 对象中缺少常量 %s", name)
+		}
+		if err := v.Set(val); err != nil {
+			return fmt.Errorf("设置常量 %s 失败: %v", name, err)
+		}
+	}
+	return nil
+}
+
+// resizeMaps 按 Options 调整 map 容量；按接口分表未启用时 EMU_IFACE_TABLES 不 pin，
+// agent 据此判断规则表布局
+func resizeMaps(spec *ebpf.CollectionSpec, opts Options) error {
+	if opts.MaxEntries > 0 {
+		for _, name := range resizedMaps {
+			m, ok := spec.Maps[name]
+			if !ok {
+				return fmt.Errorf("eBPF 对象中缺少 map %s", name)
+			}
+			m.MaxEntries = opts.MaxEntries
+		}
+		// epoch 影子表由 agent 按 MAC_HANDLE_EMU 的容量创建，内层模板保持一致
+		if tables, ok := spec.Maps["EMU_TABLES"]; ok && tables.InnerMap != nil {
+			tables.InnerMap.MaxEntries = opts.MaxEntries
+		}
+	}
+	if !opts.IfaceTables {
+		if m, ok := spec.Maps["EMU_IFACE_TABLES"]; ok {
+			m.Pinning = ebpf.PinNone
+		}
+	}
+	return nil
+}
+
+func dupMark(mark uint32) uint32 {
+	if mark == 0 {
+		return DefaultDupMark
+	}
+	return mark
+}
+
+func boolToU32(b bool) uint32 {
+	if b {
+		return 1
+	}
+	return 0
+}
+
+// allPinned 检查所有流水线变体 (含入口方向程序) 是否均已 pin 住
+func allPinned() bool {
+	paths := []string{ingressPinPath}
+	for _, mode := range []Mode{ModeFull, ModeLoss, ModeRate, ModeDelay} {
+		paths = append(paths, mode.pinPath())
+	}
+	for _, path := range paths {
+		prog, err := ebpf.LoadPinnedProgram(path, nil)
+		if err != nil {
+			return false
+		}
+		prog.Close()
+	}
+	return true
+}
+
 // Close 关闭 eBPF TC 程序	
 func Close() error {
 	err := os.RemoveAll(defaultDir)
@@ -182,19 +340,33 @@ func Close() error {
 	return nil
 }
 
-// AttachTC 将 XDP 程序附加到指定的 netlink.Link 网络接口
-func AttachTC(iface netlink.Link) error {	
-	prog, err := ebpf.LoadPinnedProgram(defaultPinPath, nil)
+// AttachTC 将指定变体的 TC 程序附加到 netlink.Link 网络接口的出口 (下行)；
+// ingress 为 true 时还在入口挂载上行程序，Pod 两个方向的规则都可以放在其所在节点
+func AttachTC(iface netlink.Link, mode Mode, ingress bool) error {
+	prog, err := ebpf.LoadPinnedProgram(mode.pinPath(), nil)
 	if err != nil {
-		return fmt.Errorf("eBPF TC 程序未初始化或未 pin 住: %v", err)
+		return fmt.Errorf("eBPF TC 程序 (%s) 未初始化或未 pin 住: %v", mode, err)
 	}
 	defer prog.Close()
 
+	var ingressProg *ebpf.Program
+	if ingress {
+		ingressProg, err = ebpf.LoadPinnedProgram(ingressPinPath, nil)
+		if err != nil {
+			return fmt.Errorf("eBPF TC 入口程序未初始化或未 pin 住: %v", err)
+		}
+		defer ingressProg.Close()
+	}
+	return attachPrograms(iface, prog, ingressProg)
+}
+
+// attachPrograms 在接口上创建 clsact 与 fq 并挂载出口程序，ingressProg 非空时同时挂载入口程序
+func attachPrograms(iface netlink.Link, prog, ingressProg *ebpf.Program) error {
 	// Create clsact qdisc
 	if _, err := CreateClsactQdisc(iface); err != nil {
 		return fmt.Errorf("Create clsact qdisc failed: %v", err)
 	}
-	
+
 	// Create fq qdisc
 	if _, err := CreateFQdisc(iface); err != nil {
 		return fmt.Errorf("Create fq qdisc failed: %v", err)
@@ -202,25 +374,31 @@ func AttachTC(iface netlink.Link) error {
 
 	// 固定使用egress方向
 	handle := uint32(netlink.HANDLE_MIN_EGRESS)
-	
+
 	// Attach bpf program
 	if _, err := CreateTCBpfFilter(iface, prog.FD(), handle, "edt_bandwidth"); err != nil {
 		return fmt.Errorf("Create bpf filter failed: %v", err)
 	}
 
+	if ingressProg != nil {
+		// 入口方向不需要 ifb：程序设置单调时钟 delivery time，由出口设备上的 fq 按时间出队
+		if _, err := CreateTCBpfFilter(iface, ingressProg.FD(), uint32(netlink.HANDLE_MIN_INGRESS), "edt_ingress"); err != nil {
+			return fmt.Errorf("Create ingress bpf filter failed: %v", err)
+		}
+	}
+
 	return nil
 }
 
 // AttachTCByName 通过接口名称附加
-func AttachTCByName(ifname string) error {
+func AttachTCByName(ifname string, mode Mode, ingress bool) error {
 	iface, err := netlink.LinkByName(ifname)
 	if err != nil {
 		return fmt.Errorf("查找网络接口 %q 失败: %v", ifname, err)
 	}
-	return AttachTC(iface)	
+	return AttachTC(iface, mode, ingress)
 }
 
-
 // DetachTC 从指定的 netlink.Link 网络接口上卸载 TC 程序
 func DetachTC(iface netlink.Link) error {
 	if err := ClearEbpf(iface); err != nil {
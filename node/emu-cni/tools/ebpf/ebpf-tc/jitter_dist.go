@@ -0,0 +1,62 @@
+package ebpftc
+
+import (
+	"errors"
+	"fmt"
+	"math"
+
+	"github.com/cilium/ebpf"
+)
+
+// 需与 maps.h 中的 JITTER_DIST_* 保持一致
+const (
+	jitterDistSize  = 4096
+	jitterDistShift = 13
+	paretoAlpha     = 3
+)
+
+// jitterDistTables 按 JITTER_DIST_NORMAL、JITTER_DIST_PARETO 的顺序生成分位数表。
+// 两种分布都归一化为均值 0、标准差 1，数据面乘以 jitter 即得到以 jitter 为标准差的抖动
+func jitterDistTables() [][]int32 {
+	normal := make([]int32, jitterDistSize)
+	pareto := make([]int32, jitterDistSize)
+
+	// Pareto(alpha=3, xm=1): 均值 alpha/(alpha-1)，方差 alpha/((alpha-1)^2 (alpha-2))
+	mean := float64(paretoAlpha) / (paretoAlpha - 1)
+	std := math.Sqrt(float64(paretoAlpha) / ((paretoAlpha - 1) * (paretoAlpha - 1) * (paretoAlpha - 2)))
+	scale := float64(int(1) << jitterDistShift)
+
+	for i := 0; i < jitterDistSize; i++ {
+		p := (float64(i) + 0.5) / jitterDistSize
+		normal[i] = int32(math.Round(math.Sqrt2 * math.Erfinv(2*p-1) * scale))
+		x := math.Pow(1-p, -1.0/paretoAlpha)
+		pareto[i] = int32(math.Round((x - mean) / std * scale))
+	}
+	return [][]int32{normal, pareto}
+}
+
+// fillJitterDist 把分布表写入 EMU_JITTER_DIST
+func fillJitterDist(m *ebpf.Map) error {
+	tables := jitterDistTables()
+	keys := make([]uint32, 0, len(tables)*jitterDistSize)
+	values := make([]int32, 0, len(tables)*jitterDistSize)
+	for d, table := range tables {
+		for i, v := range table {
+			keys = append(keys, uint32(d*jitterDistSize+i))
+			values = append(values, v)
+		}
+	}
+
+	_, err := m.BatchUpdate(keys, values, nil)
+	if errors.Is(err, ebpf.ErrNotSupported) {
+		for i := range keys {
+			if err = m.Put(keys[i], values[i]); err != nil {
+				break
+			}
+		}
+	}
+	if err != nil {
+		return fmt.Errorf("写入抖动分布表失败: %v", err)
+	}
+	return nil
+}
@@ -0,0 +1,115 @@
+#include <linux/if_ether.h> // 引入ETH_ALEN定义
+#include <linux/bpf.h>        // 引入BPF相关定义
+
+/*
+ * 快速路径读取的 TC 仿真 map。以下定义需与 ebpf-tc-c/header/maps.h 保持一致：
+ * 这里均不 pin，由 ebpfxdp.InitWithOptions 在加载时替换为 /sys/fs/bpf/tc_emu/maps 下已 pin 住的 map，
+ * XDP 与 TC 看到的是同一份规则
+ */
+
+#define FLOW_DIR_INGRESS (1U << 31)
+
+struct flow_key {
+    unsigned int ifindex;        // 网卡接口索引 (入口方向置 FLOW_DIR_INGRESS)
+    unsigned char src_mac[ETH_ALEN];  // 源MAC地址 (入口方向为目的MAC)
+} __attribute__((packed));
+
+typedef struct handle_emu {
+    __u64 throttle_rate_bps;
+    __u64 ns_per_byte_fp;
+    __u32 delay;
+    __u32 loss_rate;
+    __u32 jitter;
+    __u32 profile_id;
+    __u32 ge_p;
+    __u32 ge_r;
+    __u32 ge_loss_bad;
+    __u32 queue_limit_ns;
+    __u32 red_min_ns;
+    __u32 red_max_ns;
+    __u32 red_max_p;
+    __u32 aqm_flags;
+    __u32 group_id;
+    __u32 trace_id;
+    __u32 jitter_dist;
+    __u32 jitter_flags;
+    __u32 dup_rate;
+    __u32 corrupt_rate;
+    __u32 reorder_rate;
+    __u32 reorder_gap;
+    __u32 impair_flags;
+    __u32 reserved;
+} HANDLE_EMU;
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __type(key, struct flow_key);
+    __type(value, struct handle_emu);
+    __uint(max_entries, 65535);
+} MAC_HANDLE_EMU SEC(".maps");
+
+#define EMU_TABLE_SLOTS 2
+
+struct emu_table {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __type(key, struct flow_key);
+    __type(value, struct handle_emu);
+    __uint(max_entries, 65535);
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+    __type(key, __u32);
+    __uint(max_entries, EMU_TABLE_SLOTS);
+    __array(values, struct emu_table);
+} EMU_TABLES SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, __u32);
+    __uint(max_entries, 1);
+} EMU_EPOCH SEC(".maps");
+
+#define MAX_IFACE_TABLES    4096
+#define IFACE_TABLE_ENTRIES 4096
+
+struct iface_table {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __type(key, struct flow_key);
+    __type(value, struct handle_emu);
+    __uint(max_entries, IFACE_TABLE_ENTRIES);
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH_OF_MAPS);
+    __type(key, __u32);
+    __uint(max_entries, MAX_IFACE_TABLES);
+    __array(values, struct iface_table);
+} EMU_IFACE_TABLES SEC(".maps");
+
+#define MAX_IFACE_AGG 65536
+
+struct agg_cfg {
+    __u64 throttle_rate_bps;
+    __u64 ns_per_byte_fp;
+    __u32 queue_limit_ns;
+    __u32 reserved;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct agg_cfg);
+    __uint(max_entries, MAX_IFACE_AGG);
+} EMU_IFACE_AGG SEC(".maps");
+
+#define CLASS_F_MASK          0x7
+#define CLASS_F_INGRESS_SHIFT 4
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, __u32);
+    __uint(max_entries, MAX_IFACE_AGG);
+} EMU_CLASS_IFACES SEC(".maps");
@@ -4,15 +4,16 @@
 #include <linux/if_ether.h>
 #include <bpf/bpf_helpers.h>
 
-// 调试宏: 开启后通过 /sys/kernel/debug/tracing/trace_pipe 查看 
-// 生产环境建议注释掉或减少日志量 
-#define DEBUG 1 
-
-#ifdef DEBUG 
-#define bpf_debug(fmt, ...) bpf_printk(fmt, ##__VA_ARGS__) 
-#else 
-#define bpf_debug(fmt, ...) 
-#endif
+// 调试开关: 加载期常量 (.rodata)，由 ebpfxdp.InitWithOptions 在加载前设置。
+// 默认关闭，verifier 会把 bpf_debug 整段裁剪掉，生产环境零开销；
+// 开启后通过 /sys/kernel/debug/tracing/trace_pipe 查看
+volatile const __u32 debug_enabled = 0;
+
+#define bpf_debug(fmt, ...)                     \
+    do {                                        \
+        if (debug_enabled)                      \
+            bpf_printk(fmt, ##__VA_ARGS__);     \
+    } while (0)
 
 // 这是一个辅助宏，用于现代化的 Map 定义
 // 位于 <bpf/bpf_helpers.h> 中，如果未定义需手动补充，但通常 libbpf 开发包里都有
@@ -20,6 +21,16 @@
 #define __type(name, val) typeof(val) *name
 #endif
 
+#include "header/emu_maps.h"
+
+/*
+ * 快速路径 (加载期常量)：fast_path = 1 时只有两个方向都没有损伤的单播才直接重定向，
+ * 带损伤的链路交给内核栈，经过目的 veth 上的 fq 与 TC 仿真程序。
+ * 为 0 时命中 mac_table 即重定向 (不经过 TC 仿真)。iface_tables 与 TC 侧的规则表布局一致
+ */
+volatile const __u32 fast_path = 0;
+volatile const __u32 iface_tables = 0;
+
 // 定义 MAC 地址 Key 结构
 struct mac_key {
     unsigned char mac[6];
@@ -52,6 +63,105 @@ struct {
 
 } tx_ports SEC(".maps");
 
+// ============================================================
+// 3. 转发结果计数 (Per-CPU Array)
+// ============================================================
+// 替代逐包 bpf_printk，用户态通过 ebpfxdp.ReadStats 汇总各 CPU 计数
+enum xdp_stat {
+    XDP_STAT_BROADCAST = 0,     // 广播/组播，经 devmap 广播
+    XDP_STAT_REDIRECT,          // 单播命中 mac_table，重定向
+    XDP_STAT_UNKNOWN_UNICAST,   // 单播未命中，交给内核栈
+    XDP_STAT_SHORT,             // 包长不足以太网头，丢弃
+    XDP_STAT_EMU,               // 快速路径下链路带损伤，交给内核栈与 TC 仿真
+    XDP_STAT_MAX,
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, XDP_STAT_MAX);
+    __type(key, __u32);
+    __type(value, __u64);
+    __uint(pinning, LIBBPF_PIN_BY_NAME); // pin map by name
+} xdp_stats SEC(".maps");
+
+static __always_inline void xdp_stat_inc(__u32 idx)
+{
+    __u64 *cnt = bpf_map_lookup_elem(&xdp_stats, &idx);
+    if (cnt)
+        *cnt += 1;
+}
+
+// emu_rule_lookup 与 TC 侧同名函数一致：按布局与当前 epoch 选择规则表
+static __always_inline struct handle_emu *emu_rule_lookup(struct flow_key *key)
+{
+    if (iface_tables) {
+        __u32 ifindex = key->ifindex;
+        void *table = bpf_map_lookup_elem(&EMU_IFACE_TABLES, &ifindex);
+        if (!table)
+            return 0;
+        return bpf_map_lookup_elem(table, key);
+    }
+
+    __u32 zero = 0;
+    __u32 *epoch = bpf_map_lookup_elem(&EMU_EPOCH, &zero);
+
+    if (epoch && *epoch) {
+        __u32 slot = (*epoch - 1) & (EMU_TABLE_SLOTS - 1);
+        void *table = bpf_map_lookup_elem(&EMU_TABLES, &slot);
+        if (!table)
+            return 0;
+        return bpf_map_lookup_elem(table, key);
+    }
+    return bpf_map_lookup_elem(&MAC_HANDLE_EMU, key);
+}
+
+/*
+ * emu_rule_clean 判断一个方向是否无损伤：没有规则，或规则的各项损伤均为 0。
+ * 绑定模板、轨迹或共享组的规则参数不在规则本身，一律视为有损伤
+ */
+static __always_inline int emu_rule_clean(struct flow_key *key)
+{
+    struct handle_emu *val = emu_rule_lookup(key);
+    if (!val)
+        return 1;
+    return !val->ns_per_byte_fp && !val->delay && !val->jitter && !val->loss_rate && !val->ge_p &&
+           !val->profile_id && !val->group_id && !val->trace_id &&
+           !val->dup_rate && !val->corrupt_rate && !val->reorder_rate;
+}
+
+// emu_iface_clean 判断接口的一个方向是否配置了接口聚合瓶颈 (仅出口) 或 L3/L4 分类
+static __always_inline int emu_iface_clean(__u32 ifindex, int ingress)
+{
+    if (ifindex >= MAX_IFACE_AGG)
+        return 1;
+    if (!ingress) {
+        struct agg_cfg *cfg = bpf_map_lookup_elem(&EMU_IFACE_AGG, &ifindex);
+        if (cfg && cfg->ns_per_byte_fp)
+            return 0;
+    }
+    __u32 *flags = bpf_map_lookup_elem(&EMU_CLASS_IFACES, &ifindex);
+    if (flags && ((*flags >> (ingress ? CLASS_F_INGRESS_SHIFT : 0)) & CLASS_F_MASK))
+        return 0;
+    return 1;
+}
+
+/*
+ * emu_fast_path_ok 判断重定向是否会绕过仿真：重定向同时跳过源 veth 的 TC 入口 (上行规则)
+ * 与目的 veth 的 TC 出口 (下行规则)，两个方向都无损伤时才可直接转发
+ */
+static __always_inline int emu_fast_path_ok(__u32 src_ifindex, __u32 dst_ifindex, struct ethhdr *eth)
+{
+    // 下行：目的 veth 出口，键为 (目的 ifindex, 源 MAC)
+    struct flow_key key = { .ifindex = dst_ifindex };
+    __builtin_memcpy(key.src_mac, eth->h_source, ETH_ALEN);
+    if (!emu_iface_clean(dst_ifindex, 0) || !emu_rule_clean(&key))
+        return 0;
+
+    // 上行：源 veth 入口，键为 (源 ifindex | FLOW_DIR_INGRESS, 目的 MAC)
+    key.ifindex = src_ifindex | FLOW_DIR_INGRESS;
+    __builtin_memcpy(key.src_mac, eth->h_dest, ETH_ALEN);
+    return emu_iface_clean(src_ifindex, 1) && emu_rule_clean(&key);
+}
 
 SEC("xdp")
 int xdp_l2_fwd_prog(struct xdp_md *ctx) {
@@ -66,6 +176,7 @@ int xdp_l2_fwd_prog(struct xdp_md *ctx) {
     // 1. 包长度检查 (Verifier 必须)
     if ((void *)(eth + 1) > data_end) {
         bpf_debug("XDP: Packet too short, dropping\n");
+        xdp_stat_inc(XDP_STAT_SHORT);
         return XDP_DROP;
     }
 
@@ -74,6 +185,7 @@ int xdp_l2_fwd_prog(struct xdp_md *ctx) {
     // 广播地址 FF:FF:FF:FF:FF:FF 的最低位也是 1
     if (eth->h_dest[0] & 1) {
         bpf_debug("XDP: Broadcast/Multicast packet, broadcasting via devmap\n");
+        xdp_stat_inc(XDP_STAT_BROADCAST);
         // 使用 BPF_F_BROADCAST 标志实现广播转发
         // BPF_F_EXCLUDE_INGRESS 确保数据包不会回发到入站接口
         return bpf_redirect_map(&tx_ports, 0, BPF_F_BROADCAST | BPF_F_EXCLUDE_INGRESS);
@@ -88,16 +200,25 @@ int xdp_l2_fwd_prog(struct xdp_md *ctx) {
     __u32 *dest_ifindex = bpf_map_lookup_elem(&mac_table, &key);
 
     if (dest_ifindex) {
+        // 快速路径：链路带损伤时交给内核栈，由 TC 仿真处理
+        if (fast_path && !emu_fast_path_ok(ifindex, *dest_ifindex, eth)) {
+            bpf_debug("XDP: Impaired link to ifindex %d, passing to TC\n", *dest_ifindex);
+            xdp_stat_inc(XDP_STAT_EMU);
+            return XDP_PASS;
+        }
+
         // 5. 执行重定向
         // 如果找到了目标 ifindex，通过 devmap 转发
         // 注意：用户态程序必须先将该 ifindex 添加到 tx_ports map 中
         bpf_debug("XDP: Forwarding packet to ifindex %d\n", *dest_ifindex);
+        xdp_stat_inc(XDP_STAT_REDIRECT);
         return bpf_redirect_map(&tx_ports, *dest_ifindex, 0);
     }
 
     // 6. 未知单播 -> 交给内核栈 (Bridge/Routing)
     // 这样可以处理未命中缓存的情况，保证网络不断
     bpf_debug("XDP: Unknown unicast packet, passing to kernel\n");
+    xdp_stat_inc(XDP_STAT_UNKNOWN_UNICAST);
     return XDP_PASS;
 }
 
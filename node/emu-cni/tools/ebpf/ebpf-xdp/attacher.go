@@ -0,0 +1,73 @@
+package ebpfxdp
+
+import (
+	"fmt"
+	"net"
+	"sync"
+
+	"github.com/cilium/ebpf"
+	"github.com/vishvananda/netlink"
+)
+
+// Attacher 供常驻进程 (node agent) 挂载 XDP 程序：对象只在首次挂载时加载，
+// 之后复用已打开的 pin 住的程序与转发表，每次挂载只剩 map 写入与 netlink 操作
+type Attacher struct {
+	mu       sync.Mutex
+	prog     *ebpf.Program
+	txPorts  *ebpf.Map
+	macTable *ebpf.Map
+}
+
+// NewAttacher 创建 Attacher，eBPF 对象延迟到第一次 Attach 时加载
+func NewAttacher() *Attacher {
+	return &Attacher{}
+}
+
+// Attach 登记 Pod 的转发表项后在 ifindex 上挂载 XDP 程序；opts 仅在节点首次加载 eBPF 对象时生效，
+// 与 InitWithOptions 一致。先写 devmap 与 mac_table，挂载后重定向到该 Pod 的包不会因表项缺失而丢弃
+func (a *Attacher) Attach(ifindex int, mac net.HardwareAddr, opts Options) error {
+	a.mu.Lock()
+	defer a.mu.Unlock()
+
+	if err := a.open(opts); err != nil {
+		return err
+	}
+	if err := updateDevMap(a.txPorts, uint32(ifindex)); err != nil {
+		return err
+	}
+	if err := updateFwdRule(a.macTable, mac, uint32(ifindex)); err != nil {
+		return err
+	}
+	iface, err := netlink.LinkByIndex(ifindex)
+	if err != nil {
+		return fmt.Errorf("查找网络接口 %d 失败: %v", ifindex, err)
+	}
+	return attachProgram(iface, a.prog)
+}
+
+// open 在首次调用时初始化对象并打开 pin 住的程序与转发表
+func (a *Attacher) open(opts Options) error {
+	if a.prog != nil {
+		return nil
+	}
+	if err := InitWithOptions(opts); err != nil {
+		return fmt.Errorf("xdp init failed: %v", err)
+	}
+	prog, err := ebpf.LoadPinnedProgram(defaultPinPath, nil)
+	if err != nil {
+		return fmt.Errorf("eBPF XDP 程序未初始化或未 pin 住: %v", err)
+	}
+	txPorts, err := ebpf.LoadPinnedMap(defaultMapPinPath+"/tx_ports", nil)
+	if err != nil {
+		prog.Close()
+		return fmt.Errorf("加载 pin 住的 tx_ports 失败: %v", err)
+	}
+	macTable, err := ebpf.LoadPinnedMap(defaultMapPinPath+"/mac_table", nil)
+	if err != nil {
+		prog.Close()
+		txPorts.Close()
+		return fmt.Errorf("加载 pin 住的 mac_table 失败: %v", err)
+	}
+	a.prog, a.txPorts, a.macTable = prog, txPorts, macTable
+	return nil
+}
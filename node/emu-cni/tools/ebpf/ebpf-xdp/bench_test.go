@@ -0,0 +1,122 @@
+package ebpfxdp
+
+import (
+	"encoding/binary"
+	"fmt"
+	"testing"
+
+	"github.com/cilium/ebpf"
+	"github.com/cilium/ebpf/rlimit"
+)
+
+// 转发面微基准：通过 BPF_PROG_TEST_RUN 重复执行 xdp_l2_fwd_prog，报告每包耗时 (ns/pkt)。
+// 需要 root (CAP_BPF)，权限不足时跳过；运行方式见 Makefile 的 bench 目标
+
+// benchMapSizes 为 mac_table 的容量，表按容量填满
+var benchMapSizes = []uint32{1024, 65535, 1 << 20}
+
+// benchDstIfindex 为所有转发规则的目的接口，快速路径在其出口方向查找 TC 规则
+const benchDstIfindex = 100
+
+func benchMAC(i uint32) [6]uint8 {
+	var mac [6]uint8
+	mac[0] = 0x02
+	binary.BigEndian.PutUint32(mac[2:], i)
+	return mac
+}
+
+// benchSrcMAC 为测试帧的源 MAC，快速路径的损伤规则以它为键
+var benchSrcMAC = [6]uint8{0x02, 0xfe, 0, 0, 0, 1}
+
+// benchFrame 构造一个 128 字节的 IPv4/UDP 帧，目的 MAC 为 dst
+func benchFrame(dst [6]uint8) []byte {
+	pkt := make([]byte, 128)
+	copy(pkt[0:6], dst[:])
+	copy(pkt[6:12], benchSrcMAC[:])
+	binary.BigEndian.PutUint16(pkt[12:], 0x0800)
+	ip := pkt[14:]
+	ip[0] = 0x45
+	binary.BigEndian.PutUint16(ip[2:], uint16(len(pkt)-14))
+	ip[8] = 64
+	ip[9] = 17
+	return pkt
+}
+
+// loadBench 加载一份不 pin 的对象并填满容量为 entries 的 mac_table；fastPath 时规则表为对象自带的
+// 未共享副本，由调用方按需写入。对象在子基准外加载一次，由调用方关闭
+func loadBench(b *testing.B, entries uint32, fastPath bool) *bpfObjects {
+	b.Helper()
+	if err := rlimit.RemoveMemlock(); err != nil {
+		b.Skipf("移除内存锁定限制失败 (需要 root): %v", err)
+	}
+	spec, err := loadBpf()
+	if err != nil {
+		b.Fatalf("读取 eBPF 对象失败: %v", err)
+	}
+	if err := spec.Variables["fast_path"].Set(boolU32(fastPath)); err != nil {
+		b.Fatal(err)
+	}
+	spec.Maps["mac_table"].MaxEntries = entries
+	for _, m := range spec.Maps {
+		m.Pinning = ebpf.PinNone
+	}
+
+	var objs bpfObjects
+	if err := spec.LoadAndAssign(&objs, nil); err != nil {
+		b.Skipf("加载 eBPF 对象失败 (需要 root 与 BPF 权限): %v", err)
+	}
+	for i := uint32(0); i < entries; i++ {
+		if err := objs.MacTable.Put(bpfMacKey{Mac: benchMAC(i)}, uint32(benchDstIfindex)); err != nil {
+			objs.Close()
+			b.Fatalf("填充第 %d 条转发规则失败: %v", i, err)
+		}
+	}
+	return &objs
+}
+
+func boolU32(v bool) uint32 {
+	if v {
+		return 1
+	}
+	return 0
+}
+
+func runBench(b *testing.B, prog *ebpf.Program, pkt []byte) {
+	b.Helper()
+	b.ResetTimer()
+	_, perRun, err := prog.Benchmark(pkt, b.N, nil)
+	if err != nil {
+		b.Fatalf("BPF_PROG_TEST_RUN 失败: %v", err)
+	}
+	b.ReportMetric(float64(perRun.Nanoseconds()), "ns/pkt")
+}
+
+func BenchmarkXDP(b *testing.B) {
+	for _, size := range benchMapSizes {
+		hit := benchFrame(benchMAC(size / 2))
+
+		objs := loadBench(b, size, false)
+		b.Run(fmt.Sprintf("redirect/entries=%d", size), func(b *testing.B) {
+			runBench(b, objs.XdpL2FwdProg, hit)
+		})
+		b.Run(fmt.Sprintf("unknown/entries=%d", size), func(b *testing.B) {
+			runBench(b, objs.XdpL2FwdProg, benchFrame(benchMAC(1<<31)))
+		})
+		objs.Close()
+
+		// 快速路径：无损伤时多两次规则查找后仍重定向，有损伤时交给内核栈 (XDP_PASS)
+		objs = loadBench(b, size, true)
+		b.Run(fmt.Sprintf("fast_path_clean/entries=%d", size), func(b *testing.B) {
+			runBench(b, objs.XdpL2FwdProg, hit)
+		})
+		key := bpfFlowKey{Ifindex: benchDstIfindex, SrcMac: benchSrcMAC}
+		if err := objs.MacHandleEmu.Put(key, bpfHandleEmu{Delay: 10000}); err != nil {
+			objs.Close()
+			b.Fatalf("写入损伤规则失败: %v", err)
+		}
+		b.Run(fmt.Sprintf("fast_path_impaired/entries=%d", size), func(b *testing.B) {
+			runBench(b, objs.XdpL2FwdProg, hit)
+		})
+		objs.Close()
+	}
+}
@@ -13,6 +13,14 @@ import (
 	"github.com/cilium/ebpf"
 )
 
+type bpfAggCfg struct {
+	_               structs.HostLayout
+	ThrottleRateBps uint64
+	NsPerByteFp     uint64
+	QueueLimitNs    uint32
+	Reserved        uint32
+}
+
 type bpfBpfDevmapVal struct {
 	_       structs.HostLayout
 	Ifindex uint32
@@ -22,6 +30,40 @@ type bpfBpfDevmapVal struct {
 	}
 }
 
+type bpfFlowKey struct {
+	_       structs.HostLayout
+	Ifindex uint32
+	SrcMac  [6]uint8
+}
+
+type bpfHandleEmu struct {
+	_               structs.HostLayout
+	ThrottleRateBps uint64
+	NsPerByteFp     uint64
+	Delay           uint32
+	LossRate        uint32
+	Jitter          uint32
+	ProfileId       uint32
+	GeP             uint32
+	GeR             uint32
+	GeLossBad       uint32
+	QueueLimitNs    uint32
+	RedMinNs        uint32
+	RedMaxNs        uint32
+	RedMaxP         uint32
+	AqmFlags        uint32
+	GroupId         uint32
+	TraceId         uint32
+	JitterDist      uint32
+	JitterFlags     uint32
+	DupRate         uint32
+	CorruptRate     uint32
+	ReorderRate     uint32
+	ReorderGap      uint32
+	ImpairFlags     uint32
+	Reserved        uint32
+}
+
 type bpfMacKey struct {
 	_   structs.HostLayout
 	Mac [6]uint8
@@ -86,14 +128,24 @@ type bpfProgramSpecs struct {
 //
 // It can be passed ebpf.CollectionSpec.Assign.
 type bpfMapSpecs struct {
-	MacTable *ebpf.MapSpec `ebpf:"mac_table"`
-	TxPorts  *ebpf.MapSpec `ebpf:"tx_ports"`
+	EmuClassIfaces *ebpf.MapSpec `ebpf:"EMU_CLASS_IFACES"`
+	EmuEpoch       *ebpf.MapSpec `ebpf:"EMU_EPOCH"`
+	EmuIfaceAgg    *ebpf.MapSpec `ebpf:"EMU_IFACE_AGG"`
+	EmuIfaceTables *ebpf.MapSpec `ebpf:"EMU_IFACE_TABLES"`
+	EmuTables      *ebpf.MapSpec `ebpf:"EMU_TABLES"`
+	MacHandleEmu   *ebpf.MapSpec `ebpf:"MAC_HANDLE_EMU"`
+	MacTable       *ebpf.MapSpec `ebpf:"mac_table"`
+	TxPorts        *ebpf.MapSpec `ebpf:"tx_ports"`
+	XdpStats       *ebpf.MapSpec `ebpf:"xdp_stats"`
 }
 
 // bpfVariableSpecs contains global variables before they are loaded into the kernel.
 //
 // It can be passed ebpf.CollectionSpec.Assign.
 type bpfVariableSpecs struct {
+	DebugEnabled *ebpf.VariableSpec `ebpf:"debug_enabled"`
+	FastPath     *ebpf.VariableSpec `ebpf:"fast_path"`
+	IfaceTables  *ebpf.VariableSpec `ebpf:"iface_tables"`
 }
 
 // bpfObjects contains all objects after they have been loaded into the kernel.
@@ -116,14 +168,28 @@ func (o *bpfObjects) Close() error {
 //
 // It can be passed to loadBpfObjects or ebpf.CollectionSpec.LoadAndAssign.
 type bpfMaps struct {
-	MacTable *ebpf.Map `ebpf:"mac_table"`
-	TxPorts  *ebpf.Map `ebpf:"tx_ports"`
+	EmuClassIfaces *ebpf.Map `ebpf:"EMU_CLASS_IFACES"`
+	EmuEpoch       *ebpf.Map `ebpf:"EMU_EPOCH"`
+	EmuIfaceAgg    *ebpf.Map `ebpf:"EMU_IFACE_AGG"`
+	EmuIfaceTables *ebpf.Map `ebpf:"EMU_IFACE_TABLES"`
+	EmuTables      *ebpf.Map `ebpf:"EMU_TABLES"`
+	MacHandleEmu   *ebpf.Map `ebpf:"MAC_HANDLE_EMU"`
+	MacTable       *ebpf.Map `ebpf:"mac_table"`
+	TxPorts        *ebpf.Map `ebpf:"tx_ports"`
+	XdpStats       *ebpf.Map `ebpf:"xdp_stats"`
 }
 
 func (m *bpfMaps) Close() error {
 	return _BpfClose(
+		m.EmuClassIfaces,
+		m.EmuEpoch,
+		m.EmuIfaceAgg,
+		m.EmuIfaceTables,
+		m.EmuTables,
+		m.MacHandleEmu,
 		m.MacTable,
 		m.TxPorts,
+		m.XdpStats,
 	)
 }
 
@@ -131,6 +197,9 @@ func (m *bpfMaps) Close() error {
 //
 // It can be passed to loadBpfObjects or ebpf.CollectionSpec.LoadAndAssign.
 type bpfVariables struct {
+	DebugEnabled *ebpf.Variable `ebpf:"debug_enabled"`
+	FastPath     *ebpf.Variable `ebpf:"fast_path"`
+	IfaceTables  *ebpf.Variable `ebpf:"iface_tables"`
 }
 
 // bpfPrograms contains all programs after they have been loaded into the kernel.
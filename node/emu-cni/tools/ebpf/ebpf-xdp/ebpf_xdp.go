@@ -18,10 +18,40 @@ const (
 	defaultDir        = "/sys/fs/bpf/xdp_bridge"
 	defaultPinPath    = "/sys/fs/bpf/xdp_bridge/program"
 	defaultMapPinPath = "/sys/fs/bpf/xdp_bridge/maps"
+	// tcMapPinPath 为 TC 仿真程序 pin 住的 map 目录，快速路径从这里读取仿真规则
+	tcMapPinPath = "/sys/fs/bpf/tc_emu/maps"
 )
 
-// Init 初始化 eBPF XDP 程序
+// tcMaps 为快速路径需要共享的 TC 仿真 map，EMU_IFACE_TABLES 仅在 TC 启用按接口分表时存在
+var tcMaps = []string{"MAC_HANDLE_EMU", "EMU_EPOCH", "EMU_TABLES", "EMU_IFACE_AGG", "EMU_CLASS_IFACES"}
+
+const tcIfaceTablesMap = "EMU_IFACE_TABLES"
+
+// Options 控制 eBPF XDP 对象的加载期参数，仅在首次加载 (尚未 pin 住) 时生效
+type Options struct {
+	// Debug 开启逐包 bpf_printk，仅用于排障，会显著降低转发吞吐
+	Debug bool
+	// FastPath 只对两个方向都无损伤的链路直接重定向，带损伤的单播交给内核栈经过 TC 仿真。
+	// 需先加载 TC 仿真程序；关闭时命中 mac_table 的单播一律重定向，会绕过仿真
+	FastPath bool
+}
+
+// Stats 为 xdp_stats 中各转发结果在所有 CPU 上的累计值
+type Stats struct {
+	Broadcast      uint64 // 广播/组播
+	Redirect       uint64 // 单播命中 mac_table 并重定向
+	UnknownUnicast uint64 // 单播未命中，交给内核栈
+	Short          uint64 // 包长不足被丢弃
+	Emu            uint64 // 快速路径下链路带损伤，交给内核栈
+}
+
+// Init 使用默认参数 (关闭调试输出) 初始化 eBPF XDP 程序
 func Init() error {
+	return InitWithOptions(Options{})
+}
+
+// InitWithOptions 初始化 eBPF XDP 程序
+func InitWithOptions(opts Options) error {
 	// 1. 幂等性检查
 	prog, err := ebpf.LoadPinnedProgram(defaultPinPath, nil)
 	if err == nil {
@@ -29,7 +59,7 @@ func Init() error {
 		return nil
 	}
 	if !os.IsNotExist(err) {
-		fmt.Printf("警告: 检查 Pin 程序时发生意外错误: %v\n", err)
+		fmt.Fprintf(os.Stderr, "警告: 检查 Pin 程序时发生意外错误: %v\n", err)
 	}
 
 	// 2. 移除内存锁定限制
@@ -48,9 +78,31 @@ func Init() error {
 		PinPath: defaultMapPinPath,
 	}
 
-	// 5. 加载编译后的 eBPF 对象
+	// 5. 设置加载期常量并加载编译后的 eBPF 对象
+	spec, err := loadBpf()
+	if err != nil {
+		return fmt.Errorf("读取 eBPF 对象失败: %v", err)
+	}
+	debug := uint32(0)
+	if opts.Debug {
+		debug = 1
+	}
+	if err := spec.Variables["debug_enabled"].Set(debug); err != nil {
+		return fmt.Errorf("设置调试开关失败: %v", err)
+	}
+	if opts.FastPath {
+		shared, err := shareTCMaps(spec, loadOpts)
+		if err != nil {
+			return err
+		}
+		defer func() {
+			for _, m := range shared {
+				m.Close()
+			}
+		}()
+	}
 	var objs bpfObjects
-	if err := loadBpfObjects(&objs, loadOpts); err != nil {
+	if err := spec.LoadAndAssign(&objs, loadOpts); err != nil {
 		return fmt.Errorf("加载 eBPF 对象失败: %v", err)
 	}
 	defer objs.Close()
@@ -63,6 +115,65 @@ func Init() error {
 	return nil
 }
 
+// shareTCMaps 用 TC 仿真程序 pin 住的 map 替换对象中同名的 map，使 XDP 与 TC 读取同一份规则，
+// 并按 TC 侧的实际布局设置 fast_path / iface_tables 常量。返回的 map 需在加载完成后关闭
+func shareTCMaps(spec *ebpf.CollectionSpec, loadOpts *ebpf.CollectionOptions) ([]*ebpf.Map, error) {
+	shared := make(map[string]*ebpf.Map)
+	closeAll := func() {
+		for _, m := range shared {
+			m.Close()
+		}
+	}
+
+	names := append([]string{}, tcMaps...)
+	ifaceTables := uint32(0)
+	if _, err := os.Stat(tcMapPinPath + "/" + tcIfaceTablesMap); err == nil {
+		names = append(names, tcIfaceTablesMap)
+		ifaceTables = 1
+	}
+	for _, name := range names {
+		m, err := ebpf.LoadPinnedMap(tcMapPinPath+"/"+name, nil)
+		if err != nil {
+			closeAll()
+			return nil, fmt.Errorf("快速路径需先加载 TC 仿真程序，加载 %s 失败: %v", name, err)
+		}
+		shared[name] = m
+
+		// 容量由 CNI 的 maxEntries 决定，替换前与 TC 侧保持一致，否则内核拒绝替换
+		info, err := m.Info()
+		if err != nil {
+			closeAll()
+			return nil, fmt.Errorf("读取 %s 信息失败: %v", name, err)
+		}
+		ms, ok := spec.Maps[name]
+		if !ok {
+			closeAll()
+			return nil, fmt.Errorf("eBPF 对象中缺少 map %s", name)
+		}
+		ms.MaxEntries, ms.Flags = info.MaxEntries, info.Flags
+	}
+
+	consts := map[string]uint32{"fast_path": 1, "iface_tables": ifaceTables}
+	for name, val := range consts {
+		v, ok := spec.Variables[name]
+		if !ok {
+			closeAll()
+			return nil, fmt.Errorf("eBPF 对象中缺少常量 %s", name)
+		}
+		if err := v.Set(val); err != nil {
+			closeAll()
+			return nil, fmt.Errorf("设置常量 %s 失败: %v", name, err)
+		}
+	}
+
+	loadOpts.MapReplacements = shared
+	list := make([]*ebpf.Map, 0, len(shared))
+	for _, m := range shared {
+		list = append(list, m)
+	}
+	return list, nil
+}
+
 // Close 关闭 eBPF XDP 程序
 func Close() error {
 	err := os.RemoveAll(defaultDir)
@@ -111,9 +222,13 @@ func AttachXDP(iface netlink.Link) error {
 		return fmt.Errorf("eBPF XDP 程序未初始化或未 pin 住: %v", err)
 	}
 	defer prog.Close()
+	return attachProgram(iface, prog)
+}
 
+// attachProgram 优先以驱动模式挂载，失败时回退到通用模式
+func attachProgram(iface netlink.Link, prog *ebpf.Program) error {
 	// 尝试驱动模式
-	err = netlink.LinkSetXdpFdWithFlags(iface, prog.FD(), nl.XDP_FLAGS_DRV_MODE)
+	err := netlink.LinkSetXdpFdWithFlags(iface, prog.FD(), nl.XDP_FLAGS_DRV_MODE)
 	if err == nil {
 		return nil
 	}
@@ -189,7 +304,11 @@ func AddToDevMap(ifindex uint32) error {
     }
     defer devMap.Close()
 
-    // 对于 DEVMAP_HASH, Key 是 ifindex, Value 是 bpf_devmap_val
+    return updateDevMap(devMap, ifindex)
+}
+
+// updateDevMap 对于 DEVMAP_HASH, Key 是 ifindex, Value 是 bpf_devmap_val
+func updateDevMap(devMap *ebpf.Map, ifindex uint32) error {
     // bpf_devmap_val 结构体简单来说只需要填 ifindex (fd设为0)
     key := ifindex
     val := struct {
@@ -212,6 +331,10 @@ func UpdateFwdRule(macAddr []byte, targetIfIndex uint32) error {
     }
     defer macMap.Close()
 
+    return updateFwdRule(macMap, macAddr, targetIfIndex)
+}
+
+func updateFwdRule(macMap *ebpf.Map, macAddr []byte, targetIfIndex uint32) error {
     // Key 需要匹配 C 代码中的 struct mac_key
     key := struct{ Mac [6]byte }{}  
     copy(key.Mac[:], macAddr)
@@ -278,4 +401,28 @@ func DeleteAllFwdRulesByIfIndex(targetIfIndex uint32) error {
     }
 
     return nil
-}
\ No newline at end of file
+}
+
+// 6. 读取转发结果计数 (累加所有 CPU)
+func ReadStats() (*Stats, error) {
+    statsMap, err := ebpf.LoadPinnedMap(defaultMapPinPath+"/xdp_stats", nil)
+    if err != nil {
+        return nil, fmt.Errorf("加载 pin 住的 xdp_stats 失败: %v", err)
+    }
+    defer statsMap.Close()
+
+    // 下标需与 xdp_bpf.c 中 enum xdp_stat 保持一致
+    stats := &Stats{}
+    fields := []*uint64{&stats.Broadcast, &stats.Redirect, &stats.UnknownUnicast, &stats.Short, &stats.Emu}
+
+    for idx, field := range fields {
+        var perCPU []uint64
+        if err := statsMap.Lookup(uint32(idx), &perCPU); err != nil {
+            return nil, fmt.Errorf("读取 xdp_stats[%d] 失败: %v", idx, err)
+        }
+        for _, v := range perCPU {
+            *field += v
+        }
+    }
+    return stats, nil
+}
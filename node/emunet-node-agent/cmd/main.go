@@ -19,20 +19,34 @@ import (
 
 func main() {
 	var apiAddr string
+	var streamAddr string
+	var cniSocket string
 	var redisAddr string
 	var redisPassword string
 	var redisDB int
+	var statsInterval time.Duration
+	var nodeName string
+	var resyncTimeout time.Duration
 
 	// 1. 配置参数
 	// Agent 默认监听 12345
 	flag.StringVar(&apiAddr, "api-bind-address", ":12345", "The address the Agent API endpoint binds to.")
+	flag.StringVar(&cniSocket, "cni-socket", "/run/emunet/agent.sock", "The unix socket CNI ADD calls to attach programs and register pods. Empty disables it.")
+	flag.StringVar(&streamAddr, "stream-bind-address", ":12346", "The address the linkserver control stream binds to. Empty disables it.")
 
 	// Redis 配置 (Agent 通过 Service DNS 连接)
 	flag.StringVar(&redisAddr, "redis-addr", "emunet-redis.default.svc.cluster.local:6379", "The address of the Redis server")
 	flag.StringVar(&redisPassword, "redis-password", "", "The password of the Redis server")
 	flag.IntVar(&redisDB, "redis-db", 0, "The Redis database index")
+	flag.DurationVar(&statsInterval, "stats-interval", 5*time.Second, "How often LINK_STATS is aggregated for /metrics.")
+	// 节点名需与 linkserver 分发规则时使用的 Pod nodeName 一致 (DaemonSet 通过 downward API 注入 NODE_NAME)
+	flag.StringVar(&nodeName, "node-name", os.Getenv("NODE_NAME"), "The Kubernetes node this agent runs on, keys its rule snapshot in Redis. Defaults to $NODE_NAME, then the hostname.")
+	flag.DurationVar(&resyncTimeout, "resync-timeout", 30*time.Second, "Upper bound of the startup resync against the Redis rule snapshot.")
 
 	flag.Parse()
+	if nodeName == "" {
+		nodeName, _ = os.Hostname()
+	}
 
 	// 2. 初始化日志 (生产环境建议 JSON 格式)
 	config := zap.NewProductionConfig()
@@ -66,6 +80,44 @@ func main() {
 	// 注入 Redis 客户端，移除所有 K8s 相关依赖
 	agentServer := api.NewServer(redisClient)
 
+	// 重启对账：以 pin 住的规则表为基础只补写与 Redis 快照的差异，须在接受 linkserver 写入之前完成
+	resyncCtx, resyncCancel := context.WithTimeout(context.Background(), resyncTimeout)
+	if res, err := agentServer.Resync(resyncCtx, nodeName); err != nil {
+		logger.Errorw("Failed to resync rules from snapshot, keeping pinned tables as they are", "node", nodeName, "error", err)
+	} else {
+		logger.Infow("Resynced rules from snapshot", "node", nodeName, "version", res.Version,
+			"live", res.Live, "desired", res.Desired, "upserts", res.Upserts, "deletes", res.Deletes,
+			"unchanged", res.Unchanged, "stale", res.Stale, "pods", res.Pods, "duration", res.Duration)
+	}
+	resyncCancel()
+
+	// 链路统计后台采集，供 /metrics 导出
+	statsCtx, statsCancel := context.WithCancel(context.Background())
+	defer statsCancel()
+	agentServer.StartStatsCollector(statsCtx, statsInterval)
+	// 定时链路变更的本地调度
+	agentServer.StartScheduler(statsCtx)
+	// Pod 信息的 Redis 上报
+	agentServer.StartPodReporter(statsCtx)
+
+	// CNI ADD 通道 (失败时 CNI 退回本地挂载 + HTTP 登记)
+	if cniSocket != "" {
+		if err := agentServer.StartCNIServer(statsCtx, cniSocket); err != nil {
+			logger.Errorw("Failed to start CNI socket listener", "error", err)
+		} else {
+			logger.Infow("Listening for CNI calls", "socket", cniSocket)
+		}
+	}
+
+	// linkserver 规则增量长连接 (失败时 linkserver 退回 HTTP 批量接口)
+	if streamAddr != "" {
+		if err := agentServer.StartStreamServer(statsCtx, streamAddr); err != nil {
+			logger.Errorw("Failed to start control stream listener", "error", err)
+		} else {
+			logger.Infow("Listening for control streams", "address", streamAddr)
+		}
+	}
+
 	// 6. 配置 HTTP Server
 	server := &http.Server{
 		Addr:         apiAddr,
@@ -7,14 +7,21 @@ require (
 	github.com/gorilla/mux v1.8.1
 	github.com/redis/go-redis/v9 v9.17.3
 	go.uber.org/zap v1.27.0
+	golang.org/x/sys v0.38.0
 )
 
+// TC 程序由 agent 挂载，复用 CNI 中的 eBPF 对象与挂载逻辑
+require EMU_CNI v0.0.0
+
+replace EMU_CNI => ../emu-cni
+
 require (
 	github.com/cespare/xxhash/v2 v2.3.0 // indirect
 	github.com/dgryski/go-rendezvous v0.0.0-20200823014737-9f7001d12a5f // indirect
 	github.com/google/go-cmp v0.7.0 // indirect
 	github.com/rogpeppe/go-internal v1.13.1 // indirect
 	github.com/stretchr/testify v1.10.0 // indirect
+	github.com/vishvananda/netlink v1.3.1 // indirect
+	github.com/vishvananda/netns v0.0.5 // indirect
 	go.uber.org/multierr v1.11.0 // indirect
-	golang.org/x/sys v0.37.0 // indirect
 )
@@ -0,0 +1,89 @@
+package api
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"net/http"
+
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// 聚合瓶颈 Handlers
+// ==========================================
+
+func (s *AgentServer) aggregateMaps() (pkg.AggregateMaps, error) {
+	iface, err := s.ifaceAggMap.get()
+	if err != nil {
+		return pkg.AggregateMaps{}, err
+	}
+	group, err := s.groupAggMap.get()
+	if err != nil {
+		return pkg.AggregateMaps{}, err
+	}
+	return pkg.AggregateMaps{Iface: iface, Group: group}, nil
+}
+
+// handleAggregates 写入 (POST) 或清零 (DELETE) 接口/组聚合瓶颈，请求体均为 JSON 数组
+func (s *AgentServer) handleAggregates(w http.ResponseWriter, r *http.Request) {
+	s.recordRequestStart()
+	success := false
+	defer func() {
+		s.recordRequestEnd(success, false)
+	}()
+
+	maps, err := s.aggregateMaps()
+	if err != nil {
+		http.Error(w, "eBPF aggregate map error", http.StatusServiceUnavailable)
+		return
+	}
+
+	var reqs []pkg.AggregateRequest
+	if err := json.NewDecoder(r.Body).Decode(&reqs); err != nil {
+		http.Error(w, "Invalid JSON", http.StatusBadRequest)
+		return
+	}
+
+	var applied int
+	var aggs []pkg.Aggregate
+	if aggs, err = pkg.ParseAggregateRequests(reqs, r.Method == "POST"); err == nil {
+		if r.Method == "POST" {
+			applied, err = pkg.PutAggregates(maps, aggs)
+		} else {
+			applied, err = pkg.ResetAggregates(maps, aggs)
+		}
+	}
+
+	if errors.Is(err, pkg.ErrInvalidParams) {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if err != nil {
+		http.Error(w, fmt.Sprintf("applied %d aggregates: %v", applied, err), http.StatusInternalServerError)
+		return
+	}
+
+	success = true
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(http.StatusOK)
+	fmt.Fprintf(w, `{"status":"success","applied":%d}`, applied)
+}
+
+func (s *AgentServer) handleAggregatesList(w http.ResponseWriter, r *http.Request) {
+	maps, err := s.aggregateMaps()
+	if err != nil {
+		http.Error(w, "eBPF aggregate map error", http.StatusServiceUnavailable)
+		return
+	}
+	aggs, err := pkg.ListAggregates(maps)
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+	if aggs == nil {
+		aggs = []pkg.AggregateRequest{}
+	}
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(aggs)
+}
@@ -0,0 +1,90 @@
+package api
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"net/http"
+
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// L3/L4 分类 Handlers
+// ==========================================
+
+func (s *AgentServer) classMaps() (pkg.ClassMaps, error) {
+	rules, err := s.classRulesMap.get()
+	if err != nil {
+		return pkg.ClassMaps{}, err
+	}
+	prefixes, err := s.classPrefixesMap.get()
+	if err != nil {
+		return pkg.ClassMaps{}, err
+	}
+	ifaces, err := s.classIfacesMap.get()
+	if err != nil {
+		return pkg.ClassMaps{}, err
+	}
+	return pkg.ClassMaps{Rules: rules, Prefixes: prefixes, Ifaces: ifaces}, nil
+}
+
+// handleClasses 写入 (POST) 或删除 (DELETE) L3/L4 分类，请求体均为 JSON 数组
+func (s *AgentServer) handleClasses(w http.ResponseWriter, r *http.Request) {
+	s.recordRequestStart()
+	success := false
+	defer func() {
+		s.recordRequestEnd(success, false)
+	}()
+
+	maps, err := s.classMaps()
+	if err != nil {
+		http.Error(w, "eBPF class map error", http.StatusServiceUnavailable)
+		return
+	}
+
+	var reqs []pkg.ClassRequest
+	if err := json.NewDecoder(r.Body).Decode(&reqs); err != nil {
+		http.Error(w, "Invalid JSON", http.StatusBadRequest)
+		return
+	}
+
+	var applied int
+	var classes []pkg.Class
+	if classes, err = pkg.ParseClassRequests(reqs, r.Method == "POST"); err == nil {
+		if r.Method == "POST" {
+			applied, err = pkg.PutClasses(maps, classes)
+		} else {
+			applied, err = pkg.DeleteClasses(maps, classes)
+		}
+	}
+
+	if errors.Is(err, pkg.ErrInvalidParams) {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if err != nil {
+		http.Error(w, fmt.Sprintf("applied %d classes: %v", applied, err), http.StatusInternalServerError)
+		return
+	}
+
+	success = true
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(http.StatusOK)
+	fmt.Fprintf(w, `{"status":"success","applied":%d}`, applied)
+}
+
+func (s *AgentServer) handleClassesList(w http.ResponseWriter, r *http.Request) {
+	maps, err := s.classMaps()
+	if err != nil {
+		http.Error(w, "eBPF class map error", http.StatusServiceUnavailable)
+		return
+	}
+	classes, err := pkg.ListClasses(maps)
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(classes)
+}
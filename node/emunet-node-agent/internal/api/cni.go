@@ -0,0 +1,265 @@
+package api
+
+import (
+	"bufio"
+	"context"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"path/filepath"
+	"sort"
+	"sync"
+	"time"
+
+	ebpftc "EMU_CNI/tools/ebpf/ebpf-tc"
+	ebpfxdp "EMU_CNI/tools/ebpf/ebpf-xdp"
+)
+
+// ==========================================
+// CNI unix socket (CNI ADD：挂载 + 登记一次往返)
+// ==========================================
+
+// cniRequest 与 CNI 中的 AttachRequest 一一对应
+type cniRequest struct {
+	Op          string `json:"op"`
+	PodName     string `json:"podName"`
+	Ifindex     int    `json:"ifindex"`
+	SrcMac      string `json:"srcMac"`
+	Mode        string `json:"mode,omitempty"`
+	Ingress     bool   `json:"ingress,omitempty"`
+	EDTLockless bool   `json:"edtLockless,omitempty"`
+	MaxEntries  uint32 `json:"maxEntries,omitempty"`
+	IfaceTables bool   `json:"ifaceTables,omitempty"`
+	DupMark     uint32 `json:"dupMark,omitempty"`
+	XDPFastPath bool   `json:"xdpFastPath,omitempty"`
+}
+
+type cniResponse struct {
+	Status string `json:"status"`
+	Error  string `json:"error,omitempty"`
+}
+
+const (
+	cniConnTimeout = 10 * time.Second
+	// podReportWorkers 个协程串行写 Redis，突发扩容时不再每个 Pod 起一个协程
+	podReportWorkers = 4
+	podReportQueue   = 4096
+)
+
+// StartCNIServer 在 unix socket path 上接受 CNI 调用，ctx 取消时关闭监听并删除 socket 文件
+func (s *AgentServer) StartCNIServer(ctx context.Context, path string) error {
+	if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+		return fmt.Errorf("failed to create socket dir: %v", err)
+	}
+	// 上次退出未清理的 socket 文件会导致 bind 失败
+	if err := os.Remove(path); err != nil && !os.IsNotExist(err) {
+		return fmt.Errorf("failed to remove stale socket %s: %v", path, err)
+	}
+	ln, err := net.Listen("unix", path)
+	if err != nil {
+		return fmt.Errorf("failed to listen on %s: %v", path, err)
+	}
+	// 只有 root (kubelet 调用的 CNI) 可以连接
+	if err := os.Chmod(path, 0600); err != nil {
+		ln.Close()
+		return fmt.Errorf("failed to chmod %s: %v", path, err)
+	}
+
+	go func() {
+		<-ctx.Done()
+		ln.Close()
+	}()
+
+	go func() {
+		for {
+			conn, err := ln.Accept()
+			if err != nil {
+				if ctx.Err() != nil {
+					return
+				}
+				fmt.Printf("[ERROR] cni socket accept failed: %v\n", err)
+				time.Sleep(100 * time.Millisecond)
+				continue
+			}
+			go s.serveCNI(conn)
+		}
+	}()
+	return nil
+}
+
+// serveCNI 逐条处理一个连接上的请求，CNI 每次调用只发一条
+func (s *AgentServer) serveCNI(conn net.Conn) {
+	defer conn.Close()
+	conn.SetDeadline(time.Now().Add(cniConnTimeout))
+
+	dec := json.NewDecoder(bufio.NewReader(conn))
+	enc := json.NewEncoder(conn)
+	for {
+		var req cniRequest
+		if err := dec.Decode(&req); err != nil {
+			if !errors.Is(err, io.EOF) {
+				enc.Encode(cniResponse{Status: "error", Error: err.Error()})
+			}
+			return
+		}
+
+		resp := cniResponse{Status: "success"}
+		if err := s.handleCNI(req); err != nil {
+			resp = cniResponse{Status: "error", Error: err.Error()}
+		}
+		if err := enc.Encode(resp); err != nil {
+			return
+		}
+	}
+}
+
+func (s *AgentServer) handleCNI(req cniRequest) error {
+	s.recordRequestStart()
+	start := time.Now()
+	success := false
+	defer func() {
+		s.recordRequestEnd(success, false)
+	}()
+
+	if req.Op != "add" {
+		return fmt.Errorf("unknown op %q", req.Op)
+	}
+	if req.Ifindex <= 0 || req.PodName == "" {
+		return fmt.Errorf("podName and ifindex required")
+	}
+	mode, err := ebpftc.ParseMode(req.Mode)
+	if err != nil {
+		return err
+	}
+
+	opts := ebpftc.Options{
+		EDTLockless: req.EDTLockless,
+		MaxEntries:  req.MaxEntries,
+		IfaceTables: req.IfaceTables,
+		DupMark:     req.DupMark,
+	}
+	if err := s.attacher.Attach(req.Ifindex, mode, req.Ingress, opts); err != nil {
+		return fmt.Errorf("attach eBPF to ifindex %d failed: %v", req.Ifindex, err)
+	}
+	// XDP 快速路径需在 TC 对象 pin 住之后首次加载，才能共享其仿真规则
+	if req.XDPFastPath {
+		mac, err := net.ParseMAC(req.SrcMac)
+		if err != nil {
+			return fmt.Errorf("invalid srcMac %q: %v", req.SrcMac, err)
+		}
+		if err := s.xdpAttacher.Attach(req.Ifindex, mac, ebpfxdp.Options{FastPath: true}); err != nil {
+			return fmt.Errorf("attach XDP to ifindex %d failed: %v", req.Ifindex, err)
+		}
+	}
+	s.registerPod(&PodInfo{PodName: req.PodName, Ifindex: req.Ifindex, SrcMac: req.SrcMac})
+
+	s.cniAdd.observe(time.Since(start))
+	success = true
+	return nil
+}
+
+// registerPod 写入本地 Store 并排队上报 Redis，队列满时退回单独协程，保证不丢上报
+func (s *AgentServer) registerPod(info *PodInfo) {
+	s.podInfoStore.Set(info.PodName, info)
+	select {
+	case s.podReports <- info:
+	default:
+		go s.reportPod(info)
+	}
+}
+
+// StartPodReporter 启动 Redis 上报协程，ctx 取消时退出
+func (s *AgentServer) StartPodReporter(ctx context.Context) {
+	for i := 0; i < podReportWorkers; i++ {
+		go func() {
+			for {
+				select {
+				case <-ctx.Done():
+					return
+				case info := <-s.podReports:
+					s.reportPod(info)
+				}
+			}
+		}()
+	}
+}
+
+func (s *AgentServer) reportPod(info *PodInfo) {
+	if s.redis == nil {
+		return
+	}
+	ctx, cancel := context.WithTimeout(context.Background(), 5*time.Second)
+	defer cancel()
+	if err := s.redis.UpdatePodNetworkInfo(ctx, info.PodName, info.SrcMac, info.Ifindex); err != nil {
+		fmt.Printf("[ERROR] Failed to update Redis for pod %s: %v\n", info.PodName, err)
+	}
+}
+
+func (s *AgentServer) unreportPod(podName string) {
+	if s.redis == nil {
+		return
+	}
+	ctx, cancel := context.WithTimeout(context.Background(), 5*time.Second)
+	defer cancel()
+	if err := s.redis.DeleteAgentNetworkInfo(ctx, podName); err != nil {
+		fmt.Printf("[ERROR] Failed to delete Redis report of pod %s: %v\n", podName, err)
+	}
+}
+
+// ==========================================
+// CNI ADD 耗时 (滑动窗口分位数)
+// ==========================================
+
+const latencyWindowSize = 1024
+
+// latencyWindow 保留最近 latencyWindowSize 次耗时，抓取时排序求分位数；
+// 累计值 sum/count 覆盖全部样本
+type latencyWindow struct {
+	mu      sync.Mutex
+	samples [latencyWindowSize]time.Duration
+	next    int
+	count   int64
+	sum     time.Duration
+}
+
+func (l *latencyWindow) observe(d time.Duration) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	l.samples[l.next] = d
+	l.next = (l.next + 1) % latencyWindowSize
+	l.count++
+	l.sum += d
+}
+
+// quantiles 返回窗口内各分位数，没有样本时 ok 为 false
+func (l *latencyWindow) quantiles(qs []float64) (values []time.Duration, count int64, sum time.Duration, ok bool) {
+	l.mu.Lock()
+	n := int(l.count)
+	if n > latencyWindowSize {
+		n = latencyWindowSize
+	}
+	window := make([]time.Duration, n)
+	copy(window, l.samples[:n])
+	count, sum = l.count, l.sum
+	l.mu.Unlock()
+
+	if n == 0 {
+		return nil, count, sum, false
+	}
+	sort.Slice(window, func(i, j int) bool { return window[i] < window[j] })
+	values = make([]time.Duration, len(qs))
+	for i, q := range qs {
+		idx := int(q*float64(n)+0.5) - 1
+		if idx < 0 {
+			idx = 0
+		}
+		if idx >= n {
+			idx = n - 1
+		}
+		values[i] = window[idx]
+	}
+	return values, count, sum, true
+}
@@ -0,0 +1,255 @@
+package api
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"net/http"
+	"sync"
+	"time"
+
+	"github.com/cilium/ebpf"
+
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// Epoch 模式 (双缓冲规则表的暂存与提交)
+// ==========================================
+
+// maxCommitDelay 限制定时提交的最长等待，防止时钟异常导致请求长时间挂起
+const maxCommitDelay = 2 * time.Second
+
+// epochState 记录当前生效的规则表与暂存中的影子表。
+// 生效表在 epoch 为 0 时为 MAC_HANDLE_EMU，否则为 EMU_TABLES 中的内层表
+type epochState struct {
+	mu     sync.Mutex
+	tables *pkg.EpochTables
+
+	loaded      bool
+	active      uint32
+	activeTable *ebpf.Map // epoch > 0 时的生效表
+
+	// 暂存中的 epoch，token 由 linkserver 指定，用于匹配 begin/commit
+	staged      uint32
+	stagedToken uint64
+	shadow      *ebpf.Map
+}
+
+type epochBeginRequest struct {
+	Token uint64 `json:"token"`
+	// Seed 为 true 时影子表以当前生效规则为初始内容，否则从空表开始
+	Seed bool `json:"seed"`
+}
+
+type epochCommitRequest struct {
+	Token uint64 `json:"token"`
+	// AtUnixNano 非 0 时等到该时刻再翻转，便于多节点在同一时刻切换
+	AtUnixNano int64 `json:"atUnixNano,omitempty"`
+}
+
+// load 首次使用时从 EMU_EPOCH 恢复当前 epoch (agent 可能重启过)，需持有 mu。
+// flat 为 MAC_HANDLE_EMU，影子表沿用其容量
+func (e *epochState) load(flat *ebpf.Map) error {
+	if e.loaded {
+		return nil
+	}
+	tables, err := pkg.LoadEpochTables(flat.MaxEntries())
+	if err != nil {
+		return err
+	}
+	active, err := tables.Epoch()
+	if err != nil {
+		tables.Close()
+		return err
+	}
+	var activeTable *ebpf.Map
+	if active != 0 {
+		if activeTable, err = tables.Table(active); err != nil {
+			tables.Close()
+			return err
+		}
+	}
+	e.tables, e.active, e.activeTable, e.loaded = tables, active, activeTable, true
+	return nil
+}
+
+// ruleTables 返回实时写入应落到的表：按接口分表布局下为各接口的内层表；
+// 否则为生效表，以及暂存中的影子表 (若有)。
+// 影子表同步接收实时写入，避免提交后丢失暂存期间的常规更新
+func (s *AgentServer) ruleTables() (pkg.RuleWriter, error) {
+	flat, err := s.getEBPFMap()
+	if err != nil {
+		return nil, err
+	}
+	ifaceTables, err := s.ifaceTables.get()
+	if err != nil {
+		return nil, err
+	}
+	if ifaceTables != nil {
+		return ifaceTables, nil
+	}
+
+	e := s.epoch
+	e.mu.Lock()
+	defer e.mu.Unlock()
+	if err := e.load(flat); err != nil {
+		// 旧版本数据面没有 EMU_TABLES，只能使用 MAC_HANDLE_EMU
+		return pkg.RuleMaps{flat}, nil
+	}
+
+	tables := make(pkg.RuleMaps, 0, 2)
+	if e.active == 0 {
+		tables = append(tables, flat)
+	} else {
+		tables = append(tables, e.activeTable)
+	}
+	if e.shadow != nil {
+		tables = append(tables, e.shadow)
+	}
+	return tables, nil
+}
+
+// stagedTable 返回 token 对应的影子表
+func (s *AgentServer) stagedTable(token uint64) (*ebpf.Map, error) {
+	e := s.epoch
+	e.mu.Lock()
+	defer e.mu.Unlock()
+	if e.shadow == nil || e.stagedToken != token {
+		return nil, fmt.Errorf("no staged epoch with token %d", token)
+	}
+	return e.shadow, nil
+}
+
+func (s *AgentServer) handleEpochBegin(w http.ResponseWriter, r *http.Request) {
+	var req epochBeginRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
+		http.Error(w, "Invalid JSON", http.StatusBadRequest)
+		return
+	}
+
+	flat, err := s.getEBPFMap()
+	if err != nil {
+		http.Error(w, "eBPF map error", http.StatusServiceUnavailable)
+		return
+	}
+	// 按接口分表时数据面不读 EMU_TABLES，翻转 epoch 不会生效
+	if ifaceTables, err := s.ifaceTables.get(); err != nil {
+		http.Error(w, "eBPF map error", http.StatusServiceUnavailable)
+		return
+	} else if ifaceTables != nil {
+		http.Error(w, "epoch mode is not supported with per-interface rule tables", http.StatusConflict)
+		return
+	}
+
+	e := s.epoch
+	e.mu.Lock()
+	defer e.mu.Unlock()
+	if err := e.load(flat); err != nil {
+		http.Error(w, "epoch tables unavailable: "+err.Error(), http.StatusServiceUnavailable)
+		return
+	}
+
+	// 重新开始暂存时丢弃上一次未提交的影子表
+	if e.shadow != nil {
+		e.shadow.Close()
+		e.shadow = nil
+	}
+
+	var seed *ebpf.Map
+	if req.Seed {
+		seed = flat
+		if e.active != 0 {
+			seed = e.activeTable
+		}
+	}
+	next := e.active + 1
+	shadow, err := e.tables.Stage(next, seed)
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+	e.staged, e.stagedToken, e.shadow = next, req.Token, shadow
+
+	w.Header().Set("Content-Type", "application/json")
+	fmt.Fprintf(w, `{"status":"staged","epoch":%d,"active":%d}`, next, e.active)
+}
+
+// handleEpochEntries 与 /api/ebpf/entries:batch 相同的请求体，但只写入暂存中的影子表
+func (s *AgentServer) handleEpochEntries(w http.ResponseWriter, r *http.Request) {
+	var token uint64
+	if _, err := fmt.Sscanf(r.URL.Query().Get("token"), "%d", &token); err != nil {
+		http.Error(w, "token query parameter required", http.StatusBadRequest)
+		return
+	}
+	shadow, err := s.stagedTable(token)
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusConflict)
+		return
+	}
+	s.serveBatch(w, r, func() (pkg.RuleWriter, error) { return pkg.RuleMaps{shadow}, nil })
+}
+
+func (s *AgentServer) handleEpochCommit(w http.ResponseWriter, r *http.Request) {
+	var req epochCommitRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
+		http.Error(w, "Invalid JSON", http.StatusBadRequest)
+		return
+	}
+	if _, err := s.stagedTable(req.Token); err != nil {
+		http.Error(w, err.Error(), http.StatusConflict)
+		return
+	}
+
+	if req.AtUnixNano != 0 {
+		wait := time.Until(time.Unix(0, req.AtUnixNano))
+		if wait > maxCommitDelay {
+			http.Error(w, "commit time too far in the future", http.StatusBadRequest)
+			return
+		}
+		if wait > 0 {
+			time.Sleep(wait)
+		}
+	}
+
+	e := s.epoch
+	e.mu.Lock()
+	defer e.mu.Unlock()
+	if e.shadow == nil || e.stagedToken != req.Token {
+		http.Error(w, "staged epoch changed while waiting", http.StatusConflict)
+		return
+	}
+	if err := e.tables.Activate(e.staged); err != nil {
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+	flippedAt := time.Now()
+
+	if e.activeTable != nil {
+		e.activeTable.Close()
+	}
+	e.active, e.activeTable = e.staged, e.shadow
+	e.staged, e.stagedToken, e.shadow = 0, 0, nil
+
+	w.Header().Set("Content-Type", "application/json")
+	fmt.Fprintf(w, `{"status":"committed","epoch":%d,"flippedAtUnixNano":%d}`, e.active, flippedAt.UnixNano())
+}
+
+func (s *AgentServer) handleEpochAbort(w http.ResponseWriter, r *http.Request) {
+	var req epochCommitRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil && !errors.Is(err, io.EOF) {
+		http.Error(w, "Invalid JSON", http.StatusBadRequest)
+		return
+	}
+
+	e := s.epoch
+	e.mu.Lock()
+	defer e.mu.Unlock()
+	if e.shadow != nil && (req.Token == 0 || req.Token == e.stagedToken) {
+		e.shadow.Close()
+		e.staged, e.stagedToken, e.shadow = 0, 0, nil
+	}
+	w.Header().Set("Content-Type", "application/json")
+	fmt.Fprintf(w, `{"status":"aborted","epoch":%d}`, e.active)
+}
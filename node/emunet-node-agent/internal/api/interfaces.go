@@ -0,0 +1,127 @@
+package api
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"net/http"
+	"os"
+	"strconv"
+	"sync"
+
+	"github.com/gorilla/mux"
+
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// 按接口分表 (布局识别与接口回收)
+// ==========================================
+
+// ifaceTablesState 识别 CNI 加载的规则表布局：EMU_IFACE_TABLES 仅在启用按接口分表时 pin 住
+type ifaceTablesState struct {
+	mu      sync.Mutex
+	checked bool
+	tables  *pkg.IfaceTables
+}
+
+// get 返回按接口分表的写入器，扁平布局时返回 nil。
+// 调用方需先确认 MAC_HANDLE_EMU 已存在，否则无法区分“未启用”与“尚未加载”
+func (st *ifaceTablesState) get() (*pkg.IfaceTables, error) {
+	st.mu.Lock()
+	defer st.mu.Unlock()
+	if st.checked {
+		return st.tables, nil
+	}
+	tables, err := pkg.LoadIfaceTables(pkg.DefaultIfaceTableEntries)
+	if err != nil && !errors.Is(err, os.ErrNotExist) {
+		return nil, err
+	}
+	st.checked, st.tables = true, tables
+	return tables, nil
+}
+
+func (s *AgentServer) loadIfaceTables() (*pkg.IfaceTables, error) {
+	if _, err := s.getEBPFMap(); err != nil {
+		return nil, err
+	}
+	return s.ifaceTables.get()
+}
+
+// purgeLinks 删除与 match 相关的全部规则、链路统计与该接口的分类，Pod 删除时调用
+func (s *AgentServer) purgeLinks(match pkg.FlowMatch) (int, error) {
+	rules, err := s.ruleTables()
+	if err != nil {
+		return 0, err
+	}
+	deleted, err := rules.Purge(match)
+	if err != nil {
+		return deleted, err
+	}
+	if err := s.stats.purge(match); err != nil {
+		return deleted, fmt.Errorf("purge link stats: %v", err)
+	}
+	// 旧 CNI 未创建分类表时跳过，不影响规则回收
+	if maps, err := s.classMaps(); err == nil {
+		if _, err := pkg.PurgeClasses(maps, match.Ifindex); err != nil {
+			return deleted, fmt.Errorf("purge classes: %v", err)
+		}
+	}
+	return deleted, nil
+}
+
+// handleInterfaceDelete 回收一个接口的全部规则；带 srcMac 查询参数时还删除以该 MAC 为源的规则
+func (s *AgentServer) handleInterfaceDelete(w http.ResponseWriter, r *http.Request) {
+	s.recordRequestStart()
+	success := false
+	defer func() {
+		s.recordRequestEnd(success, false)
+	}()
+
+	ifindex, err := strconv.ParseUint(mux.Vars(r)["ifindex"], 10, 32)
+	if err != nil {
+		http.Error(w, "Invalid ifindex", http.StatusBadRequest)
+		return
+	}
+	match := pkg.FlowMatch{Ifindex: uint32(ifindex)}
+	if mac := r.URL.Query().Get("srcMac"); mac != "" {
+		if match.SrcMac, err = pkg.ParseMAC(mac); err != nil {
+			http.Error(w, err.Error(), http.StatusBadRequest)
+			return
+		}
+		match.HasMac = true
+	}
+
+	deleted, err := s.purgeLinks(match)
+	if err != nil {
+		http.Error(w, fmt.Sprintf("applied %d entries: %v", deleted, err), http.StatusInternalServerError)
+		return
+	}
+
+	success = true
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(http.StatusOK)
+	fmt.Fprintf(w, `{"status":"success","applied":%d}`, deleted)
+}
+
+// handleInterfacesList 返回当前布局与已创建规则表的接口
+func (s *AgentServer) handleInterfacesList(w http.ResponseWriter, r *http.Request) {
+	tables, err := s.loadIfaceTables()
+	if err != nil {
+		http.Error(w, "eBPF map error", http.StatusServiceUnavailable)
+		return
+	}
+	resp := struct {
+		Layout     string   `json:"layout"`
+		Interfaces []uint32 `json:"interfaces,omitempty"`
+	}{Layout: "flat"}
+	if tables != nil {
+		resp.Layout = "iface"
+		if resp.Interfaces, err = tables.Interfaces(); err != nil {
+			http.Error(w, err.Error(), http.StatusInternalServerError)
+			return
+		}
+	}
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(resp)
+}
@@ -0,0 +1,226 @@
+package api
+
+import (
+	"context"
+	"fmt"
+	"net"
+	"net/http"
+	"sort"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/cilium/ebpf"
+
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// 链路统计采集 (LINK_STATS per-CPU map)
+// ==========================================
+
+// statsCollector 周期性地批量读取 LINK_STATS 并缓存聚合结果，
+// /metrics 只读取缓存，抓取频率不会放大 map 遍历开销
+type statsCollector struct {
+	mu       sync.RWMutex
+	statsMap *ebpf.Map
+	snapshot map[pkg.FlowKey]pkg.LinkStats
+	lastScan time.Time
+	scanErr  error
+}
+
+// StartStatsCollector 启动后台采集，ctx 取消时退出
+func (s *AgentServer) StartStatsCollector(ctx context.Context, interval time.Duration) {
+	go func() {
+		ticker := time.NewTicker(interval)
+		defer ticker.Stop()
+		for {
+			s.stats.collect()
+			select {
+			case <-ctx.Done():
+				s.stats.close()
+				return
+			case <-ticker.C:
+			}
+		}
+	}()
+}
+
+func (c *statsCollector) collect() {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	// 统计 map 由 CNI 首次加载 TC 程序时创建，未就绪时下个周期重试
+	if c.statsMap == nil {
+		m, err := pkg.LoadEBPFMap(pkg.DefaultStatsMapPath)
+		if err != nil {
+			c.scanErr = err
+			return
+		}
+		c.statsMap = m
+	}
+
+	snapshot, err := pkg.DumpLinkStats(c.statsMap)
+	c.scanErr = err
+	if err != nil {
+		return
+	}
+	c.snapshot = snapshot
+	c.lastScan = time.Now()
+}
+
+// purge 删除匹配链路的统计，并同步更新缓存，/metrics 不再导出已删除的链路
+func (c *statsCollector) purge(match pkg.FlowMatch) error {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.statsMap == nil {
+		m, err := pkg.LoadEBPFMap(pkg.DefaultStatsMapPath)
+		if err != nil {
+			return err
+		}
+		c.statsMap = m
+	}
+	if _, err := pkg.PurgeLinkStats(c.statsMap, match); err != nil {
+		return err
+	}
+	for key := range c.snapshot {
+		if match.Match(key) {
+			delete(c.snapshot, key)
+		}
+	}
+	return nil
+}
+
+func (c *statsCollector) close() {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.statsMap != nil {
+		c.statsMap.Close()
+		c.statsMap = nil
+	}
+}
+
+// ==========================================
+// Prometheus 文本格式导出
+// ==========================================
+
+func (s *AgentServer) handleMetrics(w http.ResponseWriter, r *http.Request) {
+	var b strings.Builder
+
+	writeMetric(&b, "emunet_agent_requests_total", "counter", "Total API requests handled by the agent.",
+		atomic.LoadInt64(&s.metrics.totalRequests))
+	writeMetric(&b, "emunet_agent_active_requests", "gauge", "API requests currently in flight.",
+		atomic.LoadInt64(&s.metrics.activeRequests))
+	writeMetric(&b, "emunet_agent_successful_requests_total", "counter", "API requests that succeeded.",
+		atomic.LoadInt64(&s.metrics.successfulRequests))
+	writeMetric(&b, "emunet_agent_failed_requests_total", "counter", "API requests that failed.",
+		atomic.LoadInt64(&s.metrics.failedRequests))
+	writeMetric(&b, "emunet_agent_timeout_requests_total", "counter", "API requests rejected because the agent was busy.",
+		atomic.LoadInt64(&s.metrics.timeoutRequests))
+	writeMetric(&b, "emunet_agent_stream_connections", "gauge", "Open linkserver control streams.",
+		atomic.LoadInt64(&s.metrics.streamConns))
+	writeMetric(&b, "emunet_agent_stream_frames_total", "counter", "Rule frames applied from control streams.",
+		atomic.LoadInt64(&s.metrics.streamFrames))
+
+	if qs, count, sum, ok := s.cniAdd.quantiles([]float64{0.5, 0.99}); ok {
+		const name = "emunet_agent_cni_add_duration_seconds"
+		fmt.Fprintf(&b, "# HELP %s CNI ADD handling time (attach and register) over the last %d calls.\n# TYPE %s summary\n",
+			name, latencyWindowSize, name)
+		fmt.Fprintf(&b, "%s{quantile=\"0.5\"} %g\n%s{quantile=\"0.99\"} %g\n", name, qs[0].Seconds(), name, qs[1].Seconds())
+		fmt.Fprintf(&b, "%s_sum %g\n%s_count %d\n", name, sum.Seconds(), name, count)
+	}
+
+	if res, ok := s.resync.get(); ok {
+		writeMetric(&b, "emunet_agent_resync_snapshot_version", "gauge", "Version of the node rule snapshot reconciled at startup.",
+			res.Version)
+		const name = "emunet_agent_resync_duration_seconds"
+		fmt.Fprintf(&b, "# HELP %s Time spent reconciling pinned rule tables with the snapshot at startup.\n# TYPE %s gauge\n%s %g\n",
+			name, name, name, res.Duration.Seconds())
+		writeMetric(&b, "emunet_agent_resync_upserts", "gauge", "Rules written by the startup resync.", int64(res.Upserts))
+		writeMetric(&b, "emunet_agent_resync_deletes", "gauge", "Rules deleted by the startup resync.", int64(res.Deletes))
+		writeMetric(&b, "emunet_agent_resync_unchanged", "gauge", "Rules already matching the snapshot at startup.", int64(res.Unchanged))
+	}
+
+	sched := s.scheduler.Stats()
+	writeMetric(&b, "emunet_schedule_pending_events", "gauge", "Scheduled link changes waiting for their time.",
+		int64(sched.PendingCount))
+	writeMetric(&b, "emunet_schedule_applied_total", "counter", "Scheduled link changes applied.",
+		int64(sched.Applied))
+	writeMetric(&b, "emunet_schedule_failed_total", "counter", "Scheduled link changes that failed to apply.",
+		int64(sched.Failed))
+	writeMetric(&b, "emunet_schedule_max_lateness_nanoseconds", "gauge", "Largest delay between a scheduled time and its map update.",
+		sched.MaxLatenessNs)
+
+	s.stats.mu.RLock()
+	snapshot := s.stats.snapshot
+	lastScan := s.stats.lastScan
+	scanErr := s.stats.scanErr
+	s.stats.mu.RUnlock()
+
+	scanOK := int64(0)
+	if scanErr == nil && !lastScan.IsZero() {
+		scanOK = 1
+	}
+	writeMetric(&b, "emunet_link_stats_scan_ok", "gauge", "Whether the last LINK_STATS scan succeeded.", scanOK)
+	if !lastScan.IsZero() {
+		writeMetric(&b, "emunet_link_stats_last_scan_timestamp_seconds", "gauge", "Unix time of the last LINK_STATS scan.",
+			lastScan.Unix())
+	}
+
+	keys := make([]pkg.FlowKey, 0, len(snapshot))
+	for k := range snapshot {
+		keys = append(keys, k)
+	}
+	sort.Slice(keys, func(i, j int) bool {
+		if keys[i].Ifindex != keys[j].Ifindex {
+			return keys[i].Ifindex < keys[j].Ifindex
+		}
+		return string(keys[i].SrcMac[:]) < string(keys[j].SrcMac[:])
+	})
+
+	linkMetrics := []struct {
+		name  string
+		help  string
+		value func(*pkg.LinkStats) uint64
+	}{
+		{"emunet_link_packets_total", "Packets matched by an emulation rule.", func(st *pkg.LinkStats) uint64 { return st.Packets }},
+		{"emunet_link_bytes_total", "Bytes matched by an emulation rule.", func(st *pkg.LinkStats) uint64 { return st.Bytes }},
+		{"emunet_link_loss_drops_total", "Packets dropped by random loss.", func(st *pkg.LinkStats) uint64 { return st.LossDrops }},
+		{"emunet_link_horizon_drops_total", "Packets dropped for exceeding the EDT time horizon.", func(st *pkg.LinkStats) uint64 { return st.HorizonDrops }},
+		{"emunet_link_queue_drops_total", "Packets tail-dropped by the bottleneck queue limit.", func(st *pkg.LinkStats) uint64 { return st.QueueDrops }},
+		{"emunet_link_aqm_drops_total", "Packets dropped early by RED.", func(st *pkg.LinkStats) uint64 { return st.AqmDrops }},
+		{"emunet_link_ecn_marks_total", "Packets marked ECN CE by the bottleneck queue.", func(st *pkg.LinkStats) uint64 { return st.EcnMarks }},
+		{"emunet_link_agg_drops_total", "Packets dropped by an interface or group aggregate bottleneck.", func(st *pkg.LinkStats) uint64 { return st.AggDrops }},
+		{"emunet_link_dup_packets_total", "Duplicate packets injected by clone redirect.", func(st *pkg.LinkStats) uint64 { return st.DupPackets }},
+		{"emunet_link_corrupt_packets_total", "Packets with a flipped payload bit.", func(st *pkg.LinkStats) uint64 { return st.CorruptPackets }},
+		{"emunet_link_reorder_packets_total", "Packets reordered by skipping delay and jitter.", func(st *pkg.LinkStats) uint64 { return st.ReorderPackets }},
+		{"emunet_link_error_drops_total", "Packets dropped because a map update failed.", func(st *pkg.LinkStats) uint64 { return st.ErrorDrops }},
+		{"emunet_link_injected_delay_seconds_total", "Cumulative delay injected by rate limiting, delay and jitter.", nil},
+	}
+
+	for _, m := range linkMetrics {
+		fmt.Fprintf(&b, "# HELP %s %s\n# TYPE %s counter\n", m.name, m.help, m.name)
+		for _, k := range keys {
+			st := snapshot[k]
+			direction := "egress"
+			if k.Ingress() {
+				direction = "ingress"
+			}
+			labels := fmt.Sprintf(`{ifindex="%d",src_mac="%s",direction="%s",class="%d"}`, k.Iface(), net.HardwareAddr(k.SrcMac[:]).String(), direction, k.Class())
+			if m.value == nil {
+				fmt.Fprintf(&b, "%s%s %g\n", m.name, labels, float64(st.DelayNs)/1e9)
+			} else {
+				fmt.Fprintf(&b, "%s%s %d\n", m.name, labels, m.value(&st))
+			}
+		}
+	}
+
+	w.Header().Set("Content-Type", "text/plain; version=0.0.4; charset=utf-8")
+	w.WriteHeader(http.StatusOK)
+	w.Write([]byte(b.String()))
+}
+
+func writeMetric(b *strings.Builder, name, typ, help string, value int64) {
+	fmt.Fprintf(b, "# HELP %s %s\n# TYPE %s %s\n%s %d\n", name, help, name, typ, name, value)
+}
@@ -0,0 +1,92 @@
+package api
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"net/http"
+	"strconv"
+
+	"github.com/gorilla/mux"
+
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// 链路模板 Handlers
+// ==========================================
+
+// handleProfiles 批量写入 (POST，JSON 模板数组) 或清零 (DELETE，JSON id 数组) 模板
+func (s *AgentServer) handleProfiles(w http.ResponseWriter, r *http.Request) {
+	s.recordRequestStart()
+	success := false
+	defer func() {
+		s.recordRequestEnd(success, false)
+	}()
+
+	profileMap, err := s.profileMap.get()
+	if err != nil {
+		http.Error(w, "eBPF profile map error", http.StatusServiceUnavailable)
+		return
+	}
+
+	var applied int
+	if r.Method == "POST" {
+		var reqs []pkg.ProfileRequest
+		if err := json.NewDecoder(r.Body).Decode(&reqs); err != nil {
+			http.Error(w, "Invalid JSON", http.StatusBadRequest)
+			return
+		}
+		var profiles []pkg.Profile
+		if profiles, err = pkg.ParseProfileRequests(reqs); err == nil {
+			applied, err = pkg.PutProfiles(profileMap, profiles)
+		}
+	} else if r.Method == "DELETE" {
+		var ids []uint32
+		if err := json.NewDecoder(r.Body).Decode(&ids); err != nil {
+			http.Error(w, "Invalid JSON", http.StatusBadRequest)
+			return
+		}
+		applied, err = pkg.ResetProfiles(profileMap, ids)
+	}
+
+	if errors.Is(err, pkg.ErrInvalidParams) {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if err != nil {
+		http.Error(w, fmt.Sprintf("applied %d profiles: %v", applied, err), http.StatusInternalServerError)
+		return
+	}
+
+	success = true
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(http.StatusOK)
+	fmt.Fprintf(w, `{"status":"success","applied":%d}`, applied)
+}
+
+func (s *AgentServer) handleProfileGet(w http.ResponseWriter, r *http.Request) {
+	id, err := strconv.ParseUint(mux.Vars(r)["id"], 10, 32)
+	if err != nil {
+		http.Error(w, "Invalid profile id", http.StatusBadRequest)
+		return
+	}
+
+	profileMap, err := s.profileMap.get()
+	if err != nil {
+		http.Error(w, "eBPF profile map error", http.StatusServiceUnavailable)
+		return
+	}
+
+	profile, err := pkg.GetProfile(profileMap, uint32(id))
+	if errors.Is(err, pkg.ErrInvalidParams) {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(profile)
+}
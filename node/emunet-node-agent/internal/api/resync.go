@@ -0,0 +1,186 @@
+package api
+
+import (
+	"context"
+	"encoding/binary"
+	"fmt"
+	"net"
+	"os"
+	"sync"
+	"time"
+
+	"github.com/emunet/emunet-operator/internal/redis"
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// 重启对账 (pin 住的规则表 + Redis 节点快照)
+// ==========================================
+
+// ResyncResult 为一次启动对账的结果
+type ResyncResult struct {
+	Version   int64 // 对账所用的快照版本，0 表示 Redis 中没有本节点的快照
+	Live      int   // 对账前规则表中的规则数
+	Desired   int   // 快照中的规则数
+	Upserts   int
+	Deletes   int
+	Unchanged int
+	// Stale 为快照中所在 veth 已不存在的规则 (Pod 在 agent 停止期间被删除)，不写入并从快照移除
+	Stale    int
+	Pods     int // 从 Redis 恢复到本地 Store 的 Pod 数
+	Duration time.Duration
+}
+
+// resyncState 保存最近一次对账的结果供 /metrics 导出
+type resyncState struct {
+	mu     sync.Mutex
+	done   bool
+	result ResyncResult
+}
+
+func (st *resyncState) set(res ResyncResult) {
+	st.mu.Lock()
+	defer st.mu.Unlock()
+	st.done, st.result = true, res
+}
+
+func (st *resyncState) get() (ResyncResult, bool) {
+	st.mu.Lock()
+	defer st.mu.Unlock()
+	return st.result, st.done
+}
+
+// Resync 读出 pin 住的规则表，与 Redis 中本节点的期望快照对比后只写入差异，
+// 重启耗时随变更量而不是拓扑规模增长。需在开始接受 linkserver 写入 (长连接与 HTTP) 之前调用。
+// 没有快照 (版本 0) 时只补齐不删除，避免把 linkserver 尚未记录过的规则清空
+func (s *AgentServer) Resync(ctx context.Context, node string) (ResyncResult, error) {
+	start := time.Now()
+	var res ResyncResult
+	if s.redis == nil {
+		return res, fmt.Errorf("redis client not configured")
+	}
+
+	pods, err := s.restorePods(ctx, node)
+	if err != nil {
+		fmt.Printf("[ERROR] Failed to restore pods of node %s: %v\n", node, err)
+	}
+	res.Pods = pods
+
+	// 规则表在首次挂载 TC 程序时创建；尚不存在时没有需要保留的规则
+	if _, err := os.Stat(pkg.DefaultEBPFMapPath); os.IsNotExist(err) {
+		res.Duration = time.Since(start)
+		s.resync.set(res)
+		return res, nil
+	}
+
+	rules, err := s.ruleTables()
+	if err != nil {
+		return res, err
+	}
+	live, err := rules.Dump()
+	if err != nil {
+		return res, fmt.Errorf("failed to dump rule tables: %v", err)
+	}
+	res.Live = len(live)
+
+	snapshot, version, err := s.redis.LoadNodeRules(ctx, node)
+	if err != nil {
+		return res, fmt.Errorf("failed to load rule snapshot: %v", err)
+	}
+	res.Version = version
+
+	ifaces, err := localIfindexes()
+	if err != nil {
+		return res, err
+	}
+	records := make([][]byte, 0, len(snapshot))
+	var stale []string
+	for field, rec := range snapshot {
+		if len(field) != redis.NodeRuleKeySize {
+			continue
+		}
+		key := pkg.FlowKey{Ifindex: binary.LittleEndian.Uint32([]byte(field[:4]))}
+		if _, ok := ifaces[key.Iface()]; !ok {
+			stale = append(stale, field)
+			continue
+		}
+		records = append(records, []byte(rec))
+	}
+	desired, err := pkg.DecodeRuleRecords(records)
+	if err != nil {
+		return res, fmt.Errorf("malformed rule snapshot: %v", err)
+	}
+	res.Desired, res.Stale = len(desired), len(stale)
+
+	delta := pkg.DiffRules(live, desired, version > 0)
+	res.Unchanged = delta.Unchanged
+	res.Upserts, res.Deletes, err = pkg.ApplyRuleDelta(rules, delta)
+	res.Duration = time.Since(start)
+	if err != nil {
+		return res, fmt.Errorf("failed to apply rule delta: %v", err)
+	}
+
+	if len(stale) > 0 {
+		if _, err := s.redis.SaveNodeRules(ctx, node, &redis.NodeRulesDelta{Deletes: stale}); err != nil {
+			fmt.Printf("[ERROR] Failed to prune stale rules from snapshot of node %s: %v\n", node, err)
+		}
+	}
+	s.resync.set(res)
+	return res, nil
+}
+
+// restorePods 从 Redis 重建本地 PodInfoStore：pod_routes 给出调度到本节点的 Pod，
+// agent_routes 给出此前上报的 veth 与 MAC；veth 已不存在的 Pod 跳过
+func (s *AgentServer) restorePods(ctx context.Context, node string) (int, error) {
+	routes, err := s.redis.LoadAllPodLookups(ctx)
+	if err != nil {
+		return 0, err
+	}
+	var names []string
+	for _, pod := range routes {
+		if pod.NodeName == node {
+			names = append(names, pod.PodName)
+		}
+	}
+	if len(names) == 0 {
+		return 0, nil
+	}
+	reported, err := s.redis.GetAgentNetworkInfos(ctx, names)
+	if err != nil {
+		return 0, err
+	}
+	ifaces, err := localIfindexes()
+	if err != nil {
+		return 0, err
+	}
+
+	restored := 0
+	for name, pod := range reported {
+		if pod == nil || pod.VethIfIndex <= 0 {
+			continue
+		}
+		if _, ok := ifaces[uint32(pod.VethIfIndex)]; !ok {
+			continue
+		}
+		// CNI 可能在重建期间已登记了更新的信息
+		if _, exists := s.podInfoStore.Get(name); exists {
+			continue
+		}
+		s.podInfoStore.Set(name, &PodInfo{PodName: name, Ifindex: pod.VethIfIndex, SrcMac: pod.MACAddress})
+		restored++
+	}
+	return restored, nil
+}
+
+// localIfindexes 返回本机 (agent 所在的主机网络命名空间) 现有接口的 ifindex 集合
+func localIfindexes() (map[uint32]struct{}, error) {
+	list, err := net.Interfaces()
+	if err != nil {
+		return nil, fmt.Errorf("failed to list interfaces: %v", err)
+	}
+	ifaces := make(map[uint32]struct{}, len(list))
+	for _, iface := range list {
+		ifaces[uint32(iface.Index)] = struct{}{}
+	}
+	return ifaces, nil
+}
@@ -0,0 +1,106 @@
+package api
+
+import (
+	"context"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"net/http"
+
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// 定时链路变更 Handlers
+// ==========================================
+
+// StartScheduler 启动本地定时调度，ctx 取消时退出
+func (s *AgentServer) StartScheduler(ctx context.Context) {
+	go s.scheduler.Run(ctx.Done())
+}
+
+// applyScheduled 在计划时刻把事件写入数据面：先模板，再规则写入与删除
+func (s *AgentServer) applyScheduled(ev *pkg.ScheduledEvent) error {
+	if len(ev.Profiles) > 0 {
+		profileMap, err := s.profileMap.get()
+		if err != nil {
+			return err
+		}
+		if _, err := pkg.PutProfiles(profileMap, ev.Profiles); err != nil {
+			return err
+		}
+	}
+	if len(ev.Upsert) == 0 && len(ev.Delete) == 0 {
+		return nil
+	}
+	rules, err := s.ruleTables()
+	if err != nil {
+		return err
+	}
+	if _, err := rules.PutEntries(ev.Upsert); err != nil {
+		return err
+	}
+	if _, err := rules.DeleteEntries(ev.Delete); err != nil {
+		return err
+	}
+	return nil
+}
+
+func logScheduleError(ev *pkg.ScheduledEvent, err error) {
+	fmt.Printf("[ERROR] scheduled event %s failed: %v\n", ev.ID, err)
+}
+
+// handleSchedule 加入 (POST，JSON 事件数组) 或取消 (DELETE，JSON id 数组，空数组取消全部) 定时事件
+func (s *AgentServer) handleSchedule(w http.ResponseWriter, r *http.Request) {
+	s.recordRequestStart()
+	success := false
+	defer func() {
+		s.recordRequestEnd(success, false)
+	}()
+
+	var count int
+	var err error
+	if r.Method == "POST" {
+		var reqs []pkg.ScheduleRequest
+		if err := json.NewDecoder(r.Body).Decode(&reqs); err != nil {
+			http.Error(w, "Invalid JSON", http.StatusBadRequest)
+			return
+		}
+		var events []*pkg.ScheduledEvent
+		if events, err = pkg.ParseScheduleRequests(reqs); err == nil {
+			err = s.scheduler.Add(events)
+			count = len(events)
+		}
+	} else if r.Method == "DELETE" {
+		var ids []string
+		if err := json.NewDecoder(r.Body).Decode(&ids); err != nil {
+			http.Error(w, "Invalid JSON", http.StatusBadRequest)
+			return
+		}
+		count = s.scheduler.Cancel(ids)
+	}
+
+	if errors.Is(err, pkg.ErrInvalidParams) {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+
+	success = true
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(http.StatusOK)
+	fmt.Fprintf(w, `{"status":"success","count":%d}`, count)
+}
+
+// handleScheduleStatus 返回待执行事件与执行统计，?summary=true 时不含事件列表
+func (s *AgentServer) handleScheduleStatus(w http.ResponseWriter, r *http.Request) {
+	status := s.scheduler.Status
+	if r.URL.Query().Get("summary") == "true" {
+		status = s.scheduler.Stats
+	}
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(status())
+}
@@ -3,7 +3,9 @@ package api
 import (
 	"context"
 	"encoding/json"
+	"errors"
 	"fmt"
+	"io"
 	"net/http"
 	"sync"
 	"sync/atomic"
@@ -14,6 +16,9 @@ import (
 
 	"github.com/emunet/emunet-operator/internal/redis"
 	"github.com/emunet/emunet-operator/pkg"
+
+	ebpftc "EMU_CNI/tools/ebpf/ebpf-tc"
+	ebpfxdp "EMU_CNI/tools/ebpf/ebpf-xdp"
 )
 
 // ==========================================
@@ -57,10 +62,30 @@ type AgentServer struct {
 	redis          *redis.Client
 	semaphore      chan struct{}
 	metrics        *ServerMetrics
+	stats          *statsCollector
 	ebpfMap        *ebpf.Map
 	ebpfMapMutex   sync.RWMutex
-	ebpfMapLoaded  bool
-	ebpfMapLoadErr error
+	profileMap     *pinnedMap
+	ifaceAggMap    *pinnedMap
+	groupAggMap    *pinnedMap
+	traceMetaMap   *pinnedMap
+	tracePointsMap *pinnedMap
+	scheduler      *pkg.Scheduler
+	epoch          *epochState
+	ifaceTables    *ifaceTablesState
+
+	classRulesMap    *pinnedMap
+	classPrefixesMap *pinnedMap
+	classIfacesMap   *pinnedMap
+
+	// CNI ADD 经 unix socket 由 agent 挂载 TC (及 XDP 快速路径) 程序，程序只加载一次
+	attacher    *ebpftc.Attacher
+	xdpAttacher *ebpfxdp.Attacher
+	podReports  chan *PodInfo
+	cniAdd      *latencyWindow
+
+	// 启动时与 Redis 节点快照对账的结果
+	resync *resyncState
 }
 
 type ServerMetrics struct {
@@ -69,6 +94,8 @@ type ServerMetrics struct {
 	successfulRequests int64
 	failedRequests     int64
 	timeoutRequests    int64
+	streamConns        int64
+	streamFrames       int64
 }
 
 // NewServer 初始化
@@ -80,7 +107,27 @@ func NewServer(redisClient *redis.Client) *AgentServer {
 		// 并发控制：根据机器核数调整，例如 2000
 		semaphore: make(chan struct{}, 2000),
 		metrics:   &ServerMetrics{},
+		stats:     &statsCollector{},
+
+		profileMap:     &pinnedMap{path: pkg.DefaultProfileMapPath},
+		ifaceAggMap:    &pinnedMap{path: pkg.DefaultIfaceAggMapPath},
+		groupAggMap:    &pinnedMap{path: pkg.DefaultGroupAggMapPath},
+		traceMetaMap:   &pinnedMap{path: pkg.DefaultTraceMetaMapPath},
+		tracePointsMap: &pinnedMap{path: pkg.DefaultTracePointsMapPath},
+		epoch:          &epochState{},
+		ifaceTables:    &ifaceTablesState{},
+
+		classRulesMap:    &pinnedMap{path: pkg.DefaultClassRulesMapPath},
+		classPrefixesMap: &pinnedMap{path: pkg.DefaultClassPrefixesMapPath},
+		classIfacesMap:   &pinnedMap{path: pkg.DefaultClassIfacesMapPath},
+
+		attacher:    ebpftc.NewAttacher(),
+		xdpAttacher: ebpfxdp.NewAttacher(),
+		podReports:  make(chan *PodInfo, podReportQueue),
+		cniAdd:      &latencyWindow{},
+		resync:      &resyncState{},
 	}
+	s.scheduler = pkg.NewScheduler(s.applyScheduled, logScheduleError)
 	s.setupRoutes()
 	return s
 }
@@ -88,11 +135,35 @@ func NewServer(redisClient *redis.Client) *AgentServer {
 func (s *AgentServer) setupRoutes() {
 	// eBPF 核心路径
 	s.router.HandleFunc("/api/ebpf/entry", s.handleEBPFEntry).Methods("POST", "DELETE")
+	s.router.HandleFunc("/api/ebpf/entries:batch", s.handleEBPFBatch).Methods("POST", "DELETE")
+	s.router.HandleFunc("/api/ebpf/profiles", s.handleProfiles).Methods("POST", "DELETE")
+	s.router.HandleFunc("/api/ebpf/profiles/{id}", s.handleProfileGet).Methods("GET")
+	// 聚合瓶颈：接口 (ifindex) 或组 (groupId) 共享的限速队列
+	s.router.HandleFunc("/api/ebpf/aggregates", s.handleAggregates).Methods("POST", "DELETE")
+	s.router.HandleFunc("/api/ebpf/aggregates", s.handleAggregatesList).Methods("GET")
+	// 轨迹回放：链路参数按时间片随轨迹变化
+	s.router.HandleFunc("/api/ebpf/traces", s.handleTraces).Methods("POST", "DELETE")
+	s.router.HandleFunc("/api/ebpf/traces/{id}", s.handleTraceGet).Methods("GET")
+
+	s.router.HandleFunc("/api/ebpf/classes", s.handleClasses).Methods("POST", "DELETE")
+	s.router.HandleFunc("/api/ebpf/classes", s.handleClassesList).Methods("GET")
+	// 定时变更：事件提前上传，到点由本地调度直接写 map，不受控制面排队影响
+	s.router.HandleFunc("/api/ebpf/schedule", s.handleSchedule).Methods("POST", "DELETE")
+	s.router.HandleFunc("/api/ebpf/schedule", s.handleScheduleStatus).Methods("GET")
+	// epoch 模式：暂存影子表 -> 写入 -> 一次翻转生效
+	s.router.HandleFunc("/api/ebpf/epoch/begin", s.handleEpochBegin).Methods("POST")
+	s.router.HandleFunc("/api/ebpf/epoch/entries:batch", s.handleEpochEntries).Methods("POST", "DELETE")
+	s.router.HandleFunc("/api/ebpf/epoch/commit", s.handleEpochCommit).Methods("POST")
+	s.router.HandleFunc("/api/ebpf/epoch/abort", s.handleEpochAbort).Methods("POST")
+	// 接口回收：Pod 删除时批量删除其全部规则 (按接口分表时整表回收)
+	s.router.HandleFunc("/api/ebpf/interfaces", s.handleInterfacesList).Methods("GET")
+	s.router.HandleFunc("/api/ebpf/interfaces/{ifindex}", s.handleInterfaceDelete).Methods("DELETE")
 
 	// Pod Info 路径
 	s.router.HandleFunc("/api/podinfo/add", s.handlePodInfoAdd).Methods("POST")
 	s.router.HandleFunc("/api/podinfo/{podName}", s.handlePodInfo).Methods("GET", "DELETE")
 	s.router.HandleFunc("/health", s.handleHealth).Methods("GET")
+	s.router.HandleFunc("/metrics", s.handleMetrics).Methods("GET")
 }
 
 // GetRouter 供 main.go 调用
@@ -144,55 +215,149 @@ func (s *AgentServer) handleEBPFEntry(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 
-	ebpfMap, err := s.getEBPFMap()
+	rules, err := s.ruleTables()
 	if err != nil {
 		http.Error(w, "eBPF map error", http.StatusServiceUnavailable)
 		return
 	}
 
+	var req pkg.EntryRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
+		http.Error(w, "Invalid JSON", http.StatusBadRequest)
+		return
+	}
+	entries, err := pkg.ParseEntryRequests([]pkg.EntryRequest{req})
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+
 	if r.Method == "POST" {
-		var req struct {
-			Ifindex         uint32 `json:"ifindex"`
-			SrcMac          string `json:"srcMac"`
-			ThrottleRateBps uint32 `json:"throttleRateBps"`
-			Delay           uint32 `json:"delay"`
-			LossRate        uint32 `json:"lossRate"`
-			Jitter          uint32 `json:"jitter"`
+		_, err = rules.PutEntries(entries)
+	} else if r.Method == "DELETE" {
+		var n int
+		n, err = rules.DeleteEntries([]pkg.FlowKey{entries[0].Key})
+		if err == nil && n == 0 {
+			http.Error(w, "entry not found", http.StatusNotFound)
+			return
 		}
+	}
+	if errors.Is(err, pkg.ErrInvalidParams) {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+
+	success = true
+	w.WriteHeader(http.StatusOK)
+	w.Write([]byte(`{"status":"success"}`))
+}
+
+// handleEBPFBatch 批量写入 (POST) / 删除 (DELETE) 规则，整批对应一次 map batch 系统调用。
+// Content-Type 为 application/octet-stream 时按 pkg 中的二进制格式解析，否则按 JSON 数组解析
+func (s *AgentServer) handleEBPFBatch(w http.ResponseWriter, r *http.Request) {
+	s.serveBatch(w, r, s.ruleTables)
+}
+
+// serveBatch 解析批量请求体并写入 tables 返回的全部规则表
+func (s *AgentServer) serveBatch(w http.ResponseWriter, r *http.Request, tables func() (pkg.RuleWriter, error)) {
+	s.recordRequestStart()
+	success := false
+	isTimeout := false
+
+	defer func() {
+		s.recordRequestEnd(success, isTimeout)
+	}()
+
+	select {
+	case s.semaphore <- struct{}{}:
+		defer func() { <-s.semaphore }()
+	case <-time.After(100 * time.Millisecond):
+		isTimeout = true
+		http.Error(w, "Server busy", http.StatusServiceUnavailable)
+		return
+	}
+
+	rules, err := tables()
+	if err != nil {
+		http.Error(w, "eBPF map error", http.StatusServiceUnavailable)
+		return
+	}
+
+	binaryBody := r.Header.Get("Content-Type") == pkg.BatchContentType
+	limit := pkg.MaxBatchBodySize()
+	if !binaryBody {
+		// JSON 每条约 100 字节，上限放宽到二进制格式的 4 倍
+		limit *= 4
+	}
+	body, err := io.ReadAll(http.MaxBytesReader(w, r.Body, limit))
+	if err != nil {
+		http.Error(w, "Request body too large", http.StatusRequestEntityTooLarge)
+		return
+	}
 
-		if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
-			http.Error(w, "Invalid JSON", http.StatusBadRequest)
+	var applied int
+	if r.Method == "POST" {
+		var entries []pkg.Entry
+		if binaryBody {
+			entries, err = pkg.DecodeUpsertBatch(body)
+		} else {
+			var reqs []pkg.EntryRequest
+			if err = json.Unmarshal(body, &reqs); err == nil {
+				entries, err = pkg.ParseEntryRequests(reqs)
+			}
+		}
+		if err != nil {
+			http.Error(w, err.Error(), http.StatusBadRequest)
 			return
 		}
-
-		if err := pkg.AddEBPFEntry(ebpfMap, req.Ifindex, req.SrcMac, req.ThrottleRateBps, req.Delay, req.LossRate, req.Jitter); err != nil {
-			http.Error(w, err.Error(), http.StatusInternalServerError)
+		if len(entries) > pkg.MaxBatchEntries {
+			http.Error(w, "Too many entries", http.StatusRequestEntityTooLarge)
 			return
 		}
-
-		success = true
-		w.WriteHeader(http.StatusOK)
-		w.Write([]byte(`{"status":"success"}`))
+		applied, err = rules.PutEntries(entries)
 
 	} else if r.Method == "DELETE" {
-		var req struct {
-			Ifindex uint32 `json:"ifindex"`
-			SrcMac  string `json:"srcMac"`
+		var keys []pkg.FlowKey
+		if binaryBody {
+			keys, err = pkg.DecodeDeleteBatch(body)
+		} else {
+			var reqs []pkg.EntryRequest
+			if err = json.Unmarshal(body, &reqs); err == nil {
+				var entries []pkg.Entry
+				entries, err = pkg.ParseEntryRequests(reqs)
+				for _, e := range entries {
+					keys = append(keys, e.Key)
+				}
+			}
 		}
-		if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
-			http.Error(w, "Invalid JSON", http.StatusBadRequest)
+		if err != nil {
+			http.Error(w, err.Error(), http.StatusBadRequest)
 			return
 		}
-
-		if err := pkg.DeleteEBPFEntry(ebpfMap, req.Ifindex, req.SrcMac); err != nil {
-			http.Error(w, err.Error(), http.StatusInternalServerError)
+		if len(keys) > pkg.MaxBatchEntries {
+			http.Error(w, "Too many entries", http.StatusRequestEntityTooLarge)
 			return
 		}
+		applied, err = rules.DeleteEntries(keys)
+	}
 
-		success = true
-		w.WriteHeader(http.StatusOK)
-		w.Write([]byte(`{"status":"success"}`))
+	if errors.Is(err, pkg.ErrInvalidParams) {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if err != nil {
+		http.Error(w, fmt.Sprintf("applied %d entries: %v", applied, err), http.StatusInternalServerError)
+		return
 	}
+
+	success = true
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(http.StatusOK)
+	fmt.Fprintf(w, `{"status":"success","applied":%d}`, applied)
 }
 
 func (s *AgentServer) handlePodInfoAdd(w http.ResponseWriter, r *http.Request) {
@@ -210,30 +375,12 @@ func (s *AgentServer) handlePodInfoAdd(w http.ResponseWriter, r *http.Request) {
 		return
 	}
 
-	// 1. 存入本地内存 Store
-	info := &PodInfo{
+	// 存入本地内存 Store，Redis 由上报协程异步写入
+	s.registerPod(&PodInfo{
 		PodName: req.PodName,
 		Ifindex: req.Ifindex,
 		SrcMac:  req.SrcMac,
-	}
-	s.podInfoStore.Set(req.PodName, info)
-
-	// 2. 异步写入 Redis (增加调试日志!!!)
-	go func(name, mac string, idx int) {
-		ctx, cancel := context.WithTimeout(context.Background(), 5*time.Second)
-		defer cancel()
-
-		// --- 修改开始 ---
-		err := s.redis.UpdatePodNetworkInfo(ctx, name, mac, idx)
-		if err != nil {
-			// 这里会打印具体的错误原因，例如 DNS 解析失败、连接超时等
-			fmt.Printf("[ERROR] Failed to update Redis for pod %s: %v\n", name, err)
-		} else {
-			fmt.Printf("[DEBUG] Successfully wrote to Redis: lookup:%s -> %s\n", name, mac)
-		}
-		// --- 修改结束 ---
-
-	}(req.PodName, req.SrcMac, req.Ifindex)
+	})
 
 	s.recordRequestEnd(true, false)
 	w.WriteHeader(http.StatusOK)
@@ -252,11 +399,57 @@ func (s *AgentServer) handlePodInfo(w http.ResponseWriter, r *http.Request) {
 			http.Error(w, "Not found", http.StatusNotFound)
 		}
 	} else if r.Method == "DELETE" {
+		match, ok := s.podLinkMatch(r, podName)
 		s.podInfoStore.Delete(podName)
+		// agent_routes 没有 TTL，Pod 删除时一并移除上报
+		go s.unreportPod(podName)
+		if !ok {
+			// 没有接口信息可回收，规则由 linkserver 删除或随 LRU/重建淘汰
+			w.WriteHeader(http.StatusOK)
+			return
+		}
+		deleted, err := s.purgeLinks(match)
+		if err != nil {
+			fmt.Printf("[ERROR] Failed to purge links of pod %s: %v\n", podName, err)
+			http.Error(w, fmt.Sprintf("applied %d entries: %v", deleted, err), http.StatusInternalServerError)
+			return
+		}
+		w.Header().Set("Content-Type", "application/json")
 		w.WriteHeader(http.StatusOK)
+		fmt.Fprintf(w, `{"status":"success","applied":%d}`, deleted)
 	}
 }
 
+// podLinkMatch 确定离开的 Pod 的 veth 与 MAC：优先使用 CNI 在查询参数中给出的值，
+// 其次是本地记录，agent 重启过时再查 Redis 中 agent 上报的记录
+func (s *AgentServer) podLinkMatch(r *http.Request, podName string) (pkg.FlowMatch, bool) {
+	var (
+		ifindex int
+		mac     string
+	)
+	if v := r.URL.Query().Get("ifindex"); v != "" {
+		fmt.Sscanf(v, "%d", &ifindex)
+		mac = r.URL.Query().Get("srcMac")
+	} else if info, ok := s.podInfoStore.Get(podName); ok {
+		ifindex, mac = info.Ifindex, info.SrcMac
+	} else if s.redis != nil {
+		ctx, cancel := context.WithTimeout(r.Context(), 2*time.Second)
+		defer cancel()
+		if pod, err := s.redis.GetAgentNetworkInfo(ctx, podName); err == nil {
+			ifindex, mac = pod.VethIfIndex, pod.MACAddress
+		}
+	}
+	if ifindex <= 0 {
+		return pkg.FlowMatch{}, false
+	}
+
+	match := pkg.FlowMatch{Ifindex: uint32(ifindex)}
+	if parsed, err := pkg.ParseMAC(mac); err == nil {
+		match.SrcMac, match.HasMac = parsed, true
+	}
+	return match, true
+}
+
 func (s *AgentServer) handleHealth(w http.ResponseWriter, r *http.Request) {
 	w.WriteHeader(http.StatusOK)
 	w.Write([]byte(`{"status":"healthy"}`))
@@ -266,31 +459,50 @@ func (s *AgentServer) handleHealth(w http.ResponseWriter, r *http.Request) {
 // 5. EBPF Helpers
 // ==========================================
 
-func (s *AgentServer) loadEBPFMap() error {
+// loadEBPFMap 加载规则表，失败不缓存：agent 负责首次加载 TC 程序，
+// 首个 CNI ADD 之前 map 尚不存在，此时到达的 linkserver 写入在 map 创建后重试即可成功
+func (s *AgentServer) loadEBPFMap() (*ebpf.Map, error) {
 	s.ebpfMapMutex.Lock()
 	defer s.ebpfMapMutex.Unlock()
-	if s.ebpfMapLoaded {
-		return s.ebpfMapLoadErr
+	if s.ebpfMap != nil {
+		return s.ebpfMap, nil
 	}
 	ebpfMap, err := pkg.LoadEBPFMap(pkg.DefaultEBPFMapPath)
-	s.ebpfMapLoadErr = err
-	s.ebpfMapLoaded = true
-	if err == nil {
-		s.ebpfMap = ebpfMap
+	if err != nil {
+		return nil, err
 	}
-	return err
+	s.ebpfMap = ebpfMap
+	return ebpfMap, nil
 }
 
 func (s *AgentServer) getEBPFMap() (*ebpf.Map, error) {
 	s.ebpfMapMutex.RLock()
-	if s.ebpfMapLoaded {
-		defer s.ebpfMapMutex.RUnlock()
-		return s.ebpfMap, s.ebpfMapLoadErr
-	}
+	ebpfMap := s.ebpfMap
 	s.ebpfMapMutex.RUnlock()
-	err := s.loadEBPFMap()
+	if ebpfMap != nil {
+		return ebpfMap, nil
+	}
+	return s.loadEBPFMap()
+}
+
+// pinnedMap 按需加载一个 pin 住的 map，与 getEBPFMap 一样加载失败不缓存错误，
+// map 在首次挂载 TC 程序时创建，agent 可能先于它启动
+type pinnedMap struct {
+	path string
+	mu   sync.Mutex
+	m    *ebpf.Map
+}
+
+func (p *pinnedMap) get() (*ebpf.Map, error) {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.m != nil {
+		return p.m, nil
+	}
+	m, err := pkg.LoadEBPFMap(p.path)
 	if err != nil {
 		return nil, err
 	}
-	return s.ebpfMap, nil
+	p.m = m
+	return m, nil
 }
@@ -0,0 +1,134 @@
+package api
+
+import (
+	"bufio"
+	"context"
+	"errors"
+	"fmt"
+	"io"
+	"net"
+	"sync/atomic"
+	"time"
+
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// 控制流长连接 (linkserver -> agent 规则增量)
+// ==========================================
+
+// StartStreamServer 在 addr 上接受 linkserver 的长连接，ctx 取消时关闭监听
+func (s *AgentServer) StartStreamServer(ctx context.Context, addr string) error {
+	ln, err := net.Listen("tcp", addr)
+	if err != nil {
+		return fmt.Errorf("failed to listen on %s: %v", addr, err)
+	}
+
+	go func() {
+		<-ctx.Done()
+		ln.Close()
+	}()
+
+	go func() {
+		for {
+			conn, err := ln.Accept()
+			if err != nil {
+				if ctx.Err() != nil {
+					return
+				}
+				fmt.Printf("[ERROR] stream accept failed: %v\n", err)
+				time.Sleep(100 * time.Millisecond)
+				continue
+			}
+			go s.serveStream(ctx, conn)
+		}
+	}()
+	return nil
+}
+
+// serveStream 按接收顺序逐帧应用并回 ACK；单连接内串行，保证同一 key 的更新顺序
+func (s *AgentServer) serveStream(ctx context.Context, conn net.Conn) {
+	defer conn.Close()
+	atomic.AddInt64(&s.metrics.streamConns, 1)
+	defer atomic.AddInt64(&s.metrics.streamConns, -1)
+
+	if tcp, ok := conn.(*net.TCPConn); ok {
+		tcp.SetNoDelay(true)
+		tcp.SetKeepAlive(true)
+		tcp.SetKeepAlivePeriod(15 * time.Second)
+	}
+
+	go func() {
+		<-ctx.Done()
+		conn.Close()
+	}()
+
+	r := bufio.NewReaderSize(conn, 64*1024)
+	w := bufio.NewWriterSize(conn, 4*1024)
+	for {
+		frame, err := pkg.ReadFrame(r)
+		if err != nil {
+			if !errors.Is(err, io.EOF) && ctx.Err() == nil {
+				fmt.Printf("[ERROR] stream from %s closed: %v\n", conn.RemoteAddr(), err)
+			}
+			return
+		}
+
+		ack := s.applyFrame(frame)
+		if err := pkg.WriteFrame(w, &pkg.Frame{Type: pkg.FrameAck, Seq: frame.Seq, Payload: pkg.EncodeAck(ack)}); err != nil {
+			return
+		}
+		// 对端已无待读数据时才 Flush，连续到达的帧共享一次写系统调用
+		if r.Buffered() == 0 {
+			if err := w.Flush(); err != nil {
+				return
+			}
+		}
+	}
+}
+
+func (s *AgentServer) applyFrame(frame *pkg.Frame) *pkg.Ack {
+	s.recordRequestStart()
+	atomic.AddInt64(&s.metrics.streamFrames, 1)
+
+	rules, err := s.ruleTables()
+	if err != nil {
+		s.recordRequestEnd(false, false)
+		return &pkg.Ack{Status: pkg.AckError, Message: "eBPF map error: " + err.Error()}
+	}
+
+	start := time.Now()
+	var applied int
+	switch frame.Type {
+	case pkg.FrameUpsert:
+		var entries []pkg.Entry
+		if entries, err = pkg.DecodeUpsertBatch(frame.Payload); err == nil {
+			applied, err = rules.PutEntries(entries)
+		} else {
+			err = fmt.Errorf("%w: %v", pkg.ErrInvalidParams, err)
+		}
+	case pkg.FrameDelete:
+		var keys []pkg.FlowKey
+		if keys, err = pkg.DecodeDeleteBatch(frame.Payload); err == nil {
+			applied, err = rules.DeleteEntries(keys)
+		} else {
+			err = fmt.Errorf("%w: %v", pkg.ErrInvalidParams, err)
+		}
+	default:
+		err = fmt.Errorf("%w: unknown frame type %d", pkg.ErrInvalidParams, frame.Type)
+	}
+
+	ack := &pkg.Ack{Applied: uint32(applied), ApplyNs: uint64(time.Since(start))}
+	switch {
+	case err == nil:
+		ack.Status = pkg.AckOK
+	case errors.Is(err, pkg.ErrInvalidParams):
+		ack.Status = pkg.AckInvalid
+		ack.Message = err.Error()
+	default:
+		ack.Status = pkg.AckError
+		ack.Message = err.Error()
+	}
+	s.recordRequestEnd(err == nil, false)
+	return ack
+}
@@ -0,0 +1,102 @@
+package api
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"net/http"
+	"strconv"
+
+	"github.com/cilium/ebpf"
+	"github.com/gorilla/mux"
+
+	"github.com/emunet/emunet-operator/pkg"
+)
+
+// ==========================================
+// 轨迹回放 Handlers
+// ==========================================
+
+// handleTraces 批量加载 (POST，JSON 轨迹数组) 或卸载 (DELETE，JSON id 数组) 轨迹
+func (s *AgentServer) handleTraces(w http.ResponseWriter, r *http.Request) {
+	s.recordRequestStart()
+	success := false
+	defer func() {
+		s.recordRequestEnd(success, false)
+	}()
+
+	metaMap, err := s.traceMetaMap.get()
+	if err != nil {
+		http.Error(w, "eBPF trace map error", http.StatusServiceUnavailable)
+		return
+	}
+
+	var applied int
+	if r.Method == "POST" {
+		var pointsMap *ebpf.Map
+		if pointsMap, err = s.tracePointsMap.get(); err != nil {
+			http.Error(w, "eBPF trace map error", http.StatusServiceUnavailable)
+			return
+		}
+		var reqs []pkg.TraceRequest
+		if err := json.NewDecoder(r.Body).Decode(&reqs); err != nil {
+			http.Error(w, "Invalid JSON", http.StatusBadRequest)
+			return
+		}
+		var traces []pkg.Trace
+		if traces, err = pkg.ParseTraceRequests(reqs); err == nil {
+			applied, err = pkg.PutTraces(metaMap, pointsMap, traces)
+		}
+	} else if r.Method == "DELETE" {
+		var ids []uint32
+		if err := json.NewDecoder(r.Body).Decode(&ids); err != nil {
+			http.Error(w, "Invalid JSON", http.StatusBadRequest)
+			return
+		}
+		applied, err = pkg.ResetTraces(metaMap, ids)
+	}
+
+	if errors.Is(err, pkg.ErrInvalidParams) {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if err != nil {
+		http.Error(w, fmt.Sprintf("applied %d traces: %v", applied, err), http.StatusInternalServerError)
+		return
+	}
+
+	success = true
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(http.StatusOK)
+	fmt.Fprintf(w, `{"status":"success","applied":%d}`, applied)
+}
+
+func (s *AgentServer) handleTraceGet(w http.ResponseWriter, r *http.Request) {
+	id, err := strconv.ParseUint(mux.Vars(r)["id"], 10, 32)
+	if err != nil {
+		http.Error(w, "Invalid trace id", http.StatusBadRequest)
+		return
+	}
+
+	metaMap, err := s.traceMetaMap.get()
+	if err != nil {
+		http.Error(w, "eBPF trace map error", http.StatusServiceUnavailable)
+		return
+	}
+
+	trace, err := pkg.GetTrace(metaMap, uint32(id))
+	if errors.Is(err, pkg.ErrInvalidParams) {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	if errors.Is(err, ebpf.ErrKeyNotExist) {
+		http.Error(w, "Trace not loaded", http.StatusNotFound)
+		return
+	}
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(trace)
+}
@@ -0,0 +1,144 @@
+package pkg
+
+import (
+	"errors"
+	"fmt"
+
+	"github.com/cilium/ebpf"
+)
+
+// ==========================================
+// 聚合瓶颈 (EMU_IFACE_AGG / EMU_GROUP_AGG ARRAY)
+// ==========================================
+
+const (
+	DefaultIfaceAggMapPath = "/sys/fs/bpf/tc_emu/maps/EMU_IFACE_AGG"
+	DefaultGroupAggMapPath = "/sys/fs/bpf/tc_emu/maps/EMU_GROUP_AGG"
+
+	// MaxIfaceAggregates / MaxGroupAggregates 需与 maps.h 中的 MAX_IFACE_AGG / MAX_GROUP_AGG 保持一致
+	MaxIfaceAggregates = 65536
+	MaxGroupAggregates = 4096
+)
+
+// AggConfig 与 maps.h 中 struct agg_cfg 一一对应
+type AggConfig struct {
+	ThrottleRateBps uint64
+	NsPerByteFP     uint64
+	QueueLimitNs    uint32
+	Reserved        uint32
+}
+
+// AggregateRequest 为一个聚合瓶颈的 JSON 表示，Ifindex 与 GroupID 二选一。
+// 接口瓶颈作用于该 veth 上的所有链路，组瓶颈作用于 groupId 相同的链路
+type AggregateRequest struct {
+	Ifindex         uint32 `json:"ifindex,omitempty"`
+	GroupID         uint32 `json:"groupId,omitempty"`
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
+	QueueBytes      uint32 `json:"queueBytes,omitempty"`
+	QueueDelay      uint32 `json:"queueDelay,omitempty"`
+}
+
+// Aggregate 为解析后的聚合瓶颈
+type Aggregate struct {
+	Group  bool   // false 为接口瓶颈
+	ID     uint32 // ifindex 或 group id
+	Config AggConfig
+}
+
+// AggregateMaps 为接口与组两张配置表
+type AggregateMaps struct {
+	Iface *ebpf.Map
+	Group *ebpf.Map
+}
+
+func (m AggregateMaps) mapFor(group bool) *ebpf.Map {
+	if group {
+		return m.Group
+	}
+	return m.Iface
+}
+
+// ParseAggregateRequests 校验并转换请求，任意一条非法则整批拒绝；
+// withRate 为 false 时 (删除) 不检查速率
+func ParseAggregateRequests(reqs []AggregateRequest, withRate bool) ([]Aggregate, error) {
+	aggs := make([]Aggregate, 0, len(reqs))
+	for i, req := range reqs {
+		var agg Aggregate
+		switch {
+		case req.Ifindex != 0 && req.GroupID != 0:
+			return nil, fmt.Errorf("%w: aggregate %d: ifindex and groupId are mutually exclusive", ErrInvalidParams, i)
+		case req.GroupID != 0:
+			if req.GroupID >= MaxGroupAggregates {
+				return nil, fmt.Errorf("%w: aggregate %d: group id out of range [1, %d)", ErrInvalidParams, i, MaxGroupAggregates)
+			}
+			agg.Group, agg.ID = true, req.GroupID
+		case req.Ifindex != 0:
+			if req.Ifindex >= MaxIfaceAggregates {
+				return nil, fmt.Errorf("%w: aggregate %d: ifindex %d not supported (max %d)", ErrInvalidParams, i, req.Ifindex, MaxIfaceAggregates-1)
+			}
+			agg.ID = req.Ifindex
+		default:
+			return nil, fmt.Errorf("%w: aggregate %d: ifindex or groupId required", ErrInvalidParams, i)
+		}
+
+		if withRate {
+			if req.ThrottleRateBps < MinThrottleRateBps {
+				return nil, fmt.Errorf("%w: aggregate %d: throttle rate %d bps below minimum %d bps", ErrInvalidParams, i, req.ThrottleRateBps, MinThrottleRateBps)
+			}
+			agg.Config = AggConfig{
+				ThrottleRateBps: req.ThrottleRateBps,
+				NsPerByteFP:     NsPerByteFP(req.ThrottleRateBps),
+				QueueLimitNs:    queueLimitNs(req.ThrottleRateBps, req.QueueBytes, req.QueueDelay),
+			}
+		}
+		aggs = append(aggs, agg)
+	}
+	return aggs, nil
+}
+
+// PutAggregates 写入一组聚合瓶颈配置，下一个包即生效；排队状态由数据面保留
+func PutAggregates(maps AggregateMaps, aggs []Aggregate) (int, error) {
+	for i, agg := range aggs {
+		if err := maps.mapFor(agg.Group).Put(agg.ID, agg.Config); err != nil {
+			return i, err
+		}
+	}
+	return len(aggs), nil
+}
+
+// ResetAggregates 清零配置 (ARRAY 不支持删除)，相应链路不再经过该瓶颈
+func ResetAggregates(maps AggregateMaps, aggs []Aggregate) (int, error) {
+	for i := range aggs {
+		aggs[i].Config = AggConfig{}
+	}
+	return PutAggregates(maps, aggs)
+}
+
+// ListAggregates 返回所有已配置 (速率非 0) 的聚合瓶颈
+func ListAggregates(maps AggregateMaps) ([]AggregateRequest, error) {
+	var result []AggregateRequest
+	for _, group := range []bool{false, true} {
+		var id uint32
+		var cfg AggConfig
+		iter := maps.mapFor(group).Iterate()
+		for iter.Next(&id, &cfg) {
+			if cfg.ThrottleRateBps == 0 {
+				continue
+			}
+			req := AggregateRequest{
+				ThrottleRateBps: cfg.ThrottleRateBps,
+				QueueDelay:      cfg.QueueLimitNs / NsPerDelayUnit,
+			}
+			if group {
+				req.GroupID = id
+			} else {
+				req.Ifindex = id
+			}
+			result = append(result, req)
+		}
+		if err := iter.Err(); err != nil && !errors.Is(err, ebpf.ErrKeyNotExist) {
+			return nil, err
+		}
+	}
+	return result, nil
+}
@@ -0,0 +1,323 @@
+package pkg
+
+import (
+	"errors"
+	"fmt"
+	"net/netip"
+	"strings"
+
+	"github.com/cilium/ebpf"
+)
+
+// ==========================================
+// L3/L4 分类 (EMU_CLASS_RULES HASH / EMU_CLASS_PREFIXES LPM_TRIE)
+// ==========================================
+
+const (
+	DefaultClassRulesMapPath    = "/sys/fs/bpf/tc_emu/maps/EMU_CLASS_RULES"
+	DefaultClassPrefixesMapPath = "/sys/fs/bpf/tc_emu/maps/EMU_CLASS_PREFIXES"
+	DefaultClassIfacesMapPath   = "/sys/fs/bpf/tc_emu/maps/EMU_CLASS_IFACES"
+
+	// MaxClasses 需与 maps.h 中的 MAX_CLASSES 保持一致，0 号保留
+	MaxClasses = 1024
+
+	// 需与 maps.h 中的 CLASS_MODE_* 保持一致
+	ClassModeOverride = 0
+	ClassModeStack    = 1
+
+	// 需与 maps.h 中的 CLASS_F_* 保持一致
+	classFlagPort          = 1 << 0
+	classFlagPrefix        = 1 << 1
+	classFlagDSCP          = 1 << 2
+	classFlagsIngressShift = 4
+
+	ipProtoTCP = 6
+	ipProtoUDP = 17
+	maxDSCP    = 63
+)
+
+// ClassKey 与 maps.h 中 struct class_key 一一对应
+type ClassKey struct {
+	Ifindex uint32
+	Proto   uint8
+	Dscp    uint8
+	Port    uint16
+}
+
+// ClassPrefixKey 与 maps.h 中 struct class_prefix_key 一一对应，Addr 为网络字节序
+type ClassPrefixKey struct {
+	Prefixlen uint32
+	Ifindex   uint32
+	Addr      [4]byte
+}
+
+// ClassRule 与 maps.h 中 struct class_rule 一一对应
+type ClassRule struct {
+	ClassID   uint32
+	ProfileID uint32
+	Mode      uint32
+	Reserved  uint32
+}
+
+// ClassRequest 为一条分类的 JSON 表示，port (需带 proto)、prefix、dscp 三者选一。
+// 类的参数取自模板 profileId；stack 为 true 时在 MAC 规则之后叠加，否则覆盖 MAC 规则
+type ClassRequest struct {
+	Ifindex   uint32 `json:"ifindex"`
+	Ingress   bool   `json:"ingress,omitempty"`
+	Proto     string `json:"proto,omitempty"` // "tcp" 或 "udp"
+	Port      uint16 `json:"port,omitempty"`
+	Prefix    string `json:"prefix,omitempty"` // 对端 IPv4 前缀，如 "10.1.0.0/16"
+	DSCP      *uint8 `json:"dscp,omitempty"`
+	ClassID   uint32 `json:"classId,omitempty"`
+	ProfileID uint32 `json:"profileId,omitempty"`
+	Stack     bool   `json:"stack,omitempty"`
+}
+
+// Class 为解析后的分类，Kind 为 classFlag* 之一，决定使用 Key 还是 Prefix
+type Class struct {
+	Kind   uint32
+	Key    ClassKey
+	Prefix ClassPrefixKey
+	Rule   ClassRule
+}
+
+func (c Class) iface() uint32 {
+	return c.Key.Ifindex &^ FlowDirIngress
+}
+
+// ClassMaps 为分类规则、前缀与接口标志三张表
+type ClassMaps struct {
+	Rules    *ebpf.Map
+	Prefixes *ebpf.Map
+	Ifaces   *ebpf.Map
+}
+
+// ParseClassRequests 校验并转换请求，任意一条非法则整批拒绝；
+// withRule 为 false 时 (删除) 不检查 classId / profileId
+func ParseClassRequests(reqs []ClassRequest, withRule bool) ([]Class, error) {
+	classes := make([]Class, 0, len(reqs))
+	for i, req := range reqs {
+		if req.Ifindex == 0 || req.Ifindex >= MaxIfaceAggregates {
+			return nil, fmt.Errorf("%w: class %d: ifindex %d not supported (max %d)", ErrInvalidParams, i, req.Ifindex, MaxIfaceAggregates-1)
+		}
+		ifindex := req.Ifindex
+		if req.Ingress {
+			ifindex |= FlowDirIngress
+		}
+
+		var c Class
+		kinds := 0
+		if req.Port != 0 {
+			kinds++
+			var proto uint8
+			switch strings.ToLower(req.Proto) {
+			case "tcp":
+				proto = ipProtoTCP
+			case "udp":
+				proto = ipProtoUDP
+			default:
+				return nil, fmt.Errorf("%w: class %d: port requires proto tcp or udp", ErrInvalidParams, i)
+			}
+			c.Kind, c.Key = classFlagPort, ClassKey{Ifindex: ifindex, Proto: proto, Port: req.Port}
+		}
+		if req.Prefix != "" {
+			kinds++
+			prefix, err := netip.ParsePrefix(req.Prefix)
+			if err != nil || !prefix.Addr().Is4() {
+				return nil, fmt.Errorf("%w: class %d: invalid IPv4 prefix %q", ErrInvalidParams, i, req.Prefix)
+			}
+			prefix = prefix.Masked()
+			c.Kind = classFlagPrefix
+			c.Key = ClassKey{Ifindex: ifindex}
+			c.Prefix = ClassPrefixKey{Prefixlen: 32 + uint32(prefix.Bits()), Ifindex: ifindex, Addr: prefix.Addr().As4()}
+		}
+		if req.DSCP != nil {
+			kinds++
+			if *req.DSCP > maxDSCP {
+				return nil, fmt.Errorf("%w: class %d: dscp %d out of range [0, %d]", ErrInvalidParams, i, *req.DSCP, maxDSCP)
+			}
+			c.Kind, c.Key = classFlagDSCP, ClassKey{Ifindex: ifindex, Dscp: *req.DSCP}
+		}
+		if kinds != 1 {
+			return nil, fmt.Errorf("%w: class %d: exactly one of port, prefix and dscp required", ErrInvalidParams, i)
+		}
+
+		if withRule {
+			if req.ClassID == 0 || req.ClassID >= MaxClasses {
+				return nil, fmt.Errorf("%w: class %d: class id out of range [1, %d)", ErrInvalidParams, i, MaxClasses)
+			}
+			if req.ProfileID == 0 || req.ProfileID >= MaxProfiles {
+				return nil, fmt.Errorf("%w: class %d: profile id out of range [1, %d)", ErrInvalidParams, i, MaxProfiles)
+			}
+			c.Rule = ClassRule{ClassID: req.ClassID, ProfileID: req.ProfileID, Mode: ClassModeOverride}
+			if req.Stack {
+				c.Rule.Mode = ClassModeStack
+			}
+		}
+		classes = append(classes, c)
+	}
+	return classes, nil
+}
+
+// PutClasses 写入一组分类，再打开所涉接口的分类标志，数据面下一个包即开始解析 IP 头
+func PutClasses(maps ClassMaps, classes []Class) (int, error) {
+	ifaces := make(map[uint32]struct{})
+	applied := 0
+	var err error
+	for _, c := range classes {
+		if c.Kind == classFlagPrefix {
+			err = maps.Prefixes.Put(c.Prefix, c.Rule)
+		} else {
+			err = maps.Rules.Put(c.Key, c.Rule)
+		}
+		if err != nil {
+			break
+		}
+		ifaces[c.iface()] = struct{}{}
+		applied++
+	}
+	if ferr := refreshClassFlags(maps, ifaces); err == nil {
+		err = ferr
+	}
+	return applied, err
+}
+
+// DeleteClasses 删除一组分类，不存在的分类视为已删除；接口上不再有分类时关闭其标志
+func DeleteClasses(maps ClassMaps, classes []Class) (int, error) {
+	ifaces := make(map[uint32]struct{})
+	deleted := 0
+	var err error
+	for _, c := range classes {
+		ifaces[c.iface()] = struct{}{}
+		if c.Kind == classFlagPrefix {
+			err = maps.Prefixes.Delete(c.Prefix)
+		} else {
+			err = maps.Rules.Delete(c.Key)
+		}
+		if errors.Is(err, ebpf.ErrKeyNotExist) {
+			err = nil
+			continue
+		}
+		if err != nil {
+			break
+		}
+		deleted++
+	}
+	if ferr := refreshClassFlags(maps, ifaces); err == nil {
+		err = ferr
+	}
+	return deleted, err
+}
+
+// PurgeClasses 删除一个接口两个方向的全部分类，Pod 删除时调用，避免 ifindex 复用后新 Pod 继承旧分类
+func PurgeClasses(maps ClassMaps, ifindex uint32) (int, error) {
+	all, err := listClasses(maps)
+	if err != nil {
+		return 0, err
+	}
+	var classes []Class
+	for _, c := range all {
+		if c.iface() == ifindex {
+			classes = append(classes, c)
+		}
+	}
+	if len(classes) == 0 {
+		return 0, nil
+	}
+	return DeleteClasses(maps, classes)
+}
+
+// ListClasses 返回所有分类的 JSON 表示
+func ListClasses(maps ClassMaps) ([]ClassRequest, error) {
+	classes, err := listClasses(maps)
+	if err != nil {
+		return nil, err
+	}
+	result := make([]ClassRequest, 0, len(classes))
+	for _, c := range classes {
+		req := ClassRequest{
+			Ifindex:   c.iface(),
+			Ingress:   c.Key.Ifindex&FlowDirIngress != 0,
+			ClassID:   c.Rule.ClassID,
+			ProfileID: c.Rule.ProfileID,
+			Stack:     c.Rule.Mode == ClassModeStack,
+		}
+		switch c.Kind {
+		case classFlagPort:
+			req.Port, req.Proto = c.Key.Port, "tcp"
+			if c.Key.Proto == ipProtoUDP {
+				req.Proto = "udp"
+			}
+		case classFlagPrefix:
+			req.Prefix = netip.PrefixFrom(netip.AddrFrom4(c.Prefix.Addr), int(c.Prefix.Prefixlen-32)).String()
+		case classFlagDSCP:
+			dscp := c.Key.Dscp
+			req.DSCP = &dscp
+		}
+		result = append(result, req)
+	}
+	return result, nil
+}
+
+func listClasses(maps ClassMaps) ([]Class, error) {
+	var classes []Class
+
+	var key ClassKey
+	var rule ClassRule
+	iter := maps.Rules.Iterate()
+	for iter.Next(&key, &rule) {
+		kind := uint32(classFlagDSCP)
+		if key.Proto != 0 {
+			kind = classFlagPort
+		}
+		classes = append(classes, Class{Kind: kind, Key: key, Rule: rule})
+	}
+	if err := iter.Err(); err != nil {
+		return nil, err
+	}
+
+	var prefix ClassPrefixKey
+	iter = maps.Prefixes.Iterate()
+	for iter.Next(&prefix, &rule) {
+		classes = append(classes, Class{
+			Kind:   classFlagPrefix,
+			Key:    ClassKey{Ifindex: prefix.Ifindex},
+			Prefix: prefix,
+			Rule:   rule,
+		})
+	}
+	if err := iter.Err(); err != nil {
+		return nil, err
+	}
+	return classes, nil
+}
+
+// refreshClassFlags 按当前分类表重算 ifaces 中各接口的 CLASS_F_* 标志。
+// 分类表规模有限 (各 16384)，每次变更全表扫描一遍即可，无需维护引用计数
+func refreshClassFlags(maps ClassMaps, ifaces map[uint32]struct{}) error {
+	if len(ifaces) == 0 {
+		return nil
+	}
+	classes, err := listClasses(maps)
+	if err != nil {
+		return err
+	}
+	flags := make(map[uint32]uint32, len(ifaces))
+	for _, c := range classes {
+		iface := c.iface()
+		if _, ok := ifaces[iface]; !ok {
+			continue
+		}
+		kind := c.Kind
+		if c.Key.Ifindex&FlowDirIngress != 0 {
+			kind <<= classFlagsIngressShift
+		}
+		flags[iface] |= kind
+	}
+	for iface := range ifaces {
+		if err := maps.Ifaces.Put(iface, flags[iface]); err != nil {
+			return fmt.Errorf("update class flags of ifindex %d: %v", iface, err)
+		}
+	}
+	return nil
+}
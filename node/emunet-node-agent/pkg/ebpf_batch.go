@@ -0,0 +1,614 @@
+package pkg
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+
+	"github.com/cilium/ebpf"
+)
+
+// ==========================================
+// 批量规则编解码 (JSON / 紧凑二进制)
+// ==========================================
+
+// EntryRequest 为一条链路规则，JSON 字段与 /api/ebpf/entry 保持一致
+type EntryRequest struct {
+	Ifindex         uint32 `json:"ifindex"`
+	SrcMac          string `json:"srcMac"`
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
+	Delay           uint32 `json:"delay"`
+	LossRate        uint32 `json:"lossRate"`
+	Jitter          uint32 `json:"jitter"`
+	ProfileID       uint32 `json:"profileId,omitempty"`
+	GeP             uint32 `json:"geP,omitempty"`
+	GeR             uint32 `json:"geR,omitempty"`
+	GeLossBad       uint32 `json:"geLossBad,omitempty"`
+	QueueBytes      uint32 `json:"queueBytes,omitempty"`
+	QueueDelay      uint32 `json:"queueDelay,omitempty"`
+	RedMin          uint32 `json:"redMin,omitempty"`
+	RedMax          uint32 `json:"redMax,omitempty"`
+	RedMaxP         uint32 `json:"redMaxP,omitempty"`
+	ECN             bool   `json:"ecn,omitempty"`
+	GroupID         uint32 `json:"groupId,omitempty"`
+	TraceID         uint32 `json:"traceId,omitempty"`
+	JitterDist      uint32 `json:"jitterDist,omitempty"`
+	JitterOrdered   bool   `json:"jitterOrdered,omitempty"`
+	DupRate         uint32 `json:"dupRate,omitempty"`
+	CorruptRate     uint32 `json:"corruptRate,omitempty"`
+	CorruptKeepCsum bool   `json:"corruptKeepCsum,omitempty"`
+	ReorderRate     uint32 `json:"reorderRate,omitempty"`
+	ReorderGap      uint32 `json:"reorderGap,omitempty"`
+	// Ingress 为 true 时规则作用于 Ifindex 入口方向 (Pod 发出的包)，SrcMac 为对端 (目的) MAC
+	Ingress bool `json:"ingress,omitempty"`
+}
+
+// Params 返回请求中的链路参数
+func (req EntryRequest) Params() LinkParams {
+	return LinkParams{
+		ThrottleRateBps: req.ThrottleRateBps,
+		Delay:           req.Delay,
+		LossRate:        req.LossRate,
+		Jitter:          req.Jitter,
+		ProfileID:       req.ProfileID,
+		GeP:             req.GeP,
+		GeR:             req.GeR,
+		GeLossBad:       req.GeLossBad,
+		QueueBytes:      req.QueueBytes,
+		QueueDelay:      req.QueueDelay,
+		RedMin:          req.RedMin,
+		RedMax:          req.RedMax,
+		RedMaxP:         req.RedMaxP,
+		ECN:             req.ECN,
+		GroupID:         req.GroupID,
+		TraceID:         req.TraceID,
+		JitterDist:      req.JitterDist,
+		JitterOrdered:   req.JitterOrdered,
+		DupRate:         req.DupRate,
+		CorruptRate:     req.CorruptRate,
+		CorruptKeepCsum: req.CorruptKeepCsum,
+		ReorderRate:     req.ReorderRate,
+		ReorderGap:      req.ReorderGap,
+	}
+}
+
+// LinkParams 为单条链路的损伤参数，速率单位 bps，延迟/抖动单位 0.01ms，丢包率与转移概率单位 0.01%。
+// ProfileID 非 0 时链路绑定到模板，其余参数仅作记录。
+// GeP 非 0 时启用 Gilbert-Elliott 突发丢包：LossRate 为好状态丢包率，GeLossBad 为坏状态丢包率。
+// 队列与 AQM 参数只在限速时生效：QueueBytes/QueueDelay 为瓶颈队列上限 (同时设置时取较小者)，
+// RedMin/RedMax 为 RED 排队时延阈值 (0.01ms)，ECN 为 true 时对 ECT 报文标记 CE 代替早期丢包。
+// GroupID 非 0 时链路在自身与接口瓶颈之后还经过该组的共享瓶颈 (见 aggregates.go)。
+// TraceID 非 0 时速率/时延/丢包率改为按轨迹回放 (见 traces.go)，轨迹未加载时使用自身参数。
+// JitterDist 选择抖动分布 (JitterDist*，非均匀分布时 Jitter 为标准差)，
+// JitterOrdered 为 true 时发送时间不早于同一链路的上一个包，抖动不造成乱序。
+// DupRate/CorruptRate/ReorderRate (0.01%) 为 netem 式的复制、比特损坏与重排概率：损坏默认令 L4 校验和失配，
+// CorruptKeepCsum 为 true 时修正校验和；重排的包跳过时延抖动，ReorderGap 同 netem 的 gap，需配合 Delay 才有效果
+type LinkParams struct {
+	ThrottleRateBps uint64
+	Delay           uint32
+	LossRate        uint32
+	Jitter          uint32
+	ProfileID       uint32
+	GeP             uint32
+	GeR             uint32
+	GeLossBad       uint32
+	QueueBytes      uint32
+	QueueDelay      uint32
+	RedMin          uint32
+	RedMax          uint32
+	RedMaxP         uint32
+	ECN             bool
+	GroupID         uint32
+	TraceID         uint32
+	JitterDist      uint32
+	JitterOrdered   bool
+	DupRate         uint32
+	CorruptRate     uint32
+	CorruptKeepCsum bool
+	ReorderRate     uint32
+	ReorderGap      uint32
+}
+
+// Entry 为解析后的一条规则
+type Entry struct {
+	Key    FlowKey
+	Params LinkParams
+}
+
+// 二进制批量格式 (小端):
+//
+//	header: magic u16 | version u16 | count u32
+//	upsert record v7 (96B): ifindex u32 | mac [6] | pad [2] | rate u64 | delay u32 | loss u32 | jitter u32 | profile u32 |
+//	                        ge_p u32 | ge_r u32 | ge_loss_bad u32 |
+//	                        queue_bytes u32 | queue_delay u32 | red_min u32 | red_max u32 | red_max_p u32 | flags u32 |
+//	                        group u32 | trace u32 | dup u32 | corrupt u32 | reorder u32 | reorder_gap u32
+//	flags: bit0 ECN | bit1 jitter ordered | bit2 corrupt keep csum | bit8-15 jitter dist (旧发送方均为 0，语义不变)
+//	upsert record v6 (80B): 同 v7 但没有 dup/corrupt/reorder 字段
+//	upsert record v5 (76B): 同 v6 但没有 trace 字段
+//	upsert record v4 (72B): 同 v5 但没有 group 字段
+//	upsert record v3 (48B): 同 v4 但没有队列与 AQM 字段
+//	upsert record v2 (36B): 同 v3 但没有 ge_* 字段
+//	upsert record v1 (32B): 同 v2 但没有 profile 字段
+//	delete record (12B): ifindex u32 | mac [6] | pad [2]
+const (
+	BatchMagic           = 0xEB01
+	BatchVersion         = 7
+	BatchHeaderSize      = 8
+	BatchUpsertRecSize   = 96
+	batchUpsertRecSizeV6 = 80
+	batchUpsertRecSizeV5 = 76
+	batchUpsertRecSizeV4 = 72
+	batchUpsertRecSizeV3 = 48
+	batchUpsertRecSizeV2 = 36
+	batchUpsertRecSizeV1 = 32
+	BatchDeleteRecSize   = 12
+	BatchContentType     = "application/octet-stream"
+	batchFlagECN         = 1 << 0
+	batchFlagJitterOrder = 1 << 1
+	batchFlagKeepCsum    = 1 << 2
+	batchJitterDistShift = 8
+	MaxBatchEntries      = 65535 // 单个批量请求 (帧) 的条数上限，限定帧大小 (maxFrameSize)，与规则表容量无关
+	maxBatchRecordBytes  = BatchUpsertRecSize
+)
+
+// ErrInvalidParams 表示规则参数非法 (调用方应返回 400 而非 500)
+var ErrInvalidParams = errors.New("invalid link params")
+
+// ValidateParams 检查参数是否可以安全写入数据面
+func ValidateParams(p LinkParams) error {
+	if p.ThrottleRateBps != 0 && p.ThrottleRateBps < MinThrottleRateBps {
+		return fmt.Errorf("%w: throttle rate %d bps below minimum %d bps", ErrInvalidParams, p.ThrottleRateBps, MinThrottleRateBps)
+	}
+	if p.ProfileID >= MaxProfiles {
+		return fmt.Errorf("%w: profile id %d out of range [0, %d)", ErrInvalidParams, p.ProfileID, MaxProfiles)
+	}
+	if p.GeP > LossScope || p.GeR > LossScope || p.GeLossBad > LossScope {
+		return fmt.Errorf("%w: geP/geR/geLossBad must not exceed %d", ErrInvalidParams, LossScope)
+	}
+	if p.GeP != 0 && p.GeR == 0 {
+		// 坏状态无法恢复，链路进入后等同于按 GeLossBad 永久丢包
+		return fmt.Errorf("%w: geR must be non-zero when geP is set", ErrInvalidParams)
+	}
+	if p.RedMax != 0 && p.RedMax <= p.RedMin {
+		return fmt.Errorf("%w: redMax %d must be greater than redMin %d", ErrInvalidParams, p.RedMax, p.RedMin)
+	}
+	if p.RedMaxP > LossScope {
+		return fmt.Errorf("%w: redMaxP must not exceed %d", ErrInvalidParams, LossScope)
+	}
+	if p.GroupID >= MaxGroupAggregates {
+		return fmt.Errorf("%w: group id %d out of range [0, %d)", ErrInvalidParams, p.GroupID, MaxGroupAggregates)
+	}
+	if p.TraceID >= MaxTraces {
+		return fmt.Errorf("%w: trace id %d out of range [0, %d)", ErrInvalidParams, p.TraceID, MaxTraces)
+	}
+	if p.JitterDist > JitterDistPareto {
+		return fmt.Errorf("%w: unknown jitter distribution %d", ErrInvalidParams, p.JitterDist)
+	}
+	if p.DupRate > LossScope || p.CorruptRate > LossScope || p.ReorderRate > LossScope {
+		return fmt.Errorf("%w: dupRate/corruptRate/reorderRate must not exceed %d", ErrInvalidParams, LossScope)
+	}
+	return nil
+}
+
+// ToHandleEmu 生成写入 MAC_HANDLE_EMU 的 value，预计算定点倒数
+func (p LinkParams) ToHandleEmu() HandleEmu {
+	h := HandleEmu{
+		ThrottleRateBps: p.ThrottleRateBps,
+		NsPerByteFP:     NsPerByteFP(p.ThrottleRateBps),
+		Delay:           p.Delay,
+		LossRate:        p.LossRate,
+		Jitter:          p.Jitter,
+		ProfileID:       p.ProfileID,
+		GeP:             p.GeP,
+		GeR:             p.GeR,
+		GeLossBad:       p.GeLossBad,
+		QueueLimitNs:    p.queueLimitNs(),
+		RedMinNs:        delayUnitsToNs(p.RedMin),
+		RedMaxNs:        delayUnitsToNs(p.RedMax),
+		RedMaxP:         p.RedMaxP,
+		GroupID:         p.GroupID,
+		TraceID:         p.TraceID,
+		JitterDist:      p.JitterDist,
+		DupRate:         p.DupRate,
+		CorruptRate:     p.CorruptRate,
+		ReorderRate:     p.ReorderRate,
+		ReorderGap:      p.ReorderGap,
+	}
+	if p.CorruptKeepCsum {
+		h.ImpairFlags |= ImpairFlagKeepCsum
+	}
+	if p.ECN {
+		h.AqmFlags |= AqmFlagECN
+	}
+	if p.JitterOrdered {
+		h.JitterFlags |= JitterFlagOrdered
+	}
+	return h
+}
+
+// queueLimitNs 把队列上限换算为排队时延：字节上限按链路速率换算，
+// 与时延上限同时设置时取较小者；不限速的链路没有队列
+func (p LinkParams) queueLimitNs() uint32 {
+	return queueLimitNs(p.ThrottleRateBps, p.QueueBytes, p.QueueDelay)
+}
+
+func queueLimitNs(rateBps uint64, queueBytes, queueDelay uint32) uint32 {
+	if rateBps == 0 {
+		return 0
+	}
+	limit := uint64(delayUnitsToNs(queueDelay))
+	if queueBytes != 0 {
+		byBytes := uint64(float64(queueBytes) * 8e9 / float64(rateBps))
+		if byBytes == 0 {
+			byBytes = 1
+		}
+		if limit == 0 || byBytes < limit {
+			limit = byBytes
+		}
+	}
+	if limit > TimeHorizonNs {
+		limit = TimeHorizonNs
+	}
+	return uint32(limit)
+}
+
+// delayUnitsToNs 把 0.01ms 单位的阈值换算为纳秒，超过时间视界的按视界截断
+func delayUnitsToNs(v uint32) uint32 {
+	ns := uint64(v) * NsPerDelayUnit
+	if ns > TimeHorizonNs {
+		ns = TimeHorizonNs
+	}
+	return uint32(ns)
+}
+
+// ParseEntryRequests 把 JSON 请求转换为 Entry，任意一条非法则整批拒绝
+func ParseEntryRequests(reqs []EntryRequest) ([]Entry, error) {
+	entries := make([]Entry, 0, len(reqs))
+	for i, req := range reqs {
+		mac, err := ParseMAC(req.SrcMac)
+		if err != nil {
+			return nil, fmt.Errorf("entry %d: failed to parse MAC address: %v", i, err)
+		}
+		if req.Ifindex&FlowDirIngress != 0 {
+			return nil, fmt.Errorf("%w: entry %d: ifindex %d out of range", ErrInvalidParams, i, req.Ifindex)
+		}
+		key := FlowKey{Ifindex: req.Ifindex, SrcMac: mac}
+		if req.Ingress {
+			key.Ifindex |= FlowDirIngress
+		}
+		entries = append(entries, Entry{Key: key, Params: req.Params()})
+	}
+	return entries, nil
+}
+
+func putBatchHeader(buf []byte, count int) {
+	binary.LittleEndian.PutUint16(buf[0:], BatchMagic)
+	binary.LittleEndian.PutUint16(buf[2:], BatchVersion)
+	binary.LittleEndian.PutUint32(buf[4:], uint32(count))
+}
+
+// parseBatchHeader 校验头部并返回记录数与版本；recSize 根据版本给出每条记录的长度
+func parseBatchHeader(buf []byte, recSize func(version uint16) int) (int, uint16, error) {
+	if len(buf) < BatchHeaderSize {
+		return 0, 0, fmt.Errorf("batch body too short")
+	}
+	if magic := binary.LittleEndian.Uint16(buf[0:]); magic != BatchMagic {
+		return 0, 0, fmt.Errorf("bad batch magic 0x%04x", magic)
+	}
+	ver := binary.LittleEndian.Uint16(buf[2:])
+	if ver < 1 || ver > BatchVersion {
+		return 0, 0, fmt.Errorf("unsupported batch version %d", ver)
+	}
+	count := int(binary.LittleEndian.Uint32(buf[4:]))
+	if count > MaxBatchEntries {
+		return 0, 0, fmt.Errorf("batch of %d entries exceeds limit %d", count, MaxBatchEntries)
+	}
+	if len(buf) != BatchHeaderSize+count*recSize(ver) {
+		return 0, 0, fmt.Errorf("batch body length %d does not match %d records", len(buf), count)
+	}
+	return count, ver, nil
+}
+
+func upsertRecSize(version uint16) int {
+	switch version {
+	case 1:
+		return batchUpsertRecSizeV1
+	case 2:
+		return batchUpsertRecSizeV2
+	case 3:
+		return batchUpsertRecSizeV3
+	case 4:
+		return batchUpsertRecSizeV4
+	case 5:
+		return batchUpsertRecSizeV5
+	case 6:
+		return batchUpsertRecSizeV6
+	}
+	return BatchUpsertRecSize
+}
+
+func deleteRecSize(uint16) int {
+	return BatchDeleteRecSize
+}
+
+func putFlowKey(buf []byte, key FlowKey) {
+	binary.LittleEndian.PutUint32(buf[0:], key.Ifindex)
+	copy(buf[4:10], key.SrcMac[:])
+}
+
+func getFlowKey(buf []byte) FlowKey {
+	var key FlowKey
+	key.Ifindex = binary.LittleEndian.Uint32(buf[0:])
+	copy(key.SrcMac[:], buf[4:10])
+	return key
+}
+
+// checkRuleKey 拒绝带分类位的 key：规则 key 的 ifindex 只允许方向位 (与 linkserver 的 newLinkKey 对应)，
+// 分类位只出现在统计与按流状态的 key 中，写入规则表会造成无法匹配的脏规则
+func checkRuleKey(i int, key FlowKey) error {
+	if key.Ifindex&(FlowClassStacked|FlowClassMask) != 0 {
+		return fmt.Errorf("entry %d: ifindex 0x%08x out of range", i, key.Ifindex)
+	}
+	return nil
+}
+
+func (p LinkParams) batchFlags() uint32 {
+	flags := (p.JitterDist & 0xff) << batchJitterDistShift
+	if p.ECN {
+		flags |= batchFlagECN
+	}
+	if p.JitterOrdered {
+		flags |= batchFlagJitterOrder
+	}
+	if p.CorruptKeepCsum {
+		flags |= batchFlagKeepCsum
+	}
+	return flags
+}
+
+func (p *LinkParams) setBatchFlags(flags uint32) {
+	p.ECN = flags&batchFlagECN != 0
+	p.JitterOrdered = flags&batchFlagJitterOrder != 0
+	p.CorruptKeepCsum = flags&batchFlagKeepCsum != 0
+	p.JitterDist = (flags >> batchJitterDistShift) & 0xff
+}
+
+// EncodeUpsertBatch 编码批量写入请求体
+func EncodeUpsertBatch(entries []Entry) []byte {
+	buf := make([]byte, BatchHeaderSize+len(entries)*BatchUpsertRecSize)
+	putBatchHeader(buf, len(entries))
+	for i, e := range entries {
+		rec := buf[BatchHeaderSize+i*BatchUpsertRecSize:]
+		putFlowKey(rec, e.Key)
+		binary.LittleEndian.PutUint64(rec[12:], e.Params.ThrottleRateBps)
+		binary.LittleEndian.PutUint32(rec[20:], e.Params.Delay)
+		binary.LittleEndian.PutUint32(rec[24:], e.Params.LossRate)
+		binary.LittleEndian.PutUint32(rec[28:], e.Params.Jitter)
+		binary.LittleEndian.PutUint32(rec[32:], e.Params.ProfileID)
+		binary.LittleEndian.PutUint32(rec[36:], e.Params.GeP)
+		binary.LittleEndian.PutUint32(rec[40:], e.Params.GeR)
+		binary.LittleEndian.PutUint32(rec[44:], e.Params.GeLossBad)
+		binary.LittleEndian.PutUint32(rec[48:], e.Params.QueueBytes)
+		binary.LittleEndian.PutUint32(rec[52:], e.Params.QueueDelay)
+		binary.LittleEndian.PutUint32(rec[56:], e.Params.RedMin)
+		binary.LittleEndian.PutUint32(rec[60:], e.Params.RedMax)
+		binary.LittleEndian.PutUint32(rec[64:], e.Params.RedMaxP)
+		binary.LittleEndian.PutUint32(rec[68:], e.Params.batchFlags())
+		binary.LittleEndian.PutUint32(rec[72:], e.Params.GroupID)
+		binary.LittleEndian.PutUint32(rec[76:], e.Params.TraceID)
+		binary.LittleEndian.PutUint32(rec[80:], e.Params.DupRate)
+		binary.LittleEndian.PutUint32(rec[84:], e.Params.CorruptRate)
+		binary.LittleEndian.PutUint32(rec[88:], e.Params.ReorderRate)
+		binary.LittleEndian.PutUint32(rec[92:], e.Params.ReorderGap)
+	}
+	return buf
+}
+
+// DecodeUpsertBatch 解码批量写入请求体
+func DecodeUpsertBatch(buf []byte) ([]Entry, error) {
+	count, ver, err := parseBatchHeader(buf, upsertRecSize)
+	if err != nil {
+		return nil, err
+	}
+	recSize := upsertRecSize(ver)
+	entries := make([]Entry, count)
+	for i := range entries {
+		rec := buf[BatchHeaderSize+i*recSize:]
+		key := getFlowKey(rec)
+		if err := checkRuleKey(i, key); err != nil {
+			return nil, err
+		}
+		entries[i] = Entry{
+			Key: key,
+			Params: LinkParams{
+				ThrottleRateBps: binary.LittleEndian.Uint64(rec[12:]),
+				Delay:           binary.LittleEndian.Uint32(rec[20:]),
+				LossRate:        binary.LittleEndian.Uint32(rec[24:]),
+				Jitter:          binary.LittleEndian.Uint32(rec[28:]),
+			},
+		}
+		if ver >= 2 {
+			entries[i].Params.ProfileID = binary.LittleEndian.Uint32(rec[32:])
+		}
+		if ver >= 3 {
+			entries[i].Params.GeP = binary.LittleEndian.Uint32(rec[36:])
+			entries[i].Params.GeR = binary.LittleEndian.Uint32(rec[40:])
+			entries[i].Params.GeLossBad = binary.LittleEndian.Uint32(rec[44:])
+		}
+		if ver >= 4 {
+			p := &entries[i].Params
+			p.QueueBytes = binary.LittleEndian.Uint32(rec[48:])
+			p.QueueDelay = binary.LittleEndian.Uint32(rec[52:])
+			p.RedMin = binary.LittleEndian.Uint32(rec[56:])
+			p.RedMax = binary.LittleEndian.Uint32(rec[60:])
+			p.RedMaxP = binary.LittleEndian.Uint32(rec[64:])
+			p.setBatchFlags(binary.LittleEndian.Uint32(rec[68:]))
+		}
+		if ver >= 5 {
+			entries[i].Params.GroupID = binary.LittleEndian.Uint32(rec[72:])
+		}
+		if ver >= 6 {
+			entries[i].Params.TraceID = binary.LittleEndian.Uint32(rec[76:])
+		}
+		if ver >= 7 {
+			p := &entries[i].Params
+			p.DupRate = binary.LittleEndian.Uint32(rec[80:])
+			p.CorruptRate = binary.LittleEndian.Uint32(rec[84:])
+			p.ReorderRate = binary.LittleEndian.Uint32(rec[88:])
+			p.ReorderGap = binary.LittleEndian.Uint32(rec[92:])
+		}
+	}
+	return entries, nil
+}
+
+// EncodeDeleteBatch 编码批量删除请求体
+func EncodeDeleteBatch(keys []FlowKey) []byte {
+	buf := make([]byte, BatchHeaderSize+len(keys)*BatchDeleteRecSize)
+	putBatchHeader(buf, len(keys))
+	for i, key := range keys {
+		putFlowKey(buf[BatchHeaderSize+i*BatchDeleteRecSize:], key)
+	}
+	return buf
+}
+
+// DecodeDeleteBatch 解码批量删除请求体
+func DecodeDeleteBatch(buf []byte) ([]FlowKey, error) {
+	count, _, err := parseBatchHeader(buf, deleteRecSize)
+	if err != nil {
+		return nil, err
+	}
+	keys := make([]FlowKey, count)
+	for i := range keys {
+		keys[i] = getFlowKey(buf[BatchHeaderSize+i*BatchDeleteRecSize:])
+		if err := checkRuleKey(i, keys[i]); err != nil {
+			return nil, err
+		}
+	}
+	return keys, nil
+}
+
+// MaxBatchBodySize 为批量请求体的上限 (按二进制格式计算)
+func MaxBatchBodySize() int64 {
+	return BatchHeaderSize + MaxBatchEntries*maxBatchRecordBytes
+}
+
+// ==========================================
+// 批量写入 / 删除 MAC_HANDLE_EMU
+// ==========================================
+
+// BatchPutEntries 一次 BPF_MAP_UPDATE_BATCH 写入整批规则，内核不支持时逐条写入
+func BatchPutEntries(ebpfMap *ebpf.Map, entries []Entry) (int, error) {
+	if len(entries) == 0 {
+		return 0, nil
+	}
+	keys := make([]FlowKey, len(entries))
+	values := make([]HandleEmu, len(entries))
+	for i, e := range entries {
+		if err := ValidateParams(e.Params); err != nil {
+			return 0, fmt.Errorf("entry %d: %w", i, err)
+		}
+		keys[i] = e.Key
+		values[i] = e.Params.ToHandleEmu()
+	}
+
+	n, err := ebpfMap.BatchUpdate(keys, values, nil)
+	if errors.Is(err, ebpf.ErrNotSupported) {
+		for i := range keys {
+			if err := ebpfMap.Put(keys[i], values[i]); err != nil {
+				return i, err
+			}
+		}
+		return len(keys), nil
+	}
+	return n, err
+}
+
+// BatchDeleteEntries 批量删除规则，已不存在的 key 视为删除成功
+func BatchDeleteEntries(ebpfMap *ebpf.Map, keys []FlowKey) (int, error) {
+	deleted := 0
+	for len(keys) > 0 {
+		n, err := ebpfMap.BatchDelete(keys, nil)
+		deleted += n
+		switch {
+		case err == nil:
+			return deleted, nil
+		case errors.Is(err, ebpf.ErrKeyNotExist):
+			// 内核在第一个不存在的 key 处停止，跳过它继续删除剩余部分
+			keys = keys[n+1:]
+		case errors.Is(err, ebpf.ErrNotSupported):
+			for _, key := range keys[n:] {
+				if err := ebpfMap.Delete(key); err == nil {
+					deleted++
+				} else if !errors.Is(err, ebpf.ErrKeyNotExist) {
+					return deleted, err
+				}
+			}
+			return deleted, nil
+		default:
+			return deleted, err
+		}
+	}
+	return deleted, nil
+}
+
+// RuleWriter 为规则写入目标：扁平表 (RuleMaps) 或按接口分表 (IfaceTables)
+type RuleWriter interface {
+	PutEntries(entries []Entry) (int, error)
+	DeleteEntries(keys []FlowKey) (int, error)
+	// Purge 删除与 match 相关的全部规则
+	Purge(match FlowMatch) (int, error)
+	// Dump 读出当前生效的全部规则
+	Dump() (map[FlowKey]HandleEmu, error)
+}
+
+// RuleMaps 把同一批规则写入多张扁平规则表
+type RuleMaps []*ebpf.Map
+
+func (m RuleMaps) PutEntries(entries []Entry) (int, error) { return BatchPutEntriesTo(m, entries) }
+
+func (m RuleMaps) DeleteEntries(keys []FlowKey) (int, error) { return BatchDeleteEntriesFrom(m, keys) }
+
+// Purge 逐表扫描并批量删除，返回第一张表的删除数
+func (m RuleMaps) Purge(match FlowMatch) (int, error) {
+	deleted := 0
+	for i, table := range m {
+		n, err := PurgeRules(table, match)
+		if i == 0 {
+			deleted = n
+		}
+		if err != nil {
+			return deleted, err
+		}
+	}
+	return deleted, nil
+}
+
+// BatchPutEntriesTo 把同一批规则写入多张表 (如生效表与暂存中的影子表)，返回第一张表的写入数
+func BatchPutEntriesTo(maps []*ebpf.Map, entries []Entry) (int, error) {
+	applied := 0
+	for i, m := range maps {
+		n, err := BatchPutEntries(m, entries)
+		if i == 0 {
+			applied = n
+		}
+		if err != nil {
+			return applied, err
+		}
+	}
+	return applied, nil
+}
+
+// BatchDeleteEntriesFrom 从多张表中删除同一批规则，返回第一张表的删除数
+func BatchDeleteEntriesFrom(maps []*ebpf.Map, keys []FlowKey) (int, error) {
+	deleted := 0
+	for i, m := range maps {
+		n, err := BatchDeleteEntries(m, keys)
+		if i == 0 {
+			deleted = n
+		}
+		if err != nil {
+			return deleted, err
+		}
+	}
+	return deleted, nil
+}
@@ -0,0 +1,206 @@
+package pkg
+
+import (
+	"encoding/binary"
+	"testing"
+)
+
+// linkserverRequest 与 linkserver 的 AgentRequest 中参与二进制编码的字段一致
+type linkserverRequest struct {
+	ThrottleRateBps uint64
+	Delay           uint32
+	LossRate        uint32
+	Jitter          uint32
+	ProfileID       uint32
+	GeP             uint32
+	GeR             uint32
+	GeLossBad       uint32
+	QueueBytes      uint32
+	QueueDelay      uint32
+	RedMin          uint32
+	RedMax          uint32
+	RedMaxP         uint32
+	ECN             bool
+	GroupID         uint32
+	TraceID         uint32
+	JitterDist      uint32
+	JitterOrdered   bool
+	DupRate         uint32
+	CorruptRate     uint32
+	CorruptKeepCsum bool
+	ReorderRate     uint32
+	ReorderGap      uint32
+}
+
+// encodeLinkserverBatch 逐行照抄 master/linkserver/internal/api/dispatcher.go 的 encodeAgentBatch
+// (含其常量)，两边布局改动时需同步修改这里
+func encodeLinkserverBatch(keys []FlowKey, reqs []linkserverRequest) []byte {
+	const (
+		batchMagic         = 0xEB01
+		batchVersion       = 7
+		batchHeaderSize    = 8
+		batchUpsertRecSize = 96
+		batchFlagECN       = 1 << 0
+		batchFlagJitterOrd = 1 << 1
+		batchFlagKeepCsum  = 1 << 2
+		batchJitterShift   = 8
+	)
+	buf := make([]byte, batchHeaderSize+len(keys)*batchUpsertRecSize)
+	binary.LittleEndian.PutUint16(buf[0:], batchMagic)
+	binary.LittleEndian.PutUint16(buf[2:], batchVersion)
+	binary.LittleEndian.PutUint32(buf[4:], uint32(len(keys)))
+	for i, key := range keys {
+		rec := buf[batchHeaderSize+i*batchUpsertRecSize:]
+		binary.LittleEndian.PutUint32(rec[0:], key.Ifindex)
+		copy(rec[4:10], key.SrcMac[:])
+		req := &reqs[i]
+		binary.LittleEndian.PutUint64(rec[12:], req.ThrottleRateBps)
+		binary.LittleEndian.PutUint32(rec[20:], req.Delay)
+		binary.LittleEndian.PutUint32(rec[24:], req.LossRate)
+		binary.LittleEndian.PutUint32(rec[28:], req.Jitter)
+		binary.LittleEndian.PutUint32(rec[32:], req.ProfileID)
+		binary.LittleEndian.PutUint32(rec[36:], req.GeP)
+		binary.LittleEndian.PutUint32(rec[40:], req.GeR)
+		binary.LittleEndian.PutUint32(rec[44:], req.GeLossBad)
+		binary.LittleEndian.PutUint32(rec[48:], req.QueueBytes)
+		binary.LittleEndian.PutUint32(rec[52:], req.QueueDelay)
+		binary.LittleEndian.PutUint32(rec[56:], req.RedMin)
+		binary.LittleEndian.PutUint32(rec[60:], req.RedMax)
+		binary.LittleEndian.PutUint32(rec[64:], req.RedMaxP)
+		flags := (req.JitterDist & 0xff) << batchJitterShift
+		if req.ECN {
+			flags |= batchFlagECN
+		}
+		if req.JitterOrdered {
+			flags |= batchFlagJitterOrd
+		}
+		if req.CorruptKeepCsum {
+			flags |= batchFlagKeepCsum
+		}
+		binary.LittleEndian.PutUint32(rec[68:], flags)
+		binary.LittleEndian.PutUint32(rec[72:], req.GroupID)
+		binary.LittleEndian.PutUint32(rec[76:], req.TraceID)
+		binary.LittleEndian.PutUint32(rec[80:], req.DupRate)
+		binary.LittleEndian.PutUint32(rec[84:], req.CorruptRate)
+		binary.LittleEndian.PutUint32(rec[88:], req.ReorderRate)
+		binary.LittleEndian.PutUint32(rec[92:], req.ReorderGap)
+	}
+	return buf
+}
+
+func (r linkserverRequest) params() LinkParams {
+	return LinkParams{
+		ThrottleRateBps: r.ThrottleRateBps,
+		Delay:           r.Delay,
+		LossRate:        r.LossRate,
+		Jitter:          r.Jitter,
+		ProfileID:       r.ProfileID,
+		GeP:             r.GeP,
+		GeR:             r.GeR,
+		GeLossBad:       r.GeLossBad,
+		QueueBytes:      r.QueueBytes,
+		QueueDelay:      r.QueueDelay,
+		RedMin:          r.RedMin,
+		RedMax:          r.RedMax,
+		RedMaxP:         r.RedMaxP,
+		ECN:             r.ECN,
+		GroupID:         r.GroupID,
+		TraceID:         r.TraceID,
+		JitterDist:      r.JitterDist,
+		JitterOrdered:   r.JitterOrdered,
+		DupRate:         r.DupRate,
+		CorruptRate:     r.CorruptRate,
+		CorruptKeepCsum: r.CorruptKeepCsum,
+		ReorderRate:     r.ReorderRate,
+		ReorderGap:      r.ReorderGap,
+	}
+}
+
+// 每个字段取互不相同的值，任一偏移错位都会让某个字段读到相邻字段的值
+func TestDecodeUpsertBatchLinkserverLayout(t *testing.T) {
+	cases := []struct {
+		name string
+		key  FlowKey
+		req  linkserverRequest
+	}{
+		{"zero", FlowKey{Ifindex: 7, SrcMac: [6]byte{0x02, 0, 0, 0, 0, 1}}, linkserverRequest{}},
+		{"rate only", FlowKey{Ifindex: 8, SrcMac: [6]byte{0x02, 0, 0, 0, 0, 2}}, linkserverRequest{ThrottleRateBps: 1 << 40}},
+		{"all fields", FlowKey{Ifindex: 9, SrcMac: [6]byte{0x02, 0x11, 0x22, 0x33, 0x44, 0x55}}, linkserverRequest{
+			ThrottleRateBps: 100000001, Delay: 102, LossRate: 103, Jitter: 104, ProfileID: 105,
+			GeP: 106, GeR: 107, GeLossBad: 108, QueueBytes: 109000, QueueDelay: 110,
+			RedMin: 111, RedMax: 112, RedMaxP: 113, GroupID: 114, TraceID: 15,
+			DupRate: 116, CorruptRate: 117, ReorderRate: 118, ReorderGap: 119,
+		}},
+		{"flags", FlowKey{Ifindex: 10, SrcMac: [6]byte{0x02, 0, 0, 0, 0, 3}}, linkserverRequest{
+			ThrottleRateBps: 5000000, ECN: true, JitterDist: JitterDistPareto, JitterOrdered: true, CorruptKeepCsum: true,
+		}},
+		{"single flag", FlowKey{Ifindex: 11, SrcMac: [6]byte{0x02, 0, 0, 0, 0, 4}}, linkserverRequest{
+			JitterDist: JitterDistNormal, CorruptKeepCsum: true,
+		}},
+		{"ingress", FlowKey{Ifindex: 12 | FlowDirIngress, SrcMac: [6]byte{0x02, 0, 0, 0, 0, 5}}, linkserverRequest{Delay: 500}},
+	}
+	for _, tc := range cases {
+		t.Run(tc.name, func(t *testing.T) {
+			want := tc.req.params()
+			buf := encodeLinkserverBatch([]FlowKey{tc.key}, []linkserverRequest{tc.req})
+			entries, err := DecodeUpsertBatch(buf)
+			if err != nil {
+				t.Fatalf("DecodeUpsertBatch: %v", err)
+			}
+			if len(entries) != 1 {
+				t.Fatalf("decoded %d entries, want 1", len(entries))
+			}
+			if entries[0].Key != tc.key {
+				t.Errorf("key = %+v, want %+v", entries[0].Key, tc.key)
+			}
+			if entries[0].Params != want {
+				t.Errorf("params = %+v, want %+v", entries[0].Params, want)
+			}
+			if got, exp := entries[0].Params.ToHandleEmu(), want.ToHandleEmu(); got != exp {
+				t.Errorf("ToHandleEmu = %+v, want %+v", got, exp)
+			}
+			// 两侧编码器应产生完全相同的字节
+			if own := EncodeUpsertBatch([]Entry{{Key: tc.key, Params: want}}); string(own) != string(buf) {
+				t.Errorf("EncodeUpsertBatch differs from linkserver encoding")
+			}
+		})
+	}
+}
+
+func TestDecodeBatchRejectsClassBits(t *testing.T) {
+	mac := [6]byte{0x02, 0, 0, 0, 0, 1}
+	cases := []struct {
+		name    string
+		ifindex uint32
+		wantErr bool
+	}{
+		{"egress", 7, false},
+		{"ingress", 7 | FlowDirIngress, false},
+		{"class", 7 | 3<<FlowClassShift, true},
+		{"stacked", 7 | FlowClassStacked, true},
+		{"ingress class", 7 | FlowDirIngress | 1<<FlowClassShift, true},
+	}
+	for _, tc := range cases {
+		t.Run(tc.name, func(t *testing.T) {
+			key := FlowKey{Ifindex: tc.ifindex, SrcMac: mac}
+			_, err := DecodeUpsertBatch(encodeLinkserverBatch([]FlowKey{key}, []linkserverRequest{{}}))
+			if (err != nil) != tc.wantErr {
+				t.Errorf("DecodeUpsertBatch err = %v, wantErr %v", err, tc.wantErr)
+			}
+			_, err = DecodeDeleteBatch(EncodeDeleteBatch([]FlowKey{key}))
+			if (err != nil) != tc.wantErr {
+				t.Errorf("DecodeDeleteBatch err = %v, wantErr %v", err, tc.wantErr)
+			}
+		})
+	}
+}
+
+func TestDecodeUpsertBatchRejectsBadLength(t *testing.T) {
+	buf := encodeLinkserverBatch([]FlowKey{{Ifindex: 7}}, []linkserverRequest{{}})
+	if _, err := DecodeUpsertBatch(buf[:len(buf)-4]); err == nil {
+		t.Fatal("truncated batch decoded without error")
+	}
+	if entries, err := DecodeUpsertBatch(encodeLinkserverBatch(nil, nil)); err != nil || len(entries) != 0 {
+		t.Fatalf("empty batch: %d entries, err %v", len(entries), err)
+	}
+}
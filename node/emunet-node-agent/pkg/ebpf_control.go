@@ -13,11 +13,89 @@ type FlowKey struct {
 	SrcMac  [6]byte
 }
 
+// FlowDirIngress 需与 maps.h 中的 FLOW_DIR_INGRESS 保持一致：入口方向 (Pod 发出，上行) 的规则
+// 在 Ifindex 最高位置 1，SrcMac 为目的 MAC
+const FlowDirIngress = 1 << 31
+
+// 需与 maps.h 中的 FLOW_CLASS_* 保持一致：L3/L4 分类的统计与状态在 Ifindex 第 20~29 位
+// 存放 class id，叠加模式再置第 30 位
+const (
+	FlowClassShift   = 20
+	FlowClassMask    = (MaxClasses - 1) << FlowClassShift
+	FlowClassStacked = 1 << 30
+)
+
+// Iface 返回去掉方向位与分类位的 veth ifindex
+func (k FlowKey) Iface() uint32 {
+	return k.Ifindex &^ (FlowDirIngress | FlowClassStacked | FlowClassMask)
+}
+
+// Class 返回统计所属的 L3/L4 分类，0 表示 MAC 规则本身
+func (k FlowKey) Class() uint32 {
+	return (k.Ifindex & FlowClassMask) >> FlowClassShift
+}
+
+// Ingress 判断是否为入口方向 (上行) 的规则
+func (k FlowKey) Ingress() bool {
+	return k.Ifindex&FlowDirIngress != 0
+}
+
+// HandleEmu 与 maps.h 中 struct handle_emu 一一对应
 type HandleEmu struct {
-	ThrottleRateBps uint32
+	ThrottleRateBps uint64
+	NsPerByteFP     uint64 // 每字节传输耗时 (ns)，RateFPShift 位定点数
 	Delay           uint32
 	LossRate        uint32
 	Jitter          uint32
+	ProfileID       uint32 // 非 0 时数据面改用 EMU_PROFILES[ProfileID] 的参数
+	GeP             uint32 // Gilbert-Elliott 好 -> 坏转移概率，0 表示独立丢包
+	GeR             uint32 // 坏 -> 好转移概率
+	GeLossBad       uint32 // 坏状态丢包率
+	QueueLimitNs    uint32 // 瓶颈队列上限 (排队时延)，0 表示只受时间视界限制
+	RedMinNs        uint32
+	RedMaxNs        uint32 // 0 表示不启用 RED
+	RedMaxP         uint32
+	AqmFlags        uint32 // AqmFlag*
+	GroupID         uint32 // 非 0 时链路还经过 EMU_GROUP_AGG[GroupID] 的共享瓶颈
+	TraceID         uint32 // 非 0 时速率/时延/丢包率按 EMU_TRACE_POINTS 中的轨迹随时间变化
+	JitterDist      uint32 // JitterDist*
+	JitterFlags     uint32 // JitterFlag*
+	DupRate         uint32 // 复制概率
+	CorruptRate     uint32 // 损坏概率
+	ReorderRate     uint32 // 重排概率
+	ReorderGap      uint32 // 大于 1 时每 ReorderGap - 1 个正常延迟的包之后才考虑重排
+	ImpairFlags     uint32 // ImpairFlag*
+	Reserved        uint32
+}
+
+const (
+	// RateFPShift 需与 maps.h 中的 RATE_FP_SHIFT 保持一致
+	RateFPShift = 20
+	// TimeHorizonNs 需与 tc_bpf.c 中的 TIME_HORIZON_NS 保持一致，队列与 RED 阈值不超过该值
+	TimeHorizonNs = 2000 * 1000 * 1000
+	// NsPerDelayUnit 为延迟类参数单位 (0.01ms) 对应的纳秒数
+	NsPerDelayUnit = 10000
+	// AqmFlagECN 需与 maps.h 中的 AQM_F_ECN 保持一致
+	AqmFlagECN = 1 << 0
+	// JitterDist* / JitterFlagOrdered 需与 maps.h 中的 JITTER_DIST_* / JITTER_F_ORDERED 保持一致
+	JitterDistUniform = 0
+	JitterDistNormal  = 1
+	JitterDistPareto  = 2
+	JitterFlagOrdered = 1 << 0
+	// ImpairFlagKeepCsum 需与 maps.h 中的 IMPAIR_F_KEEP_CSUM 保持一致
+	ImpairFlagKeepCsum = 1 << 0
+	// LossScope 需与 tc_bpf.c 中的 PKT_LOSS_SCOPE 保持一致，丢包率与转移概率以 1/LossScope 为单位
+	LossScope = 10000
+	// MinThrottleRateBps 低于该速率时 64KB 报文的 len*ns_per_byte_fp 可能溢出
+	MinThrottleRateBps = 1000
+)
+
+// NsPerByteFP 预计算每字节传输耗时的定点数，0 速率表示不限速
+func NsPerByteFP(rateBps uint64) uint64 {
+	if rateBps == 0 {
+		return 0
+	}
+	return (8 * 1000000000 << RateFPShift) / rateBps
 }
 
 func ParseMAC(macStr string) ([6]byte, error) {
@@ -42,25 +120,22 @@ func ParseMAC(macStr string) ([6]byte, error) {
 	return mac, nil
 }
 
-func AddEBPFEntry(ebpfMap *ebpf.Map, ifindex uint32, macStr string, throttleRateBps, delay, lossRate, jitter uint32) error {
+func AddEBPFEntry(ebpfMap *ebpf.Map, ifindex uint32, macStr string, params LinkParams) error {
 	mac, err := ParseMAC(macStr)
 	if err != nil {
 		return fmt.Errorf("failed to parse MAC address: %v", err)
 	}
 
+	if err := ValidateParams(params); err != nil {
+		return err
+	}
+
 	key := FlowKey{
 		Ifindex: ifindex,
 		SrcMac:  mac,
 	}
 
-	value := HandleEmu{
-		ThrottleRateBps: throttleRateBps,
-		Delay:           delay,
-		LossRate:        lossRate,
-		Jitter:          jitter,
-	}
-
-	return ebpfMap.Put(key, value)
+	return ebpfMap.Put(key, params.ToHandleEmu())
 }
 
 func DeleteEBPFEntry(ebpfMap *ebpf.Map, ifindex uint32, macStr string) error {
@@ -0,0 +1,154 @@
+package pkg
+
+import (
+	"errors"
+	"fmt"
+
+	"github.com/cilium/ebpf"
+)
+
+// ==========================================
+// 双缓冲规则表 (EMU_TABLES + EMU_EPOCH)
+// ==========================================
+
+const (
+	DefaultEpochMapPath  = "/sys/fs/bpf/tc_emu/maps/EMU_EPOCH"
+	DefaultTablesMapPath = "/sys/fs/bpf/tc_emu/maps/EMU_TABLES"
+
+	// EmuTableSlots 需与 maps.h 中的 EMU_TABLE_SLOTS 保持一致
+	EmuTableSlots = 2
+)
+
+// emuTableSpec 为内层规则表的定义，必须与 maps.h 中 struct emu_table 完全一致，
+// 否则写入 EMU_TABLES 时内核会拒绝
+var emuTableSpec = ebpf.MapSpec{
+	Type:       ebpf.Hash,
+	KeySize:    10,  // struct flow_key (packed)
+	ValueSize:  104, // struct handle_emu
+	MaxEntries: 65535,
+}
+
+// EpochTables 封装 epoch 切换所需的两个 pin 住的 map
+type EpochTables struct {
+	epoch  *ebpf.Map
+	tables *ebpf.Map
+	// maxEntries 为影子表容量，与 MAC_HANDLE_EMU 一致 (CNI 可配置)，0 表示沿用 emuTableSpec
+	maxEntries uint32
+}
+
+// LoadEpochTables 加载 pin 住的 EMU_EPOCH / EMU_TABLES，maxEntries 为影子表容量
+func LoadEpochTables(maxEntries uint32) (*EpochTables, error) {
+	epoch, err := LoadEBPFMap(DefaultEpochMapPath)
+	if err != nil {
+		return nil, err
+	}
+	tables, err := LoadEBPFMap(DefaultTablesMapPath)
+	if err != nil {
+		epoch.Close()
+		return nil, err
+	}
+	return &EpochTables{epoch: epoch, tables: tables, maxEntries: maxEntries}, nil
+}
+
+// Epoch 返回当前生效的 epoch，0 表示数据面直接使用 MAC_HANDLE_EMU
+func (t *EpochTables) Epoch() (uint32, error) {
+	var epoch uint32
+	if err := t.epoch.Lookup(uint32(0), &epoch); err != nil {
+		return 0, err
+	}
+	return epoch, nil
+}
+
+// SlotOf 返回 epoch 对应的 EMU_TABLES 槽位
+func SlotOf(epoch uint32) uint32 {
+	return (epoch - 1) & (EmuTableSlots - 1)
+}
+
+// Table 打开 epoch 对应的内层规则表，调用方负责 Close
+func (t *EpochTables) Table(epoch uint32) (*ebpf.Map, error) {
+	if epoch == 0 {
+		return nil, fmt.Errorf("epoch 0 has no double-buffered table")
+	}
+	var id uint32
+	if err := t.tables.Lookup(SlotOf(epoch), &id); err != nil {
+		return nil, fmt.Errorf("no table installed for epoch %d: %v", epoch, err)
+	}
+	return ebpf.NewMapFromID(ebpf.MapID(id))
+}
+
+// Stage 为 epoch 新建一张空的影子表并装入对应槽位；seed 非空时先把 seed 的内容复制进去。
+// 槽位中原有的表 (上上个 epoch) 被替换，数据面此时不会读到它
+func (t *EpochTables) Stage(epoch uint32, seed *ebpf.Map) (*ebpf.Map, error) {
+	if epoch == 0 {
+		return nil, fmt.Errorf("epoch must be non-zero")
+	}
+	if current, err := t.Epoch(); err == nil && current != 0 && SlotOf(current) == SlotOf(epoch) {
+		return nil, fmt.Errorf("epoch %d would overwrite the active table of epoch %d", epoch, current)
+	}
+
+	spec := emuTableSpec
+	if t.maxEntries > 0 {
+		spec.MaxEntries = t.maxEntries
+	}
+	shadow, err := ebpf.NewMap(&spec)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create shadow table: %v", err)
+	}
+	if seed != nil {
+		if err := CopyRules(seed, shadow); err != nil {
+			shadow.Close()
+			return nil, fmt.Errorf("failed to seed shadow table: %v", err)
+		}
+	}
+	if err := t.tables.Put(SlotOf(epoch), shadow); err != nil {
+		shadow.Close()
+		return nil, fmt.Errorf("failed to install shadow table: %v", err)
+	}
+	return shadow, nil
+}
+
+// Activate 翻转 EMU_EPOCH，单次数组写入对所有 CPU 原子可见
+func (t *EpochTables) Activate(epoch uint32) error {
+	return t.epoch.Put(uint32(0), epoch)
+}
+
+func (t *EpochTables) Close() {
+	t.epoch.Close()
+	t.tables.Close()
+}
+
+// CopyRules 把 src 中的全部规则批量复制到 dst
+func CopyRules(src, dst *ebpf.Map) error {
+	keys := make([]FlowKey, statsBatchSize)
+	values := make([]HandleEmu, statsBatchSize)
+	cursor := new(ebpf.MapBatchCursor)
+	for {
+		n, err := src.BatchLookup(cursor, keys, values, nil)
+		if n > 0 {
+			if _, perr := dst.BatchUpdate(keys[:n], values[:n], nil); perr != nil {
+				return perr
+			}
+		}
+		if errors.Is(err, ebpf.ErrKeyNotExist) {
+			return nil
+		}
+		if errors.Is(err, ebpf.ErrNotSupported) {
+			return copyRulesIter(src, dst)
+		}
+		if err != nil {
+			return err
+		}
+	}
+}
+
+func copyRulesIter(src, dst *ebpf.Map) error {
+	var key FlowKey
+	var value HandleEmu
+	iter := src.Iterate()
+	for iter.Next(&key, &value) {
+		if err := dst.Put(key, value); err != nil {
+			return err
+		}
+	}
+	return iter.Err()
+}
@@ -0,0 +1,210 @@
+package pkg
+
+import (
+	"errors"
+	"fmt"
+	"sync"
+
+	"github.com/cilium/ebpf"
+)
+
+// ==========================================
+// 按接口分表 (EMU_IFACE_TABLES HASH_OF_MAPS)
+// ==========================================
+
+const (
+	DefaultIfaceTablesMapPath = "/sys/fs/bpf/tc_emu/maps/EMU_IFACE_TABLES"
+
+	// MaxIfaceTables 需与 maps.h 中的 MAX_IFACE_TABLES 保持一致
+	MaxIfaceTables = 4096
+	// DefaultIfaceTableEntries 为每个接口内层表的容量，即一个 Pod 最多可区分的源 MAC 数。
+	// 内核只校验内层哈希表的类型、键值大小与 flags，容量由 agent 创建时决定
+	DefaultIfaceTableEntries = 4096
+)
+
+// IfaceTables 把规则按 ifindex 写入各接口独立的内层表，内层表在第一条规则写入时创建
+type IfaceTables struct {
+	outer      *ebpf.Map
+	maxEntries uint32
+
+	mu    sync.Mutex
+	inner map[uint32]*ebpf.Map
+}
+
+// LoadIfaceTables 加载 pin 住的 EMU_IFACE_TABLES；CNI 未启用按接口分表时该 map 不存在
+func LoadIfaceTables(maxEntries uint32) (*IfaceTables, error) {
+	outer, err := LoadEBPFMap(DefaultIfaceTablesMapPath)
+	if err != nil {
+		return nil, err
+	}
+	if maxEntries == 0 {
+		maxEntries = DefaultIfaceTableEntries
+	}
+	return &IfaceTables{outer: outer, maxEntries: maxEntries, inner: make(map[uint32]*ebpf.Map)}, nil
+}
+
+// table 返回 ifindex 的内层表；create 为 false 且表不存在时返回 nil
+func (t *IfaceTables) table(ifindex uint32, create bool) (*ebpf.Map, error) {
+	if m, ok := t.inner[ifindex]; ok {
+		return m, nil
+	}
+
+	// agent 重启后从外层表恢复已有的内层表
+	var id uint32
+	err := t.outer.Lookup(ifindex, &id)
+	if err == nil {
+		m, err := ebpf.NewMapFromID(ebpf.MapID(id))
+		if err != nil {
+			return nil, fmt.Errorf("failed to open table of ifindex %d: %v", ifindex, err)
+		}
+		t.inner[ifindex] = m
+		return m, nil
+	}
+	if !errors.Is(err, ebpf.ErrKeyNotExist) {
+		return nil, err
+	}
+	if !create {
+		return nil, nil
+	}
+
+	spec := emuTableSpec
+	spec.MaxEntries = t.maxEntries
+	m, err := ebpf.NewMap(&spec)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create table of ifindex %d: %v", ifindex, err)
+	}
+	if err := t.outer.Update(ifindex, m, ebpf.UpdateNoExist); err != nil {
+		m.Close()
+		return nil, fmt.Errorf("failed to install table of ifindex %d: %v", ifindex, err)
+	}
+	t.inner[ifindex] = m
+	return m, nil
+}
+
+// PutEntries 按 ifindex 分组后逐表批量写入，返回成功写入数。参数先整批校验，避免部分接口已写入
+func (t *IfaceTables) PutEntries(entries []Entry) (int, error) {
+	for i, e := range entries {
+		if err := ValidateParams(e.Params); err != nil {
+			return 0, fmt.Errorf("entry %d: %w", i, err)
+		}
+	}
+
+	t.mu.Lock()
+	defer t.mu.Unlock()
+
+	applied := 0
+	for ifindex, group := range groupEntries(entries) {
+		m, err := t.table(ifindex, true)
+		if err != nil {
+			return applied, err
+		}
+		n, err := BatchPutEntries(m, group)
+		applied += n
+		if err != nil {
+			return applied, err
+		}
+	}
+	return applied, nil
+}
+
+// DeleteEntries 按 ifindex 分组后逐表批量删除，内层表不存在的规则视为已删除
+func (t *IfaceTables) DeleteEntries(keys []FlowKey) (int, error) {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+
+	groups := make(map[uint32][]FlowKey)
+	for _, key := range keys {
+		groups[key.Ifindex] = append(groups[key.Ifindex], key)
+	}
+	deleted := 0
+	for ifindex, group := range groups {
+		m, err := t.table(ifindex, false)
+		if err != nil {
+			return deleted, err
+		}
+		if m == nil {
+			continue
+		}
+		n, err := BatchDeleteEntries(m, group)
+		deleted += n
+		if err != nil {
+			return deleted, err
+		}
+	}
+	return deleted, nil
+}
+
+// Drop 删除接口一个方向 (ifindex 含方向位) 的整张内层表：一次外层元素删除即回收该接口的全部规则，
+// 数据面随后对该接口查不到规则，内核在最后一个引用释放后回收内层表
+func (t *IfaceTables) Drop(ifindex uint32) (bool, error) {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+
+	if m, ok := t.inner[ifindex]; ok {
+		m.Close()
+		delete(t.inner, ifindex)
+	}
+	err := t.outer.Delete(ifindex)
+	if errors.Is(err, ebpf.ErrKeyNotExist) {
+		return false, nil
+	}
+	return err == nil, err
+}
+
+// Purge 整表回收 match.Ifindex 两个方向的规则，HasMac 时再从其余接口的表中删除该 MAC 的规则。
+// 返回值只计入按 MAC 删除的规则，整表回收的规则不逐条计数
+func (t *IfaceTables) Purge(match FlowMatch) (int, error) {
+	for _, ifindex := range []uint32{match.Ifindex, match.Ifindex | FlowDirIngress} {
+		if _, err := t.Drop(ifindex); err != nil {
+			return 0, err
+		}
+	}
+	if !match.HasMac {
+		return 0, nil
+	}
+	ifaces, err := t.Interfaces()
+	if err != nil {
+		return 0, err
+	}
+
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	deleted := 0
+	for _, ifindex := range ifaces {
+		m, err := t.table(ifindex, false)
+		if err != nil {
+			return deleted, err
+		}
+		if m == nil {
+			continue
+		}
+		n, err := PurgeRules(m, match)
+		deleted += n
+		if err != nil {
+			return deleted, err
+		}
+	}
+	return deleted, nil
+}
+
+// Interfaces 返回已创建内层表的 ifindex 列表
+func (t *IfaceTables) Interfaces() ([]uint32, error) {
+	var (
+		ifindex uint32
+		id      uint32
+		list    []uint32
+	)
+	iter := t.outer.Iterate()
+	for iter.Next(&ifindex, &id) {
+		list = append(list, ifindex)
+	}
+	return list, iter.Err()
+}
+
+func groupEntries(entries []Entry) map[uint32][]Entry {
+	groups := make(map[uint32][]Entry)
+	for _, e := range entries {
+		groups[e.Key.Ifindex] = append(groups[e.Key.Ifindex], e)
+	}
+	return groups
+}
@@ -0,0 +1,100 @@
+package pkg
+
+import (
+	"errors"
+	"fmt"
+
+	"github.com/cilium/ebpf"
+)
+
+const DefaultStatsMapPath = "/sys/fs/bpf/tc_emu/maps/LINK_STATS"
+
+// statsBatchSize 每次 BatchLookup 读取的链路数
+const statsBatchSize = 1024
+
+// LinkStats 与 maps.h 中 struct link_stats 一一对应
+type LinkStats struct {
+	Packets        uint64
+	Bytes          uint64
+	LossDrops      uint64
+	HorizonDrops   uint64
+	ErrorDrops     uint64
+	DelayNs        uint64
+	QueueDrops     uint64
+	AqmDrops       uint64
+	EcnMarks       uint64
+	AggDrops       uint64
+	DupPackets     uint64
+	CorruptPackets uint64
+	ReorderPackets uint64
+}
+
+func (s *LinkStats) add(o *LinkStats) {
+	s.Packets += o.Packets
+	s.Bytes += o.Bytes
+	s.LossDrops += o.LossDrops
+	s.HorizonDrops += o.HorizonDrops
+	s.ErrorDrops += o.ErrorDrops
+	s.DelayNs += o.DelayNs
+	s.QueueDrops += o.QueueDrops
+	s.AqmDrops += o.AqmDrops
+	s.EcnMarks += o.EcnMarks
+	s.AggDrops += o.AggDrops
+	s.DupPackets += o.DupPackets
+	s.CorruptPackets += o.CorruptPackets
+	s.ReorderPackets += o.ReorderPackets
+}
+
+// DumpLinkStats 批量读取 per-CPU 统计 map，并把各 CPU 的计数累加为每条链路一份
+func DumpLinkStats(statsMap *ebpf.Map) (map[FlowKey]LinkStats, error) {
+	nCPU, err := ebpf.PossibleCPU()
+	if err != nil {
+		return nil, fmt.Errorf("failed to get possible CPUs: %v", err)
+	}
+
+	result := make(map[FlowKey]LinkStats)
+	keys := make([]FlowKey, statsBatchSize)
+	// per-CPU map 的批量读取：每个 key 对应 nCPU 个连续的 value
+	values := make([]LinkStats, statsBatchSize*nCPU)
+	cursor := new(ebpf.MapBatchCursor)
+
+	for {
+		n, err := statsMap.BatchLookup(cursor, keys, values, nil)
+		for i := 0; i < n; i++ {
+			var total LinkStats
+			for cpu := 0; cpu < nCPU; cpu++ {
+				total.add(&values[i*nCPU+cpu])
+			}
+			result[keys[i]] = total
+		}
+		if errors.Is(err, ebpf.ErrKeyNotExist) {
+			return result, nil
+		}
+		if errors.Is(err, ebpf.ErrNotSupported) {
+			// 内核不支持批量操作时退化为逐条迭代
+			return dumpLinkStatsIter(statsMap)
+		}
+		if err != nil {
+			return nil, fmt.Errorf("batch lookup failed: %v", err)
+		}
+	}
+}
+
+func dumpLinkStatsIter(statsMap *ebpf.Map) (map[FlowKey]LinkStats, error) {
+	result := make(map[FlowKey]LinkStats)
+	var key FlowKey
+	var perCPU []LinkStats
+
+	it := statsMap.Iterate()
+	for it.Next(&key, &perCPU) {
+		var total LinkStats
+		for i := range perCPU {
+			total.add(&perCPU[i])
+		}
+		result[key] = total
+	}
+	if err := it.Err(); err != nil {
+		return nil, fmt.Errorf("iterate stats map failed: %v", err)
+	}
+	return result, nil
+}
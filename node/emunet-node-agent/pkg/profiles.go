@@ -0,0 +1,166 @@
+package pkg
+
+import (
+	"errors"
+	"fmt"
+
+	"github.com/cilium/ebpf"
+)
+
+// ==========================================
+// 链路模板 (EMU_PROFILES ARRAY)
+// ==========================================
+
+const DefaultProfileMapPath = "/sys/fs/bpf/tc_emu/maps/EMU_PROFILES"
+
+// MaxProfiles 需与 maps.h 中的 MAX_PROFILES 保持一致，0 号保留
+const MaxProfiles = 4096
+
+// ProfileRequest 为一个模板的 JSON 表示
+type ProfileRequest struct {
+	ID              uint32 `json:"id"`
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
+	Delay           uint32 `json:"delay"`
+	LossRate        uint32 `json:"lossRate"`
+	Jitter          uint32 `json:"jitter"`
+	GeP             uint32 `json:"geP,omitempty"`
+	GeR             uint32 `json:"geR,omitempty"`
+	GeLossBad       uint32 `json:"geLossBad,omitempty"`
+	QueueBytes      uint32 `json:"queueBytes,omitempty"`
+	QueueDelay      uint32 `json:"queueDelay,omitempty"`
+	RedMin          uint32 `json:"redMin,omitempty"`
+	RedMax          uint32 `json:"redMax,omitempty"`
+	RedMaxP         uint32 `json:"redMaxP,omitempty"`
+	ECN             bool   `json:"ecn,omitempty"`
+	GroupID         uint32 `json:"groupId,omitempty"`
+	TraceID         uint32 `json:"traceId,omitempty"`
+	JitterDist      uint32 `json:"jitterDist,omitempty"`
+	JitterOrdered   bool   `json:"jitterOrdered,omitempty"`
+	DupRate         uint32 `json:"dupRate,omitempty"`
+	CorruptRate     uint32 `json:"corruptRate,omitempty"`
+	CorruptKeepCsum bool   `json:"corruptKeepCsum,omitempty"`
+	ReorderRate     uint32 `json:"reorderRate,omitempty"`
+	ReorderGap      uint32 `json:"reorderGap,omitempty"`
+}
+
+// Profile 为解析后的模板
+type Profile struct {
+	ID     uint32
+	Params LinkParams
+}
+
+// ParseProfileRequests 校验并转换模板请求，任意一条非法则整批拒绝
+func ParseProfileRequests(reqs []ProfileRequest) ([]Profile, error) {
+	profiles := make([]Profile, 0, len(reqs))
+	for i, req := range reqs {
+		if req.ID == 0 || req.ID >= MaxProfiles {
+			return nil, fmt.Errorf("%w: profile %d: id out of range [1, %d)", ErrInvalidParams, i, MaxProfiles)
+		}
+		p := Profile{
+			ID: req.ID,
+			Params: LinkParams{
+				ThrottleRateBps: req.ThrottleRateBps,
+				Delay:           req.Delay,
+				LossRate:        req.LossRate,
+				Jitter:          req.Jitter,
+				GeP:             req.GeP,
+				GeR:             req.GeR,
+				GeLossBad:       req.GeLossBad,
+				QueueBytes:      req.QueueBytes,
+				QueueDelay:      req.QueueDelay,
+				RedMin:          req.RedMin,
+				RedMax:          req.RedMax,
+				RedMaxP:         req.RedMaxP,
+				ECN:             req.ECN,
+				GroupID:         req.GroupID,
+				TraceID:         req.TraceID,
+				JitterDist:      req.JitterDist,
+				JitterOrdered:   req.JitterOrdered,
+				DupRate:         req.DupRate,
+				CorruptRate:     req.CorruptRate,
+				CorruptKeepCsum: req.CorruptKeepCsum,
+				ReorderRate:     req.ReorderRate,
+				ReorderGap:      req.ReorderGap,
+			},
+		}
+		if err := ValidateParams(p.Params); err != nil {
+			return nil, fmt.Errorf("profile %d: %w", req.ID, err)
+		}
+		profiles = append(profiles, p)
+	}
+	return profiles, nil
+}
+
+// PutProfiles 一次 BPF_MAP_UPDATE_BATCH 写入一组模板，内核不支持时逐条写入。
+// 数组元素原地覆盖，绑定该模板的所有链路在下一个包即生效
+func PutProfiles(profileMap *ebpf.Map, profiles []Profile) (int, error) {
+	if len(profiles) == 0 {
+		return 0, nil
+	}
+	keys := make([]uint32, len(profiles))
+	values := make([]HandleEmu, len(profiles))
+	for i, p := range profiles {
+		keys[i] = p.ID
+		// 模板不可再引用模板
+		p.Params.ProfileID = 0
+		values[i] = p.Params.ToHandleEmu()
+	}
+
+	n, err := profileMap.BatchUpdate(keys, values, nil)
+	if errors.Is(err, ebpf.ErrNotSupported) {
+		for i := range keys {
+			if err := profileMap.Put(keys[i], values[i]); err != nil {
+				return i, err
+			}
+		}
+		return len(keys), nil
+	}
+	return n, err
+}
+
+// ResetProfiles 把模板清零 (ARRAY 不支持删除)，绑定的链路随之变为无损伤
+func ResetProfiles(profileMap *ebpf.Map, ids []uint32) (int, error) {
+	profiles := make([]Profile, 0, len(ids))
+	for _, id := range ids {
+		if id == 0 || id >= MaxProfiles {
+			return 0, fmt.Errorf("%w: profile id %d out of range [1, %d)", ErrInvalidParams, id, MaxProfiles)
+		}
+		profiles = append(profiles, Profile{ID: id})
+	}
+	return PutProfiles(profileMap, profiles)
+}
+
+// GetProfile 读取一个模板；队列上限以换算后的时延 (queueDelay) 返回
+func GetProfile(profileMap *ebpf.Map, id uint32) (*ProfileRequest, error) {
+	if id == 0 || id >= MaxProfiles {
+		return nil, fmt.Errorf("%w: profile id %d out of range [1, %d)", ErrInvalidParams, id, MaxProfiles)
+	}
+	var value HandleEmu
+	if err := profileMap.Lookup(id, &value); err != nil {
+		return nil, err
+	}
+	return &ProfileRequest{
+		ID:              id,
+		ThrottleRateBps: value.ThrottleRateBps,
+		Delay:           value.Delay,
+		LossRate:        value.LossRate,
+		Jitter:          value.Jitter,
+		GeP:             value.GeP,
+		GeR:             value.GeR,
+		GeLossBad:       value.GeLossBad,
+		QueueDelay:      value.QueueLimitNs / NsPerDelayUnit,
+		RedMin:          value.RedMinNs / NsPerDelayUnit,
+		RedMax:          value.RedMaxNs / NsPerDelayUnit,
+		RedMaxP:         value.RedMaxP,
+		ECN:             value.AqmFlags&AqmFlagECN != 0,
+		GroupID:         value.GroupID,
+		TraceID:         value.TraceID,
+		JitterDist:      value.JitterDist,
+		JitterOrdered:   value.JitterFlags&JitterFlagOrdered != 0,
+		DupRate:         value.DupRate,
+		CorruptRate:     value.CorruptRate,
+		CorruptKeepCsum: value.ImpairFlags&ImpairFlagKeepCsum != 0,
+		ReorderRate:     value.ReorderRate,
+		ReorderGap:      value.ReorderGap,
+	}, nil
+}
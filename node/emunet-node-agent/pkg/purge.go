@@ -0,0 +1,85 @@
+package pkg
+
+import (
+	"errors"
+
+	"github.com/cilium/ebpf"
+)
+
+// ==========================================
+// Pod 删除时回收规则与统计
+// ==========================================
+
+// FlowMatch 选出与离开的 Pod 相关的链路：其 veth 上两个方向的规则 (键中 ifindex 为其 veth)，
+// HasMac 时还包括其他 Pod 的 veth 上以它为对端的规则 (键中 MAC 为其 MAC)
+type FlowMatch struct {
+	Ifindex uint32
+	SrcMac  [6]byte
+	HasMac  bool
+}
+
+func (m FlowMatch) Match(key FlowKey) bool {
+	return key.Iface() == m.Ifindex || (m.HasMac && key.SrcMac == m.SrcMac)
+}
+
+// MatchingRules 批量扫描规则表，返回匹配的键
+func MatchingRules(m *ebpf.Map, match FlowMatch) ([]FlowKey, error) {
+	var matched []FlowKey
+	keys := make([]FlowKey, statsBatchSize)
+	values := make([]HandleEmu, statsBatchSize)
+	cursor := new(ebpf.MapBatchCursor)
+	for {
+		n, err := m.BatchLookup(cursor, keys, values, nil)
+		for _, key := range keys[:n] {
+			if match.Match(key) {
+				matched = append(matched, key)
+			}
+		}
+		if errors.Is(err, ebpf.ErrKeyNotExist) {
+			return matched, nil
+		}
+		if errors.Is(err, ebpf.ErrNotSupported) {
+			return matchingRulesIter(m, match)
+		}
+		if err != nil {
+			return nil, err
+		}
+	}
+}
+
+func matchingRulesIter(m *ebpf.Map, match FlowMatch) ([]FlowKey, error) {
+	var matched []FlowKey
+	var key FlowKey
+	var value HandleEmu
+	iter := m.Iterate()
+	for iter.Next(&key, &value) {
+		if match.Match(key) {
+			matched = append(matched, key)
+		}
+	}
+	return matched, iter.Err()
+}
+
+// PurgeRules 扫描一遍规则表，再用一次批量删除移除全部匹配的规则
+func PurgeRules(m *ebpf.Map, match FlowMatch) (int, error) {
+	keys, err := MatchingRules(m, match)
+	if err != nil {
+		return 0, err
+	}
+	return BatchDeleteEntries(m, keys)
+}
+
+// PurgeLinkStats 删除匹配链路的统计，避免已删除 Pod 的计数长期占用 LINK_STATS
+func PurgeLinkStats(statsMap *ebpf.Map, match FlowMatch) (int, error) {
+	stats, err := DumpLinkStats(statsMap)
+	if err != nil {
+		return 0, err
+	}
+	var keys []FlowKey
+	for key := range stats {
+		if match.Match(key) {
+			keys = append(keys, key)
+		}
+	}
+	return BatchDeleteEntries(statsMap, keys)
+}
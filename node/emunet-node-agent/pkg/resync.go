@@ -0,0 +1,167 @@
+package pkg
+
+import (
+	"errors"
+	"fmt"
+
+	"github.com/cilium/ebpf"
+)
+
+// ==========================================
+// 重启对账 (pin 住的规则表 vs Redis 期望快照)
+// ==========================================
+
+// DumpRules 批量读出规则表的全部内容
+func DumpRules(m *ebpf.Map) (map[FlowKey]HandleEmu, error) {
+	rules := make(map[FlowKey]HandleEmu)
+	keys := make([]FlowKey, statsBatchSize)
+	values := make([]HandleEmu, statsBatchSize)
+	cursor := new(ebpf.MapBatchCursor)
+	for {
+		n, err := m.BatchLookup(cursor, keys, values, nil)
+		for i := 0; i < n; i++ {
+			rules[keys[i]] = values[i]
+		}
+		if errors.Is(err, ebpf.ErrKeyNotExist) {
+			return rules, nil
+		}
+		if errors.Is(err, ebpf.ErrNotSupported) {
+			return dumpRulesIter(m)
+		}
+		if err != nil {
+			return nil, err
+		}
+	}
+}
+
+func dumpRulesIter(m *ebpf.Map) (map[FlowKey]HandleEmu, error) {
+	rules := make(map[FlowKey]HandleEmu)
+	var key FlowKey
+	var value HandleEmu
+	iter := m.Iterate()
+	for iter.Next(&key, &value) {
+		rules[key] = value
+	}
+	return rules, iter.Err()
+}
+
+// Dump 读出生效表 (第一张表) 的全部规则
+func (m RuleMaps) Dump() (map[FlowKey]HandleEmu, error) {
+	if len(m) == 0 {
+		return map[FlowKey]HandleEmu{}, nil
+	}
+	return DumpRules(m[0])
+}
+
+// Dump 读出全部内层表的规则
+func (t *IfaceTables) Dump() (map[FlowKey]HandleEmu, error) {
+	ifaces, err := t.Interfaces()
+	if err != nil {
+		return nil, err
+	}
+
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	rules := make(map[FlowKey]HandleEmu)
+	for _, ifindex := range ifaces {
+		m, err := t.table(ifindex, false)
+		if err != nil {
+			return nil, err
+		}
+		if m == nil {
+			continue
+		}
+		part, err := DumpRules(m)
+		if err != nil {
+			return nil, err
+		}
+		for key, value := range part {
+			rules[key] = value
+		}
+	}
+	return rules, nil
+}
+
+// DecodeRuleRecords 解码快照中的规则：每条记录为一条当前版本的批量写入记录 (BatchUpsertRecSize 字节)
+func DecodeRuleRecords(records [][]byte) ([]Entry, error) {
+	entries := make([]Entry, 0, len(records))
+	for start := 0; start < len(records); start += MaxBatchEntries {
+		end := start + MaxBatchEntries
+		if end > len(records) {
+			end = len(records)
+		}
+		buf := make([]byte, BatchHeaderSize, BatchHeaderSize+(end-start)*BatchUpsertRecSize)
+		putBatchHeader(buf, end-start)
+		for i, rec := range records[start:end] {
+			if len(rec) != BatchUpsertRecSize {
+				return nil, fmt.Errorf("rule record %d has %d bytes, want %d", start+i, len(rec), BatchUpsertRecSize)
+			}
+			buf = append(buf, rec...)
+		}
+		part, err := DecodeUpsertBatch(buf)
+		if err != nil {
+			return nil, err
+		}
+		entries = append(entries, part...)
+	}
+	return entries, nil
+}
+
+// RuleDelta 为把现有规则变为期望规则所需的最少写入
+type RuleDelta struct {
+	Upserts []Entry   // 缺失或参数不同的规则
+	Deletes []FlowKey // 期望中没有的规则
+	// Unchanged 为已与期望一致、无需写入的规则数
+	Unchanged int
+}
+
+// DiffRules 对比现有规则与期望规则；prune 为 false 时只补齐，不删除期望之外的规则
+func DiffRules(current map[FlowKey]HandleEmu, desired []Entry, prune bool) RuleDelta {
+	var delta RuleDelta
+	want := make(map[FlowKey]struct{}, len(desired))
+	for _, e := range desired {
+		want[e.Key] = struct{}{}
+		if value, ok := current[e.Key]; ok && value == e.Params.ToHandleEmu() {
+			delta.Unchanged++
+			continue
+		}
+		delta.Upserts = append(delta.Upserts, e)
+	}
+	if !prune {
+		return delta
+	}
+	for key := range current {
+		if _, ok := want[key]; !ok {
+			delta.Deletes = append(delta.Deletes, key)
+		}
+	}
+	return delta
+}
+
+// ApplyRuleDelta 按 MaxBatchEntries 分批把差异写入 w，返回写入与删除的条数
+func ApplyRuleDelta(w RuleWriter, delta RuleDelta) (int, int, error) {
+	applied, deleted := 0, 0
+	for start := 0; start < len(delta.Upserts); start += MaxBatchEntries {
+		end := start + MaxBatchEntries
+		if end > len(delta.Upserts) {
+			end = len(delta.Upserts)
+		}
+		n, err := w.PutEntries(delta.Upserts[start:end])
+		applied += n
+		if err != nil {
+			return applied, deleted, err
+		}
+	}
+	for start := 0; start < len(delta.Deletes); start += MaxBatchEntries {
+		end := start + MaxBatchEntries
+		if end > len(delta.Deletes) {
+			end = len(delta.Deletes)
+		}
+		n, err := w.DeleteEntries(delta.Deletes[start:end])
+		deleted += n
+		if err != nil {
+			return applied, deleted, err
+		}
+	}
+	return applied, deleted, nil
+}
@@ -0,0 +1,321 @@
+package pkg
+
+import (
+	"container/heap"
+	"fmt"
+	"runtime"
+	"sort"
+	"sync"
+	"time"
+)
+
+// ==========================================
+// 定时链路变更 (节点本地精确调度)
+// ==========================================
+
+const (
+	// MaxScheduledEvents 限制待执行事件数，防止无界占用内存
+	MaxScheduledEvents = 65536
+	// scheduleSpinWindow 为到点前改用忙等的窗口：定时器唤醒存在数十到数百微秒的抖动，
+	// 最后一段用单调时钟自旋把误差压到微秒级
+	scheduleSpinWindow = 500 * time.Microsecond
+)
+
+// ScheduleRequest 为一个定时事件的 JSON 表示：在 AtUnixNano 时刻依次写入模板、规则并删除规则。
+// 多节点时钟同步时，相同的 AtUnixNano 在各节点同一时刻生效
+type ScheduleRequest struct {
+	ID         string           `json:"id"`
+	AtUnixNano int64            `json:"atUnixNano"`
+	Upsert     []EntryRequest   `json:"upsert,omitempty"`
+	Delete     []EntryRequest   `json:"delete,omitempty"`
+	Profiles   []ProfileRequest `json:"profiles,omitempty"`
+}
+
+// ScheduledEvent 为解析后的定时事件，参数在上传时即完成校验与转换，到点只剩 map 写入
+type ScheduledEvent struct {
+	ID         string
+	AtUnixNano int64
+	Upsert     []Entry
+	Delete     []FlowKey
+	Profiles   []Profile
+
+	at    time.Time // 携带单调时钟读数，不受墙上时间跳变影响
+	index int
+}
+
+// ParseScheduleRequests 校验并转换定时事件，任意一条非法则整批拒绝
+func ParseScheduleRequests(reqs []ScheduleRequest) ([]*ScheduledEvent, error) {
+	now := time.Now()
+	events := make([]*ScheduledEvent, 0, len(reqs))
+	for i, req := range reqs {
+		if req.ID == "" {
+			return nil, fmt.Errorf("%w: event %d: id required", ErrInvalidParams, i)
+		}
+		if req.AtUnixNano == 0 {
+			return nil, fmt.Errorf("%w: event %s: atUnixNano required", ErrInvalidParams, req.ID)
+		}
+		ev := &ScheduledEvent{
+			ID:         req.ID,
+			AtUnixNano: req.AtUnixNano,
+			at:         now.Add(time.Duration(req.AtUnixNano - now.UnixNano())),
+		}
+
+		var err error
+		if ev.Upsert, err = ParseEntryRequests(req.Upsert); err != nil {
+			return nil, fmt.Errorf("event %s: %w", req.ID, err)
+		}
+		for j, e := range ev.Upsert {
+			if err := ValidateParams(e.Params); err != nil {
+				return nil, fmt.Errorf("event %s entry %d: %w", req.ID, j, err)
+			}
+		}
+		dels, err := ParseEntryRequests(req.Delete)
+		if err != nil {
+			return nil, fmt.Errorf("event %s: %w", req.ID, err)
+		}
+		for _, e := range dels {
+			ev.Delete = append(ev.Delete, e.Key)
+		}
+		if ev.Profiles, err = ParseProfileRequests(req.Profiles); err != nil {
+			return nil, fmt.Errorf("event %s: %w", req.ID, err)
+		}
+		if len(ev.Upsert)+len(ev.Delete)+len(ev.Profiles) == 0 {
+			return nil, fmt.Errorf("%w: event %s is empty", ErrInvalidParams, req.ID)
+		}
+		events = append(events, ev)
+	}
+	return events, nil
+}
+
+// ScheduleStatus 为调度器的摘要
+type ScheduleStatus struct {
+	PendingCount int                `json:"pendingCount"`
+	Pending      []ScheduledSummary `json:"pending,omitempty"`
+	Applied      uint64             `json:"applied"`
+	Failed       uint64             `json:"failed"`
+	// LastLatenessNs / MaxLatenessNs 为实际写入完成时刻相对计划时刻的偏差
+	LastLatenessNs int64 `json:"lastLatenessNs"`
+	MaxLatenessNs  int64 `json:"maxLatenessNs"`
+}
+
+// ScheduledSummary 为单个待执行事件的摘要
+type ScheduledSummary struct {
+	ID         string `json:"id"`
+	AtUnixNano int64  `json:"atUnixNano"`
+	Upsert     int    `json:"upsert"`
+	Delete     int    `json:"delete"`
+	Profiles   int    `json:"profiles"`
+}
+
+// Scheduler 按计划时刻执行事件。执行在独占 OS 线程的单个 goroutine 中进行，
+// 不经过 HTTP 与请求信号量，控制面负载不影响生效时刻
+type Scheduler struct {
+	mu     sync.Mutex
+	events eventHeap
+	byID   map[string]*ScheduledEvent
+	wake   chan struct{}
+	apply  func(ev *ScheduledEvent) error
+
+	applied      uint64
+	failed       uint64
+	lastLateness time.Duration
+	maxLateness  time.Duration
+	onError      func(ev *ScheduledEvent, err error)
+}
+
+// NewScheduler 创建调度器，apply 负责把事件写入数据面，onError 可为 nil
+func NewScheduler(apply func(ev *ScheduledEvent) error, onError func(ev *ScheduledEvent, err error)) *Scheduler {
+	return &Scheduler{
+		byID:    make(map[string]*ScheduledEvent),
+		wake:    make(chan struct{}, 1),
+		apply:   apply,
+		onError: onError,
+	}
+}
+
+// Add 加入一批事件，同 ID 的待执行事件被替换；已过期的事件会被立即执行
+func (s *Scheduler) Add(events []*ScheduledEvent) error {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	added := 0
+	for _, ev := range events {
+		if _, ok := s.byID[ev.ID]; !ok {
+			added++
+		}
+	}
+	if len(s.events)+added > MaxScheduledEvents {
+		return fmt.Errorf("%w: %d pending events would exceed limit %d", ErrInvalidParams, len(s.events)+added, MaxScheduledEvents)
+	}
+	for _, ev := range events {
+		if old, ok := s.byID[ev.ID]; ok {
+			heap.Remove(&s.events, old.index)
+		}
+		heap.Push(&s.events, ev)
+		s.byID[ev.ID] = ev
+	}
+	s.kick()
+	return nil
+}
+
+// Cancel 取消指定事件，ids 为空时取消全部，返回取消数
+func (s *Scheduler) Cancel(ids []string) int {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if len(ids) == 0 {
+		n := len(s.events)
+		s.events = nil
+		s.byID = make(map[string]*ScheduledEvent)
+		s.kick()
+		return n
+	}
+	n := 0
+	for _, id := range ids {
+		if ev, ok := s.byID[id]; ok {
+			heap.Remove(&s.events, ev.index)
+			delete(s.byID, id)
+			n++
+		}
+	}
+	s.kick()
+	return n
+}
+
+// Stats 返回执行统计与待执行事件数 (不含事件列表)
+func (s *Scheduler) Stats() ScheduleStatus {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	return s.statsLocked()
+}
+
+func (s *Scheduler) statsLocked() ScheduleStatus {
+	return ScheduleStatus{
+		PendingCount:   len(s.events),
+		Applied:        s.applied,
+		Failed:         s.failed,
+		LastLatenessNs: int64(s.lastLateness),
+		MaxLatenessNs:  int64(s.maxLateness),
+	}
+}
+
+// Status 返回待执行事件 (按时间排序) 与执行统计
+func (s *Scheduler) Status() ScheduleStatus {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	st := s.statsLocked()
+	st.Pending = make([]ScheduledSummary, 0, len(s.events))
+	for _, ev := range s.events {
+		st.Pending = append(st.Pending, ScheduledSummary{
+			ID:         ev.ID,
+			AtUnixNano: ev.AtUnixNano,
+			Upsert:     len(ev.Upsert),
+			Delete:     len(ev.Delete),
+			Profiles:   len(ev.Profiles),
+		})
+	}
+	sort.Slice(st.Pending, func(i, j int) bool { return st.Pending[i].AtUnixNano < st.Pending[j].AtUnixNano })
+	return st
+}
+
+func (s *Scheduler) kick() {
+	select {
+	case s.wake <- struct{}{}:
+	default:
+	}
+}
+
+// Run 执行调度循环直到 done 关闭
+func (s *Scheduler) Run(done <-chan struct{}) {
+	// 独占 OS 线程，避免自旋窗口内被 Go 调度器换出
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+
+	timer := time.NewTimer(time.Hour)
+	defer timer.Stop()
+	for {
+		s.mu.Lock()
+		var next *ScheduledEvent
+		if len(s.events) > 0 {
+			next = s.events[0]
+		}
+		s.mu.Unlock()
+
+		wait := time.Hour
+		if next != nil {
+			wait = time.Until(next.at) - scheduleSpinWindow
+		}
+		if wait > 0 {
+			if !timer.Stop() {
+				select {
+				case <-timer.C:
+				default:
+				}
+			}
+			timer.Reset(wait)
+			select {
+			case <-done:
+				return
+			case <-s.wake:
+				continue
+			case <-timer.C:
+				continue
+			}
+		}
+
+		for time.Now().Before(next.at) {
+		}
+
+		// 自旋期间事件可能被取消或替换，只执行仍在堆顶的同一事件
+		s.mu.Lock()
+		if len(s.events) == 0 || s.events[0] != next {
+			s.mu.Unlock()
+			continue
+		}
+		heap.Pop(&s.events)
+		delete(s.byID, next.ID)
+		s.mu.Unlock()
+
+		err := s.apply(next)
+		lateness := time.Since(next.at)
+
+		s.mu.Lock()
+		if err != nil {
+			s.failed++
+		} else {
+			s.applied++
+		}
+		s.lastLateness = lateness
+		if lateness > s.maxLateness {
+			s.maxLateness = lateness
+		}
+		s.mu.Unlock()
+		if err != nil && s.onError != nil {
+			s.onError(next, err)
+		}
+	}
+}
+
+// eventHeap 为按计划时刻排序的最小堆
+type eventHeap []*ScheduledEvent
+
+func (h eventHeap) Len() int           { return len(h) }
+func (h eventHeap) Less(i, j int) bool { return h[i].at.Before(h[j].at) }
+func (h eventHeap) Swap(i, j int) {
+	h[i], h[j] = h[j], h[i]
+	h[i].index = i
+	h[j].index = j
+}
+
+func (h *eventHeap) Push(x interface{}) {
+	ev := x.(*ScheduledEvent)
+	ev.index = len(*h)
+	*h = append(*h, ev)
+}
+
+func (h *eventHeap) Pop() interface{} {
+	old := *h
+	n := len(old)
+	ev := old[n-1]
+	old[n-1] = nil
+	*h = old[:n-1]
+	return ev
+}
@@ -0,0 +1,105 @@
+package pkg
+
+import (
+	"encoding/binary"
+	"fmt"
+	"io"
+)
+
+// ==========================================
+// 控制流帧格式 (linkserver <-> agent 长连接)
+// ==========================================
+//
+//	frame: length u32 | type u8 | seq u64 | payload [length-9]
+//
+// UPSERT / DELETE 的 payload 即 ebpf_batch.go 中的二进制批量格式；
+// ACK 的 payload 为: status u8 | applied u32 | apply_ns u64 | message [...]。
+// 同一连接上的帧严格按序应用，ACK 按 seq 一一对应。
+
+const (
+	FrameUpsert byte = 1
+	FrameDelete byte = 2
+	FrameAck    byte = 3
+
+	AckOK      byte = 0
+	AckInvalid byte = 1 // 参数非法，重试无意义
+	AckError   byte = 2 // 写 map 失败，可重试
+
+	DefaultStreamPort = 12346
+
+	frameHeaderSize = 13 // length + type + seq
+	ackFixedSize    = 13 // status + applied + apply_ns
+	maxFrameSize    = BatchHeaderSize + MaxBatchEntries*maxBatchRecordBytes + frameHeaderSize
+)
+
+// Frame 为一帧控制消息
+type Frame struct {
+	Type    byte
+	Seq     uint64
+	Payload []byte
+}
+
+// Ack 为 agent 对一帧规则的应用结果
+type Ack struct {
+	Status  byte
+	Applied uint32
+	ApplyNs uint64 // agent 侧 map 写入耗时
+	Message string
+}
+
+// WriteFrame 写出一帧，调用方负责对 w 做缓冲与 Flush
+func WriteFrame(w io.Writer, f *Frame) error {
+	var hdr [frameHeaderSize]byte
+	binary.LittleEndian.PutUint32(hdr[0:], uint32(len(f.Payload)+9))
+	hdr[4] = f.Type
+	binary.LittleEndian.PutUint64(hdr[5:], f.Seq)
+	if _, err := w.Write(hdr[:]); err != nil {
+		return err
+	}
+	_, err := w.Write(f.Payload)
+	return err
+}
+
+// ReadFrame 读取一帧
+func ReadFrame(r io.Reader) (*Frame, error) {
+	var hdr [frameHeaderSize]byte
+	if _, err := io.ReadFull(r, hdr[:]); err != nil {
+		return nil, err
+	}
+	length := binary.LittleEndian.Uint32(hdr[0:])
+	if length < 9 || length > maxFrameSize {
+		return nil, fmt.Errorf("invalid frame length %d", length)
+	}
+	f := &Frame{
+		Type:    hdr[4],
+		Seq:     binary.LittleEndian.Uint64(hdr[5:]),
+		Payload: make([]byte, length-9),
+	}
+	if _, err := io.ReadFull(r, f.Payload); err != nil {
+		return nil, err
+	}
+	return f, nil
+}
+
+// EncodeAck 编码 ACK payload
+func EncodeAck(a *Ack) []byte {
+	buf := make([]byte, ackFixedSize+len(a.Message))
+	buf[0] = a.Status
+	binary.LittleEndian.PutUint32(buf[1:], a.Applied)
+	binary.LittleEndian.PutUint64(buf[5:], a.ApplyNs)
+	copy(buf[ackFixedSize:], a.Message)
+	return buf
+}
+
+// DecodeAck 解码 ACK payload
+func DecodeAck(buf []byte) (*Ack, error) {
+	if len(buf) < ackFixedSize {
+		return nil, fmt.Errorf("ack payload too short")
+	}
+	return &Ack{
+		Status:  buf[0],
+		Applied: binary.LittleEndian.Uint32(buf[1:]),
+		ApplyNs: binary.LittleEndian.Uint64(buf[5:]),
+		Message: string(buf[ackFixedSize:]),
+	}, nil
+}
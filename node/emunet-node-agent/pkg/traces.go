@@ -0,0 +1,244 @@
+package pkg
+
+import (
+	"errors"
+	"fmt"
+	"time"
+
+	"github.com/cilium/ebpf"
+	"golang.org/x/sys/unix"
+)
+
+// ==========================================
+// 轨迹回放 (EMU_TRACE_META / EMU_TRACE_POINTS ARRAY)
+// ==========================================
+
+const (
+	DefaultTraceMetaMapPath   = "/sys/fs/bpf/tc_emu/maps/EMU_TRACE_META"
+	DefaultTracePointsMapPath = "/sys/fs/bpf/tc_emu/maps/EMU_TRACE_POINTS"
+
+	// MaxTraces / MaxTracePoints 需与 maps.h 中的 MAX_TRACES / MAX_TRACE_POINTS 保持一致，0 号轨迹保留
+	MaxTraces      = 64
+	MaxTracePoints = 4096
+
+	// MahimahiMTU 为 Mahimahi 轨迹中每个发送机会对应的字节数
+	MahimahiMTU = 1500
+)
+
+// TraceMeta 与 maps.h 中 struct trace_meta 一一对应
+type TraceMeta struct {
+	StartNs  uint64
+	SlotNs   uint64
+	Len      uint32
+	Reserved uint32
+}
+
+// TracePointValue 与 maps.h 中 struct trace_point 一一对应
+type TracePointValue struct {
+	NsPerByteFP uint64
+	Delay       uint32
+	LossRate    uint32
+}
+
+// TracePoint 为轨迹中的一个点，单位与 LinkParams 相同
+type TracePoint struct {
+	ThrottleRateBps uint64 `json:"throttleRateBps"`
+	Delay           uint32 `json:"delay"`
+	LossRate        uint32 `json:"lossRate"`
+}
+
+// TraceRequest 为一条轨迹的 JSON 表示，Points 与 Mahimahi 二选一。
+// Mahimahi 为毫秒时间戳序列 (每个时间戳表示一次 MTU 发送机会)，按 SlotUs 聚合为速率，
+// 此时 Delay/LossRate 作为所有点的固定时延与丢包率
+type TraceRequest struct {
+	ID     uint32 `json:"id"`
+	SlotUs uint32 `json:"slotUs"`
+	// StartUnixNano 为轨迹第 0 个点对应的墙上时间，多节点使用相同值即可对齐；0 表示立即开始
+	StartUnixNano int64        `json:"startUnixNano,omitempty"`
+	Points        []TracePoint `json:"points,omitempty"`
+	Mahimahi      []uint64     `json:"mahimahi,omitempty"`
+	Delay         uint32       `json:"delay,omitempty"`
+	LossRate      uint32       `json:"lossRate,omitempty"`
+}
+
+// Trace 为解析后的轨迹
+type Trace struct {
+	ID     uint32
+	Meta   TraceMeta
+	Points []TracePointValue
+}
+
+// ParseTraceRequests 校验并转换轨迹请求，任意一条非法则整批拒绝
+func ParseTraceRequests(reqs []TraceRequest) ([]Trace, error) {
+	now, err := ktimeNow()
+	if err != nil {
+		return nil, err
+	}
+	wallNow := time.Now().UnixNano()
+
+	traces := make([]Trace, 0, len(reqs))
+	for _, req := range reqs {
+		if req.ID == 0 || req.ID >= MaxTraces {
+			return nil, fmt.Errorf("%w: trace id %d out of range [1, %d)", ErrInvalidParams, req.ID, MaxTraces)
+		}
+		if req.SlotUs == 0 {
+			return nil, fmt.Errorf("%w: trace %d: slotUs must be non-zero", ErrInvalidParams, req.ID)
+		}
+		slotNs := uint64(req.SlotUs) * 1000
+
+		points := req.Points
+		if len(req.Mahimahi) > 0 {
+			if len(points) > 0 {
+				return nil, fmt.Errorf("%w: trace %d: points and mahimahi are mutually exclusive", ErrInvalidParams, req.ID)
+			}
+			if points, err = MahimahiToPoints(req.Mahimahi, slotNs, req.Delay, req.LossRate); err != nil {
+				return nil, fmt.Errorf("trace %d: %w", req.ID, err)
+			}
+		}
+		if len(points) == 0 || len(points) > MaxTracePoints {
+			return nil, fmt.Errorf("%w: trace %d: %d points, expected [1, %d]", ErrInvalidParams, req.ID, len(points), MaxTracePoints)
+		}
+
+		trace := Trace{
+			ID:   req.ID,
+			Meta: TraceMeta{StartNs: now, SlotNs: slotNs, Len: uint32(len(points))},
+		}
+		if req.StartUnixNano != 0 {
+			// 墙上时间换算到 bpf_ktime_get_ns 的单调时钟
+			start := int64(now) + (req.StartUnixNano - wallNow)
+			if start < 0 {
+				start = 0
+			}
+			trace.Meta.StartNs = uint64(start)
+		}
+		for i, p := range points {
+			if err := ValidateParams(LinkParams{ThrottleRateBps: p.ThrottleRateBps, LossRate: p.LossRate}); err != nil {
+				return nil, fmt.Errorf("trace %d point %d: %w", req.ID, i, err)
+			}
+			trace.Points = append(trace.Points, TracePointValue{
+				NsPerByteFP: NsPerByteFP(p.ThrottleRateBps),
+				Delay:       p.Delay,
+				LossRate:    p.LossRate,
+			})
+		}
+		traces = append(traces, trace)
+	}
+	return traces, nil
+}
+
+// MahimahiToPoints 把 Mahimahi 发送机会时间戳 (ms，循环周期为最后一个时间戳) 按 slotNs 聚合为速率。
+// 没有发送机会的时间片按最低速率处理，包在队列中等待而不是无限速通过
+func MahimahiToPoints(timestampsMs []uint64, slotNs uint64, delay, lossRate uint32) ([]TracePoint, error) {
+	periodNs := timestampsMs[len(timestampsMs)-1] * uint64(time.Millisecond)
+	if periodNs == 0 {
+		return nil, fmt.Errorf("%w: mahimahi trace period is zero", ErrInvalidParams)
+	}
+	slots := (periodNs + slotNs - 1) / slotNs
+	if slots > MaxTracePoints {
+		return nil, fmt.Errorf("%w: mahimahi trace needs %d slots, increase slotUs (max %d points)", ErrInvalidParams, slots, MaxTracePoints)
+	}
+
+	counts := make([]uint64, slots)
+	for _, ts := range timestampsMs {
+		// 时间戳 t 的发送机会处于 (t-1, t] 毫秒内，归入其起点所在的时间片
+		var slot uint64
+		if ts > 0 {
+			slot = ((ts - 1) * uint64(time.Millisecond)) / slotNs
+		}
+		if slot >= slots {
+			slot = slots - 1
+		}
+		counts[slot]++
+	}
+
+	points := make([]TracePoint, slots)
+	for i, n := range counts {
+		rate := n * MahimahiMTU * 8 * uint64(time.Second) / slotNs
+		if rate < MinThrottleRateBps {
+			rate = MinThrottleRateBps
+		}
+		points[i] = TracePoint{ThrottleRateBps: rate, Delay: delay, LossRate: lossRate}
+	}
+	return points, nil
+}
+
+// PutTraces 先批量写入轨迹点，最后写入 meta，数据面只在 meta 更新后才按新长度取点
+func PutTraces(metaMap, pointsMap *ebpf.Map, traces []Trace) (int, error) {
+	for i, trace := range traces {
+		keys := make([]uint32, len(trace.Points))
+		for j := range keys {
+			keys[j] = trace.ID*MaxTracePoints + uint32(j)
+		}
+		_, err := pointsMap.BatchUpdate(keys, trace.Points, nil)
+		if errors.Is(err, ebpf.ErrNotSupported) {
+			for j := range keys {
+				if err = pointsMap.Put(keys[j], trace.Points[j]); err != nil {
+					break
+				}
+			}
+		}
+		if err != nil {
+			return i, err
+		}
+		if err := metaMap.Put(trace.ID, trace.Meta); err != nil {
+			return i, err
+		}
+	}
+	return len(traces), nil
+}
+
+// ResetTraces 清零轨迹 meta，绑定的链路回到自身参数
+func ResetTraces(metaMap *ebpf.Map, ids []uint32) (int, error) {
+	for i, id := range ids {
+		if id == 0 || id >= MaxTraces {
+			return i, fmt.Errorf("%w: trace id %d out of range [1, %d)", ErrInvalidParams, id, MaxTraces)
+		}
+		if err := metaMap.Put(id, TraceMeta{}); err != nil {
+			return i, err
+		}
+	}
+	return len(ids), nil
+}
+
+// TraceStatus 为已加载轨迹的摘要
+type TraceStatus struct {
+	ID       uint32 `json:"id"`
+	SlotUs   uint64 `json:"slotUs"`
+	Points   uint32 `json:"points"`
+	PeriodMs uint64 `json:"periodMs"`
+	// Position 为当前播放到的点
+	Position uint32 `json:"position"`
+}
+
+// GetTrace 读取轨迹摘要，未加载时返回 ebpf.ErrKeyNotExist
+func GetTrace(metaMap *ebpf.Map, id uint32) (*TraceStatus, error) {
+	if id == 0 || id >= MaxTraces {
+		return nil, fmt.Errorf("%w: trace id %d out of range [1, %d)", ErrInvalidParams, id, MaxTraces)
+	}
+	var meta TraceMeta
+	if err := metaMap.Lookup(id, &meta); err != nil {
+		return nil, err
+	}
+	if meta.Len == 0 || meta.SlotNs == 0 {
+		return nil, ebpf.ErrKeyNotExist
+	}
+	status := &TraceStatus{
+		ID:       id,
+		SlotUs:   meta.SlotNs / 1000,
+		Points:   meta.Len,
+		PeriodMs: meta.SlotNs * uint64(meta.Len) / uint64(time.Millisecond),
+	}
+	if now, err := ktimeNow(); err == nil && now > meta.StartNs {
+		status.Position = uint32(((now - meta.StartNs) / meta.SlotNs) % uint64(meta.Len))
+	}
+	return status, nil
+}
+
+// ktimeNow 返回与 bpf_ktime_get_ns 相同时钟 (CLOCK_MONOTONIC) 的当前时间
+func ktimeNow() (uint64, error) {
+	var ts unix.Timespec
+	if err := unix.ClockGettime(unix.CLOCK_MONOTONIC, &ts); err != nil {
+		return 0, fmt.Errorf("failed to read monotonic clock: %v", err)
+	}
+	return uint64(ts.Nano()), nil
+}